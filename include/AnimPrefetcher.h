@@ -0,0 +1,177 @@
+// ============================================================================
+//                             AnimPrefetcher.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "ConditionProgram.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// ============================================================================
+//                              AnimPrefetcher
+// ----------------------------------------------------------------------------
+// A replacement animation is loaded (AnimationFileManager_Load) the first
+// time it's chosen, synchronously, inside the clip generator: with the file
+// not in the OS cache, that's a hitch the first time each DAR animation
+// plays. So when an actor is first seen using a project, the replacements
+// it's likely to get are predicted (see LikelyLink) and read here, on a
+// thread of our own, ahead of time: the game's own load then finds them
+// cached.
+// 
+// Reading is limited to a budget of bytes per second (with a burst
+// allowance) so as not to compete with the game's own streaming, and the
+// last maxFiles files read are remembered (least recently requested first
+// out), so that they aren't read again for every actor.
+// 
+// It knows nothing of the game: it's given a function to read a file with,
+// which a test can replace with a mock.
+// ============================================================================
+class AnimPrefetcher
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	// Reads the file at 'path' (relative to Data), returning the number of
+	// bytes read (0 if it couldn't be).
+	typedef uint64_t (*FileReader)(const std::string& path);
+
+	struct Settings
+	{
+		uint64_t  bytesPerSecond = 8 << 20;   // I/O budget
+		uint64_t  burstBytes = 4 << 20;       // most that can be read at once after idling
+		size_t    maxFiles = 4096;            // files remembered as read (and most queued)
+	};
+
+	explicit AnimPrefetcher(FileReader readFile) : readFile(readFile) {}
+	AnimPrefetcher(const AnimPrefetcher&) = delete;
+	AnimPrefetcher& operator=(const AnimPrefetcher&) = delete;
+	~AnimPrefetcher() { stop(); }
+
+	// Call before start().
+	void configure(const Settings& settings);
+
+	// Starts and stops the thread that reads the queued files. (Without
+	// it, readNext() can be called directly, e.g. by a test.)
+	void start();
+	void stop();
+	bool isRunning() const { return bRunning; }
+
+	// Queues 'path' to be read, unless it's already queued, was read
+	// recently, or the queue is full. Returns true if it was queued.
+	bool request(const std::string& path);
+
+	// Reads the next queued file, if there is one and the budget allows it
+	// at time 'now'. Returns true if a file was read (or failed to be).
+	bool readNext(Clock::time_point now = Clock::now());
+
+	// Number of files queued, read (and how many bytes), and requests
+	// turned away because the file had just been read or the queue was
+	// full.
+	uint64_t numQueued() const { return nQueued; }
+	uint64_t numRead() const { return nRead; }
+	uint64_t bytesRead() const { return nBytesRead; }
+	uint64_t numRecent() const { return nRecent; }
+	uint64_t numDropped() const { return nDropped; }
+	size_t queueSize();
+
+private:
+	FileReader                        readFile;
+	Settings                          settings;
+
+	std::mutex                        lock;          // guards everything below
+	std::condition_variable           wake;
+	std::deque<std::string>           queue;
+	std::unordered_set<std::string>   queued;
+	std::list<std::string>            recent;        // most recently requested first
+	std::unordered_map<std::string, std::list<std::string>::iterator> recentIndex;
+	int64_t                           budget = 0;    // bytes that may be read now (< 0: overdrawn)
+	Clock::time_point                 refilledAt{};
+
+	std::thread                       worker;
+	std::atomic<bool>                 bStop{ false };
+	std::atomic<bool>                 bRunning{ false };
+
+	std::atomic<uint64_t>             nQueued{ 0 };
+	std::atomic<uint64_t>             nRead{ 0 };
+	std::atomic<uint64_t>             nBytesRead{ 0 };
+	std::atomic<uint64_t>             nRecent{ 0 };
+	std::atomic<uint64_t>             nDropped{ 0 };
+
+	void refill(Clock::time_point now);
+	void remember(const std::string& path);
+	void run();
+};
+
+// What makes the actor a candidate for a replacement: its actor base, its
+// race and the types of what's in its hands. These change rarely, if ever,
+// unlike the rest of what conditions test.
+struct ActorProfile
+{
+	uint32_t  baseFormID = 0;
+	uint32_t  raceFormID = 0;
+	float     equippedTypes[2] = {};      // DAR item types (0 = left, 1 = right)
+};
+
+// A replacement that an actor is likely to get, given its profile: an actor
+// base link, or a condition link whose chain (all ANDs) requires a certain
+// actor base, race or equipped type. (Links requiring none of these are
+// left out: they'd predict every file for every actor.)
+struct LikelyLink
+{
+	static constexpr uint8_t kActorBase = 1, kRace = 2, kLeftType = 4, kRightType = 8;
+
+	uint8_t      guards = 0;              // which of the below the link requires
+	uint32_t     actorBaseID = 0;
+	uint32_t     raceID = 0;
+	float        equippedTypes[2] = {};
+	std::string  path;                    // the replacement file (relative to Data)
+
+	bool matches(const ActorProfile& profile) const;
+
+	// The guards that 'program' (compiled against 'layout') places on the
+	// actor. Returns false if it places none, or its guards can't be told
+	// apart from the rest of the chain (i.e. it has ORs).
+	bool guardsFrom(const ConditionProgram& program, const FeatureLayout& layout);
+};
+
+// Reads the profile of 'actor' (through g_gameState).
+void readActorProfile(Actor* actor, ActorProfile& profile_out);
+
+// The prefetcher for the replacement animation files (see
+// DARProjectRegistry.cpp).
+extern AnimPrefetcher g_animPrefetcher;
\ No newline at end of file
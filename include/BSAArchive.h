@@ -0,0 +1,81 @@
+// ============================================================================
+//                               BSAArchive.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ============================================================================
+//                               BSAArchive
+// ----------------------------------------------------------------------------
+// A reader for Skyrim SE / AE archives (BSA version 105). open() streams
+// through the archive's directory (folder records, file records and names)
+// once, keeping only the files in the folders the caller asks for; no file
+// data is read until readFile() is called for a particular file. LZ4
+// compressed files (the SE format) are decompressed on the way out.
+// 
+// The format is as documented at https://en.uesp.net/wiki/Skyrim_Mod:Archive_File_Format
+// ============================================================================
+class BSAArchive
+{
+public:
+	static const uint32_t kVersion = 105;
+
+	struct File
+	{
+		std::string path;          // lower case and '\\' separated, from Data
+		uint32_t    offset;        // of the file's data in the archive
+		uint32_t    size;          // of the file's data in the archive
+		bool        bCompressed;
+	};
+
+	// Reads the directory of the archive at 'archivePath', keeping the
+	// files whose folder (lower case, e.g. "meshes\\actors") 'wantFolder'
+	// accepts. Returns false if there's no such archive, or if it can't be
+	// read, in which case error() says why.
+	bool open(const std::string& archivePath,
+		      const std::function<bool(std::string_view folder)>& wantFolder);
+
+	// Why open() or readFile() failed (NULL if there was simply no archive).
+	const char* error() const { return lastError; }
+
+	const std::string& path() const { return archivePath; }
+	const std::vector<File>& files() const { return fileList; }
+
+	// Reads (and if need be decompresses) one of files().
+	bool readFile(const File& file, std::string& data_out) const;
+
+private:
+	std::string         archivePath;
+	std::vector<File>   fileList;
+	uint64_t            archiveSize = 0;
+	uint32_t            archiveFlags = 0;
+	mutable const char* lastError = NULL;
+};
\ No newline at end of file
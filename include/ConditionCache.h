@@ -0,0 +1,111 @@
+// ============================================================================
+//                             ConditionCache.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "ConditionEvents.h"
+#include "ConditionProgram.h"
+#include "ShardedHashMap.h"
+#include "SpinLock.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// ============================================================================
+//                              ConditionCache
+// ----------------------------------------------------------------------------
+// What an actor's last activation of an animation found, kept so that the
+// next one can skip whatever can't have changed since:
+// 
+//  - static features (read off the actor's base record: IsActorBase,
+//    IsClass, IsFemale, ...) are only read once per actor;
+//  - event driven features (IsEquippedRight, IsWorn, IsInCombat, ...) are
+//    only read again once a matching event has fired for the actor (see
+//    ConditionEvents);
+//  - programs that read none of the other, kActor, features keep their
+//    result until one of the features they read changes: a world feature
+//    (e.g. a global variable) changes value (see ConditionProgram::stamp)
+//    or an event driven one is read again.
+// 
+// Entries are per (actor, layout), and keyed by form ID and layout ID
+// rather than pointers, so an actor being unloaded, or a project being
+// reloaded, can't leave an entry that a different one then picks up.
+// ============================================================================
+class ConditionCache
+{
+public:
+	struct Entry
+	{
+		SpinLock                 lock;               // held by whoever is using the entry
+		uint32_t                 baseFormID = 0;     // actor base it was filled in for
+		bool                     bFilled = false;    // every actor feature in 'features' has been read
+		FeatureVector            features;
+		ConditionEvents::Tick    eventsSeen = 0;     // when the features were last read
+		ActorObservation         observed;           // what the actor looked like then
+
+		uint64_t                 activation = 0;     // number of activations so far
+		uint64_t                 scopeReadAt[(size_t)FeatureScope::kNumScopes] = {};
+		std::vector<uint64_t>    stamps;             // by program index: stamp of its result (0 = none)
+		std::vector<uint64_t>    evaluatedAt;        // (activation)
+		std::vector<uint8_t>     results;
+
+		// Empties the entry, for the given actor base and layout.
+		void reset(uint32_t baseFormID, const FeatureLayout& layout);
+
+		// Starts an activation of actor 'actorID', which currently looks
+		// like 'observed'. Returns the scopes (scopeBit()s) of the features
+		// that have to be read again.
+		uint32_t beginActivation(uint32_t actorID, const ActorObservation& observed,
+			                     ConditionEvents& events);
+
+		// The cached result of 'program', if it is still current given the
+		// program's stamp().
+		bool findResult(const ConditionProgram& program, uint64_t stamp, bool& result_out) const;
+		void setResult(const ConditionProgram& program, uint64_t stamp, bool result);
+	};
+
+	explicit ConditionCache(size_t maxEntries) : maxEntries(maxEntries) {}
+	ConditionCache(const ConditionCache&) = delete;
+	ConditionCache& operator=(const ConditionCache&) = delete;
+
+	// The entry for the given actor (form ID) and layout, adding an empty
+	// one if there isn't one yet. Once there are more than the max entries,
+	// the cache is emptied before adding (entries still in use stay valid).
+	std::shared_ptr<Entry> get(uint32_t actorID, uint32_t layoutID);
+
+	void clear();
+	size_t size() { return entries.size(); }
+
+private:
+	ShardedHashMap<uint64_t, std::shared_ptr<Entry>> entries;
+	std::atomic<size_t>                              nEntries{ 0 };
+	size_t                                           maxEntries;
+};
+
+// The cache used by DARGH::getNewAnimIndex.
+extern ConditionCache g_conditionCache;
\ No newline at end of file
@@ -0,0 +1,129 @@
+// ============================================================================
+//                             ConditionEvents.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "ConditionProgram.h"
+#include "ShardedHashMap.h"
+
+#include <atomic>
+#include <cstdint>
+
+// ============================================================================
+//                             ConditionEvents
+// ----------------------------------------------------------------------------
+// Some of the state that conditions read only ever changes along with a game
+// event: what an actor has equipped (TESEquipEvent), whether it's in combat
+// (TESCombatEvent), ... (the event driven FeatureScopes). This records, per
+// actor, when such events last fired, so that whoever read those features
+// at some point can ask which of them are dirty, i.e. may have changed
+// since, and only read those again (see ConditionCache).
+// 
+// It knows nothing of the game: the game's event sinks (see
+// ConditionEventSinks.cpp) are just one source of notifications, and it can
+// as well be fed directly, e.g. by a test or a benchmark.
+// ============================================================================
+class ConditionEvents
+{
+public:
+	typedef uint64_t Tick;
+
+	static constexpr uint32_t kEventScopes = scopeBit(FeatureScope::kEquipment)
+		                                   | scopeBit(FeatureScope::kCombat)
+		                                   | scopeBit(FeatureScope::kCell);
+
+	explicit ConditionEvents(size_t maxActors) : maxActors(maxActors) {}
+	ConditionEvents(const ConditionEvents&) = delete;
+	ConditionEvents& operator=(const ConditionEvents&) = delete;
+
+	// The time now. Features read after this is taken reflect every event
+	// notified before it.
+	Tick now() { return ++lastTick; }
+
+	// Notifies an event that changed the given scopes (scopeBit()s) of
+	// actor 'actorID', or of every actor (e.g. a game being loaded).
+	void notify(uint32_t actorID, uint32_t scopes);
+	void notifyAll(uint32_t scopes);
+
+	// Says that events changing the given scopes will be notified from now
+	// on. Until they are, those scopes are always dirty.
+	void subscribe(uint32_t scopes) { subscribed |= scopes; }
+
+	// The scopes of actor 'actorID' notified after 'since' (and those that
+	// aren't subscribed).
+	uint32_t dirtyScopes(uint32_t actorID, Tick since);
+
+	// Number of notifications so far.
+	uint64_t numNotified() const { return nNotified; }
+
+private:
+	struct ActorTicks
+	{
+		Tick  ticks[(size_t)FeatureScope::kNumScopes] = {};
+	};
+	ShardedHashMap<uint32_t, ActorTicks>  actors;
+	size_t                                maxActors;
+
+	std::atomic<Tick>                     lastTick{ 0 };
+	std::atomic<Tick>                     allTicks[(size_t)FeatureScope::kNumScopes] = {};
+	std::atomic<uint32_t>                 nPendingAll{ 0 };      // notifyAll()s storing their ticks
+	std::atomic<uint64_t>                 nNotified{ 0 };
+	std::atomic<uint32_t>                 subscribed{ 0 };
+};
+
+// A few cheap reads of an actor's state that show some event driven scopes
+// changing without waiting for (or without there being) an event: its cell
+// (walking between exterior cells doesn't raise one) and what's in its hands.
+struct ActorObservation
+{
+	uint32_t  parentCell = 0;             // form IDs (0 if none)
+	uint32_t  hands[2] = {};              // (0 = left, 1 = right)
+
+	// Scopes (scopeBit()s) in which the two differ.
+	uint32_t changedScopes(const ActorObservation& other) const
+	{
+		uint32_t scopes = 0;
+		if (parentCell != other.parentCell)
+		{
+			scopes |= scopeBit(FeatureScope::kCell);
+		}
+		if (hands[0] != other.hands[0] || hands[1] != other.hands[1])
+		{
+			scopes |= scopeBit(FeatureScope::kEquipment);
+		}
+		return scopes;
+	}
+};
+
+// Reads the observation from 'actor' (through g_gameState).
+void observeActor(Actor* actor, ActorObservation& observation_out);
+
+// The events that the game's sinks notify.
+extern ConditionEvents g_conditionEvents;
+
+// Adds the sinks that notify g_conditionEvents to the game's event sources,
+// and subscribes the scopes they cover (see ConditionEventSinks.cpp).
+bool registerConditionEventSinks();
\ No newline at end of file
@@ -0,0 +1,286 @@
+// ============================================================================
+//                            ConditionProgram.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "Conditions.h"
+#include "LocationAncestry.h"
+#include "MemoryAccounting.h"
+
+#include <cstdint>
+#include <vector>
+
+class WorldState;
+struct WorldSnapshot;
+
+// ============================================================================
+//                             ConditionProgram
+// ----------------------------------------------------------------------------
+// Condition chains compiled to run over a feature vector.
+// 
+// Every condition function used to pull its own state out of the actor (and
+// the world), through the game's virtual calls, each time it was evaluated,
+// and several priorities of the same animation often test the same things:
+// the same actor value, faction, right hand weapon, ... Instead, the chains
+// from one animation share a FeatureLayout listing each distinct thing they
+// read. When a clip is activated, those features are extracted into a
+// FeatureVector once (see extractFeatures), and each chain is then a pure
+// function of that vector: a ConditionProgram. Features that don't depend
+// on the actor are copied from a WorldState snapshot instead.
+// ============================================================================
+
+enum class FeatureKind : uint8_t
+{
+	// Numeric features (FeatureVector::nums). NaN if they can't be read
+	// (e.g. a global variable that doesn't exist).
+	kPredicate,                   // 1 or 0: condition 'funcId' with form ID arg 'param'
+	kCall,                        // 1 or 0: FeatureLayout::calls['param'], evaluated as is
+	kEquippedType,                // DAR item type in hand 'param' (0 = left, 1 = right)
+	kLevel,
+	kMovementDirection,           // 0 = standing still, 1 = forward, ... (see IsMovementDirection)
+	kGameHour,                    // (world) hour of the current game day
+	kActorValue,                  // actor value 'param'
+	kActorValueBase,
+	kActorValueMax,
+	kActorValuePercentage,
+	kFactionRank,                 // rank in faction 'param' (form ID)
+	kGlobalValue,                 // (world) value of global variable 'param' (form ID)
+
+	// Form ID features (FeatureVector::formIDs). 0 if there isn't one.
+	kEquipped,                    // form in hand 'param' (0 = left, 1 = right)
+	kSelectedPower,
+	kActorBase,
+	kRace,
+	kClass,
+	kCombatStyle,
+	kVoiceType,
+	kParentCell,
+	kWorldSpace,
+	kLocationRefType,
+	kCurrentLocation,
+	kWeather,                     // (world)
+};
+
+// What a feature's value depends on, i.e. when it has to be read again.
+enum class FeatureScope : uint8_t
+{
+	kActor,                       // the actor's current state: read at every activation
+	kStatic,                      // only the actor's base record: read once per actor
+	kWorld,                       // not the actor at all (see WorldState)
+
+	// State of the actor that only changes along with some game event
+	// (see ConditionEvents): read again once one has fired for the actor.
+	kEquipment,                   // what it has equipped or is wearing
+	kCombat,                      // whether it's in combat
+	kCell,                        // the cell it's in
+
+	kNumScopes
+};
+
+constexpr uint32_t scopeBit(FeatureScope scope)
+{
+	return 1u << (uint32_t)scope;
+}
+
+struct FeatureKey
+{
+	FeatureKind  kind;
+	uint16_t     funcId;              // (kPredicate only)
+	uint32_t     param;
+
+	bool operator==(const FeatureKey& other) const
+	{
+		return kind == other.kind && funcId == other.funcId && param == other.param;
+	}
+};
+
+// A condition that is evaluated as is, rather than compiled to a test of
+// a shared feature (e.g. Random, which must be drawn for each condition).
+struct ConditionCall
+{
+	uint16_t      funcId;
+	ConditionArg  args[kMaxConditionArgs];
+};
+
+// The features read by a set of condition chains, in slot order.
+struct FeatureLayout
+{
+	uint32_t                    id;           // unique to this layout (see ConditionCache)
+	uint16_t                    nPrograms = 0;
+	std::vector<FeatureKey>     nums;
+	std::vector<FeatureScope>   numScopes;
+	std::vector<FeatureKey>     formIDs;
+	std::vector<FeatureScope>   formIDScopes;
+	std::vector<ConditionCall>  calls;
+
+	// Features that don't depend on the actor: their slots here, and
+	// their slots in the WorldState they're copied from.
+	struct WorldSlot
+	{
+		uint16_t  slot;
+		uint32_t  worldSlot;
+	};
+	std::vector<WorldSlot>      worldNums;
+	std::vector<WorldSlot>      worldFormIDs;
+
+	FeatureLayout();
+
+	// Slot of the given feature, adding it if it isn't already there.
+	uint16_t addNum(FeatureKind kind, uint32_t param = 0, uint16_t funcId = 0,
+		            FeatureScope scope = FeatureScope::kActor);
+	uint16_t addFormID(FeatureKind kind, uint32_t param = 0,
+		               FeatureScope scope = FeatureScope::kActor);
+
+	// As above, for features that don't depend on the actor (registering
+	// them with 'world').
+	uint16_t addWorldNum(FeatureKind kind, uint32_t param, WorldState& world);
+	uint16_t addWorldFormID(FeatureKind kind, uint32_t param, WorldState& world);
+
+	// Slot of a new kCall feature (these are never shared).
+	uint16_t addCall(const ConditionCall& call);
+
+	bool hasWorldFeatures() const
+	{
+		return !worldNums.empty() || !worldFormIDs.empty();
+	}
+
+	// Heap bytes held by the slot lists.
+	size_t numBytes() const
+	{
+		return memBytes(nums) + memBytes(numScopes) + memBytes(formIDs) + memBytes(formIDScopes)
+			+ memBytes(calls) + memBytes(worldNums) + memBytes(worldFormIDs);
+	}
+
+	void clear()
+	{
+		nPrograms = 0;
+		nums.clear(); numScopes.clear(); formIDs.clear(); formIDScopes.clear(); calls.clear();
+		worldNums.clear(); worldFormIDs.clear();
+	}
+};
+
+// Feature values, laid out as in a FeatureLayout.
+struct FeatureVector
+{
+	std::vector<float>     nums;
+	std::vector<uint32_t>  formIDs;
+};
+
+// A numeric operand: a feature, or a value given in the _conditions.txt.
+struct FeatureOperand
+{
+	static const uint16_t kConstant = 0xFFFF;
+
+	uint16_t  slot = kConstant;
+	float     value = 0.0f;
+
+	float get(const FeatureVector& features) const
+	{
+		return slot == kConstant ? value : features.nums[slot];
+	}
+};
+
+struct ConditionOp
+{
+	enum Test : uint8_t
+	{
+		kFalse,                   // always false (e.g. the condition's plugin isn't loaded)
+		kTrue,                    // lhs != 0
+		kEqual,                   // lhs == rhs
+		kLess,                    // lhs < rhs
+		kFormEqual,               // formIDs[lhs.slot] == rhsFormID (and isn't 0)
+		kInLocation,              // location formIDs[lhs.slot] is rhsFormID or inside it
+	};
+
+	uint8_t         test = kFalse;
+	bool            bNot = false;     // result of this condition should be NOTed
+	bool            bAnd = true;      // result of this condition should be ANDed with the next condition
+	FeatureOperand  lhs;
+	FeatureOperand  rhs;
+	uint32_t        rhsFormID = 0;
+
+	bool evaluate(const FeatureVector& features) const
+	{
+		switch (test)
+		{
+		case kTrue:
+			return lhs.get(features) != 0.0f;
+		case kEqual:
+			return lhs.get(features) == rhs.get(features);
+		case kLess:
+			return lhs.get(features) < rhs.get(features);
+		case kFormEqual:
+			return features.formIDs[lhs.slot] != 0
+				&& features.formIDs[lhs.slot] == rhsFormID;
+		case kInLocation:
+			return g_locationAncestry.isIn(features.formIDs[lhs.slot], rhsFormID);
+		}
+		return false;
+	}
+};
+
+struct ConditionProgram
+{
+	std::vector<ConditionOp> ops;
+
+	// Set by link(). A program that reads no kActor features can keep its
+	// result for an actor until one of the features it does read changes:
+	// a world feature (its stamp() changes with them), or one re-read
+	// after an event.
+	uint16_t               index = 0;         // among the programs of its layout
+	uint32_t               readScopes = 0;    // scopeBit()s of the features it reads
+	bool                   bCacheable = false;
+	std::vector<uint32_t>  worldNums;         // world slots it reads
+	std::vector<uint32_t>  worldFormIDs;
+
+	// Evaluates the chain of conditions as DAR does: left to right, with
+	// AND and OR at the same precedence, skipping what can't change the
+	// result.
+	bool evaluate(const FeatureVector& features) const;
+
+	// Call once 'ops' is compiled against 'layout'.
+	void link(FeatureLayout& layout);
+
+	// The latest version of the world features it reads (1 if none).
+	uint64_t stamp(const WorldSnapshot* world) const;
+
+	// Heap bytes held by the program.
+	size_t numBytes() const
+	{
+		return memBytes(ops) + memBytes(worldNums) + memBytes(worldFormIDs);
+	}
+};
+
+// Compiles condition 'funcId' with args 'args' into a test of the features
+// in 'layout' (adding any it needs). The caller sets bNot and bAnd.
+ConditionOp compileCondition(uint16_t funcId, const ConditionArg* args, FeatureLayout& layout);
+
+// Reads the features in 'layout' with the given scopes (scopeBit()s) from
+// 'actor' (through g_gameState) into 'features_out', leaving the others as they are, and copies
+// the world features from 'world' (a snapshot of g_worldState, if the
+// layout has world features).
+void extractFeatures(const FeatureLayout& layout, Actor* actor, const WorldSnapshot* world,
+	                 uint32_t readScopes, FeatureVector& features_out);
\ No newline at end of file
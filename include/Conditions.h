@@ -26,13 +26,107 @@
 // (The MIT License)
 // ============================================================================
 #pragma once
+#include <cstdint>
+#include <string>
 #include <unordered_map>
 
+struct Actor;
+struct TESGlobal;
+
+// The most args any DAR condition function takes (checked against each
+// function's parameter list in Conditions.cpp).
+constexpr uint32_t kMaxConditionArgs = 2;
+
+struct ConditionArg
+{
+	uint32_t  formID = 0;                 // form ID, if the arg was given as "esp name" | formID
+	float     fVal = 0.0f;                // direct value, if the arg was given as a float
+	bool      bIsFloat = false;           // which of the two the arg is
+	const TESGlobal* global = nullptr;    // the global variable 'formID' (if the arg may be one), looked up when binding
+};
+
+// The DAR defined actor state functions. These all test an actor for a
+// specific state and return TRUE or FALSE. Each is listed with the function
+// implementing it (see Conditions.cpp), its number of args and a bit mask of
+// the args that may be floats; Conditions.cpp checks the last two against
+// the function's parameter list.
+#define DAR_CONDITION_FUNCS(X)                                                  \
+    X("IsEquippedRight",                IsEquippedRight,                 1, 0)  \
+    X("IsEquippedRightType",            IsEquippedRightType,             1, 1)  \
+    X("IsEquippedRightHasKeyword",      IsEquippedRightHasKeyword,       1, 0)  \
+    X("IsEquippedLeft",                 IsEquippedLeft,                  1, 0)  \
+    X("IsEquippedLeftType",             IsEquippedLeftType,              1, 1)  \
+    X("IsEquippedLeftHasKeyword",       IsEquippedLeftHasKeyword,        1, 0)  \
+    X("IsEquippedShout",                IsEquippedShout,                 1, 0)  \
+    X("IsWorn",                         IsWorn,                          1, 0)  \
+    X("IsWornHasKeyword",               IsWornHasKeyword,                1, 0)  \
+    X("IsFemale",                       IsFemale,                        0, 0)  \
+    X("IsChild",                        Is_Child,                        0, 0)  \
+    X("IsPlayerTeammate",               IsPlayerTeammate,                0, 0)  \
+    X("IsInInterior",                   IsInInterior,                    0, 0)  \
+    X("IsInFaction",                    IsInFaction,                     1, 0)  \
+    X("HasKeyword",                     HasKeyword,                      1, 0)  \
+    X("HasMagicEffect",                 HasMagicEffect,                  1, 0)  \
+    X("HasMagicEffectWithKeyword",      HasMagicEffectWithKeyword,       1, 0)  \
+    X("HasPerk",                        HasPerk,                         1, 0)  \
+    X("HasSpell",                       HasSpell,                        1, 0)  \
+    X("IsActorValueEqualTo",            IsActorValueEqualTo,             2, 3)  \
+    X("IsActorValueLessThan",           IsActorValueLessThan,            2, 3)  \
+    X("IsActorValueBaseEqualTo",        IsActorValueBaseEqualTo,         2, 3)  \
+    X("IsActorValueBaseLessThan",       IsActorValueBaseLessThan,        2, 3)  \
+    X("IsActorValueMaxEqualTo",         IsActorValueMaxEqualTo,          2, 3)  \
+    X("IsActorValueMaxLessThan",        IsActorValueMaxLessThan,         2, 3)  \
+    X("IsActorValuePercentageEqualTo",  IsActorValuePercentageEqualTo,   2, 3)  \
+    X("IsActorValuePercentageLessThan", IsActorValuePercentageLessThan,  2, 3)  \
+    X("IsLevelLessThan",                IsLevelLessThan,                 1, 1)  \
+    X("IsActorBase",                    IsActorBase,                     1, 0)  \
+    X("IsRace",                         IsRace,                          1, 0)  \
+    X("CurrentWeather",                 CurrentWeather,                  1, 0)  \
+    X("CurrentGameTimeLessThan",        CurrentGameTimeLessThan,         1, 1)  \
+    X("ValueEqualTo",                   ValueEqualTo,                    2, 3)  \
+    X("ValueLessThan",                  ValueLessThan,                   2, 3)  \
+    X("Random",                         Random,                          1, 1)  \
+    X("IsUnique",                       IsUnique,                        0, 0)  \
+    X("IsClass",                        IsClass,                         1, 0)  \
+    X("IsCombatStyle",                  IsCombatStyle,                   1, 0)  \
+    X("IsVoiceType",                    IsVoiceType,                     1, 0)  \
+    X("IsAttacking",                    IsAttacking,                     0, 0)  \
+    X("IsRunning",                      IsRunning,                       0, 0)  \
+    X("IsSneaking",                     IsSneaking,                      0, 0)  \
+    X("IsSprinting",                    IsSprinting,                     0, 0)  \
+    X("IsInAir",                        IsInAir,                         0, 0)  \
+    X("IsInCombat",                     IsInCombat,                      0, 0)  \
+    X("IsWeaponDrawn",                  IsWeaponDrawn,                   0, 0)  \
+    X("IsInLocation",                   IsInLocation,                    1, 0)  \
+    X("HasRefType",                     HasRefType,                      1, 0)  \
+    X("IsParentCell",                   IsParentCell,                    1, 0)  \
+    X("IsWorldSpace",                   IsWorldSpace,                    1, 0)  \
+    X("IsFactionRankEqualTo",           IsFactionRankEqualTo,            2, 1)  \
+    X("IsFactionRankLessThan",          IsFactionRankLessThan,           2, 1)  \
+    X("IsMovementDirection",            IsMovementDirection,             1, 1)
+
+enum ConditionFuncId : uint16_t
+{
+#define X(name, func, nArgs, bmArgIsFloat) kCondition_##func,
+    DAR_CONDITION_FUNCS(X)
+#undef X
+    kNumConditionFuncs
+};
+
 struct FuncInfo
 {
-	void*     funcPtr;
-	uint32_t  nArgs;
-	uint32_t  bmArgIsFloat;
+	uint16_t  funcId;                     // what to pass to evaluateCondition()
+	uint32_t  nArgs;                      // number of args the function takes
+	uint32_t  bmArgIsFloat;               // bit mask - if the bit is set, the corresponding arg may be a float
 };
 
-extern std::unordered_map<std::string, FuncInfo> g_DARConditionFuncs;
\ No newline at end of file
+// The functions by name (see ConditionProgram.cpp).
+extern std::unordered_map<std::string, FuncInfo> g_DARConditionFuncs;
+
+// Implemented alongside the condition functions (see Conditions.cpp).
+// 
+// The global variable with the given form ID, or NULL if there isn't one.
+const TESGlobal* lookupGlobal(uint32_t formID);
+
+// Call condition function 'funcId' with its (nArgs) stored args.
+bool evaluateCondition(uint16_t funcId, Actor* actor, const ConditionArg* args);
\ No newline at end of file
@@ -0,0 +1,89 @@
+// ============================================================================
+//                            ConditionsParser.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ============================================================================
+// The result of the syntax pass over a _conditions.txt file. This is
+// everything that can be worked out from the text alone; matching function
+// names against g_DARConditionFuncs and resolving mod names against the load
+// order happens later, when the conditions are bound (see DARProject.cpp).
+// That split lets DAR bundles (see DARBundle.h) store this, precompiled.
+// 
+// All the string_views point into whatever holds the text (the file buffer,
+// or a mapped bundle).
+// ============================================================================
+struct ParsedConditionArg
+{
+	std::string_view modName;          // form ID args: mod name (no quotes)
+	uint32_t         formBaseID = 0;   // form ID args: ID within that mod
+	float            fVal = 0.0f;      // float args
+	bool             bIsFormID = false;
+};
+
+struct ParsedCondition
+{
+	std::string_view line;             // the whole line, for error messages
+	std::string_view funcName;
+	uint32_t         firstArg = 0;     // index into ParsedConditions::args
+	uint32_t         nArgs = 0;
+	bool             bNot = false;
+	bool             bAnd = true;
+	bool             bBlankArgs = false;   // just whitespace between the ()
+};
+
+struct ParsedConditions
+{
+	std::vector<ParsedCondition>    conditions;
+	std::vector<ParsedConditionArg> args;
+	std::string_view                syntaxErrorLine;   // empty if none
+
+	void clear()
+	{
+		conditions.clear();
+		args.clear();
+		syntaxErrorLine = std::string_view();
+	}
+};
+
+namespace DARGH
+{
+	// The syntax pass. Parses the text of a _conditions.txt file into
+	// 'parsed_out', stopping at the first syntax error (if any), which is
+	// recorded in parsed_out.syntaxErrorLine. Returns false if there was one.
+	// Doesn't need the game.
+	bool parseConditionSyntax(std::string_view text, ParsedConditions& parsed_out);
+
+	// Reads the whole of a _conditions.txt file into 'text_out' (whose
+	// capacity is reused between calls), up to any Ctrl+Z. Returns false if
+	// the file can't be opened.
+	bool readConditionsFile(const std::string& path, std::string& text_out);
+}
\ No newline at end of file
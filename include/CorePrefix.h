@@ -0,0 +1,115 @@
+// ============================================================================
+//                               CorePrefix.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+// Force-included into every file of the portable core when it's built on its
+// own (see CMakeLists.txt), in place of SKSE/IPrefix.h: supplies the logging
+// functions of SKSE/IDebugLog.h, and the MSVC string functions the core
+// uses. The log goes to stderr unless redirected with setCoreLog.
+#pragma once
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#ifndef _WIN32
+#include <strings.h>
+#endif
+
+enum class CoreLogLevel
+{
+	kFatalError,
+	kError,
+	kWarning,
+	kMessage,
+	kVerboseMessage,
+	kDebugMessage
+};
+
+// Writes the core's log to 'f' (NULL to discard it).
+void setCoreLog(FILE* f);
+
+void coreLog(CoreLogLevel level, const char* fmt, va_list args);
+
+inline void _FATALERROR(const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	coreLog(CoreLogLevel::kFatalError, fmt, args);
+	va_end(args);
+}
+
+inline void _ERROR(const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	coreLog(CoreLogLevel::kError, fmt, args);
+	va_end(args);
+}
+
+inline void _WARNING(const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	coreLog(CoreLogLevel::kWarning, fmt, args);
+	va_end(args);
+}
+
+inline void _MESSAGE(const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	coreLog(CoreLogLevel::kMessage, fmt, args);
+	va_end(args);
+}
+
+inline void _VMESSAGE(const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	coreLog(CoreLogLevel::kVerboseMessage, fmt, args);
+	va_end(args);
+}
+
+inline void _DMESSAGE(const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	coreLog(CoreLogLevel::kDebugMessage, fmt, args);
+	va_end(args);
+}
+
+#ifndef _WIN32
+inline int _strnicmp(const char* str1, const char* str2, size_t count)
+{
+	return strncasecmp(str1, str2, count);
+}
+
+inline int _stricmp(const char* str1, const char* str2)
+{
+	return strcasecmp(str1, str2);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+// ============================================================================
+//                            DARAnimationNames.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "DARProject.h"
+
+#include <cstdint>
+#include <vector>
+
+// ============================================================================
+//                            DARAnimationNames
+// ----------------------------------------------------------------------------
+// Rebuilding a project's animationNames array with its DAR replacements,
+// and a link index to match (see DARLinkIndex). GenAnimation_Hook does
+// this each time the game generates the project's animations, and hands
+// the new array to the game in place of the original; the rebuild itself
+// never touches the game, so it can also be run (and timed) on synthetic
+// names.
+// ============================================================================
+
+// A remap (M1 or M2) that didn't get a replacement slot.
+struct DroppedRemap
+{
+	int       priority;                   // DAR priority (M1 links are always 0)
+	PathID    from_hkx_file;
+	PathID    to_hkx_file;
+};
+
+// What a rebuild produced.
+struct AnimationNames
+{
+	char**    names = NULL;               // the new array (NULL if there were no replacements)
+	uint32_t  nNames = 0;                 // its size: the originals, then one per unique TO file
+	uint32_t  nOrig = 0;                  // number of original names
+	uint32_t  nM1Remaps = 0;              // remaps found, given slots or not
+	uint32_t  nM2Remaps = 0;
+	uint32_t  nRemaps = 0;                // remaps given slots
+	uint32_t  nWanted = 0;                // names there would have been with no limit
+	uint32_t  nRefusedFiles = 0;          // unique TO files that got no slot
+	std::vector<DroppedRemap> dropped;    // remaps that got no slot, lowest priority first
+};
+
+// The most names an array can hold: the game's binding indices are hkInt16s.
+const uint32_t kMaxAnimationNames = 0x7FFF;
+
+namespace DARGH
+{
+	// Rebuilds the array from 'links' for the project's original animation
+	// names 'origNames' (nOrig of them), giving out replacement slots until
+	// the array holds 'maxNames' names (at most kMaxAnimationNames), and
+	// publishes the link index for it in darProj.linkIndexes.
+	// The new array is allocated with operator new, for the game to own.
+	void rebuildAnimationNames(DARProject& darProj, const DARLinkTable& links,
+		                       const char* const* origNames, uint32_t nOrig,
+		                       uint32_t maxNames, AnimationNames& names_out);
+}
\ No newline at end of file
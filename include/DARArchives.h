@@ -0,0 +1,76 @@
+// ============================================================================
+//                               DARArchives.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "BSAArchive.h"
+#include "DirSnapshot.h"
+
+#include <map>
+#include <memory>
+
+// ============================================================================
+//                               DARArchives
+// ----------------------------------------------------------------------------
+// The DAR files packed inside the load order's BSA archives. DAR only ever
+// looked at loose files, so a mod that shipped its DynamicAnimationReplacer
+// folder in a BSA had to be unpacked first. At startup we read the
+// directory of each plugin's archive, keep the entries under a
+// DynamicAnimationReplacer folder, and merge those into the loose file
+// snapshots; nothing is extracted to disk.
+// 
+// As with the game, a later archive overrides an earlier one and loose files
+// override them all.
+// ============================================================================
+class DARArchives
+{
+public:
+	// Adds the DAR files in the archive at 'archivePath', overriding any
+	// already added with the same path. Returns false if it couldn't be
+	// read (a missing archive isn't an error).
+	bool addArchive(const std::string& archivePath);
+
+	// Adds the .hkx files beneath 'darDir' (a DynamicAnimationReplacer
+	// folder, relative to Data, e.g. "meshes\\actors\\character\\animations
+	// \\DynamicAnimationReplacer") to 'darTree', which is a snapshot of the
+	// same folder's loose files. If 'subDir' isn't empty, only the files
+	// beneath darDir\\subDir are added (cf. DirSnapshot::build).
+	void mergeInto(const std::string& darDir, DirSnapshot& darTree,
+		           const std::string& subDir = "") const;
+
+	// Reads the file at 'path' (relative to Data; case insensitive).
+	// Returns false if no archive has it, or it couldn't be read.
+	bool readFile(const std::string& path, std::string& data_out) const;
+
+	size_t numArchives() const { return archives.size(); }
+	size_t numFiles() const { return files.size(); }
+
+private:
+	std::vector<std::unique_ptr<BSAArchive>> archives;
+
+	// Lower case path -> the archive (and entry) that wins.
+	std::map<std::string, std::pair<const BSAArchive*, const BSAArchive::File*>> files;
+};
\ No newline at end of file
@@ -0,0 +1,110 @@
+// ============================================================================
+//                                DARBundle.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "ConditionsParser.h"
+#include "DirSnapshot.h"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+//                                DARBundle
+// ----------------------------------------------------------------------------
+// A DAR bundle (.darb) is a precompiled image of one project's
+// DynamicAnimationReplacer folder: the folder tree (directories and .hkx files
+// only) plus, for each _CustomConditions\<Priority> folder, its
+// _conditions.txt after the syntax pass. Mod names in the conditions are kept
+// as written, so a bundle doesn't depend on the load order; functions and mods
+// are still bound at data load, exactly as for loose files.
+// 
+// Bundles are made offline with the darbundle tool (tools/darbundle), which
+// also runs on Linux. The plugin looks for
+// 
+//     data\meshes\(project folder)\animations\DynamicAnimationReplacer.darb
+// 
+// and, if it finds one, maps it and uses it *instead of* walking the folder
+// and reading every _conditions.txt. The .hkx files themselves must still be
+// there (the game loads them). Rebuild the bundle whenever the folder changes.
+// 
+// Layout (little endian, each section 4 byte aligned; see DARBundle.cpp):
+//   Header
+//   DirSnapshot::Node[nNodes]      char names[namesSize]
+//   CondFile[nCondFiles]           Condition[nConditions]
+//   Arg[nArgs]                     char strings[stringsSize]
+// ============================================================================
+class DARBundle
+{
+public:
+	static const uint32_t kVersion = 1;
+
+	DARBundle() = default;
+	DARBundle(const DARBundle&) = delete;
+	DARBundle& operator=(const DARBundle&) = delete;
+	~DARBundle() { close(); }
+
+	// Maps the bundle at 'path' (an image of the folder 'darDir'). Returns
+	// false if there is no bundle there, or if it can't be used, in which
+	// case error() says why.
+	bool open(const std::string& path, const std::string& darDir);
+	void close();
+
+	// Why open() failed (NULL if there was simply no bundle).
+	const char* error() const { return openError; }
+
+	// The folder tree, as it was when the bundle was made.
+	const DirSnapshot& tree() const { return darTree; }
+
+	// Gets the parsed _conditions.txt from the priority folder 'sPriority'.
+	// Returns false if that folder had none. The string_views in
+	// 'parsed_out' point into the bundle.
+	bool getConditions(const std::string& sPriority, ParsedConditions& parsed_out) const;
+
+	size_t numBytes() const { return mapSize; }
+
+	// Writes a bundle of 'darTree' and the parsed _conditions.txt files in
+	// 'condFiles' (keyed by priority folder name) to 'path'.
+	static bool write(const std::string& path, const DirSnapshot& darTree,
+		              const std::vector<std::pair<std::string, ParsedConditions>>& condFiles);
+
+private:
+	const char*  pMap = NULL;
+	size_t       mapSize = 0;
+	const char*  openError = NULL;
+#ifdef _WIN32
+	void*        hFile = NULL;
+	void*        hMapping = NULL;
+#endif
+	DirSnapshot  darTree;
+	std::unordered_map<std::string_view, uint32_t> condFileByPriority;
+
+	bool mapFile(const std::string& path);
+	bool validate();
+};
\ No newline at end of file
@@ -0,0 +1,51 @@
+// ============================================================================
+//                              DARHotReload.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "DARProject.h"
+
+#include <string>
+#include <vector>
+
+namespace DARGH
+{
+	// Turns hot reloading on. From then on each project loaded from its
+	// DAR folder (rather than from a bundle) is watched, and changes to it
+	// are applied on a background thread.
+	void startDARHotReload();
+
+	// Starts watching 'darDir', the project's DynamicAnimationReplacer
+	// folder, if hot reloading is on.
+	void watchDARProject(DARProject& darProj, const std::string& darDir);
+
+	// The folders (relative to a DynamicAnimationReplacer folder) that
+	// have to be reloaded after changes to 'changedPaths': a priority
+	// folder, an actor base folder, an esp folder, or "" for all of it.
+	// Folders inside others in the list are left out.
+	void foldersToReload(const std::vector<std::string>& changedPaths,
+		                 std::vector<std::string>& folders_out);
+}
\ No newline at end of file
@@ -26,20 +26,21 @@
 // (The MIT License)
 // ============================================================================
 #pragma once
-#include "RE/A/Actor.h"
-#include "RE/B/BSSpinLock.h"
-#include "RE/H/hkbCharacterStringData.h"
-#include "RE/H/hkbProjectData.h"
+#include "ConditionCache.h"
+#include "ConditionProgram.h"
+#include "PathTable.h"
+#include "RE/H/hkTypes.h"
 
 #include <vector>
 #include <unordered_map>
-#include <variant>
+
+struct Actor;
 
 // Used for actor base data (method 1) ------------
 struct ActorBaseLink
 {
-	std::string   from_hkx_file;                           // animation file path to map FROM
-	std::string   to_hkx_file;                             // animation file path to map TO
+	PathID        from_hkx_file = 0;                       // animation file path to map FROM (in g_pathTable)
+	PathID        to_hkx_file = 0;                         // animation file path to map TO (in g_pathTable)
 	uint32_t      actorBaseID = 0;                         // complete actor form ID: i.e. modIndex | (actor base)
 };
 // ------------------------------------------------
@@ -47,9 +48,8 @@ struct ActorBaseLink
 // Used for condition data (method 2) -------------
 struct ConditionLinkFunc
 {
-	void* funcPtr;                                         // function pointer
-	std::vector<std::variant<uint32_t, float>> args;       // function args: form IDs (unsigned ints) or floats
-	uint32_t bmArgIsFloat;                                 // bit mask - if the bit is set, the corresponding arg is a float.
+	uint16_t funcId;                                       // function to call (see FuncInfo)
+	ConditionArg args[kMaxConditionArgs];                  // function args: form IDs or floats
 	bool bNot = false;                                     // result of this condition should be NOTed
 	bool bAnd = true;                                      // result of this condition should be ANDed with the next condition
 	bool bESPNotLoaded = false;                            // mod associated with this condition is not loaded.
@@ -57,36 +57,49 @@ struct ConditionLinkFunc
 
 struct ConditionLink
 {
-	std::string from_hkx_file;                             // animation file path to map FROM
-	std::string to_hkx_file;                               // animation file path to map TO
+	PathID from_hkx_file = 0;                              // animation file path to map FROM (in g_pathTable)
+	PathID to_hkx_file = 0;                                // animation file path to map TO (in g_pathTable)
 	int32_t priority;                                      // condition link's priority
 	std::vector<ConditionLinkFunc> conditions;             // conditions to evaluate
 };
 // ------------------------------------------------
 
+// What the links from one animation are evaluated with.
+struct LinkContext
+{
+	const FeatureVector&    features;   // the actor's features, as listed in the animation's layout
+	const WorldSnapshot*    world;      // the snapshot the world features came from (NULL if none)
+	ConditionCache::Entry*  cached;     // the actor's cache entry (NULL if not caching)
+	uint32_t                baseFormID; // the actor's base form ID (0 if none)
+};
+
 class LinkData
 {
 public:
-	virtual hkInt16 getNewAnimIndex(Actor* actor) = 0;
+	virtual ~LinkData() = default;
+
+	virtual hkInt16 getNewAnimIndex(const LinkContext& context) = 0;
+
+	// Bytes held, the object's own included (see MemoryAccounts).
+	virtual size_t numBytes() const = 0;
 };
 
 class BaseLinkData : public LinkData
 {
 public:
 	// key: actor base form ID, val: to_hkx_index
-	std::unordered_map<uint32_t, uint16_t> allLinks;
+	std::unordered_map<uint32_t, hkInt16> allLinks;
 
-	hkInt16 getNewAnimIndex(Actor* actor) override
+	hkInt16 getNewAnimIndex(const LinkContext& context) override
 	{
-		TESForm* baseForm = actor->ref.baseForm;
-		if (!baseForm) {
+		if (!context.baseFormID) {
 			// Base form is invalid (NULL)
 			return -1;
 		}
 
 		// Try to find a mapped index for the
 		// given actor base form ID.
-		auto& search = allLinks.find(baseForm->formID);
+		auto search = allLinks.find(context.baseFormID);
 		if (search == allLinks.end())
 		{
 			// Not found.
@@ -94,86 +107,66 @@ public:
 		}
 		return search->second;
 	}
+
+	size_t numBytes() const override
+	{
+		return sizeof(*this) + memBytes(allLinks);
+	}
 };
 
 class ConditionLinkData : public LinkData
 {
 public:
-	std::vector<ConditionLinkFunc> conditions;
-	uint16_t to_hkx_index;
+	ConditionProgram program;
+	hkInt16 to_hkx_index;
 
-private:
-	bool evaluateConditions(std::vector<ConditionLinkFunc> vecFuncData, Actor* actor)
+	// Compiles 'conditions' into 'program', adding the features they read
+	// to 'layout'.
+	void compile(const std::vector<ConditionLinkFunc>& conditions, FeatureLayout& layout)
 	{
-		bool bTrueOr = false;    // If true the last evaluated expression was true || ...
-		bool bCond;
-
-		// Evaluate the chain of conditions.
-		for (auto& curFuncData : vecFuncData)
+		program.ops.clear();
+		for (auto& condition : conditions)
 		{
-			if (bTrueOr)
-			{
-				// Don't need to evaluate this expression.
-
-				// We have true || ... which evaluates to true, 
-				// irrespective of what the second expression is. 
-				// So don't waste time evaluating it. Move onto the next one.
-				if (curFuncData.bAnd)
-				{
-					// This breaks our ability to avoid evaluating.
-					// We now have (true || ... && ...) == (true && ...)
-					bTrueOr = false;
-				}
-			}
-			else
+			ConditionOp op;
+			if (!condition.bESPNotLoaded)
 			{
-				// Need to evaluate this expression.
-				if (curFuncData.bESPNotLoaded)
-				{
-					bCond = false;
-				}
-				else
-				{
-					bCond =
-						((bool(__fastcall*)(Actor*, std::variant<uint32_t, float>*, uint32_t))curFuncData.funcPtr)
-						(actor, curFuncData.args.data(), curFuncData.bmArgIsFloat);
-				}
-
-				if (bCond == curFuncData.bNot)
-				{
-					// We have either
-					//   !true or false
-					// both of which evaluate to false.
-					if (curFuncData.bAnd)
-					{
-						// We have false && ...
-						// which always evaluates to false.
-						// No need to evaluate any further expressions.
-						return false;
-					}
-
-					// We have false || ...
-					// Need to evaluate the next expression.
-				}
-				else
-				{
-					// We have true (&& or ||) ...
-					// If we have true || ... we don't need
-					// to evaluate the next condition.
-					bTrueOr = !curFuncData.bAnd;
-				}
+				op = compileCondition(condition.funcId, condition.args, layout);
 			}
+			op.bNot = condition.bNot;
+			op.bAnd = condition.bAnd;
+			program.ops.push_back(op);
 		}
-		return true;
+		program.link(layout);
 	}
 
-public:
-	hkInt16 getNewAnimIndex(Actor* actor) override
+	hkInt16 getNewAnimIndex(const LinkContext& context) override
 	{
-		if (evaluateConditions(conditions, actor)) {
+		bool bResult;
+		if (context.cached && program.bCacheable)
+		{
+			// Reuse the result from an earlier activation of the actor,
+			// unless a feature it read has changed since.
+			uint64_t stamp = program.stamp(context.world);
+			if (!context.cached->findResult(program, stamp, bResult))
+			{
+				bResult = program.evaluate(context.features);
+				context.cached->setResult(program, stamp, bResult);
+			}
+		}
+		else
+		{
+			bResult = program.evaluate(context.features);
+		}
+
+		if (bResult) {
 			// Conditions evaluated to true, return the mapped index.
 			return to_hkx_index;
 		}
 		return -1;
 	}
+
+	size_t numBytes() const override
+	{
+		return sizeof(*this) + program.numBytes();
+	}
 };
\ No newline at end of file
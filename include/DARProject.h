@@ -26,34 +26,138 @@
 // (The MIT License)
 // ============================================================================
 #pragma once
+#include "AnimPrefetcher.h"
 #include "DARLink.h"
+#include "DARArchives.h"
+#include "DARBundle.h"
+#include "DirSnapshot.h"
+#include "LoadOrderIndex.h"
+#include "MemoryAccounting.h"
+#include "ShardedHashMap.h"
+#include "SpinLock.h"
+#include "StartupTimes.h"
 
-#include "RE/T/TESDataHandler.h"
-
+#include <atomic>
 #include <map>
+#include <memory>
 #include <unordered_map>
 
-struct DARProject
+struct hkbProjectData;
+
+// A project's compiled links. Once published (in DARProject::links) a
+// table is never modified: reloading a project builds a new table and
+// swaps it in, so a graph being generated keeps whichever table it started
+// with.
+struct DARLinkTable
 {
-	// Maps from (from_hkx_index => ordered map with (priority => LinkData))
-	// N.B. higher numbers == higher priority so we want them to appear
-	// first when iterating, which is why we use the custom comparator
-	std::unordered_map<
-		uint32_t,
-		std::map<int, LinkData*, std::greater<int>>
-	> allLinks;
 	std::vector<ActorBaseLink> actorBaseLinks;
 	std::vector<ConditionLink> conditionLinks;
+
+	// What the vectors hold, charged to the table's project until the
+	// table is dropped.
+	MemoryCharge linksCharge;
+	MemoryCharge conditionsCharge;
+
+	// Charges project 'projectID' with the table (once it's complete).
+	void account(uint32_t projectID)
+	{
+		size_t conditionBytes = 0, nConditions = 0;
+		for (auto& link : conditionLinks)
+		{
+			conditionBytes += memBytes(link.conditions);
+			nConditions += link.conditions.size();
+		}
+		linksCharge.set(projectID, MemCategory::kLinkVectors,
+			            memBytes(actorBaseLinks) + memBytes(conditionLinks),
+			            actorBaseLinks.size() + conditionLinks.size());
+		conditionsCharge.set(projectID, MemCategory::kConditionArgs, conditionBytes, nConditions);
+	}
+};
+
+// The links from one animation, and the features their conditions read
+// (extracted once per activation: see DARGH::getNewAnimIndex).
+struct AnimLinks
+{
+	// Ordered map with (priority => LinkData)
+	// N.B. higher numbers == higher priority so we want them to appear
+	// first when iterating, which is why we use the custom comparator
+	std::map<int, LinkData*, std::greater<int>> byPriority;
+	FeatureLayout features;
+};
+
+// The links of one rebuilt animationNames array (see DARAnimationNames.h),
+// with the binding indices that array gives their TO files. Like a
+// DARLinkTable, never modified once published: each rebuild publishes a
+// new index, so a graph generated with an earlier array keeps the links
+// that match it.
+struct DARLinkIndex
+{
+	// Maps from (from_hkx_index => links from that animation)
+	std::unordered_map<uint32_t, AnimLinks> allLinks;
+	uint32_t nNames = 0;                      // size of the array
+
+	// The replacements an actor is likely to want (see AnimPrefetcher).
+	std::vector<LikelyLink> likelyLinks;
+
+	// What allLinks holds, charged to the project (as leaked once a later
+	// rebuild supersedes the index).
+	mutable MemoryCharge linksCharge;
+
+	DARLinkIndex() = default;
+	DARLinkIndex(const DARLinkIndex&) = delete;
+	DARLinkIndex& operator=(const DARLinkIndex&) = delete;
+	~DARLinkIndex();
+};
+
+struct DARProject
+{
 	std::string projFolder;
+	uint32_t id = 0;                          // unique among the registered projects
 	hkbProjectData* projData = NULL;
 	bool animationsLoaded = false;
+
+	// The project's links, loaded the first time the project is used (see
+	// DARGH::ensureDARMapsLoaded) under loadLock; mapsLoaded is set once
+	// they've been published. Read with std::atomic_load and replaced
+	// (e.g. by a hot reload) with std::atomic_store.
+	std::shared_ptr<const DARLinkTable> links;
+	std::atomic<bool> mapsLoaded{ false };
+	SpinLock loadLock;
+
+	// The link index of each animationNames array rebuilt for the project,
+	// by the array's data (see DARGH::findLinkIndex), and the latest one
+	// (read with std::atomic_load).
+	ShardedHashMap<const void*, std::shared_ptr<const DARLinkIndex>> linkIndexes;
+	std::shared_ptr<const DARLinkIndex> latestLinkIndex;
 };
 
 namespace DARGH
 {
-	void loadDARMaps_ActorBase(DARProject& darProj,
-		                       TESDataHandler* dh, std::string darDir);
+	// Both loaders add the project's links to 'links_out'. They resolve
+	// plugin names with 'loadOrder', not the data handler, so they can be
+	// run on any thread. If 'times' isn't NULL, they add their file counts
+	// (and the conditional loader its parse and folder times) to it.
+	void loadDARMaps_ActorBase(const DARProject& darProj, const LoadOrderIndex& loadOrder,
+		                       const DirSnapshot& darTree, DARLinkTable& links_out,
+		                       ProjectLoadTimes* times = NULL);
+
+	// 'darBundle' is the project's bundle, if any (and then 'darTree' is
+	// its tree); otherwise the _conditions.txt files are read from disk,
+	// or failing that from 'darArchives' (if not NULL).
+	void loadDARMaps_Conditional(const DARProject& darProj, const LoadOrderIndex& loadOrder,
+		                         const DirSnapshot& darTree, const DARBundle* darBundle,
+		                         const DARArchives* darArchives, DARLinkTable& links_out,
+		                         ProjectLoadTimes* times = NULL);
+
+	// The link index of the project's rebuilt animationNames array whose
+	// data is 'names' (nNames of them), or NULL if the array isn't one the
+	// project rebuilt (e.g. there were no replacements for it).
+	std::shared_ptr<const DARLinkIndex> findLinkIndex(DARProject& darProj, const void* names,
+		                                              uint32_t nNames);
 
-	void loadDARMaps_Conditional(DARProject& darProj,
-		                         TESDataHandler* dh, std::string darDir);
+	// Queues the replacement files 'actor' is likely to want from 'darProj'
+	// (going by 'linkIndex') with g_animPrefetcher, the first time it's
+	// seen using the project.
+	void prefetchLikelyAnimations(const DARProject& darProj, const DARLinkIndex& linkIndex,
+		                          Actor* actor);
 }
\ No newline at end of file
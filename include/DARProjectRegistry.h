@@ -35,5 +35,30 @@ namespace DARGH
 
 	DARProject* getDARProject(hkbProjectData* projData);
 	void registerDARProject(std::string& projectFilePath);
-	hkInt16 getNewAnimIndex(DARProject* darProj, hkInt16 origAnimIndex, Actor* actor);
+
+	// Records what the loaders will need: the Data folder (ending in a
+	// separator), the load order, and the archives of the active plugins
+	// (in load order). Called once the game's data is loaded, after the
+	// projects have been registered.
+	void initDARLoading(const std::string& dataDir, LoadOrderIndex loadOrder,
+		                std::vector<std::string> archivePaths);
+
+	// Loads the project's DAR maps, unless that's already been done. Safe
+	// to call from any thread; if another thread is part way through
+	// loading them, waits for it to finish.
+	void ensureDARMapsLoaded(DARProject& darProj);
+
+	// Reloads the given folders of a project whose maps have been loaded
+	// (relative to its DynamicAnimationReplacer folder; "" for all of
+	// them), then publishes its new link table.
+	void reloadDARMaps(DARProject& darProj, const std::vector<std::string>& subDirs);
+
+	// Loads the DAR maps for the given (registered) projects on a
+	// background thread.
+	void warmDARProjects(const std::vector<std::string>& projFilePaths);
+
+	// The replacement for animation 'origAnimIndex' of a graph generated
+	// with the animationNames array that 'linkIndex' was built for, or -1.
+	hkInt16 getNewAnimIndex(DARProject* darProj, const DARLinkIndex& linkIndex,
+		                    hkInt16 origAnimIndex, Actor* actor);
 }
\ No newline at end of file
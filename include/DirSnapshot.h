@@ -0,0 +1,153 @@
+// ============================================================================
+//                               DirSnapshot.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ============================================================================
+//                               DirSnapshot
+// ----------------------------------------------------------------------------
+// An in-memory snapshot of a directory tree, taken with a single walk of the
+// file system. The DAR loaders used to call findMatchingFiles over and over
+// on overlapping subtrees of each DynamicAnimationReplacer folder (first to
+// find the priority/esp folders, then again, recursively, for the .hkx files
+// in each of them), building half a dozen temporary strings per entry each
+// time. Now the tree is read once and all the loaders query the snapshot.
+// 
+// Nodes live in one array and refer to each other by index; all of the
+// names live in one contiguous character arena. Children keep the order the
+// file system enumerated them in, so queries return exactly what
+// findMatchingFiles would have (in the same order).
+// 
+// Because the two arrays are position independent, they can also be written
+// out as is and later attached to straight from memory (see DARBundle.h).
+// 
+// On Windows the walk uses FindFirstFileExA with FindExInfoBasic (no 8.3
+// names) and FIND_FIRST_EX_LARGE_FETCH. Elsewhere (i.e. the Linux test
+// build) it uses std::filesystem.
+// ============================================================================
+class DirSnapshot
+{
+public:
+	static const uint32_t kNoNode = 0xFFFFFFFF;
+
+	// N.B. written to DAR bundles as is - don't change the layout without
+	// bumping DARBundle's version.
+	struct Node
+	{
+		uint32_t nameOffset;                  // into the names arena
+		uint32_t nameLength;
+		uint32_t firstChild;
+		uint32_t nextSibling;
+		uint32_t isDir;
+	};
+
+	DirSnapshot() = default;
+	DirSnapshot(const DirSnapshot&) = delete;
+	DirSnapshot& operator=(const DirSnapshot&) = delete;
+
+	// Walks 'rootDir' and everything beneath it. If 'fileExt' isn't empty,
+	// only files whose names end in it (case sensitive) are kept. Returns
+	// false (and leaves an empty snapshot) if 'rootDir' can't be opened.
+	// 
+	// If 'subDir' ('\\' separated, relative to the root) isn't empty, only
+	// that folder is walked; the snapshot is still rooted at 'rootDir', and
+	// holds just the path down to it (or nothing, if it doesn't exist).
+	bool build(const std::string& rootDir, const std::string& fileExt = "",
+		       const std::string& subDir = "");
+
+	// Adds the file 'relPath' ('\\' separated, relative to the root), and any
+	// folders on its path, unless already present (case insensitive). New
+	// entries go after the existing ones. For snapshots made with build()
+	// (even failed ones), not attached ones.
+	void addFile(std::string_view relPath);
+
+	// Makes this a read-only view of a snapshot held elsewhere (which must
+	// outlive it). Returns false, leaving an empty snapshot, if the arrays
+	// aren't a well formed tree.
+	bool attach(const std::string& rootDir,
+		        const Node* nodes, uint32_t nNodes,
+		        const char* names, uint32_t namesSize);
+
+	// Empties the snapshot.
+	void clear();
+
+	// The full path of the snapshot's root, as given to build().
+	const std::string& rootPath() const { return rootDir; }
+
+	// The root node, or kNoNode if build() failed.
+	uint32_t root() const { return nNodes == 0 ? kNoNode : 0; }
+
+	// The child directory of 'dir' called 'name' (case insensitive), or
+	// kNoNode if there isn't one.
+	uint32_t childDir(uint32_t dir, const std::string& name) const;
+
+	// Appends the names of the immediate subdirectories of 'dir' to
+	// 'names_out' (cf. findMatchingFiles(dir, names_out, 0, 0, "", "")).
+	// Returns false if 'dir' is kNoNode.
+	bool listSubdirs(uint32_t dir, std::vector<std::string>& names_out) const;
+
+	// Appends the paths, relative to 'dir', of all files beneath 'dir'
+	// whose names end in 'ext' (case sensitive) to 'paths_out' (cf.
+	// findMatchingFiles(dir, paths_out, 1, 1, ext, "")). Returns false if
+	// 'dir' is kNoNode.
+	bool findFiles(uint32_t dir, const std::string& ext,
+		           std::vector<std::string>& paths_out) const;
+
+	const Node* nodeData() const { return pNodes; }
+	uint32_t    numNodes() const { return nNodes; }
+	const char* nameData() const { return pNames; }
+	uint32_t    namesSize() const { return nNamesBytes; }
+
+	size_t numBytes() const
+	{
+		return nodes.capacity() * sizeof(Node) + names.capacity();
+	}
+
+private:
+	std::string       rootDir;
+
+	// The snapshot, wherever it lives.
+	const Node*       pNodes = NULL;
+	uint32_t          nNodes = 0;
+	const char*       pNames = NULL;
+	uint32_t          nNamesBytes = 0;
+
+	// Storage for snapshots we built ourselves.
+	std::vector<Node> nodes;
+	std::vector<char> names;
+	std::string       keepExt;
+
+	uint32_t addNode(uint32_t parent, uint32_t& lastChild,
+		             const char* name, size_t nameLength, bool isDir);
+	void walk(uint32_t dir, std::string& path);
+	void collectFiles(uint32_t dir, const std::string& ext, std::string& subDir,
+		              std::vector<std::string>& paths_out) const;
+};
\ No newline at end of file
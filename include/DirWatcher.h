@@ -0,0 +1,96 @@
+// ============================================================================
+//                               DirWatcher.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "SpinLock.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+//                                DirWatcher
+// ----------------------------------------------------------------------------
+// Watches a directory tree for changes (files or folders created, deleted,
+// renamed or written to) on a thread of its own, and collects the paths
+// that changed until they're taken with takeChanges().
+// 
+// On Windows it uses ReadDirectoryChangesW on the root (watching the whole
+// subtree with one handle). Elsewhere (i.e. the Linux test build) it uses
+// inotify, with one watch per folder, adding watches for new folders as
+// they appear.
+// ============================================================================
+class DirWatcher
+{
+public:
+	DirWatcher() = default;
+	DirWatcher(const DirWatcher&) = delete;
+	DirWatcher& operator=(const DirWatcher&) = delete;
+	~DirWatcher() { stop(); }
+
+	// Starts watching 'rootDir' and everything beneath it. Returns false if
+	// it can't be watched (e.g. it doesn't exist).
+	bool start(const std::string& rootDir);
+
+	// Stops watching (and waits for the watcher thread to finish).
+	void stop();
+
+	// Moves the paths changed since the last call ('\\' separated and
+	// relative to the root) into 'paths_out', returning false if there are
+	// none. If changes were lost (because too many happened at once), the
+	// paths include "" (i.e. the root itself).
+	bool takeChanges(std::vector<std::string>& paths_out);
+
+	// When the most recent change was seen.
+	std::chrono::steady_clock::time_point lastChangeTime();
+
+	const std::string& rootPath() const { return rootDir; }
+
+private:
+	std::string                           rootDir;
+	std::thread                           worker;
+	std::atomic<bool>                     bStop{ false };
+
+	SpinLock                              changesLock;
+	std::vector<std::string>              changes;
+	std::chrono::steady_clock::time_point lastChange;
+
+#ifdef _WIN32
+	void*                                 hDir = NULL;
+#else
+	int                                   fd = -1;
+	std::unordered_map<int, std::string>  watchPaths;    // watch -> path relative to root
+
+	void addWatches(const std::string& relPath);
+#endif
+
+	void run();
+	void addChange(std::string relPath);
+};
\ No newline at end of file
@@ -0,0 +1,124 @@
+// ============================================================================
+//                              FactionRanks.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "ShardedHashMap.h"
+#include "SpinLock.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// ============================================================================
+//                               FactionRanks
+// ----------------------------------------------------------------------------
+// IsInFaction, IsFactionRankEqualTo and IsFactionRankLessThan each asked the
+// game afresh, which walks the actor base's faction list and then the
+// actor's ExtraFactionChanges (under the extra data lock), for every
+// condition, for every actor, at every clip activation.
+// 
+// Instead, the factions that loaded conditions test are registered here
+// when they're compiled, and each actor gets a small table of its rank in
+// (and membership of) just those factions, sorted by faction form ID: built
+// the first time it's needed and shared by every condition, project and
+// thread after that. A test is then a lookup and a binary search.
+// 
+// The game raises no event when an actor's factions change (AddToFaction,
+// SetFactionRank, ... are script calls), so a table is simply rebuilt once
+// it's older than the max age, once the registered factions change (a
+// project being reloaded), or when everything is invalidated (a game being
+// loaded).
+// ============================================================================
+struct FactionRank
+{
+	int   rank = -2;                // as Actor_GetFactionRank: -2 if not in the faction
+	bool  bIsIn = false;            // as Actor::IsInFaction
+};
+
+class FactionRanks
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	// Reads actor 'actorID''s rank in each of the 'nFactions' factions from
+	// the game. Returns false if there is no such actor.
+	typedef bool (*Reader)(uint32_t actorID, const uint32_t* factionIDs, size_t nFactions,
+		                   FactionRank* ranks_out);
+
+	FactionRanks(Reader readRanks, size_t maxActors) : readRanks(readRanks), maxActors(maxActors) {}
+	FactionRanks(const FactionRanks&) = delete;
+	FactionRanks& operator=(const FactionRanks&) = delete;
+
+	// Registers faction 'factionID' as one that conditions test.
+	void addFaction(uint32_t factionID);
+
+	// How stale a table may get (0 turns the tables off: find() then
+	// always returns false, and the game is asked every time).
+	void setMaxAge(Clock::duration maxAge);
+
+	// Actor 'actorID''s rank in faction 'factionID', from its table (built
+	// or rebuilt first if need be). Returns false if the faction isn't
+	// registered, the tables are off, or the actor can't be read.
+	bool find(uint32_t actorID, uint32_t factionID, FactionRank& rank_out,
+		      Clock::time_point now = Clock::now());
+
+	// Forgets every table (e.g. a game being loaded).
+	void invalidateAll();
+
+	// Number of tables built so far.
+	uint64_t numBuilt() const { return nBuilt; }
+	size_t size() { return tables.size(); }
+
+private:
+	typedef std::vector<uint32_t> FactionIDs;
+
+	struct Table
+	{
+		Clock::time_point                  built;
+		std::shared_ptr<const FactionIDs>  factionIDs;     // registered when it was built
+		std::vector<FactionRank>           ranks;          // parallel to *factionIDs
+	};
+
+	Reader                                                readRanks;
+	size_t                                                maxActors;
+
+	SpinLock                                              registryLock;   // held while adding a faction
+	std::shared_ptr<const FactionIDs>                     factionIDs;     // sorted; std::atomic_load / std::atomic_store
+
+	ShardedHashMap<uint32_t, std::shared_ptr<const Table>> tables;
+	std::atomic<size_t>                                   nTables{ 0 };
+	std::atomic<int64_t>                                  maxAgeNs{ 250000000 };
+	std::atomic<uint64_t>                                 nBuilt{ 0 };
+
+	bool isFresh(const Table* table, const FactionIDs* current, Clock::time_point now) const;
+};
+
+// The faction ranks read by the condition functions (see Conditions.cpp).
+extern FactionRanks g_factionRanks;
\ No newline at end of file
@@ -0,0 +1,71 @@
+// ============================================================================
+//                                GameState.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "ConditionProgram.h"
+
+#include <cstdint>
+
+struct Actor;
+struct TESGlobal;
+
+// ============================================================================
+//                                GameState
+// ----------------------------------------------------------------------------
+// Everything the loaders, the registry and the condition evaluator read from
+// the game, behind one interface. The condition programs only ever see
+// features (see ConditionProgram.h), and the features are read through here,
+// so none of that code touches an Actor, a TESForm or an offset itself.
+// 
+// In game this is SkyrimGameState (see Conditions.cpp), which reads the
+// features with the same calls the condition functions make. Elsewhere
+// (e.g. the benchmarks in tools/darbench) it can be any synthetic world.
+// ============================================================================
+class GameState
+{
+public:
+	virtual ~GameState() {}
+
+	// The actor's reference form ID.
+	virtual uint32_t actorID(Actor* actor) = 0;
+
+	// Whether 'actor' is the player.
+	virtual bool isPlayer(Actor* actor) = 0;
+
+	// Reads the actor feature 'key' (kCall features being calls in
+	// 'layout'). NaN if it can't be read.
+	virtual float readNum(const FeatureKey& key, const FeatureLayout& layout, Actor* actor) = 0;
+
+	// Reads the actor feature 'key' (a form ID, 0 if none).
+	virtual uint32_t readFormID(const FeatureKey& key, Actor* actor) = 0;
+
+	// The global variable with the given form ID, or NULL if there isn't one.
+	virtual const TESGlobal* lookupGlobal(uint32_t formID) = 0;
+};
+
+// The game state the core reads (see Conditions.cpp).
+extern GameState* g_gameState;
\ No newline at end of file
@@ -29,6 +29,27 @@
 #include "RE/H/hkbClipGenerator.h"
 #include "RE/H/hkbContext.h"
 
+#include <memory>
+
+struct Actor;
+struct DARLinkIndex;
+struct DARProject;
+struct hkbCharacter;
+
 bool install_hooks();
 void hkbClipGenerator_activate_Hook(hkbClipGenerator* thisObj, hkbContext* context);
-void cacheModifiedCharStringData(hkbCharacterStringData* p_hkbCharStringData);
\ No newline at end of file
+void cacheModifiedCharStringData(hkbCharacterStringData* p_hkbCharStringData);
+void logHookLockStats();
+
+// The link index of the animationNames array that 'character' was generated
+// with (NULL if the project had no replacements for it).
+std::shared_ptr<const DARLinkIndex> findGraphLinkIndex(DARProject* darProj, hkbCharacter* character);
+
+// The replacement index (or -1) for the clip generator's current activation:
+// the one chosen when Hook 3 activated it, if it did, otherwise chosen (and
+// recorded) now.
+hkInt16 decideClipReplacement(hkbClipGenerator* clipGen, DARProject* darProj,
+	                          const DARLinkIndex& linkIndex, hkInt16 origIndex, Actor* actor);
+
+// Activates the clip generator as is, i.e. without Hook 3 deciding again.
+void activateClipGenerator(hkbClipGenerator* clipGen, hkbContext* context);
\ No newline at end of file
@@ -0,0 +1,83 @@
+// ============================================================================
+//                             LoadOrderIndex.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// ============================================================================
+//                              LoadOrderIndex
+// ----------------------------------------------------------------------------
+// Plugin name (case insensitive) -> where it sits in the load order.
+// 
+// The loaders resolve every "esp name" | formID argument and every esp
+// folder against the load order. They used to call LookupModByName, which
+// walks the data handler's whole file list each time, thousands of times
+// per project. The index is built from the data handler once (see
+// DARGH::initDARLoading) and then shared by the loaders, which also means
+// they never touch the data handler and can run on any thread.
+// ============================================================================
+class LoadOrderIndex
+{
+public:
+	// Longest plugin name we can be given (cf. TESFile::fileName).
+	static const size_t kMaxNameLength = 0x103;
+
+	struct Mod
+	{
+		uint8_t  compileIndex;
+		uint16_t smallFileCompileIndex;
+		bool     isESL;
+
+		// The high bits of the complete form IDs of the mod's records
+		// (i.e. xx000000, or FExxx000 for an ESL).
+		uint32_t formIDBase() const
+		{
+			return (compileIndex << 24) + (smallFileCompileIndex << 12);
+		}
+	};
+
+	// Adds 'modName', unless a mod with that name has already been added.
+	void add(std::string_view modName, const Mod& mod);
+
+	// The mod called 'modName' (case insensitive), or NULL if there's no
+	// such mod. Doesn't allocate.
+	const Mod* find(std::string_view modName) const;
+
+	size_t size() const { return mods.size(); }
+	void clear() { mods.clear(); names.clear(); }
+
+private:
+	// Lower case name -> mod. The keys view the names stored in 'names'
+	// (a deque, so they never move), which lets find() look up a view of
+	// a name folded on the stack.
+	std::unordered_map<std::string_view, Mod> mods;
+	std::deque<std::string>                   names;
+};
\ No newline at end of file
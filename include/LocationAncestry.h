@@ -0,0 +1,73 @@
+// ============================================================================
+//                            LocationAncestry.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "ShardedHashMap.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ============================================================================
+//                             LocationAncestry
+// ----------------------------------------------------------------------------
+// IsInLocation(location) holds if the actor's current location is
+// 'location' or inside it, i.e. if 'location' is on the chain of parents
+// (BGSLocation::parentLoc) up from the current location. Walking that
+// chain for each IsInLocation, for each actor, is a pointer chase through
+// forms scattered all over memory, and the chains never change: so each
+// location's ancestors (itself included) are kept here, as a sorted set of
+// form IDs, built the first time the location is seen and shared by all
+// actors. A test is then one lookup and a binary search of a few entries.
+// ============================================================================
+class LocationAncestry
+{
+public:
+	// The form ID of the parent of location 'locationID' (0 if it has none,
+	// or isn't a location).
+	typedef uint32_t (*ParentReader)(uint32_t locationID);
+
+	explicit LocationAncestry(ParentReader readParent) : readParent(readParent) {}
+	LocationAncestry(const LocationAncestry&) = delete;
+	LocationAncestry& operator=(const LocationAncestry&) = delete;
+
+	// Is location 'locationID' location 'ancestorID', or inside it?
+	bool isIn(uint32_t locationID, uint32_t ancestorID);
+
+	size_t size() { return ancestors.size(); }
+
+private:
+	// (Chains are a handful of locations long: this only guards against
+	// a malformed one looping.)
+	static const uint32_t kMaxDepth = 64;
+
+	ParentReader                                          readParent;
+	ShardedHashMap<uint32_t, std::vector<uint32_t>>       ancestors;
+};
+
+// The location ancestry read by the condition functions (see Conditions.cpp).
+extern LocationAncestry g_locationAncestry;
\ No newline at end of file
@@ -0,0 +1,159 @@
+// ============================================================================
+//                            MemoryAccounting.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "SpinLock.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// What DARGH holds memory for (see MemoryAccounts).
+enum class MemCategory : uint8_t
+{
+	kLinkVectors,                 // link tables' ActorBaseLink and ConditionLink vectors
+	kConditionArgs,               // the ConditionLinks' conditions (and their args)
+	kLinkData,                    // LinkData objects, and the AnimLinks holding them (in each project's latest DARLinkIndex)
+	kNameArrays,                  // rebuilt animationNames arrays and the names copied into them
+	kAnimHashmap,                 // g_animHashmap entries
+	kLeakedRebuilds,              // LinkData objects of link indexes superseded by later rebuilds (kept for older graphs)
+	kPaths,                       // g_pathTable
+	kNumCategories
+};
+
+const char* memCategoryName(MemCategory category);
+
+// ============================================================================
+//                              MemoryAccounts
+// ----------------------------------------------------------------------------
+// Bytes and object counts held by DARGH, per project and per category. The
+// containers are charged explicitly, as they're built and dropped, with
+// what they have allocated (sizes are worked out from the containers'
+// capacities, so are close estimates rather than exact heap figures).
+// 
+// Memory that isn't held for any one project goes in the kShared account.
+// ============================================================================
+class MemoryAccounts
+{
+public:
+	static const uint32_t kShared = 0xFFFFFFFF;
+
+	struct Usage
+	{
+		int64_t  bytes = 0;
+		int64_t  objects = 0;
+	};
+
+	// Charges project 'projectID' (kShared for none) with the given
+	// amounts: negative amounts release them.
+	void add(uint32_t projectID, MemCategory category, int64_t bytes, int64_t objects);
+
+	// Releases everything charged to the project under 'category',
+	// returning what that was.
+	Usage take(uint32_t projectID, MemCategory category);
+
+	// Name the project is listed under in the report.
+	void setName(uint32_t projectID, const std::string& name);
+
+	Usage usage(uint32_t projectID, MemCategory category) const;
+	Usage total(MemCategory category) const;
+	Usage total() const;
+
+	// Most bytes held at any one time.
+	int64_t peakBytes() const;
+
+	// Writes the report, a line at a time.
+	typedef void (*LineWriter)(const char* line);
+	void report(LineWriter write) const;
+
+	// Forgets everything (for tests).
+	void clear();
+
+private:
+	struct Account
+	{
+		std::string  name;
+		Usage        usage[(size_t)MemCategory::kNumCategories];
+	};
+
+	mutable SpinLock                  lock;
+	std::map<uint32_t, Account>       accounts;
+	Usage                             totals[(size_t)MemCategory::kNumCategories];
+	int64_t                           totalBytes = 0;
+	int64_t                           peak = 0;
+};
+
+// DARGH's accounts. (Never destroyed: link tables release their charges
+// from other globals' destructors at exit.)
+extern MemoryAccounts& g_memoryAccounts;
+
+// A charge on g_memoryAccounts for as long as the object holding it
+// lives. Copies start out uncharged.
+class MemoryCharge
+{
+public:
+	MemoryCharge() = default;
+	MemoryCharge(const MemoryCharge&) {}
+	MemoryCharge& operator=(const MemoryCharge&) = delete;
+	~MemoryCharge() { release(); }
+
+	// Replaces the charge with the given one.
+	void set(uint32_t project, MemCategory cat, size_t nBytes, size_t nObjects);
+	void release();
+
+private:
+	uint32_t     projectID = 0;
+	MemCategory  category = MemCategory::kNumCategories;    // (none)
+	size_t       bytes = 0;
+	size_t       objects = 0;
+};
+
+// What the standard containers have allocated, give or take the
+// allocator's own overheads.
+template <class T, class A>
+inline size_t memBytes(const std::vector<T, A>& v)
+{
+	return v.capacity() * sizeof(T);
+}
+
+template <class K, class V, class H, class E, class A>
+inline size_t memBytes(const std::unordered_map<K, V, H, E, A>& m)
+{
+	// Nodes hold a next pointer and the cached hash besides the value.
+	return m.size() * (sizeof(typename std::unordered_map<K, V, H, E, A>::value_type) + 2 * sizeof(void*))
+		+ m.bucket_count() * sizeof(void*);
+}
+
+template <class K, class V, class C, class A>
+inline size_t memBytes(const std::map<K, V, C, A>& m)
+{
+	// Nodes hold three links and the colour besides the value.
+	return m.size() * (sizeof(typename std::map<K, V, C, A>::value_type) + 4 * sizeof(void*));
+}
\ No newline at end of file
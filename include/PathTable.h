@@ -0,0 +1,124 @@
+// ============================================================================
+//                                PathTable.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "MemoryAccounting.h"
+#include "SpinLock.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// An interned path (see PathTable). 0 is no path.
+typedef uint32_t PathID;
+
+// ============================================================================
+//                                PathTable
+// ----------------------------------------------------------------------------
+// Every link used to hold its FROM and TO animation paths as std::strings of
+// its own, and the same _CustomConditions folders are loaded into project
+// after project (one per race), so the same long "Animations\\Dynamic
+// AnimationReplacer\\..." paths were held tens of thousands of times over.
+// Links now hold 32-bit ids into this one, process-wide, table instead,
+// which keeps a single copy of each distinct path packed into large blocks.
+// 
+// Each path's hash, taken lower-cased with '/' as '\\' (i.e. as the game
+// compares animation names), is worked out once when it's added, so that
+// matching names against links is mostly a matter of comparing integers.
+// 
+// Paths are only ever added. Looking one up takes no lock, and the strings
+// never move, so the pointers returned stay good for as long as the table.
+// ============================================================================
+class PathTable
+{
+public:
+	// If 'bAccounted', what it holds is charged to g_memoryAccounts (as
+	// shared kPaths).
+	explicit PathTable(bool bAccounted = false) : bAccounted(bAccounted) {}
+	PathTable(const PathTable&) = delete;
+	PathTable& operator=(const PathTable&) = delete;
+	~PathTable();
+
+	// The id of 'path' (case and all), adding it if it isn't there yet.
+	PathID intern(std::string_view path);
+
+	// The path with the given id ("" for 0).
+	const char* str(PathID id) const { return id ? entry(id).str : ""; }
+	uint32_t length(PathID id) const { return id ? entry(id).length : 0; }
+
+	// Hash of the path lower-cased, with '/' as '\\' (see hashLower).
+	uint32_t lowerHash(PathID id) const { return id ? entry(id).lowerHash : hashLower(""); }
+
+	// Do the two name the same file (ignoring case, and '/' vs '\\')?
+	bool sameFile(PathID id, std::string_view path) const;
+
+	static uint32_t hashLower(std::string_view path);
+
+	// Number of paths, and bytes held for them.
+	size_t size() const { return nPaths; }
+	size_t numBytes() const { return nBytes; }
+
+private:
+	struct Entry
+	{
+		const char*  str;
+		uint32_t     length;
+		uint32_t     lowerHash;
+	};
+	static const uint32_t kEntryChunkBits = 12;
+	static const uint32_t kEntriesPerChunk = 1u << kEntryChunkBits;
+	static const uint32_t kMaxEntryChunks = 4096;
+	static const size_t   kBlockSize = 1 << 20;
+
+	// Entries by id - 1, in chunks that never move once allocated.
+	std::atomic<Entry*>                           entryChunks[kMaxEntryChunks] = {};
+	std::atomic<size_t>                           nPaths{ 0 };
+	std::atomic<size_t>                           nBytes{ 0 };
+
+	SpinLock                                      lock;      // held while adding
+	std::unordered_map<std::string_view, PathID>  ids;       // (views into the blocks)
+	std::unique_ptr<char[]>*                      blocks = nullptr;
+	size_t                                        nBlocks = 0;
+	size_t                                        maxBlocks = 0;
+	size_t                                        blockUsed = kBlockSize;
+	bool                                          bAccounted;
+
+	const Entry& entry(PathID id) const
+	{
+		uint32_t index = id - 1;
+		return entryChunks[index >> kEntryChunkBits].load(std::memory_order_acquire)
+			[index & (kEntriesPerChunk - 1)];
+	}
+	char* store(std::string_view path);
+};
+
+// The table the links' paths are interned in.
+extern PathTable g_pathTable;
\ No newline at end of file
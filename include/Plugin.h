@@ -31,5 +31,14 @@
 namespace Plugin
 {
 	extern uint32_t g_MAX_ANIMATION_FILES;
+	extern bool g_bWarmDARProjects;
+	extern bool g_bHotReload;
+	extern uint32_t g_WorldStateMaxAgeMs;
+	extern uint32_t g_FactionRanksMaxAgeMs;
+	extern bool g_bPrefetchAnimations;
+	extern uint32_t g_PrefetchKBPerSecond;
 	void HandleSKSEMessage(SKSEMessagingInterface::Message * msg);
+
+	// Writes DARGH's memory report (see MemoryAccounts) to the log.
+	void logMemoryReport();
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+// ============================================================================
+//                                BSTEvent.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+// Copyright (c) 2018 Ryan - rsm - McKenzie
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+// Note from Nox Sidereum:
+// 
+//     In writing DARGH and reverse engineering DAR, I have attempted to be
+//     consistent with CommonLibSSE structures and variable names. This
+//     should facilitate any future porting of this code to 100% CommonLibSSE
+//     (which I'd encourage).
+// 
+//     Many thanks to Ryan and the authors of CommonLibSSE.
+// 
+// This particular file is based on
+//   https://github.com/Ryan-rsm-McKenzie/CommonLibSSE/blob/master/include/RE/B/BSTEvent.h
+#pragma once
+#include "RE/B/BSSpinLock.h"
+
+enum class BSEventNotifyControl : uint32_t
+{
+	kContinue = 0,
+	kStop = 1
+};
+
+template <class Event>
+struct BSTEventSource;
+
+template <class Event>
+class BSTEventSink
+{
+public:
+	virtual ~BSTEventSink() {}                                                  // 00
+
+	// add
+	virtual BSEventNotifyControl ProcessEvent(const Event* a_event,
+		                                      BSTEventSource<Event>* a_eventSource) = 0;  // 01
+};
+
+// Layout only (see CommonLibSSE's BSTArray.h).
+template <class T>
+struct BSTArray
+{
+	T*                 _data;                                // 00
+	uint32_t           _capacity;                            // 08
+	uint32_t           pad0C;                                // 0C
+	uint32_t           _size;                                // 10
+	uint32_t           pad14;                                // 14
+};
+static_assert(sizeof(BSTArray<void*>) == 0x18);
+
+template <class Event>
+struct BSTEventSource
+{
+	BSTArray<BSTEventSink<Event>*>  sinks;                   // 00
+	BSTArray<BSTEventSink<Event>*>  pendingRegisters;        // 18
+	BSTArray<BSTEventSink<Event>*>  pendingUnregisters;      // 30
+	BSSpinLock                      lock;                    // 48
+	bool                            notifying;               // 50
+	uint8_t                         pad51;                   // 51
+	uint16_t                        pad52;                   // 52
+	uint32_t                        pad54;                   // 54
+};
+static_assert(sizeof(BSTEventSource<void*>) == 0x58);
\ No newline at end of file
@@ -29,6 +29,7 @@
 //   http://web.archive.org/web/http://anarchy.cn/manual/12/HavokSdk_ProgrammersManual/index.html
 //   https://github.com/Bewolf2/projectanarchy
 #pragma once
+#include <cstdint>
 
 struct hkFinishLoadedObjectFlag
 {
@@ -34,6 +34,7 @@
 #include "RE/H/hkbClipGenerator.h"
 #include "RE/H/hkbContext.h"
 #include "RE/S/Setting.h"
+#include "RE/S/ScriptEventSourceHolder.h"
 #include "RE/S/SettingCollectionList.h"
 #include "RE/S/Sky.h"
 #include "RE/T/TESActorBase.h"
@@ -141,6 +142,20 @@ namespace RE
 	typedef uint64_t (* _AnimationFileManager_Load)(uint64_t, hkbContext*, hkbClipGenerator*, uint64_t);
 	extern _AnimationFileManager_Load AnimationFileManager_Load;
 
+	typedef ScriptEventSourceHolder* (* _ScriptEventSourceHolder_GetSingleton)(void);
+	extern _ScriptEventSourceHolder_GetSingleton ScriptEventSourceHolder_GetSingleton;
+
+	// The game's heap (e.g. for growing the game's own BSTArrays).
+	struct MemoryManager;
+	typedef MemoryManager* (* _MemoryManager_GetSingleton)(void);
+	extern _MemoryManager_GetSingleton MemoryManager_GetSingleton;
+
+	typedef void* (* _MemoryManager_Allocate)(MemoryManager* manager, size_t size, int32_t alignment, bool alignmentRequired);
+	extern _MemoryManager_Allocate MemoryManager_Allocate;
+
+	typedef void (* _MemoryManager_Deallocate)(MemoryManager* manager, void* mem, bool alignmentRequired);
+	extern _MemoryManager_Deallocate MemoryManager_Deallocate;
+
 	bool InitialiseOffsets();
 	bool DumpSpecificVersion();
 	void DumpOffsets();
@@ -0,0 +1,211 @@
+// ============================================================================
+//                             ShardedHashMap.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "SpinLock.h"
+
+#include <cstddef>
+#include <unordered_map>
+
+// ============================================================================
+//                              ShardedHashMap
+// ----------------------------------------------------------------------------
+// A concurrent hash map for pointer (or integer) keys, made of kNumShards
+// independent std::unordered_maps, each behind its own SpinLock. A key always
+// hashes to the same shard, so threads working on different keys only contend if their
+// keys land in the same shard (1 in kNumShards for well spread keys), rather
+// than all queueing on one global lock.
+// 
+// Each shard is aligned to a cache line so that the locks of neighbouring
+// shards don't share one (false sharing would defeat the purpose).
+// ============================================================================
+template <class Key, class Value, uint32_t kNumShards = 16>
+class ShardedHashMap
+{
+	static_assert((kNumShards & (kNumShards - 1)) == 0,
+		          "kNumShards must be a power of two");
+
+	struct alignas(64) Shard
+	{
+		SpinLock                       lock;
+		std::unordered_map<Key, Value> map;
+	};
+	Shard shards[kNumShards];
+
+	static constexpr uint32_t shardBits()
+	{
+		uint32_t bits = 0;
+		for (uint32_t n = kNumShards; n > 1; n >>= 1)
+		{
+			++bits;
+		}
+		return bits;
+	}
+
+	Shard& shardFor(Key key)
+	{
+		// Heap pointers are 16 byte aligned, so the low bits carry no
+		// information. Mix the rest (Fibonacci hashing) and take the
+		// top bits.
+		uint64_t h = ((uint64_t)key >> 4) * 0x9E3779B97F4A7C15ull;
+		return shards[shardBits() ? (h >> (64 - shardBits())) : 0];
+	}
+
+public:
+	void insert(Key key, Value value)
+	{
+		// Inserts (key, value). Like std::unordered_map::insert, does
+		// nothing if the key is already present.
+		Shard& shard = shardFor(key);
+		shard.lock.lock();
+		shard.map.insert(std::pair(key, value));
+		shard.lock.unlock();
+	}
+
+	template <class MakeValue>
+	Value findOrInsert(Key key, MakeValue makeValue, bool* pInserted = nullptr)
+	{
+		// Returns the value stored for 'key', first inserting makeValue()
+		// if there isn't one (and setting *pInserted to say which).
+		Shard& shard = shardFor(key);
+		shard.lock.lock();
+		auto search = shard.map.find(key);
+		bool inserted = search == shard.map.end();
+		if (inserted)
+		{
+			search = shard.map.emplace(key, makeValue()).first;
+		}
+		Value value = search->second;
+		shard.lock.unlock();
+		if (pInserted)
+		{
+			*pInserted = inserted;
+		}
+		return value;
+	}
+
+	template <class Update>
+	void update(Key key, Update update)
+	{
+		// Calls update(value) on the value stored for 'key' (inserting a
+		// default constructed one first if there isn't one), under the
+		// shard's lock.
+		Shard& shard = shardFor(key);
+		shard.lock.lock();
+		update(shard.map[key]);
+		shard.lock.unlock();
+	}
+
+	template <class Visit>
+	bool visit(Key key, Visit visit)
+	{
+		// If 'key' is present, calls visit(value) on its value, under the
+		// shard's lock (so without copying it), and returns true.
+		// Otherwise returns false.
+		bool found = false;
+		Shard& shard = shardFor(key);
+		shard.lock.lock();
+		auto search = shard.map.find(key);
+		if (search != shard.map.end())
+		{
+			visit((const Value&)search->second);
+			found = true;
+		}
+		shard.lock.unlock();
+		return found;
+	}
+
+	bool find(Key key, Value& value_out)
+	{
+		// If 'key' is present, stores a copy of its value in 'value_out'
+		// and returns true. Otherwise returns false.
+		bool found = false;
+		Shard& shard = shardFor(key);
+		shard.lock.lock();
+		auto search = shard.map.find(key);
+		if (search != shard.map.end())
+		{
+			value_out = search->second;
+			found = true;
+		}
+		shard.lock.unlock();
+		return found;
+	}
+
+	bool take(Key key, Value& value_out)
+	{
+		// If 'key' is present, removes it, stores its value in
+		// 'value_out' and returns true. Otherwise returns false.
+		bool found = false;
+		Shard& shard = shardFor(key);
+		shard.lock.lock();
+		auto search = shard.map.find(key);
+		if (search != shard.map.end())
+		{
+			value_out = search->second;
+			shard.map.erase(search);
+			found = true;
+		}
+		shard.lock.unlock();
+		return found;
+	}
+
+	void clear()
+	{
+		for (auto& shard : shards)
+		{
+			shard.lock.lock();
+			shard.map.clear();
+			shard.lock.unlock();
+		}
+	}
+
+	size_t size()
+	{
+		// Total number of entries. Only a snapshot if other threads are
+		// inserting or taking concurrently.
+		size_t total = 0;
+		for (auto& shard : shards)
+		{
+			shard.lock.lock();
+			total += shard.map.size();
+			shard.lock.unlock();
+		}
+		return total;
+	}
+
+	void logLockStats(const char* name)
+	{
+		// Logs the combined lock histograms of all the shards.
+		SpinLock::Stats stats{};
+		for (auto& shard : shards)
+		{
+			shard.lock.addStatsTo(stats);
+		}
+		SpinLock::logStats(name, stats);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,147 @@
+// ============================================================================
+//                                SpinLock.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Turn this on if you want DARGH's own locks to collect wait-time and
+// hold-time histograms (see SpinLock::logStats). Costs two clock reads
+// per lock/unlock pair, so leave it off for normal use.
+// #define DARGH_SPINLOCK_STATS
+
+// ============================================================================
+//                                 SpinLock
+// ----------------------------------------------------------------------------
+// A small, portable (non-recursive) lock for DARGH's own data structures.
+// 
+//  1. Spin phase: test-and-test-and-set. Waiters spin on a plain load (so the
+//     cache line stays shared while the lock is held) and only attempt the
+//     atomic exchange once the lock looks free. Between attempts they pause
+//     for an exponentially growing number of iterations, up to kMaxBackoff,
+//     which stops a crowd of waiters hammering the line the moment it's
+//     released.
+//  2. Park phase (optional): after kSpinLimit failed attempts the waiter
+//     stops burning CPU and sleeps on the lock word itself, via
+//     WaitOnAddress on Windows or a futex on Linux. Unlock only pays for a
+//     wake-up call if someone has actually parked.
+// 
+// Compare BSSpinLock_lock, which retries the interlocked compare-exchange
+// immediately and then falls back to Sleep(0) / Sleep(1) without backoff.
+// ============================================================================
+class SpinLock
+{
+public:
+	enum : uint32_t
+	{
+		kUnlocked = 0,
+		kLocked = 1,
+		kLockedWithWaiters = 2,
+
+		kSpinLimit = 64,          // failed acquisition attempts before parking
+		kMaxBackoff = 1024,       // max pause iterations between attempts
+		kNumHistBuckets = 32,     // log2(nanoseconds) buckets
+	};
+
+	struct Stats
+	{
+		// Histogram bucket i counts waits/holds of [2^i, 2^(i+1)) ns
+		// (bucket 0 also counts zero-length ones).
+		std::atomic<uint64_t> waitHist[kNumHistBuckets];
+		std::atomic<uint64_t> holdHist[kNumHistBuckets];
+		std::atomic<uint64_t> nAcquired;
+		std::atomic<uint64_t> nContended;   // acquisitions that had to wait
+		std::atomic<uint64_t> nParked;      // times a waiter went to sleep
+	};
+
+	explicit SpinLock(bool allowParking = true) : park(allowParking) {}
+	SpinLock(const SpinLock&) = delete;
+	SpinLock& operator=(const SpinLock&) = delete;
+
+	void lock()
+	{
+		uint32_t expected = kUnlocked;
+		if (!state.compare_exchange_strong(expected, kLocked,
+			                               std::memory_order_acquire))
+		{
+			lockContended();
+		}
+#ifdef DARGH_SPINLOCK_STATS
+		else
+		{
+			recordAcquired(0);
+		}
+#endif
+	}
+
+	bool try_lock()
+	{
+		uint32_t expected = kUnlocked;
+		bool locked = state.compare_exchange_strong(expected, kLocked,
+			                                        std::memory_order_acquire);
+#ifdef DARGH_SPINLOCK_STATS
+		if (locked)
+		{
+			recordAcquired(0);
+		}
+#endif
+		return locked;
+	}
+
+	void unlock()
+	{
+#ifdef DARGH_SPINLOCK_STATS
+		recordReleased();
+#endif
+		if (state.exchange(kUnlocked, std::memory_order_release) == kLockedWithWaiters)
+		{
+			wakeOne();
+		}
+	}
+
+	// Adds this lock's histograms into 'stats_out' (no-op unless built
+	// with DARGH_SPINLOCK_STATS).
+	void addStatsTo(Stats& stats_out) const;
+
+	// Writes 'stats' to the log, headed with 'name'.
+	static void logStats(const char* name, const Stats& stats);
+
+private:
+	std::atomic<uint32_t> state{ kUnlocked };
+	bool                  park;
+#ifdef DARGH_SPINLOCK_STATS
+	uint64_t              acquiredAt = 0;   // only touched by the holder
+	Stats                 stats{};
+
+	void recordAcquired(uint64_t waitNs);
+	void recordReleased();
+#endif
+
+	void lockContended();
+	void parkWhile(uint32_t value);
+	void wakeOne();
+};
\ No newline at end of file
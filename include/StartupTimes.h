@@ -0,0 +1,105 @@
+// ============================================================================
+//                              StartupTimes.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock StartupClock;
+
+// What loading one project's DAR maps took (see DARGH::ensureDARMapsLoaded).
+struct ProjectLoadTimes
+{
+	static const size_t kMaxSlowestFolders = 5;
+
+	struct Folder
+	{
+		std::string              priority;        // _CustomConditions subfolder
+		StartupClock::duration   elapsed;
+	};
+
+	std::string              project;
+	bool                     bFromBundle = false;
+	StartupClock::duration   treeTime{};            // walking the folder (or opening the bundle)
+	StartupClock::duration   actorBaseTime{};       // loadDARMaps_ActorBase
+	StartupClock::duration   conditionalTime{};     // loadDARMaps_Conditional ...
+	StartupClock::duration   parseTime{};           // ... of which reading, parsing and binding _conditions.txt
+	uint32_t                 nActorBaseFiles = 0;   // .hkx files linked by actor base
+	uint32_t                 nConditionsFiles = 0;  // _conditions.txt files read
+	uint32_t                 nConditionalFiles = 0; // .hkx files linked by conditions
+	std::vector<Folder>      slowestFolders;        // slowest first
+
+	// Records the time taken by a priority folder, keeping it if it's
+	// one of the slowest.
+	void addFolder(const std::string& priority, StartupClock::duration elapsed);
+
+	typedef void (*LineWriter)(const char* line);
+	void report(LineWriter write) const;
+};
+
+// ============================================================================
+//                               StartupTimes
+// ----------------------------------------------------------------------------
+// Times the phases of startup (plugin load, then data load), one after the
+// other, for a summary in the log: e.g.
+// 
+//     startupTimes.startPhase("RE::InitialiseOffsets");
+//     ...
+//     startupTimes.startPhase("install_hooks");
+//     ...
+//     startupTimes.endPhase();
+//     startupTimes.report(write);
+// 
+// Phases are only started and ended on the thread loading the plugin.
+// ============================================================================
+class StartupTimes
+{
+public:
+	// Ends the current phase (if any), and starts the next.
+	void startPhase(const char* name);
+	void endPhase();
+
+	// Writes the phases ended since the last report, and their total.
+	typedef void (*LineWriter)(const char* line);
+	void report(const char* title, LineWriter write);
+
+private:
+	struct Phase
+	{
+		const char*              name;
+		StartupClock::duration   elapsed;
+	};
+
+	const char*               current = nullptr;
+	StartupClock::time_point  currentStart;
+	std::vector<Phase>        ended;
+};
+
+extern StartupTimes g_startupTimes;
\ No newline at end of file
@@ -29,7 +29,9 @@
 #include <string>
 #include <vector>
 
+#ifdef _WIN32
 std::string getSkyrimDirectory();
+#endif
 
 bool startsWith(const std::string& str, const std::string& prefix);
 
@@ -37,8 +39,10 @@ bool endsWith(const std::string& str, const std::string& suffix);
 
 bool isNumber(const std::string& s);
 
+#ifdef _WIN32
 bool findMatchingFiles(std::string& dirToSearch, std::vector<std::string>& matches_out,
 	                   bool filterToExt, bool recursive, std::string& ext, std::string subDir);
+#endif
 
 std::string trim(const std::string& s);
 
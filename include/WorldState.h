@@ -0,0 +1,125 @@
+// ============================================================================
+//                               WorldState.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "ConditionProgram.h"
+#include "SpinLock.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// ============================================================================
+//                                WorldState
+// ----------------------------------------------------------------------------
+// A snapshot of the condition features that don't depend on the actor: the
+// current weather, the game hour and the values of global variables (i.e.
+// what CurrentWeather, CurrentGameTimeLessThan and ValueEqualTo/LessThan,
+// and any condition given a global, read).
+// 
+// These used to be read from the game (Sky_GetSingleton, the calendar, a
+// Game_GetForm per global) for every actor at every clip activation. Now
+// layouts register the ones they use here (see FeatureLayout::addWorldNum),
+// and activations copy them out of the current snapshot, which is only
+// retaken once it's older than the max age. So each is read at most once
+// per max age (by default about a frame), however many actors there are.
+// 
+// Each value also has a version, which only changes when the value does, so
+// a result computed from world features stays good for as long as their
+// versions don't move (see ConditionCache).
+// ============================================================================
+struct WorldSnapshot
+{
+	std::chrono::steady_clock::time_point  taken;
+	std::vector<float>                     nums;             // by world slot (see WorldState::addNum)
+	std::vector<uint32_t>                  formIDs;          // by world slot (see WorldState::addFormID)
+	std::vector<uint64_t>                  numVersions;      // version of each of 'nums' (never 0)
+	std::vector<uint64_t>                  formIDVersions;
+};
+
+class WorldState
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+	typedef WorldSnapshot Snapshot;
+
+	// Read one feature from the game.
+	typedef float    (*NumReader)(const FeatureKey& key);
+	typedef uint32_t (*FormIDReader)(const FeatureKey& key);
+
+	// Where a numeric feature can simply be read from memory (e.g. a global
+	// variable's value), the address to read; otherwise NULL. Called once,
+	// when the feature is registered.
+	typedef const float* (*NumSource)(const FeatureKey& key);
+
+	WorldState(NumReader readNum, FormIDReader readFormID, NumSource findNumSource = nullptr)
+		: readNum(readNum), readFormID(readFormID), findNumSource(findNumSource) {}
+	WorldState(const WorldState&) = delete;
+	WorldState& operator=(const WorldState&) = delete;
+
+	// World slot of the given feature, registering it if need be.
+	uint32_t addNum(const FeatureKey& key);
+	uint32_t addFormID(const FeatureKey& key);
+
+	// How stale a snapshot may get (0 retakes it every time).
+	void setMaxAge(Clock::duration maxAge);
+
+	// The current snapshot, retaken first if it's older than the max age
+	// or is missing features registered since it was taken.
+	std::shared_ptr<const Snapshot> get(Clock::time_point now = Clock::now());
+
+	// Number of snapshots taken so far, and of values found to have
+	// changed in them.
+	uint64_t numSnapshots() const { return nSnapshots; }
+	uint64_t numChanges() const { return nChanges; }
+
+private:
+	NumReader                        readNum;
+	FormIDReader                     readFormID;
+	NumSource                        findNumSource;
+
+	SpinLock                         registryLock;     // guards numKeys, numSources, formIDKeys
+	std::vector<FeatureKey>          numKeys;
+	std::vector<const float*>        numSources;       // by world slot (NULL: use readNum)
+	std::vector<FeatureKey>          formIDKeys;
+	std::atomic<size_t>              nNumKeys{ 0 };
+	std::atomic<size_t>              nFormIDKeys{ 0 };
+
+	SpinLock                         snapshotLock;     // held while taking a snapshot
+	std::shared_ptr<const Snapshot>  current;          // std::atomic_load / std::atomic_store
+	std::atomic<int64_t>             maxAgeNs{ 16000000 };
+	std::atomic<uint64_t>            nSnapshots{ 0 };
+	std::atomic<uint64_t>            nChanges{ 0 };
+	uint64_t                         lastVersion = 0;  // (under snapshotLock)
+
+	bool isFresh(const Snapshot* snapshot, Clock::time_point now) const;
+};
+
+// The world state read by the condition functions (see Conditions.cpp).
+extern WorldState g_worldState;
\ No newline at end of file
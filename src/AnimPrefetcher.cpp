@@ -0,0 +1,256 @@
+// ============================================================================
+//                            AnimPrefetcher.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "AnimPrefetcher.h"
+#include "GameState.h"
+
+#include <algorithm>
+
+void AnimPrefetcher::configure(const Settings& newSettings)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	settings = newSettings;
+	budget = (int64_t)settings.burstBytes;
+	refilledAt = Clock::time_point{};
+}
+
+void AnimPrefetcher::start()
+{
+	if (worker.joinable())
+	{
+		return;
+	}
+	bStop = false;
+	worker = std::thread(&AnimPrefetcher::run, this);
+	bRunning = true;
+}
+
+void AnimPrefetcher::stop()
+{
+	if (!worker.joinable())
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		bStop = true;
+	}
+	wake.notify_all();
+	worker.join();
+	bRunning = false;
+}
+
+void AnimPrefetcher::remember(const std::string& path)
+{
+	// (Under lock.) Moves 'path' to the front of the recently requested
+	// list, dropping the least recent if that makes too many.
+	auto search = recentIndex.find(path);
+	if (search != recentIndex.end())
+	{
+		recent.splice(recent.begin(), recent, search->second);
+		return;
+	}
+	recent.push_front(path);
+	recentIndex.emplace(path, recent.begin());
+	while (recent.size() > std::max<size_t>(settings.maxFiles, 1))
+	{
+		recentIndex.erase(recent.back());
+		recent.pop_back();
+	}
+}
+
+bool AnimPrefetcher::request(const std::string& path)
+{
+	std::string key(path);
+	std::transform(key.begin(), key.end(), key.begin(), tolower);
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto search = recentIndex.find(key);
+		if (search != recentIndex.end())
+		{
+			recent.splice(recent.begin(), recent, search->second);
+			nRecent++;
+			return false;
+		}
+		if (queued.count(key))
+		{
+			return false;
+		}
+		if (queue.size() >= settings.maxFiles)
+		{
+			nDropped++;
+			return false;
+		}
+		queued.insert(key);
+		queue.push_back(std::move(key));
+	}
+	nQueued++;
+	wake.notify_one();
+	return true;
+}
+
+void AnimPrefetcher::refill(Clock::time_point now)
+{
+	// (Under lock.) Tops the budget up at bytesPerSecond since it was
+	// last topped up, to at most burstBytes.
+	if (refilledAt == Clock::time_point{})
+	{
+		refilledAt = now;
+		return;
+	}
+	if (now <= refilledAt)
+	{
+		return;
+	}
+	int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - refilledAt).count();
+	int64_t added = (int64_t)((double)settings.bytesPerSecond * ns / 1e9);
+	budget = std::min<int64_t>(budget + added, (int64_t)settings.burstBytes);
+	refilledAt = now;
+}
+
+bool AnimPrefetcher::readNext(Clock::time_point now)
+{
+	std::string path;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		refill(now);
+		if (queue.empty() || budget <= 0)
+		{
+			return false;
+		}
+		path = std::move(queue.front());
+		queue.pop_front();
+		queued.erase(path);
+		remember(path);
+	}
+
+	// A file is read whole, even if that overdraws the budget: the next
+	// one then waits for it to be paid back.
+	uint64_t nBytes = readFile(path);
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		budget -= (int64_t)nBytes;
+	}
+	nRead++;
+	nBytesRead += nBytes;
+	return true;
+}
+
+size_t AnimPrefetcher::queueSize()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return queue.size();
+}
+
+void AnimPrefetcher::run()
+{
+	while (!bStop)
+	{
+		if (readNext())
+		{
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(lock);
+		if (bStop)
+		{
+			break;
+		}
+		if (queue.empty())
+		{
+			wake.wait(guard, [this] { return bStop || !queue.empty(); });
+		}
+		else
+		{
+			// Out of budget: wait until it's been paid back.
+			double seconds = settings.bytesPerSecond ? (double)(1 - budget) / settings.bytesPerSecond : 0.1;
+			auto wait = std::chrono::duration_cast<Clock::duration>(
+				std::chrono::duration<double>(std::min(std::max(seconds, 0.001), 0.1)));
+			wake.wait_for(guard, wait, [this] { return (bool)bStop; });
+		}
+	}
+}
+
+bool LikelyLink::matches(const ActorProfile& profile) const
+{
+	return guards != 0
+		&& (!(guards & kActorBase) || actorBaseID == profile.baseFormID)
+		&& (!(guards & kRace) || raceID == profile.raceFormID)
+		&& (!(guards & kLeftType) || equippedTypes[0] == profile.equippedTypes[0])
+		&& (!(guards & kRightType) || equippedTypes[1] == profile.equippedTypes[1]);
+}
+
+bool LikelyLink::guardsFrom(const ConditionProgram& program, const FeatureLayout& layout)
+{
+	guards = 0;
+	for (size_t i = 0; i < program.ops.size(); i++)
+	{
+		const ConditionOp& op = program.ops[i];
+		if (!op.bAnd && i + 1 < program.ops.size())
+		{
+			guards = 0;
+			return false;    // an OR: no one condition is required
+		}
+		if (op.bNot)
+		{
+			continue;
+		}
+		if (op.test == ConditionOp::kFormEqual)
+		{
+			FeatureKind kind = layout.formIDs[op.lhs.slot].kind;
+			if (kind == FeatureKind::kActorBase)
+			{
+				guards |= kActorBase;
+				actorBaseID = op.rhsFormID;
+			}
+			else if (kind == FeatureKind::kRace)
+			{
+				guards |= kRace;
+				raceID = op.rhsFormID;
+			}
+		}
+		else if (op.test == ConditionOp::kEqual
+			     && op.lhs.slot != FeatureOperand::kConstant
+			     && op.rhs.slot == FeatureOperand::kConstant
+			     && layout.nums[op.lhs.slot].kind == FeatureKind::kEquippedType)
+		{
+			uint32_t hand = layout.nums[op.lhs.slot].param ? 1 : 0;
+			guards |= hand ? kRightType : kLeftType;
+			equippedTypes[hand] = op.rhs.value;
+		}
+	}
+	return guards != 0;
+}
+
+void readActorProfile(Actor* actor, ActorProfile& profile_out)
+{
+	// (None of these read calls, so any layout will do.)
+	static const FeatureLayout noCalls;
+	profile_out.baseFormID = g_gameState->readFormID(FeatureKey{ FeatureKind::kActorBase, 0, 0 }, actor);
+	profile_out.raceFormID = g_gameState->readFormID(FeatureKey{ FeatureKind::kRace, 0, 0 }, actor);
+	profile_out.equippedTypes[0] = g_gameState->readNum(FeatureKey{ FeatureKind::kEquippedType, 0, 0 }, noCalls, actor);
+	profile_out.equippedTypes[1] = g_gameState->readNum(FeatureKey{ FeatureKind::kEquippedType, 0, 1 }, noCalls, actor);
+}
\ No newline at end of file
@@ -0,0 +1,527 @@
+// ============================================================================
+//                              BSAArchive.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "BSAArchive.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	// archiveFlags
+	const uint32_t kArchive_DirectoryNames = 0x001;
+	const uint32_t kArchive_FileNames      = 0x002;
+	const uint32_t kArchive_Compressed     = 0x004;
+	const uint32_t kArchive_EmbedNames     = 0x100;
+
+	// File record size bits
+	const uint32_t kSize_ToggleCompression = 0x40000000;
+	const uint32_t kSize_Mask              = 0x3FFFFFFF;
+
+	struct Header
+	{
+		char     fileId[4];              // "BSA\0"
+		uint32_t version;
+		uint32_t offset;                 // of the folder records
+		uint32_t archiveFlags;
+		uint32_t folderCount;
+		uint32_t fileCount;
+		uint32_t totalFolderNameLength;
+		uint32_t totalFileNameLength;
+		uint16_t fileFlags;
+		uint16_t pad;
+	};
+	static_assert(sizeof(Header) == 36, "BSA header");
+
+	struct FolderRecord
+	{
+		uint64_t nameHash;
+		uint32_t count;
+		uint32_t pad;
+		uint64_t offset;
+	};
+	static_assert(sizeof(FolderRecord) == 24, "BSA folder record");
+
+	struct FileRecord
+	{
+		uint64_t nameHash;
+		uint32_t size;
+		uint32_t offset;
+	};
+	static_assert(sizeof(FileRecord) == 16, "BSA file record");
+
+	class Reader
+	{
+		// ====================================================================
+		//                             Reader
+		// --------------------------------------------------------------------
+		// Buffered sequential reads, so we can stream through the
+		// archive's directory in one pass.
+		// ====================================================================
+	public:
+		explicit Reader(FILE* f) : f(f) {}
+
+		bool read(void* dest, size_t n)
+		{
+			char* pDest = (char*)dest;
+			while (n > 0)
+			{
+				if (pos == end && !fill())
+				{
+					return false;
+				}
+				size_t nChunk = (end - pos < n) ? end - pos : n;
+				memcpy(pDest, buf + pos, nChunk);
+				pos += nChunk;
+				pDest += nChunk;
+				n -= nChunk;
+			}
+			return true;
+		}
+
+		bool skip(size_t n)
+		{
+			while (n > 0)
+			{
+				if (pos == end && !fill())
+				{
+					return false;
+				}
+				size_t nChunk = (end - pos < n) ? end - pos : n;
+				pos += nChunk;
+				n -= nChunk;
+			}
+			return true;
+		}
+
+		bool readCString(std::string& s_out, size_t& nRemaining)
+		{
+			// A null terminated string, from a block with 'nRemaining'
+			// bytes left in it.
+			s_out.clear();
+			char ch;
+			while (nRemaining > 0 && read(&ch, 1))
+			{
+				--nRemaining;
+				if (!ch)
+				{
+					return true;
+				}
+				s_out.push_back(ch);
+			}
+			return false;
+		}
+
+	private:
+		FILE*  f;
+		char   buf[65536];
+		size_t pos = 0;
+		size_t end = 0;
+
+		bool fill()
+		{
+			pos = 0;
+			end = fread(buf, 1, sizeof(buf), f);
+			return end > 0;
+		}
+	};
+
+	char toLower(char ch)
+	{
+		return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+	}
+
+	uint32_t readLE32(const uint8_t* p)
+	{
+		return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+
+	// The most LZ4 can expand data by: a match of any length takes a
+	// byte per 255.
+	const uint64_t kMaxLZ4Ratio = 255;
+
+	bool decodeLZ4Block(const uint8_t* src, size_t srcSize, size_t maxSize, std::string& out)
+	{
+		// ====================================================================
+		//                          decodeLZ4Block
+		// --------------------------------------------------------------------
+		// Decodes one LZ4 block, appending to 'out', which mustn't grow past
+		// 'maxSize'. Matches may reach back into earlier blocks (i.e. 'out'
+		// is the whole window).
+		// ====================================================================
+		const uint8_t* p = src;
+		const uint8_t* pEnd = src + srcSize;
+		while (p < pEnd)
+		{
+			uint8_t token = *p++;
+
+			// Literals.
+			size_t nLiterals = token >> 4;
+			if (nLiterals == 15)
+			{
+				uint8_t b;
+				do
+				{
+					if (p == pEnd)
+					{
+						return false;
+					}
+					b = *p++;
+					nLiterals += b;
+				} while (b == 255);
+			}
+			if ((size_t)(pEnd - p) < nLiterals || maxSize - out.size() < nLiterals)
+			{
+				return false;
+			}
+			out.append((const char*)p, nLiterals);
+			p += nLiterals;
+			if (p == pEnd)
+			{
+				return true;    // the last sequence has no match
+			}
+
+			// Match.
+			if (pEnd - p < 2)
+			{
+				return false;
+			}
+			size_t offset = p[0] | (p[1] << 8);
+			p += 2;
+			size_t matchLength = (token & 15);
+			if (matchLength == 15)
+			{
+				uint8_t b;
+				do
+				{
+					if (p == pEnd)
+					{
+						return false;
+					}
+					b = *p++;
+					matchLength += b;
+				} while (b == 255);
+			}
+			matchLength += 4;
+			if (offset == 0 || offset > out.size() || maxSize - out.size() < matchLength)
+			{
+				return false;
+			}
+			// N.B. the match may overlap what it's copying.
+			size_t from = out.size() - offset;
+			for (size_t i = 0; i < matchLength; ++i)
+			{
+				out.push_back(out[from + i]);
+			}
+		}
+		return true;
+	}
+
+	bool decodeLZ4Frame(const uint8_t* src, size_t srcSize, size_t maxSize, std::string& out)
+	{
+		// ====================================================================
+		//                          decodeLZ4Frame
+		// --------------------------------------------------------------------
+		// Decodes an LZ4 frame (the format SE archives compress files with)
+		// of at most 'maxSize' bytes. Checksums, where present, are skipped
+		// rather than verified.
+		// ====================================================================
+		const uint8_t* p = src;
+		const uint8_t* pEnd = src + srcSize;
+		if (srcSize < 7 || readLE32(p) != 0x184D2204)
+		{
+			return false;
+		}
+		p += 4;
+		uint8_t flg = *p++;
+		p++;    // BD
+		if ((flg >> 6) != 1)
+		{
+			return false;    // unknown frame version
+		}
+		bool bBlockChecksums = (flg & 0x10) != 0;
+		bool bContentChecksum = (flg & 0x04) != 0;
+		size_t nHeaderExtra = ((flg & 0x08) ? 8 : 0) + ((flg & 0x01) ? 4 : 0) + 1;
+		if ((size_t)(pEnd - p) < nHeaderExtra)
+		{
+			return false;
+		}
+		p += nHeaderExtra;    // content size, dictionary ID, header checksum
+
+		while (true)
+		{
+			if (pEnd - p < 4)
+			{
+				return false;
+			}
+			uint32_t blockSize = readLE32(p);
+			p += 4;
+			if (blockSize == 0)
+			{
+				break;    // end mark
+			}
+			bool bUncompressed = (blockSize & 0x80000000) != 0;
+			blockSize &= 0x7FFFFFFF;
+			if ((size_t)(pEnd - p) < blockSize + (bBlockChecksums ? 4 : 0))
+			{
+				return false;
+			}
+			if (bUncompressed)
+			{
+				if (maxSize - out.size() < blockSize)
+				{
+					return false;
+				}
+				out.append((const char*)p, blockSize);
+			}
+			else if (!decodeLZ4Block(p, blockSize, maxSize, out))
+			{
+				return false;
+			}
+			p += blockSize + (bBlockChecksums ? 4 : 0);
+		}
+		return !bContentChecksum || pEnd - p >= 4;
+	}
+}
+
+bool BSAArchive::open(const std::string& path,
+	                  const std::function<bool(std::string_view folder)>& wantFolder)
+{
+	archivePath = path;
+	fileList.clear();
+	archiveSize = 0;
+	lastError = NULL;
+
+	FILE* f = fopen(path.c_str(), "rb");
+	if (!f)
+	{
+		return false;
+	}
+	// (Everything the header and the records say must be within this.)
+#ifdef _WIN32
+	if (_fseeki64(f, 0, SEEK_END) == 0)
+	{
+		archiveSize = (uint64_t)_ftelli64(f);
+	}
+#else
+	if (fseeko(f, 0, SEEK_END) == 0)
+	{
+		archiveSize = (uint64_t)ftello(f);
+	}
+#endif
+	rewind(f);
+	Reader reader(f);
+
+	Header header;
+	std::vector<FolderRecord> folders;
+	if (!reader.read(&header, sizeof(header)) || memcmp(header.fileId, "BSA", 4))
+	{
+		lastError = "not a BSA";
+	}
+	else if (header.version != kVersion)
+	{
+		lastError = "not an SE archive";
+	}
+	else if ((header.archiveFlags & kArchive_DirectoryNames) == 0
+		     || (header.archiveFlags & kArchive_FileNames) == 0)
+	{
+		lastError = "archive has no file names";
+	}
+	else if (header.offset < sizeof(header)
+		     || header.offset + (uint64_t)header.folderCount * sizeof(FolderRecord)
+				+ (uint64_t)header.fileCount * sizeof(FileRecord)
+				+ header.totalFileNameLength > archiveSize
+		     || !reader.skip(header.offset - sizeof(header)))
+	{
+		lastError = "truncated";
+	}
+	else
+	{
+		// Folder records.
+		archiveFlags = header.archiveFlags;
+		folders.resize(header.folderCount);
+		if (!reader.read(folders.data(), folders.size() * sizeof(FolderRecord)))
+		{
+			lastError = "truncated";
+		}
+	}
+
+	// File record blocks, each headed by its folder's name. Note which of
+	// the files we want, and where they are.
+	std::vector<File> wanted;
+	std::vector<std::pair<uint32_t, size_t>> wantedByFileIndex;    // (file index, wanted index)
+	uint32_t fileIndex = 0;
+	std::string folderName;
+	for (size_t i = 0; !lastError && i < folders.size(); ++i)
+	{
+		uint8_t nameLength;
+		if (!reader.read(&nameLength, 1))
+		{
+			lastError = "truncated";
+			break;
+		}
+		folderName.resize(nameLength);
+		if (!reader.read(&folderName[0], nameLength))
+		{
+			lastError = "truncated";
+			break;
+		}
+		if (!folderName.empty() && folderName.back() == '\0')
+		{
+			folderName.pop_back();
+		}
+		for (auto& ch : folderName)
+		{
+			ch = (ch == '/') ? '\\' : toLower(ch);
+		}
+		bool bWanted = wantFolder(folderName);
+
+		for (uint32_t j = 0; j < folders[i].count; ++j, ++fileIndex)
+		{
+			FileRecord record;
+			if (!reader.read(&record, sizeof(record)))
+			{
+				lastError = "truncated";
+				break;
+			}
+			if (bWanted)
+			{
+				File file;
+				file.path = folderName;
+				file.offset = record.offset;
+				file.size = record.size & kSize_Mask;
+				file.bCompressed = ((header.archiveFlags & kArchive_Compressed) != 0)
+					!= ((record.size & kSize_ToggleCompression) != 0);
+				wantedByFileIndex.emplace_back(fileIndex, wanted.size());
+				wanted.push_back(std::move(file));
+			}
+		}
+	}
+
+	// File names, in the same order as the file records.
+	size_t nRemaining = lastError ? 0 : header.totalFileNameLength;
+	std::string fileName;
+	size_t iWanted = 0;
+	for (uint32_t i = 0; !lastError && i < fileIndex && iWanted < wantedByFileIndex.size(); ++i)
+	{
+		if (!reader.readCString(fileName, nRemaining))
+		{
+			lastError = "truncated";
+			break;
+		}
+		if (wantedByFileIndex[iWanted].first == i)
+		{
+			File& file = wanted[wantedByFileIndex[iWanted].second];
+			for (auto& ch : fileName)
+			{
+				ch = toLower(ch);
+			}
+			file.path.push_back('\\');
+			file.path.append(fileName);
+			++iWanted;
+		}
+	}
+	fclose(f);
+
+	if (lastError)
+	{
+		return false;
+	}
+	fileList = std::move(wanted);
+	return true;
+}
+
+bool BSAArchive::readFile(const File& file, std::string& data_out) const
+{
+	data_out.clear();
+	if ((uint64_t)file.offset + file.size > archiveSize)
+	{
+		lastError = "truncated";
+		return false;
+	}
+	FILE* f = fopen(archivePath.c_str(), "rb");
+	if (!f)
+	{
+		lastError = "couldn't reopen archive";
+		return false;
+	}
+	std::string raw(file.size, '\0');
+#ifdef _WIN32
+	bool bRead = _fseeki64(f, file.offset, SEEK_SET) == 0    // (archives can pass 2 GB)
+#else
+	bool bRead = fseeko(f, file.offset, SEEK_SET) == 0
+#endif
+		&& fread(&raw[0], 1, raw.size(), f) == raw.size();
+	fclose(f);
+	if (!bRead)
+	{
+		lastError = "truncated";
+		return false;
+	}
+
+	size_t pos = 0;
+	if (archiveFlags & kArchive_EmbedNames)
+	{
+		// Skip the file's full path (a length prefixed string).
+		if (raw.empty() || 1 + (size_t)(uint8_t)raw[0] > raw.size())
+		{
+			lastError = "truncated";
+			return false;
+		}
+		pos = 1 + (uint8_t)raw[0];
+	}
+
+	if (!file.bCompressed)
+	{
+		data_out.assign(raw, pos, std::string::npos);
+		return true;
+	}
+
+	// Compressed: original size, then an LZ4 frame.
+	if (raw.size() - pos < 4)
+	{
+		lastError = "truncated";
+		return false;
+	}
+	uint32_t originalSize = readLE32((const uint8_t*)raw.data() + pos);
+	pos += 4;
+	if (originalSize > (raw.size() - pos) * kMaxLZ4Ratio)
+	{
+		// (So it can't be made to allocate more than that.)
+		lastError = "bad compressed data";
+		return false;
+	}
+	data_out.reserve(originalSize);
+	if (!decodeLZ4Frame((const uint8_t*)raw.data() + pos, raw.size() - pos, originalSize, data_out)
+		|| data_out.size() != originalSize)
+	{
+		data_out.clear();
+		lastError = "bad compressed data";
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+// ============================================================================
+//                            ConditionCache.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "ConditionCache.h"
+
+// Enough for every loaded actor to have a few dozen animations cached (an
+// entry is typically well under a KB).
+ConditionCache g_conditionCache(16384);
+
+void ConditionCache::Entry::reset(uint32_t baseFormID, const FeatureLayout& layout)
+{
+	this->baseFormID = baseFormID;
+	bFilled = false;
+	stamps.assign(layout.nPrograms, 0);
+	evaluatedAt.assign(layout.nPrograms, 0);
+	results.assign(layout.nPrograms, 0);
+}
+
+uint32_t ConditionCache::Entry::beginActivation(uint32_t actorID, const ActorObservation& observed,
+	                                            ConditionEvents& events)
+{
+	// The time is taken before asking what's dirty: an event notified in
+	// between is then newer than it, so is seen next time if not now.
+	ConditionEvents::Tick seen = events.now();
+	uint32_t readScopes;
+	if (!bFilled)
+	{
+		readScopes = ~scopeBit(FeatureScope::kWorld);
+		bFilled = true;
+	}
+	else
+	{
+		readScopes = scopeBit(FeatureScope::kActor)
+			       | events.dirtyScopes(actorID, eventsSeen)
+			       | this->observed.changedScopes(observed);
+	}
+	eventsSeen = seen;
+	this->observed = observed;
+
+	activation++;
+	for (size_t scope = 0; scope < (size_t)FeatureScope::kNumScopes; scope++)
+	{
+		if (readScopes & (1u << scope))
+		{
+			scopeReadAt[scope] = activation;
+		}
+	}
+	return readScopes;
+}
+
+bool ConditionCache::Entry::findResult(const ConditionProgram& program, uint64_t stamp,
+	                                   bool& result_out) const
+{
+	if (stamps[program.index] != stamp)
+	{
+		return false;
+	}
+	for (size_t scope = 0; scope < (size_t)FeatureScope::kNumScopes; scope++)
+	{
+		if ((program.readScopes & (1u << scope))
+			&& scopeReadAt[scope] > evaluatedAt[program.index])
+		{
+			// One of its features has been read again since.
+			return false;
+		}
+	}
+	result_out = results[program.index] != 0;
+	return true;
+}
+
+void ConditionCache::Entry::setResult(const ConditionProgram& program, uint64_t stamp, bool result)
+{
+	stamps[program.index] = stamp;
+	evaluatedAt[program.index] = activation;
+	results[program.index] = result;
+}
+
+std::shared_ptr<ConditionCache::Entry> ConditionCache::get(uint32_t actorID, uint32_t layoutID)
+{
+	if (nEntries >= maxEntries)
+	{
+		clear();
+	}
+	bool inserted;
+	std::shared_ptr<Entry> entry = entries.findOrInsert(
+		((uint64_t)actorID << 32) | layoutID,
+		[]() { return std::make_shared<Entry>(); },
+		&inserted);
+	if (inserted)
+	{
+		nEntries++;
+	}
+	return entry;
+}
+
+void ConditionCache::clear()
+{
+	entries.clear();
+	nEntries = 0;
+}
\ No newline at end of file
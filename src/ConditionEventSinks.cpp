@@ -0,0 +1,146 @@
+// ============================================================================
+//                          ConditionEventSinks.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "ConditionEvents.h"
+
+#include "RE/B/BSTEvent.h"
+#include "RE/S/ScriptEventSourceHolder.h"
+#include "RE/Offsets.h"
+
+#include <cstring>
+
+// ============================================================================
+//                           ConditionEventSinks
+// ----------------------------------------------------------------------------
+// The game's side of ConditionEvents: sinks on the ScriptEventSourceHolder
+// that pass on the events which change event driven condition features.
+// Both are sent on the main thread, once the change they report has been
+// made. (Cell changes need no sink: observeActor sees them.)
+// ============================================================================
+
+class EquipEventSink : public BSTEventSink<TESEquipEvent>
+{
+public:
+	BSEventNotifyControl ProcessEvent(const TESEquipEvent* a_event,
+		                              BSTEventSource<TESEquipEvent>*) override
+	{
+		if (a_event && a_event->actor)
+		{
+			g_conditionEvents.notify(a_event->actor->form.formID,
+				                     scopeBit(FeatureScope::kEquipment));
+		}
+		return BSEventNotifyControl::kContinue;
+	}
+};
+
+class CombatEventSink : public BSTEventSink<TESCombatEvent>
+{
+public:
+	BSEventNotifyControl ProcessEvent(const TESCombatEvent* a_event,
+		                              BSTEventSource<TESCombatEvent>*) override
+	{
+		if (a_event && a_event->actor)
+		{
+			g_conditionEvents.notify(a_event->actor->form.formID,
+				                     scopeBit(FeatureScope::kCombat));
+		}
+		return BSEventNotifyControl::kContinue;
+	}
+};
+
+template <class T>
+static bool pushBack(BSTArray<T>& array, const T& item)
+{
+	// As BSTArray::push_back. If the array has to grow, that's done on the
+	// game's heap, since that's where the game will free it from.
+	if (array._size == array._capacity)
+	{
+		uint32_t capacity = array._capacity ? array._capacity * 2 : 4;
+		RE::MemoryManager* heap = RE::MemoryManager_GetSingleton();
+		T* data = (T*)RE::MemoryManager_Allocate(heap, capacity * sizeof(T), 0, false);
+		if (!data)
+		{
+			return false;
+		}
+		if (array._data)
+		{
+			memcpy(data, array._data, array._size * sizeof(T));
+			RE::MemoryManager_Deallocate(heap, array._data, false);
+		}
+		array._data = data;
+		array._capacity = capacity;
+	}
+	array._data[array._size++] = item;
+	return true;
+}
+
+template <class Event>
+static bool addEventSink(BSTEventSource<Event>& source, BSTEventSink<Event>* sink)
+{
+	// As BSTEventSource::AddEventSink: while the source is sending an event
+	// new sinks wait in pendingRegisters.
+	BSSpinLock_lock(&source.lock);
+	bool added = pushBack(source.notifying ? source.pendingRegisters : source.sinks, sink);
+	BSSpinLock_unlock(&source.lock);
+	return added;
+}
+
+bool registerConditionEventSinks()
+{
+	// Cell changes are observed rather than sent.
+	g_conditionEvents.subscribe(scopeBit(FeatureScope::kCell));
+
+	ScriptEventSourceHolder* holder = RE::ScriptEventSourceHolder_GetSingleton();
+	if (!holder)
+	{
+		_ERROR("couldn't get ScriptEventSourceHolder: equipment and combat conditions won't be cached");
+		return false;
+	}
+
+	static EquipEventSink equipSink;
+	static CombatEventSink combatSink;
+	bool ok = true;
+	if (addEventSink<TESEquipEvent>(holder->equipEvents, &equipSink))
+	{
+		g_conditionEvents.subscribe(scopeBit(FeatureScope::kEquipment));
+	}
+	else
+	{
+		_ERROR("couldn't sink TESEquipEvent: equipment conditions won't be cached");
+		ok = false;
+	}
+	if (addEventSink<TESCombatEvent>(holder->combatEvents, &combatSink))
+	{
+		g_conditionEvents.subscribe(scopeBit(FeatureScope::kCombat));
+	}
+	else
+	{
+		_ERROR("couldn't sink TESCombatEvent: combat conditions won't be cached");
+		ok = false;
+	}
+	return ok;
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+// ============================================================================
+//                            ConditionEvents.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "ConditionEvents.h"
+#include "GameState.h"
+
+// More actors than are ever loaded at once. Past this, the oldest are
+// probably long gone: start again (as if everything had changed).
+ConditionEvents g_conditionEvents(8192);
+
+void ConditionEvents::notify(uint32_t actorID, uint32_t scopes)
+{
+	// (Events are rare enough for counting the shards to be fine.) The
+	// actors are forgotten only once everything is dirty.
+	if (actors.size() >= maxActors)
+	{
+		notifyAll(kEventScopes);
+		actors.clear();
+	}
+	actors.update(actorID, [&](ActorTicks& actor)
+	{
+		// The tick is taken under the shard's lock, so that dirtyScopes
+		// either finds it or was called before it was taken.
+		Tick tick = ++lastTick;
+		for (size_t scope = 0; scope < (size_t)FeatureScope::kNumScopes; scope++)
+		{
+			if (scopes & (1u << scope))
+			{
+				actor.ticks[scope] = tick;
+			}
+		}
+	});
+	nNotified++;
+}
+
+void ConditionEvents::notifyAll(uint32_t scopes)
+{
+	// While the tick is being stored, every scope is dirty (see
+	// dirtyScopes). The stored ticks only ever go up, whatever order
+	// concurrent notifications store them in.
+	nPendingAll++;
+	Tick tick = ++lastTick;
+	for (size_t scope = 0; scope < (size_t)FeatureScope::kNumScopes; scope++)
+	{
+		if (scopes & (1u << scope))
+		{
+			Tick stored = allTicks[scope];
+			while (stored < tick && !allTicks[scope].compare_exchange_weak(stored, tick))
+			{
+			}
+		}
+	}
+	nPendingAll--;
+	nNotified++;
+}
+
+uint32_t ConditionEvents::dirtyScopes(uint32_t actorID, Tick since)
+{
+	// (Ticks are unique, so an event notified before 'since' was taken has
+	// a smaller tick, and one notified after it a larger one.)
+	// A notifyAll() in progress may have taken a tick older than 'since'
+	// without having stored it yet.
+	ActorTicks actor;
+	actors.find(actorID, actor);
+	uint32_t scopes = kEventScopes & ~subscribed;
+	if (nPendingAll)
+	{
+		scopes |= kEventScopes;
+	}
+	for (size_t scope = 0; scope < (size_t)FeatureScope::kNumScopes; scope++)
+	{
+		if (actor.ticks[scope] > since || allTicks[scope] > since)
+		{
+			scopes |= 1u << scope;
+		}
+	}
+	return scopes;
+}
+
+void observeActor(Actor* actor, ActorObservation& observation_out)
+{
+	observation_out.parentCell = g_gameState->readFormID(FeatureKey{ FeatureKind::kParentCell, 0, 0 }, actor);
+	observation_out.hands[0] = g_gameState->readFormID(FeatureKey{ FeatureKind::kEquipped, 0, 0 }, actor);
+	observation_out.hands[1] = g_gameState->readFormID(FeatureKey{ FeatureKind::kEquipped, 0, 1 }, actor);
+}
\ No newline at end of file
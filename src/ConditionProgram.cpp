@@ -0,0 +1,437 @@
+// ============================================================================
+//                           ConditionProgram.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "ConditionProgram.h"
+#include "FactionRanks.h"
+#include "GameState.h"
+#include "WorldState.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
+FeatureLayout::FeatureLayout()
+{
+	static std::atomic<uint32_t> lastID{ 0 };
+	id = ++lastID;
+}
+
+uint16_t FeatureLayout::addNum(FeatureKind kind, uint32_t param, uint16_t funcId, FeatureScope scope)
+{
+	FeatureKey key{ kind, funcId, param };
+	for (size_t slot = 0; slot < nums.size(); slot++)
+	{
+		if (nums[slot] == key)
+		{
+			return (uint16_t)slot;
+		}
+	}
+	nums.push_back(key);
+	numScopes.push_back(scope);
+	return (uint16_t)(nums.size() - 1);
+}
+
+uint16_t FeatureLayout::addFormID(FeatureKind kind, uint32_t param, FeatureScope scope)
+{
+	FeatureKey key{ kind, 0, param };
+	for (size_t slot = 0; slot < formIDs.size(); slot++)
+	{
+		if (formIDs[slot] == key)
+		{
+			return (uint16_t)slot;
+		}
+	}
+	formIDs.push_back(key);
+	formIDScopes.push_back(scope);
+	return (uint16_t)(formIDs.size() - 1);
+}
+
+uint16_t FeatureLayout::addWorldNum(FeatureKind kind, uint32_t param, WorldState& world)
+{
+	size_t nBefore = nums.size();
+	uint16_t slot = addNum(kind, param, 0, FeatureScope::kWorld);
+	if (nums.size() != nBefore)
+	{
+		worldNums.push_back(WorldSlot{ slot, world.addNum(nums[slot]) });
+	}
+	return slot;
+}
+
+uint16_t FeatureLayout::addWorldFormID(FeatureKind kind, uint32_t param, WorldState& world)
+{
+	size_t nBefore = formIDs.size();
+	uint16_t slot = addFormID(kind, param, FeatureScope::kWorld);
+	if (formIDs.size() != nBefore)
+	{
+		worldFormIDs.push_back(WorldSlot{ slot, world.addFormID(formIDs[slot]) });
+	}
+	return slot;
+}
+
+uint16_t FeatureLayout::addCall(const ConditionCall& call)
+{
+	calls.push_back(call);
+	nums.push_back(FeatureKey{ FeatureKind::kCall, 0, (uint32_t)(calls.size() - 1) });
+	numScopes.push_back(FeatureScope::kActor);
+	return (uint16_t)(nums.size() - 1);
+}
+
+static uint32_t worldSlotOf(const std::vector<FeatureLayout::WorldSlot>& worldSlots, uint16_t slot)
+{
+	for (auto& worldSlot : worldSlots)
+	{
+		if (worldSlot.slot == slot)
+		{
+			return worldSlot.worldSlot;
+		}
+	}
+	return 0;
+}
+
+void ConditionProgram::link(FeatureLayout& layout)
+{
+	index = layout.nPrograms++;
+	readScopes = 0;
+	worldNums.clear();
+	worldFormIDs.clear();
+
+	auto readsNum = [&](const FeatureOperand& operand)
+	{
+		if (operand.slot == FeatureOperand::kConstant)
+		{
+			return;
+		}
+		FeatureScope scope = layout.numScopes[operand.slot];
+		readScopes |= scopeBit(scope);
+		if (scope == FeatureScope::kWorld)
+		{
+			worldNums.push_back(worldSlotOf(layout.worldNums, operand.slot));
+		}
+	};
+	for (auto& op : ops)
+	{
+		switch (op.test)
+		{
+		case ConditionOp::kTrue:
+			readsNum(op.lhs);
+			break;
+		case ConditionOp::kEqual:
+		case ConditionOp::kLess:
+			readsNum(op.lhs);
+			readsNum(op.rhs);
+			break;
+		case ConditionOp::kFormEqual:
+		case ConditionOp::kInLocation:
+		{
+			FeatureScope scope = layout.formIDScopes[op.lhs.slot];
+			readScopes |= scopeBit(scope);
+			if (scope == FeatureScope::kWorld)
+			{
+				worldFormIDs.push_back(worldSlotOf(layout.worldFormIDs, op.lhs.slot));
+			}
+			break;
+		}
+		}
+	}
+	bCacheable = (readScopes & scopeBit(FeatureScope::kActor)) == 0;
+}
+
+uint64_t ConditionProgram::stamp(const WorldSnapshot* world) const
+{
+	// Versions are drawn from one increasing counter, so the largest of
+	// them changes exactly when any one of them does.
+	uint64_t latest = 1;
+	for (uint32_t worldSlot : worldNums)
+	{
+		latest = std::max(latest, world->numVersions[worldSlot]);
+	}
+	for (uint32_t worldSlot : worldFormIDs)
+	{
+		latest = std::max(latest, world->formIDVersions[worldSlot]);
+	}
+	return latest;
+}
+
+bool ConditionProgram::evaluate(const FeatureVector& features) const
+{
+	bool bTrueOr = false;    // If true the last evaluated expression was true || ...
+	bool bCond;
+
+	// Evaluate the chain of conditions.
+	for (auto& op : ops)
+	{
+		if (bTrueOr)
+		{
+			// Don't need to evaluate this expression.
+
+			// We have true || ... which evaluates to true, 
+			// irrespective of what the second expression is. 
+			// So don't waste time evaluating it. Move onto the next one.
+			if (op.bAnd)
+			{
+				// This breaks our ability to avoid evaluating.
+				// We now have (true || ... && ...) == (true && ...)
+				bTrueOr = false;
+			}
+		}
+		else
+		{
+			// Need to evaluate this expression.
+			bCond = op.evaluate(features);
+			if (bCond == op.bNot)
+			{
+				// We have either
+				//   !true or false
+				// both of which evaluate to false.
+				if (op.bAnd)
+				{
+					// We have false && ...
+					// which always evaluates to false.
+					// No need to evaluate any further expressions.
+					return false;
+				}
+
+				// We have false || ...
+				// Need to evaluate the next expression.
+			}
+			else
+			{
+				// We have true (&& or ||) ...
+				// If we have true || ... we don't need
+				// to evaluate the next condition.
+				bTrueOr = !op.bAnd;
+			}
+		}
+	}
+	return true;
+}
+
+// The DAR condition functions, by name.
+static const std::pair<std::string, FuncInfo> s_conditionFuncs[] =
+{
+#define X(name, func, nArgs, bmArgIsFloat) { name, FuncInfo{ kCondition_##func, nArgs, bmArgIsFloat } },
+	DAR_CONDITION_FUNCS(X)
+#undef X
+};
+std::unordered_map<std::string, FuncInfo> g_DARConditionFuncs(
+	std::begin(s_conditionFuncs), std::end(s_conditionFuncs));
+
+ConditionOp compileCondition(uint16_t funcId, const ConditionArg* args, FeatureLayout& layout)
+{
+	// See ConditionProgram.h. Most conditions compare one feature of the
+	// actor against their args. Numeric args are operands that are either
+	// constants or (for global variables) features of their own.
+	ConditionOp op;
+	switch (funcId)
+	{
+	case kCondition_IsInFaction:
+		g_factionRanks.addFaction(args[0].formID);
+		break;
+	case kCondition_IsFactionRankEqualTo:
+	case kCondition_IsFactionRankLessThan:
+		g_factionRanks.addFaction(args[1].formID);
+		break;
+	default:
+		break;
+	}
+	auto operand = [&layout](const ConditionArg& arg)
+	{
+		FeatureOperand operand;
+		if (arg.bIsFloat)
+		{
+			operand.value = arg.fVal;
+		}
+		else
+		{
+			operand.slot = layout.addWorldNum(FeatureKind::kGlobalValue, arg.formID, g_worldState);
+		}
+		return operand;
+	};
+	auto compare = [&op](uint8_t test, FeatureOperand lhs, FeatureOperand rhs)
+	{
+		op.test = test;
+		op.lhs = lhs;
+		op.rhs = rhs;
+	};
+	auto feature = [&layout](FeatureKind kind, uint32_t param = 0,
+							 FeatureScope scope = FeatureScope::kActor)
+	{
+		FeatureOperand operand;
+		operand.slot = layout.addNum(kind, param, 0, scope);
+		return operand;
+	};
+	auto formEqual = [&op, &layout](FeatureKind kind, uint32_t param, uint32_t formID,
+									FeatureScope scope = FeatureScope::kActor)
+	{
+		op.test = ConditionOp::kFormEqual;
+		op.lhs.slot = layout.addFormID(kind, param, scope);
+		op.rhsFormID = formID;
+	};
+	auto actorValue = [&](FeatureKind kind, uint8_t test)
+	{
+		if (args[0].bIsFloat)
+		{
+			compare(test, feature(kind, (uint32_t)args[0].fVal), operand(args[1]));
+		}
+		else
+		{
+			// Which actor value is only known when we read the global.
+			ConditionCall call{ funcId, { args[0], args[1] } };
+			compare(ConditionOp::kTrue, FeatureOperand{ layout.addCall(call) }, FeatureOperand());
+		}
+	};
+
+	switch (funcId)
+	{
+	case kCondition_IsEquippedRight:                formEqual(FeatureKind::kEquipped, 1, args[0].formID, FeatureScope::kEquipment); break;
+	case kCondition_IsEquippedLeft:                 formEqual(FeatureKind::kEquipped, 0, args[0].formID, FeatureScope::kEquipment); break;
+	case kCondition_IsEquippedShout:                formEqual(FeatureKind::kSelectedPower, 0, args[0].formID, FeatureScope::kEquipment); break;
+	// (These are read off the actor's base record.)
+	case kCondition_IsActorBase:                    formEqual(FeatureKind::kActorBase, 0, args[0].formID, FeatureScope::kStatic); break;
+	case kCondition_IsRace:                         formEqual(FeatureKind::kRace, 0, args[0].formID, FeatureScope::kStatic); break;
+	case kCondition_IsClass:                        formEqual(FeatureKind::kClass, 0, args[0].formID, FeatureScope::kStatic); break;
+	case kCondition_IsCombatStyle:                  formEqual(FeatureKind::kCombatStyle, 0, args[0].formID, FeatureScope::kStatic); break;
+	case kCondition_IsVoiceType:                    formEqual(FeatureKind::kVoiceType, 0, args[0].formID, FeatureScope::kStatic); break;
+	case kCondition_IsParentCell:                   formEqual(FeatureKind::kParentCell, 0, args[0].formID, FeatureScope::kCell); break;
+	case kCondition_IsWorldSpace:                   formEqual(FeatureKind::kWorldSpace, 0, args[0].formID, FeatureScope::kCell); break;
+	case kCondition_HasRefType:                     formEqual(FeatureKind::kLocationRefType, 0, args[0].formID); break;
+	case kCondition_IsInLocation:
+		op.test = ConditionOp::kInLocation;
+		op.lhs.slot = layout.addFormID(FeatureKind::kCurrentLocation, 0, FeatureScope::kCell);
+		op.rhsFormID = args[0].formID;
+		break;
+
+	case kCondition_IsEquippedRightType:            compare(ConditionOp::kEqual, feature(FeatureKind::kEquippedType, 1, FeatureScope::kEquipment), operand(args[0])); break;
+	case kCondition_IsEquippedLeftType:             compare(ConditionOp::kEqual, feature(FeatureKind::kEquippedType, 0, FeatureScope::kEquipment), operand(args[0])); break;
+	case kCondition_IsLevelLessThan:                compare(ConditionOp::kLess, feature(FeatureKind::kLevel), operand(args[0])); break;
+	case kCondition_IsMovementDirection:            compare(ConditionOp::kEqual, feature(FeatureKind::kMovementDirection), operand(args[0])); break;
+	case kCondition_ValueEqualTo:                   compare(ConditionOp::kEqual, operand(args[0]), operand(args[1])); break;
+	case kCondition_ValueLessThan:                  compare(ConditionOp::kLess, operand(args[0]), operand(args[1])); break;
+	case kCondition_IsFactionRankEqualTo:           compare(ConditionOp::kEqual, feature(FeatureKind::kFactionRank, args[1].formID), operand(args[0])); break;
+	case kCondition_IsFactionRankLessThan:          compare(ConditionOp::kLess, feature(FeatureKind::kFactionRank, args[1].formID), operand(args[0])); break;
+
+	case kCondition_IsActorValueEqualTo:            actorValue(FeatureKind::kActorValue, ConditionOp::kEqual); break;
+	case kCondition_IsActorValueLessThan:           actorValue(FeatureKind::kActorValue, ConditionOp::kLess); break;
+	case kCondition_IsActorValueBaseEqualTo:        actorValue(FeatureKind::kActorValueBase, ConditionOp::kEqual); break;
+	case kCondition_IsActorValueBaseLessThan:       actorValue(FeatureKind::kActorValueBase, ConditionOp::kLess); break;
+	case kCondition_IsActorValueMaxEqualTo:         actorValue(FeatureKind::kActorValueMax, ConditionOp::kEqual); break;
+	case kCondition_IsActorValueMaxLessThan:        actorValue(FeatureKind::kActorValueMax, ConditionOp::kLess); break;
+	case kCondition_IsActorValuePercentageEqualTo:  actorValue(FeatureKind::kActorValuePercentage, ConditionOp::kEqual); break;
+	case kCondition_IsActorValuePercentageLessThan: actorValue(FeatureKind::kActorValuePercentage, ConditionOp::kLess); break;
+
+	// These only depend on the world, not the actor.
+	case kCondition_CurrentWeather:
+		op.test = ConditionOp::kFormEqual;
+		op.lhs.slot = layout.addWorldFormID(FeatureKind::kWeather, 0, g_worldState);
+		op.rhsFormID = args[0].formID;
+		break;
+	case kCondition_CurrentGameTimeLessThan:
+	{
+		FeatureOperand gameHour;
+		gameHour.slot = layout.addWorldNum(FeatureKind::kGameHour, 0, g_worldState);
+		compare(ConditionOp::kLess, gameHour, operand(args[0]));
+		break;
+	}
+
+	case kCondition_Random:
+	{
+		// Drawn separately for each condition, as in DAR.
+		ConditionCall call{ funcId, { args[0] } };
+		compare(ConditionOp::kTrue, FeatureOperand{ layout.addCall(call) }, FeatureOperand());
+		break;
+	}
+
+	default:
+	{
+		// The rest are predicates of the actor and (at most) one form,
+		// e.g. IsInFaction(faction): the feature is the result itself.
+		FeatureScope scope;
+		switch (funcId)
+		{
+		case kCondition_IsFemale:
+		case kCondition_IsUnique:
+			scope = FeatureScope::kStatic;
+			break;
+		case kCondition_IsEquippedRightHasKeyword:
+		case kCondition_IsEquippedLeftHasKeyword:
+		case kCondition_IsWorn:
+		case kCondition_IsWornHasKeyword:
+			scope = FeatureScope::kEquipment;
+			break;
+		case kCondition_IsInCombat:
+			scope = FeatureScope::kCombat;
+			break;
+		case kCondition_IsInInterior:
+			scope = FeatureScope::kCell;
+			break;
+		default:
+			scope = FeatureScope::kActor;
+			break;
+		}
+		FeatureOperand predicate;
+		predicate.slot = layout.addNum(FeatureKind::kPredicate, args[0].formID, funcId, scope);
+		compare(ConditionOp::kTrue, predicate, FeatureOperand());
+		break;
+	}
+	}
+	return op;
+}
+
+void extractFeatures(const FeatureLayout& layout, Actor* actor, const WorldSnapshot* world,
+					 uint32_t readScopes, FeatureVector& features_out)
+{
+	// (World features are copied over afterwards.)
+	readScopes &= ~scopeBit(FeatureScope::kWorld);
+	features_out.nums.resize(layout.nums.size());
+	for (size_t slot = 0; slot < layout.nums.size(); slot++)
+	{
+		if (readScopes & scopeBit(layout.numScopes[slot]))
+		{
+			features_out.nums[slot] = g_gameState->readNum(layout.nums[slot], layout, actor);
+		}
+	}
+	features_out.formIDs.resize(layout.formIDs.size());
+	for (size_t slot = 0; slot < layout.formIDs.size(); slot++)
+	{
+		if (readScopes & scopeBit(layout.formIDScopes[slot]))
+		{
+			features_out.formIDs[slot] = g_gameState->readFormID(layout.formIDs[slot], actor);
+		}
+	}
+
+	if (layout.hasWorldFeatures())
+	{
+		for (auto& worldSlot : layout.worldNums)
+		{
+			features_out.nums[worldSlot.slot] = world->nums[worldSlot.worldSlot];
+		}
+		for (auto& worldSlot : layout.worldFormIDs)
+		{
+			features_out.formIDs[worldSlot.slot] = world->formIDs[worldSlot.worldSlot];
+		}
+	}
+}
\ No newline at end of file
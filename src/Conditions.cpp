@@ -25,7 +25,10 @@
 // 
 // (The MIT License)
 // ============================================================================
-#include "Conditions.h"
+#include "ConditionProgram.h"
+#include "FactionRanks.h"
+#include "GameState.h"
+#include "WorldState.h"
 
 #include "RE/A/Actor.h"
 #include "RE/A/ActorValues.h"
@@ -49,8 +52,10 @@
 #include "RE/Offsets.h"
 
 #include <corecrt_math_defines.h>   // for M_PI constant
+#include <limits>
 #include <random>
-#include <variant>
+#include <tuple>
+#include <utility>
 
 static double TWO_PI = 2.0 * M_PI;
 
@@ -76,43 +81,103 @@ typedef bool            (** _BGSKeywordForm_HasKeyword)(BGSKeywordForm* kwForm,
 typedef uint32_t        (** _BSExtraData_GetType)(BSExtraData* data);
 
 // ============================================================================
-//                          HELPER FUNCTIONS
+//                           ARGUMENT TYPES
 // ============================================================================
-static const BGSKeyword* g_kwWarhammer;
+// Condition functions declare their parameters with these types. The table
+// at the end of this file derives each function's arg count and float mask
+// from its parameter list, and evaluateCondition() converts the stored
+// ConditionArgs to them before calling the function directly. An arg that
+// can't be converted (a missing form, or a form of the wrong type) makes
+// the condition false without calling the function, as in DAR.
+
+// A form ID that is only compared against, never looked up.
+struct FormID
+{
+    uint32_t formID;
+};
+
+// A form of type 'kFormType' (or any type, if it's -1), looked up
+// when the condition is evaluated.
+template <typename T> struct FormTypeOf           { static constexpr int value = -1; };
+template <> struct FormTypeOf<BGSKeyword>         { static constexpr int value = FormType::Keyword; };
+template <> struct FormTypeOf<BGSLocation>        { static constexpr int value = FormType::Location; };
+template <> struct FormTypeOf<BGSLocationRefType> { static constexpr int value = FormType::LocationRefType; };
+template <> struct FormTypeOf<EffectSetting>      { static constexpr int value = FormType::MagicEffect; };
+template <> struct FormTypeOf<TESFaction>         { static constexpr int value = FormType::Faction; };
+
+template <typename T, int kFormType = FormTypeOf<T>::value>
+struct FormRef
+{
+    T* form;
 
-bool readGlobalVars(float* values, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat, int nArgs)
+    T* operator->() const { return form; }
+    operator T*() const { return form; }
+};
+
+// A GlobalVariable or a direct value: DAR accepts either wherever its
+// documentation says GlobalVariable. Globals are looked up when the
+// condition is bound (see ConditionArg::global), and read when it is
+// evaluated.
+struct GlobalOrFloat
 {
-    // ---------------------------------------------------------------------------------------------
-    // Read 'nArgs' global variables or direct values (depending on whether the corresponding bit
-    // is set in 'bmArgIsFloat') from 'args' into 'values'. We expect that 'values' has sufficient
-    // memory allocated.
-    // ---------------------------------------------------------------------------------------------
-    // Dereference the global variables as necessary (or store the direct values).
-    int powerOfTwo = 1;
-    for (int argIndex = 0; argIndex < nArgs; argIndex++)
+    float value;
+
+    operator float() const { return value; }
+};
+
+template <typename T> struct ArgIsFloat  { static constexpr bool value = false; };
+template <> struct ArgIsFloat<GlobalOrFloat> { static constexpr bool value = true; };
+
+static inline bool readArg(const ConditionArg& arg, FormID& out)
+{
+    out.formID = arg.formID;
+    return true;
+}
+
+template <typename T, int kFormType>
+static inline bool readArg(const ConditionArg& arg, FormRef<T, kFormType>& out)
+{
+    TESForm* form = RE::Game_GetForm(arg.formID);
+    if (!form || (kFormType != -1 && form->formType != kFormType))
     {
-        if ((powerOfTwo & bmArgIsFloat) != 0)
-        {
-            // Argument is a float.
-            values[argIndex] = std::get<float>(args[argIndex]);
-        }
-        else
-        {
-            // Argument should be a global variable.
-            // Dereference it and get its current value.
-            TESGlobal* form =
-                (TESGlobal*)RE::Game_GetForm(std::get<uint32_t>(args[argIndex]));
-            if (!form || form->form.formType != FormType::Global)
-            {
-                return false;
-            }
-            values[argIndex] = form->value;
-        }
-        powerOfTwo *= 2;
+        return false;
+    }
+    out.form = (T*)form;
+    return true;
+}
+
+static inline bool readArg(const ConditionArg& arg, GlobalOrFloat& out)
+{
+    if (arg.bIsFloat)
+    {
+        out.value = arg.fVal;
+        return true;
+    }
+
+    // Get the global variable's current value.
+    if (!arg.global)
+    {
+        return false;
     }
+    out.value = arg.global->value;
     return true;
 }
 
+const TESGlobal* lookupGlobal(uint32_t formID)
+{
+    TESForm* form = RE::Game_GetForm(formID);
+    if (!form || form->formType != FormType::Global)
+    {
+        return NULL;
+    }
+    return (const TESGlobal*)form;
+}
+
+// ============================================================================
+//                          HELPER FUNCTIONS
+// ============================================================================
+static const BGSKeyword* g_kwWarhammer;
+
 int getEquippedFormType(TESForm* form)
 {
     // From DAR documentation:
@@ -322,33 +387,35 @@ bool hasKeyword(TESForm* form, const BGSKeyword* keyword)
     return result;
 }
 
-bool hasKeywordBoundObj(TESBoundObject* obj, std::variant<uint32_t, float>* args)
+bool hasKeywordBoundObj(TESBoundObject* obj, const BGSKeyword* keyword)
 {
     TESForm* form = (TESForm*)&obj->tesObj.form;
-    if (form)
-    {
-        BGSKeyword* keyword =
-            (BGSKeyword*)RE::Game_GetForm(std::get<uint32_t>(args[0]));
-        if (keyword)
-        {
-            if (keyword->form.formType == FormType::Keyword
-                && hasKeyword(form, keyword))
-            {
-                return true;
-            }
-        }
-    }
-    return false;
+    return form
+        && hasKeyword(form, keyword);
 }
 
-float getActorValPct(Actor* actor, uint32_t value)
+float getActorValue(Actor* actor, uint32_t value)
 {
-    float fActorValue =
-        (*(_ActorValueOwner_GetActorValue)(actor->actorValueOwner.pVFT + 8))
+    return (*(_ActorValueOwner_GetActorValue)(actor->actorValueOwner.pVFT + 8))
         (&actor->actorValueOwner, value);
-    float fPermActorValue =
-        (*(_ActorValueOwner_GetPermanentActorValue)(actor->actorValueOwner.pVFT + 0x10))
+}
+
+float getPermanentActorValue(Actor* actor, uint32_t value)
+{
+    return (*(_ActorValueOwner_GetPermanentActorValue)(actor->actorValueOwner.pVFT + 0x10))
         (&actor->actorValueOwner, value);
+}
+
+float getBaseActorValue(Actor* actor, uint32_t value)
+{
+    return (*(_ActorValueOwner_GetBaseActorValue)(actor->actorValueOwner.pVFT + 0x18))
+        (&actor->actorValueOwner, value);
+}
+
+float getActorValPct(Actor* actor, uint32_t value)
+{
+    float fActorValue = getActorValue(actor, value);
+    float fPermActorValue = getPermanentActorValue(actor, value);
 
     if (fPermActorValue <= 0.0)
     {
@@ -402,17 +469,80 @@ BSExtraData* ExtraDataList_GetByTypeImpl(ExtraDataList* dataList, uint32_t extra
     return data;
 }
 
+TESForm* getEquippedForm(Actor* actor, uint32_t hand)
+{
+    // 0 = left, 1 = right
+    AIProcess* currentProcess = actor->currentProcess;
+    return currentProcess ? currentProcess->equippedObjects[hand] : NULL;
+}
+
+float getGameHour()
+{
+    float gameDaysPassed = 
+        RE::Calendar_GetCurrentGameTime(*RE::g_theCalendar);
+
+    // This gives the fractional part of the game time, i.e. proportion of the current
+    // day that has passed. We then multiply it by the number of game hours per day
+    // to get the current time of the day:
+    float f = 0.0;
+    float pctCurDayPassed = modff(gameDaysPassed, &f);
+    return (float)(pctCurDayPassed * *RE::g_gameHoursPerGameDay);
+}
+
+float getFactionRank(Actor* actor, TESFaction* faction)
+{
+    // The player's factions are changed by scripts all the time (joining a
+    // guild, ...), so always ask the game; everyone else's are looked up
+    // in their FactionRanks table.
+    bool isPlayer = (actor == *(Actor**)RE::g_thePlayer);
+    FactionRank rank;
+    if (!isPlayer && g_factionRanks.find(actor->ref.form.formID, faction->form.formID, rank))
+    {
+        return (float)rank.rank;
+    }
+    return (float)RE::Actor_GetFactionRank(actor, faction, isPlayer);
+}
+
+float getMovementDirection(Actor* actor)
+{
+    float actorMoveDir = 0.0;
+    if (RE::Actor_IsMoving(actor))
+    {
+        double move_angle = RE::Actor_GetMoveDirRelToFacing(actor);
+        // Ensure movement angle (in radians) is within the range [0, 2*PI]
+        for (; move_angle < 0.0; move_angle += TWO_PI);
+        for (; move_angle > TWO_PI; move_angle -= TWO_PI);
+
+        // Get nearest boundary of circular quadrant containing this angle.
+        // Ex. 1: If movement angle is 0.4 * PI (i.e. in 1st quadrant, closest
+        //        to 0.5*PI boundary), first calc evaluates to:
+        //         y = ((0.4*PI / 2*PI) + 1/8) * 4.0 / 4.0
+        //           = [(0.2 + 0.125) * 4.0] / 4.0
+        //           = fmodf(1.3, 4.0) = 1.3 - (1.3 / 4.0 = 0.325 => 0) * 4 = 1.3
+        //        Second calc then evaluates as 1.0 + 1.0 = 2 (Right)
+        // Ex. 2. For movement angle 1.1 * PI (i.e. in 3rd quadrant, closest
+        //        to PI boundary), calcs evaluate to:
+        //        [1]:  y = ((1.1*PI / 2*PI) + 1/8) * 4.0 / 4.0 
+        //                = fmodf(2.7, 4.0) = 2.7 - (2.7 / 4.0 = 0.675 => 0) * 4 = 2.7
+        //        [2]:  2.0 + 1.0 = 3 (Back).
+        // As expected.
+        float y = fmodf((float)((move_angle / TWO_PI) + 0.125) * 4.0, 4.0);
+        actorMoveDir = floorf(y) + 1.0;
+    }
+    return actorMoveDir;
+}
+
 // ============================================================================
 //                          CONDITION FUNCTIONS
 // ============================================================================
-bool IsEquippedRight(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsEquippedRight(Actor* actor, FormID item)
 {
     // -------------------------------------------------------------------
     // IsEquippedRight(Form item)
     // Does the actor have the specified item equipped to his right hand?
     // -------------------------------------------------------------------
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsEquippedRight(%08x)", args[0]);
+    _MESSAGE("IsEquippedRight(%08x)", item.formID);
 #endif
     AIProcess* currentProcess = actor->currentProcess;
     if (currentProcess)
@@ -421,7 +551,7 @@ bool IsEquippedRight(Actor* actor, std::variant<uint32_t, float>* args)
         TESForm* equippedFormRight = currentProcess->equippedObjects[1];
         if (equippedFormRight)
         {
-            if (equippedFormRight->formID == std::get<uint32_t>(args[0]))
+            if (equippedFormRight->formID == item.formID)
             {
                 return true;
             }
@@ -430,35 +560,24 @@ bool IsEquippedRight(Actor* actor, std::variant<uint32_t, float>* args)
     return false;
 }
 
-bool IsEquippedRightType(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsEquippedRightType(Actor* actor, GlobalOrFloat type)
 {
     // IsEquippedRightType(GlobalVariable type)
     // Is the item equipped to the actor's right hand the specified type?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsEquippedRightType(%08x)", args[0]);
+    _MESSAGE("IsEquippedRightType(%f)", (float)type);
 #endif
-    float fArg0;
-    if (!readGlobalVars(&fArg0, args, bmArgIsFloat, 1))
-    {
-        return false;
-    }
-    AIProcess* currentProcess = actor->currentProcess;
-    TESForm* objEquipped = NULL;
-    if (currentProcess)
-    {
-        // 0 = left, 1 = right
-        objEquipped = currentProcess->equippedObjects[1];
-    }
-    int typeOfObjEquipped = getEquippedFormType(objEquipped);
-    return (typeOfObjEquipped == fArg0);
+    // 0 = left, 1 = right
+    int typeOfObjEquipped = getEquippedFormType(getEquippedForm(actor, 1));
+    return (typeOfObjEquipped == type);
 }
 
-bool IsEquippedRightHasKeyword(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsEquippedRightHasKeyword(Actor* actor, FormRef<BGSKeyword> keyword)
 {
     // IsEquippedRightHasKeyword(Keyword keyword)
     // Does the item equipped to the actor's right hand have the specified keyword?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsEquippedRightHasKeyword(%08x)", args[0]);
+    _MESSAGE("IsEquippedRightHasKeyword(%08x)", keyword->form.formID);
 #endif
     AIProcess* currentProcess = actor->currentProcess;
     if (!currentProcess) 
@@ -471,19 +590,15 @@ bool IsEquippedRightHasKeyword(Actor* actor, std::variant<uint32_t, float>* args
     {
         return false;
     }
-    BGSKeyword* keyword = 
-        (BGSKeyword*)RE::Game_GetForm(std::get<uint32_t>(args[0]));
-    return keyword 
-        && keyword->form.formType == Keyword
-        && hasKeyword(equippedObj, keyword);
+    return hasKeyword(equippedObj, keyword);
 }
 
-bool IsEquippedLeft(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsEquippedLeft(Actor* actor, FormID item)
 {
     // IsEquippedLeft(Form item)
     // Does the actor have the specified item equipped to his left hand?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsEquippedLeft(%08x)", args[0]);
+    _MESSAGE("IsEquippedLeft(%08x)", item.formID);
 #endif
     AIProcess* currentProcess = actor->currentProcess;
     if (currentProcess)
@@ -492,7 +607,7 @@ bool IsEquippedLeft(Actor* actor, std::variant<uint32_t, float>* args)
         TESForm* equippedFormLeft = currentProcess->equippedObjects[0];
         if (equippedFormLeft)
         {
-            if (equippedFormLeft->formID == std::get<uint32_t>(args[0]))
+            if (equippedFormLeft->formID == item.formID)
             {
                 return true;
             }
@@ -501,35 +616,24 @@ bool IsEquippedLeft(Actor* actor, std::variant<uint32_t, float>* args)
     return false;
 }
 
-bool IsEquippedLeftType(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsEquippedLeftType(Actor* actor, GlobalOrFloat type)
 {
     // IsEquippedLeftType(GlobalVariable type)
     // Is the item equipped to the actor's left hand the specified type?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsEquippedLeftType(%08x)", args[0]);
+    _MESSAGE("IsEquippedLeftType(%f)", (float)type);
 #endif
-    float fArg0;
-    if (!readGlobalVars(&fArg0, args, bmArgIsFloat, 1))
-    {
-        return false;
-    }
-    AIProcess* currentProcess = actor->currentProcess;
-    TESForm* objEquipped = NULL;
-    if (currentProcess)
-    {
-        // 0 = left, 1 = right
-        objEquipped = currentProcess->equippedObjects[0];
-    }
-    int typeOfObjEquipped = getEquippedFormType(objEquipped);
-    return (typeOfObjEquipped == fArg0);
+    // 0 = left, 1 = right
+    int typeOfObjEquipped = getEquippedFormType(getEquippedForm(actor, 0));
+    return (typeOfObjEquipped == type);
 }
 
-bool IsEquippedLeftHasKeyword(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsEquippedLeftHasKeyword(Actor* actor, FormRef<BGSKeyword> keyword)
 {
     // IsEquippedLeftHasKeyword(Keyword keyword)
     // Does the item equipped to the actor's left hand have the specified keyword?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsEquippedLeftHasKeyword(%08x)", args[0]);
+    _MESSAGE("IsEquippedLeftHasKeyword(%08x)", keyword->form.formID);
 #endif
     AIProcess* currentProcess = actor->currentProcess;
     if (!currentProcess)
@@ -542,31 +646,27 @@ bool IsEquippedLeftHasKeyword(Actor* actor, std::variant<uint32_t, float>* args)
     {
         return false;
     }
-    BGSKeyword* keyword = 
-        (BGSKeyword*)RE::Game_GetForm(std::get<uint32_t>(args[0]));
-    return keyword
-        && keyword->form.formType == Keyword
-        && hasKeyword(equippedObj, keyword);
+    return hasKeyword(equippedObj, keyword);
 }
 
-bool IsEquippedShout(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsEquippedShout(Actor* actor, FormID shout)
 {
     // IsEquippedShout(Form shout)
     // Does the actor currently have the specified shout?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsEquippedShout(%08x)", args[0]);
+    _MESSAGE("IsEquippedShout(%08x)", shout.formID);
 #endif
     TESForm* selectedPower = actor->selectedPower;
     return selectedPower 
-        && selectedPower->formID == std::get<uint32_t>(args[0]);
+        && selectedPower->formID == shout.formID;
 }
 
-bool IsWorn(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsWorn(Actor* actor, FormID item)
 {
     // IsWorn(Form item)
     // Is the actor wearing the specified item?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsWorn(%08x)", args[0]);
+    _MESSAGE("IsWorn(%08x)", item.formID);
 #endif
 
     // Get the actor's inventory.
@@ -594,7 +694,7 @@ bool IsWorn(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsF
         }
 
         TESBoundObject* obj = entryData->object;
-        if (obj && obj->tesObj.form.formID == std::get<uint32_t>(args[0]))
+        if (obj && obj->tesObj.form.formID == item.formID)
         {
             // We've found the specified item. Is it being worn?
             // Compare to commonlibsse's implementation in InventoryEntryData.cpp:
@@ -620,12 +720,12 @@ bool IsWorn(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsF
     return false;
 }
 
-bool IsWornHasKeyword(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsWornHasKeyword(Actor* actor, FormRef<BGSKeyword> keyword)
 {
     // IsWornHasKeyword(Keyword keyword)
     // Is the actor wearing anything with the specified keyword?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsWornHasKeyword(%08x)", args[0]);
+    _MESSAGE("IsWornHasKeyword(%08x)", keyword->form.formID);
 #endif
 
     // Get the actor's inventory.
@@ -652,7 +752,7 @@ bool IsWornHasKeyword(Actor* actor, std::variant<uint32_t, float>* args)
             continue;
         }
 
-        if (hasKeywordBoundObj(entryData->object, args))
+        if (hasKeywordBoundObj(entryData->object, keyword))
         {
             // We've found the specified item. Is it being worn?
             // Compare to commonlibsse's implementation in InventoryEntryData.cpp:
@@ -724,270 +824,201 @@ bool IsInInterior(Actor* actor)
         && (parentCell->cellFlags & TESObjectCELLFlag::kIsInteriorCell) != 0;
 }
 
-bool IsInFaction(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsInFaction(Actor* actor, FormRef<TESFaction> faction)
 {
     // IsInFaction(Faction faction)
     // Is the actor in the specified faction?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsInFaction(%08x)", args[0]);
+    _MESSAGE("IsInFaction(%08x)", faction->form.formID);
 #endif
-    TESForm* form = RE::Game_GetForm(std::get<uint32_t>(args[0]));
-    return form
-        && form->formType == FormType::Faction
-        && (*(_Actor_IsInFaction)(actor->ref.form.pVft + 0x7C8))(actor, form);
+    // (See getFactionRank.)
+    FactionRank rank;
+    if (actor != *(Actor**)RE::g_thePlayer
+        && g_factionRanks.find(actor->ref.form.formID, faction->form.formID, rank))
+    {
+        return rank.bIsIn;
+    }
+    return (*(_Actor_IsInFaction)(actor->ref.form.pVft + 0x7C8))(actor, &faction->form);
 }
 
-bool HasKeyword(Actor* actor, std::variant<uint32_t, float>* args)
+bool HasKeyword(Actor* actor, FormRef<BGSKeyword> keyword)
 {
     // HasKeyword(Keyword keyword)
     // Does the actor have the specified keyword?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("HasKeyword(%08x)", args[0]);
+    _MESSAGE("HasKeyword(%08x)", keyword->form.formID);
 #endif
-    TESForm* form = RE::Game_GetForm(std::get<uint32_t>(args[0]));
-    return form
-        && form->formType == FormType::Keyword
-        && (*(_Actor_HasKeyword)(actor->ref.form.pVft + 0x240))(actor, form);
+    return (*(_Actor_HasKeyword)(actor->ref.form.pVft + 0x240))(actor, &keyword->form);
 }
 
-bool HasMagicEffect(Actor* actor, std::variant<uint32_t, float>* args)
+bool HasMagicEffect(Actor* actor, FormRef<EffectSetting> magicEffect)
 {
     // HasMagicEffect(MagicEffect magiceffect)
     // Is the actor currently being affected by the given Magic Effect?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("HasMagicEffect(%08x)", args[0]);
+    _MESSAGE("HasMagicEffect(%08x)", magicEffect->form.formID);
 #endif
-    TESForm* form = RE::Game_GetForm(std::get<uint32_t>(args[0]));
-    return form
-        && form->formType == FormType::MagicEffect
-        && RE::MagicTarget_HasMagicEffect(&actor->magicTarget, form);
+    return RE::MagicTarget_HasMagicEffect(&actor->magicTarget, &magicEffect->form);
 }
 
-bool HasMagicEffectWithKeyword(Actor* actor, std::variant<uint32_t, float>* args)
+bool HasMagicEffectWithKeyword(Actor* actor, FormRef<BGSKeyword> keyword)
 {
     // HasMagicEffectWithKeyword(Keyword keyword)
     // Is the actor currently being affected by a Magic Effect with the given Keyword?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("HasMagicEffectWithKeyword(% 08x)", args[0]);
+    _MESSAGE("HasMagicEffectWithKeyword(%08x)", keyword->form.formID);
 #endif
-    TESForm* form = RE::Game_GetForm(std::get<uint32_t>(args[0]));
-    return form 
-        && form->formType == FormType::Keyword
-        && RE::MagicTarget_HasMagicEffectWithKeyword
-           (&actor->magicTarget, form, 0);
+    return RE::MagicTarget_HasMagicEffectWithKeyword
+           (&actor->magicTarget, &keyword->form, 0);
 }
 
-bool HasPerk(Actor* actor, std::variant<uint32_t, float>* args)
+bool HasPerk(Actor* actor, FormRef<TESForm, FormType::Perk> perk)
 {
     // HasPerk(Perk perk)
     // Does the actor have the given Perk ?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("HasPerk(%08x)", args[0]);
+    _MESSAGE("HasPerk(%08x)", perk->formID);
 #endif
-    TESForm* form = RE::Game_GetForm(std::get<uint32_t>(args[0]));
-    return form
-        && form->formType == FormType::Perk
-        && RE::Actor_HasPerk(actor, form);
+    return RE::Actor_HasPerk(actor, perk);
 }
 
-bool HasSpell(Actor* actor, std::variant<uint32_t, float>* args)
+bool HasSpell(Actor* actor, FormRef<TESForm> spell)
 {
     // HasSpell(Form spell)
     // Does the actor have the given Spell or Shout?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("HasSpell(%08x)", args[0]);
+    _MESSAGE("HasSpell(%08x)", spell->formID);
 #endif
-    TESForm* form = RE::Game_GetForm(std::get<uint32_t>(args[0]));
-    if (!form) {
-        return false;
-    }
-    uint8_t formType = form->formType;
+    uint8_t formType = spell->formType;
     if (formType == FormType::Spell)
     {
-        return RE::Actor_HasSpell(actor, form);
+        return RE::Actor_HasSpell(actor, spell);
     }
     if (formType == FormType::Shout)
     {
-        return RE::Actor_HasShout(actor, form);
+        return RE::Actor_HasShout(actor, spell);
     }
     return false;
 }
 
-bool IsActorValueEqualTo(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsActorValueEqualTo(Actor* actor, GlobalOrFloat id, GlobalOrFloat value)
 {
     // IsActorValueEqualTo(GlobalVariable id, GlobalVariable value)
     // Is the ActorValue of the specified ID equal to the value?
     // Temporarily disabled because it's crashing.
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsActorValueEqualTo(%08x, %08x)", args[0], args[1]);
+    _MESSAGE("IsActorValueEqualTo(%f, %f)", (float)id, (float)value);
 #endif
-    float fArgs[2];
-    if (!readGlobalVars(fArgs, args, bmArgIsFloat, 2))
-    {
-        return false;
-    }
-    float fActorVal = 
-        (*(_ActorValueOwner_GetActorValue)(actor->actorValueOwner.pVFT + 8))
-        (&actor->actorValueOwner, (uint32_t)fArgs[0]);
-    return (fActorVal == fArgs[1]);
+    float fActorVal = getActorValue(actor, (uint32_t)id);
+    return (fActorVal == value);
 }
 
-bool IsActorValueLessThan(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsActorValueLessThan(Actor* actor, GlobalOrFloat id, GlobalOrFloat value)
 {
     // IsActorValueLessThan(GlobalVariable id, GlobalVariable value)
     // Is the ActorValue of the specified ID less than the value?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsActorValueLessThan(%08x, %08x)", args[0], args[1]);
+    _MESSAGE("IsActorValueLessThan(%f, %f)", (float)id, (float)value);
 #endif
-    float fArgs[2];
-    if (!readGlobalVars(fArgs, args, bmArgIsFloat, 2))
-    {
-        return false;
-    }
-    float fActorVal =
-        (*(_ActorValueOwner_GetActorValue)(actor->actorValueOwner.pVFT + 8))
-        (&actor->actorValueOwner, (uint32_t)fArgs[0]);
-    return (fActorVal < fArgs[1]);
+    float fActorVal = getActorValue(actor, (uint32_t)id);
+    return (fActorVal < value);
 }
 
-bool IsActorValueBaseEqualTo(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsActorValueBaseEqualTo(Actor* actor, GlobalOrFloat id, GlobalOrFloat value)
 {
     // IsActorValueBaseEqualTo(GlobalVariable id, GlobalVariable value)
     // Is the base ActorValue of the specified ID equal to the value?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsActorValueBaseEqualTo(%08x, %08x)", args[0], args[1]);
+    _MESSAGE("IsActorValueBaseEqualTo(%f, %f)", (float)id, (float)value);
 #endif
-    float fArgs[2];
-    if (!readGlobalVars(fArgs, args, bmArgIsFloat, 2))
-    {
-        return false;
-    }
-    float fActorValBase = 
-        (*(_ActorValueOwner_GetBaseActorValue)(actor->actorValueOwner.pVFT + 0x18))
-        (&actor->actorValueOwner, fArgs[0]);
-    return (fActorValBase == fArgs[1]);
+    float fActorValBase = getBaseActorValue(actor, (uint32_t)id);
+    return (fActorValBase == value);
 }
 
-bool IsActorValueBaseLessThan(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsActorValueBaseLessThan(Actor* actor, GlobalOrFloat id, GlobalOrFloat value)
 {
     // IsActorValueBaseLessThan(GlobalVariable id, GlobalVariable value)
     // Is the base ActorValue of the specified ID less than the value?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsActorValueBaseLessThan(%08x, %08x)", args[0], args[1]);
+    _MESSAGE("IsActorValueBaseLessThan(%f, %f)", (float)id, (float)value);
 #endif
-    float fArgs[2];
-    if (!readGlobalVars(fArgs, args, bmArgIsFloat, 2))
-    {
-        return false;
-    }
-    float fActorValBase =
-        (*(_ActorValueOwner_GetBaseActorValue)(actor->actorValueOwner.pVFT + 0x18))
-        (&actor->actorValueOwner, fArgs[0]);
-    return (fActorValBase < fArgs[1]);
+    float fActorValBase = getBaseActorValue(actor, (uint32_t)id);
+    return (fActorValBase < value);
 }
 
-bool IsActorValueMaxEqualTo(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsActorValueMaxEqualTo(Actor* actor, GlobalOrFloat id, GlobalOrFloat value)
 {
     // IsActorValueMaxEqualTo(GlobalVariable id, GlobalVariable value)
     // Is the max ActorValue of the specified ID equal to the value?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsActorValueMaxEqualTo(%08x, %08x)", args[0], args[1]);
+    _MESSAGE("IsActorValueMaxEqualTo(%f, %f)", (float)id, (float)value);
 #endif
-    float fArgs[2];
-    if (!readGlobalVars(fArgs, args, bmArgIsFloat, 2))
-    {
-        return false;
-    }
-    float fActorValMax =
-        (*(_ActorValueOwner_GetPermanentActorValue)(actor->actorValueOwner.pVFT + 0x10))
-        (&actor->actorValueOwner, fArgs[0]);
-    return (fActorValMax == fArgs[1]);
+    float fActorValMax = getPermanentActorValue(actor, (uint32_t)id);
+    return (fActorValMax == value);
 }
 
-bool IsActorValueMaxLessThan(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsActorValueMaxLessThan(Actor* actor, GlobalOrFloat id, GlobalOrFloat value)
 {
     // IsActorValueMaxLessThan(GlobalVariable id, GlobalVariable value)
     // Is the max ActorValue of the specified ID less than the value?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsActorValueMaxLessThan(%08x, %08x)", args[0], args[1]);
+    _MESSAGE("IsActorValueMaxLessThan(%f, %f)", (float)id, (float)value);
 #endif
-    float fArgs[2];
-    if (!readGlobalVars(fArgs, args, bmArgIsFloat, 2))
-    {
-        return false;
-    }
-    float fActorValMax =
-        (*(_ActorValueOwner_GetPermanentActorValue)(actor->actorValueOwner.pVFT + 0x10))
-        (&actor->actorValueOwner, fArgs[0]);
-    return (fActorValMax < fArgs[1]);
+    float fActorValMax = getPermanentActorValue(actor, (uint32_t)id);
+    return (fActorValMax < value);
 }
 
-bool IsActorValuePercentageEqualTo(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsActorValuePercentageEqualTo(Actor* actor, GlobalOrFloat id, GlobalOrFloat value)
 {
     // IsActorValuePercentageEqualTo(GlobalVariable id, GlobalVariable value)
     // Is the percentage ActorValue of the specified ID equal to the value?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsActorValuePercentageEqualTo(%08x, %08x)", args[0], args[1]);
+    _MESSAGE("IsActorValuePercentageEqualTo(%f, %f)", (float)id, (float)value);
 #endif
-    float fArgs[2];
-    if (!readGlobalVars(fArgs, args, bmArgIsFloat, 2))
-    {
-        return false;
-    }
-    float fActorValPct = getActorValPct(actor, (uint32_t)fArgs[0]);
-    return (fActorValPct == fArgs[1]);
+    float fActorValPct = getActorValPct(actor, (uint32_t)id);
+    return (fActorValPct == value);
 }
 
-bool IsActorValuePercentageLessThan(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsActorValuePercentageLessThan(Actor* actor, GlobalOrFloat id, GlobalOrFloat value)
 {
     // IsActorValuePercentageLessThan(GlobalVariable id, GlobalVariable value)
     // Is the percentage ActorValue of the specified ID less than the value?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsActorValuePercentageLessThan(%08x, %08x)", args[0], args[1]);
+    _MESSAGE("IsActorValuePercentageLessThan(%f, %f)", (float)id, (float)value);
 #endif
-    float fArgs[2];
-    if (!readGlobalVars(fArgs, args, bmArgIsFloat, 2))
-    {
-        return false;
-    }
-    float fActorValPct = getActorValPct(actor, (uint32_t)fArgs[0]);
-    return (fActorValPct < fArgs[1]);
+    float fActorValPct = getActorValPct(actor, (uint32_t)id);
+    return (fActorValPct < value);
 }
 
-bool IsLevelLessThan(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsLevelLessThan(Actor* actor, GlobalOrFloat level)
 {
     // IsLevelLessThan(GlobalVariable level)
     // Is the actor's current level less than the specified level?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsLevelLessThan(%08x)", args[0]);
+    _MESSAGE("IsLevelLessThan(%f)", (float)level);
 #endif
-    float fArg0;
-    if (!readGlobalVars(&fArg0, args, bmArgIsFloat, 1))
-    {
-        return false;
-    }
     uint16_t actorLevel = RE::Actor_GetLevel(actor);
-    return actorLevel < fArg0;
+    return actorLevel < level;
 }
 
-bool IsActorBase(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsActorBase(Actor* actor, FormID actorBase)
 {
     // IsActorBase(ActorBase actorbase)
     // Is the actorbase for the actor the specified actorbase?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsActorBase(%08x)", args[0]);
+    _MESSAGE("IsActorBase(%08x)", actorBase.formID);
 #endif
     TESForm* baseForm = actor->ref.baseForm;
     return baseForm 
-        && baseForm->formID == std::get<uint32_t>(args[0]);
+        && baseForm->formID == actorBase.formID;
 }
 
-bool IsRace(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsRace(Actor* actor, FormID raceID)
 {
     // IsRace(Race race)
     // Is the actor's race the specified race?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsRace(%08x)", args[0]);
+    _MESSAGE("IsRace(%08x)", raceID.formID);
 #endif
     TESNPC* npc = (TESNPC*)actor->ref.baseForm;
     if (!npc)
@@ -996,15 +1027,15 @@ bool IsRace(Actor* actor, std::variant<uint32_t, float>* args)
     }
     TESRace* race = npc->raceForm.race;
     return race 
-        && race->form.formID == std::get<uint32_t>(args[0]);
+        && race->form.formID == raceID.formID;
 }
 
-bool CurrentWeather(Actor* actor, std::variant<uint32_t, float>* args)
+bool CurrentWeather(Actor* actor, FormID weather)
 {
     // CurrentWeather(Weather weather)
     // Is the current weather the specified weather?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("CurrentWeather(%08x)", args[0]);
+    _MESSAGE("CurrentWeather(%08x)", weather.formID);
 #endif
     Sky* theSky = RE::Sky_GetSingleton();
     if (theSky)
@@ -1012,7 +1043,7 @@ bool CurrentWeather(Actor* actor, std::variant<uint32_t, float>* args)
         TESWeather* curWeather = theSky->currentWeather;
         if (curWeather)
         {
-            if (curWeather->form.formID == std::get<uint32_t>(args[0]))
+            if (curWeather->form.formID == weather.formID)
             {
                 return true;
             }
@@ -1021,80 +1052,51 @@ bool CurrentWeather(Actor* actor, std::variant<uint32_t, float>* args)
     return false;
 }
 
-bool CurrentGameTimeLessThan(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool CurrentGameTimeLessThan(Actor* actor, GlobalOrFloat time)
 {
     // CurrentGameTimeLessThan(GlobalVariable time)
     // Is the current game time less than the specified time?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("CurrentGameTimeLessThan(% 08x)", args[0]);
+    _MESSAGE("CurrentGameTimeLessThan(%f)", (float)time);
 #endif
-    float fArg0;
-    if (!readGlobalVars(&fArg0, args, bmArgIsFloat, 1))
-    {
-        return false;
-    }
-
-    float gameDaysPassed = 
-        RE::Calendar_GetCurrentGameTime(*RE::g_theCalendar);
-
-    // This gives the fractional part of the game time, i.e. proportion of the current
-    // day that has passed. We then multiply it by the number of game hours per day
-    // to get the current time of the day:
-    float f = 0.0;
-    float pctCurDayPassed = modff(gameDaysPassed, &f);
-    return fArg0 > (float)(pctCurDayPassed * *RE::g_gameHoursPerGameDay);
+    return time > getGameHour();
 }
 
-bool ValueEqualTo(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool ValueEqualTo(Actor* actor, GlobalOrFloat value1, GlobalOrFloat value2)
 {
     // ValueEqualTo(GlobalVariable value1, GlobalVariable value2)
     // Is the value1 equal to the value2?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("ValueEqualTo(%08x, %08x)", args[0], args[1]);
+    _MESSAGE("ValueEqualTo(%f, %f)", (float)value1, (float)value2);
 #endif
-    float fArgs[2];
-    if (!readGlobalVars(fArgs, args, bmArgIsFloat, 2))
-    {
-        return false;
-    }
-    return (fArgs[0] == fArgs[1]);
+    return (value1 == value2);
 }
 
-bool ValueLessThan(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool ValueLessThan(Actor* actor, GlobalOrFloat value1, GlobalOrFloat value2)
 {
     // ValueLessThan(GlobalVariable value1, GlobalVariable value2)
     // Is the value1 less than the value2?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("ValueLessThan(%08x, %08x)", args[0], args[1]);
+    _MESSAGE("ValueLessThan(%f, %f)", (float)value1, (float)value2);
 #endif
-    float fArgs[2];
-    if (!readGlobalVars(fArgs, args, bmArgIsFloat, 2))
-    {
-        return false;
-    }
-    return (fArgs[0] < fArgs[1]);
+    return (value1 < value2);
 }
 
-bool Random(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool Random(Actor* actor, GlobalOrFloat percentage)
 {
     // Random(GlobalVariable percentage)
     // The probability of the specified percentage (from 0 to 1).
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("Random(%08x)", args[0]);
+    _MESSAGE("Random(%f)", (float)percentage);
 #endif
-    float fArg0;
-    if (!readGlobalVars(&fArg0, args, bmArgIsFloat, 1))
-    {
-        return false;
-    }
 
     // Some sanity checks before we proceed...
-    if (fArg0 < 0.0 || fArg0 > 1.0)
+    if (percentage < 0.0 || percentage > 1.0)
     {
         // Invalid values. Just return false.
         return false;
     } 
-    else if (fArg0 == 1.0)
+    else if (percentage == 1.0)
     {
         // Just in case, given our random number generator
         // below will never return 1. Although calling this 
@@ -1110,7 +1112,7 @@ bool Random(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsF
     std::mt19937 gen(r());
     float prob = std::generate_canonical<float, 10>(gen);
       
-    return (fArg0 > prob);
+    return (percentage > prob);
 }
 
 bool IsUnique(Actor* actor)
@@ -1126,12 +1128,12 @@ bool IsUnique(Actor* actor)
          ACTOR_BASE_DATA::Flag::kUnique) != 0;
 }
 
-bool IsClass(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsClass(Actor* actor, FormID npcClassID)
 {
     // IsClass(Class class)
     // Is the actor's class the specified class?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsClass(%08x)", args[0]);
+    _MESSAGE("IsClass(%08x)", npcClassID.formID);
 #endif
     TESNPC* form = (TESNPC*)actor->ref.baseForm;
     if (form)
@@ -1139,7 +1141,7 @@ bool IsClass(Actor* actor, std::variant<uint32_t, float>* args)
         TESClass* npcClass = form->npcClass;
         if (npcClass)
         {
-            if (npcClass->form.formID == std::get<uint32_t>(args[0]))
+            if (npcClass->form.formID == npcClassID.formID)
             {
                 return true;
             }
@@ -1148,12 +1150,12 @@ bool IsClass(Actor* actor, std::variant<uint32_t, float>* args)
     return false;
 }
 
-bool IsCombatStyle(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsCombatStyle(Actor* actor, FormID combatStyleID)
 {
     // IsCombatStyle(CombatStyle combatStyle)
     // Is the actor's CombatStyle the specified CombatStyle?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsCombatStyle(%08x)", args[0]);
+    _MESSAGE("IsCombatStyle(%08x)", combatStyleID.formID);
 #endif
     TESNPC* npc = (TESNPC*)actor->ref.baseForm;
     if (npc)
@@ -1161,7 +1163,7 @@ bool IsCombatStyle(Actor* actor, std::variant<uint32_t, float>* args)
         TESCombatStyle* combatStyle = npc->combatStyle;
         if (combatStyle)
         {
-            if (combatStyle->form.formID == std::get<uint32_t>(args[0]))
+            if (combatStyle->form.formID == combatStyleID.formID)
             {
                 return true;
             }
@@ -1170,12 +1172,12 @@ bool IsCombatStyle(Actor* actor, std::variant<uint32_t, float>* args)
     return false;
 }
 
-bool IsVoiceType(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsVoiceType(Actor* actor, FormID voiceTypeID)
 {
     // IsVoiceType(VoiceType voiceType)
     // Is the actor's VoiceType the specified VoiceType?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsVoiceType(%08x)", args[0]);
+    _MESSAGE("IsVoiceType(%08x)", voiceTypeID.formID);
 #endif
     TESNPC* npc = (TESNPC*)actor->ref.baseForm;
     if (npc)
@@ -1183,7 +1185,7 @@ bool IsVoiceType(Actor* actor, std::variant<uint32_t, float>* args)
         BGSVoiceType* voiceType = npc->actorBase.actorData.voiceType;
         if (voiceType)
         {
-            if (voiceType->form.formID == std::get<uint32_t>(args[0]))
+            if (voiceType->form.formID == voiceTypeID.formID)
             {
                 return true;
             }
@@ -1263,86 +1265,57 @@ bool IsWeaponDrawn(Actor* actor)
     return actor->actorState.actorState2.weaponState >= WEAPON_STATE::kDrawn;
 }
 
-bool IsInLocation(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsInLocation(Actor* actor, FormRef<BGSLocation> location)
 {
     // IsInLocation(Location location)
     // Is the actor in the specified location or a child of that location?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsInLocation(%08x)", args[0]);
+    _MESSAGE("IsInLocation(%08x)", location->form.formID);
 #endif
-    BGSLocation* curLoc;
-    TESForm* frm;
-    TESForm* frmBGSLocation = RE::Game_GetForm(std::get<uint32_t>(args[0]));
-    if (frmBGSLocation
-        && frmBGSLocation->formType == FormType::Location
-        && (curLoc = (BGSLocation*)RE::ObjectReference_GetCurrentLocation((TESObjectREFR*)actor), 
-            (frm = &curLoc->form) != NULL))
-    {
-        while (true)
-        {
-            curLoc = curLoc->parentLoc;
-            if (curLoc == (BGSLocation*)frmBGSLocation)
-            {
-                break;
-            }
-            if (!curLoc)
-            {
-                if (frm != frmBGSLocation)
-                {
-                    return false;
-                }
-                break;
-            }
-        }
-        return true;
-    }
-    return false;
+    // (The chains of parent locations are cached: see LocationAncestry.)
+    BGSLocation* curLoc = RE::ObjectReference_GetCurrentLocation((TESObjectREFR*)actor);
+    return curLoc && g_locationAncestry.isIn(curLoc->form.formID, location->form.formID);
 }
 
-bool HasRefType(Actor* actor, std::variant<uint32_t, float>* args)
+bool HasRefType(Actor* actor, FormRef<BGSLocationRefType> refType)
 {
     // HasRefType(LocationRefType refType)
     // Does the actor have the specified LocationRefType attached?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("HasRefType(%08x)", args[0]);
+    _MESSAGE("HasRefType(%08x)", refType->keyword.form.formID);
 #endif
-    TESForm* frmBGSLocationRefType = RE::Game_GetForm(std::get<uint32_t>(args[0]));
-    if (!frmBGSLocationRefType || frmBGSLocationRefType->formType != LocationRefType)
-    {
-        return false;
-    }
     ExtraLocationRefType* locRef = 
         (ExtraLocationRefType*)ExtraDataList_GetByTypeImpl(&actor->ref.extraData, ExtraDataType::kLocationRefType);
     return locRef 
-        && locRef->locRefType == (BGSLocationRefType*)frmBGSLocationRefType;
+        && locRef->locRefType == refType;
 }
 
-bool IsParentCell(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsParentCell(Actor* actor, FormID cell)
 {
     // IsParentCell(Cell cell)
     // Is the actor in the specified cell?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsParentCell(%08x)", args[0]);
+    _MESSAGE("IsParentCell(%08x)", cell.formID);
 #endif
     TESObjectCELL* parentCell = actor->ref.parentCell;
     return parentCell 
-        && parentCell->form.formID == std::get<uint32_t>(args[0]);
+        && parentCell->form.formID == cell.formID;
 }
 
-bool IsWorldSpace(Actor* actor, std::variant<uint32_t, float>* args)
+bool IsWorldSpace(Actor* actor, FormID worldSpace)
 {
     // IsWorldSpace(WorldSpace worldSpace)
     // Is the actor in the specified WorldSpace?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsWorldSpace(%08x)", args[0]);
+    _MESSAGE("IsWorldSpace(%08x)", worldSpace.formID);
 #endif
     TESWorldSpace* worldspace = 
         RE::TESObjectREFR_GetWorldSpace(&actor->ref);
     return worldspace 
-        && worldspace->form.formID == std::get<uint32_t>(args[0]);
+        && worldspace->form.formID == worldSpace.formID;
 }
 
-bool IsFactionRankEqualTo(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsFactionRankEqualTo(Actor* actor, GlobalOrFloat rank, FormRef<TESFaction> faction)
 {
     // IsFactionRankEqualTo(GlobalVariable rank, Faction faction)
     // Is the actor's rank in the specified faction equal to the specified rank?
@@ -1355,54 +1328,23 @@ bool IsFactionRankEqualTo(Actor* actor, std::variant<uint32_t, float>* args, uin
     //             of this faction.)
     //      => A non-negative number equal to the actor's rank in the faction."
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsFactionRankEqualTo(%08x, %08x)", args[0], args[1]);
+    _MESSAGE("IsFactionRankEqualTo(%f, %08x)", (float)rank, faction->form.formID);
 #endif
-    float fArg0;
-    if (!readGlobalVars(&fArg0, args, bmArgIsFloat, 1))
-    {
-        return false;
-    }
-
-    TESForm* frmTESFaction = RE::Game_GetForm(std::get<uint32_t>(args[1]));
-    if (!frmTESFaction || frmTESFaction->formType != FormType::Faction)
-    {
-        return false;
-    }
   
-    bool isPlayer = (actor == *(Actor**)RE::g_thePlayer);
-    float actorRank = 
-        (float)RE::Actor_GetFactionRank
-        (actor, (TESFaction*)frmTESFaction, isPlayer);
-    return (actorRank == fArg0);
+    return (getFactionRank(actor, faction) == rank);
 }
 
-bool IsFactionRankLessThan(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsFactionRankLessThan(Actor* actor, GlobalOrFloat rank, FormRef<TESFaction> faction)
 {
     // IsFactionRankLessThan(GlobalVariable rank, Faction faction)
     // Is the actor's rank in the specified faction less than the specified rank?
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsFactionRankLessThan(%08x, %08x)", args[0], args[1]);
+    _MESSAGE("IsFactionRankLessThan(%f, %08x)", (float)rank, faction->form.formID);
 #endif
-    float fArg0;
-    if (!readGlobalVars(&fArg0, args, bmArgIsFloat, 1))
-    {
-        return false;
-    }
-
-    TESForm* frmTESFaction = RE::Game_GetForm(std::get<uint32_t>(args[1]));
-    if (!frmTESFaction || frmTESFaction->formType != FormType::Faction)
-    {
-        return false;
-    }
-
-    bool isPlayer = (actor == *(Actor**)RE::g_thePlayer);
-    float actorRank =
-        (float)RE::Actor_GetFactionRank
-        (actor, (TESFaction*)frmTESFaction, isPlayer);
-    return (actorRank < fArg0);
+    return (getFactionRank(actor, faction) < rank);
 }
 
-bool IsMovementDirection(Actor* actor, std::variant<uint32_t, float>* args, uint32_t bmArgIsFloat)
+bool IsMovementDirection(Actor* actor, GlobalOrFloat direction)
 {
     // IsMovementDirection(GlobalVariable direction)
     // Is the actor moving in the specified direction?
@@ -1415,101 +1357,280 @@ bool IsMovementDirection(Actor* actor, std::variant<uint32_t, float>* args, uint
     //      => 3 = Back
     //      => 4 = Left"
 #ifdef DEBUG_TRACE_CONDITIONS
-    _MESSAGE("IsMovementDirection(%08x)", args[0]);
+    _MESSAGE("IsMovementDirection(%f)", (float)direction);
 #endif
-    float fArg0;
-    if (!readGlobalVars(&fArg0, args, bmArgIsFloat, 1))
+    return (getMovementDirection(actor) == direction);
+}
+
+// ============================================================================
+//                        REGISTRATION AND DISPATCH
+// ============================================================================
+template <typename Func> struct ConditionTraits;
+
+template <typename... Params>
+struct ConditionTraits<bool (*)(Actor*, Params...)>
+{
+    static constexpr uint32_t nArgs = sizeof...(Params);
+
+    static constexpr uint32_t argFloatMask()
+    {
+        constexpr bool bIsFloat[] = { false, ArgIsFloat<Params>::value... };
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < nArgs; i++)
+        {
+            if (bIsFloat[i + 1])
+            {
+                mask |= 1 << i;
+            }
+        }
+        return mask;
+    }
+    static constexpr uint32_t bmArgIsFloat = argFloatMask();
+
+    template <bool (*Func)(Actor*, Params...), size_t... I>
+    static inline bool invoke(Actor* actor, const ConditionArg* args, std::index_sequence<I...>)
+    {
+        static_assert(sizeof...(Params) <= kMaxConditionArgs,
+                      "ConditionLinkFunc can't hold this many args");
+        std::tuple<Params...> typedArgs;
+        if (!(readArg(args[I], std::get<I>(typedArgs)) && ...))
+        {
+            return false;
+        }
+        return Func(actor, std::get<I>(typedArgs)...);
+    }
+};
+
+#define CONDITION_TRAITS(func) ConditionTraits<decltype(&func)>
+
+bool evaluateCondition(uint16_t funcId, Actor* actor, const ConditionArg* args)
+{
+    // Each case calls its function directly, so the compiler is free to
+    // inline it (most are only a few loads and a compare).
+    switch (funcId)
+    {
+#define X(name, func, n, mask)                                             \
+    case kCondition_##func:                                               \
+        return CONDITION_TRAITS(func)::invoke<&func>                      \
+            (actor, args, std::make_index_sequence<CONDITION_TRAITS(func)::nArgs>());
+    DAR_CONDITION_FUNCS(X)
+#undef X
+    }
+    return false;
+}
+
+// The arg counts and float masks listed in DAR_CONDITION_FUNCS (which the
+// parser and the compiler go by) must match the functions.
+#define X(name, func, n, mask)                                            \
+    static_assert(CONDITION_TRAITS(func)::nArgs == n &&                   \
+                  CONDITION_TRAITS(func)::bmArgIsFloat == mask,           \
+                  "DAR_CONDITION_FUNCS entry doesn't match " name);
+DAR_CONDITION_FUNCS(X)
+#undef X
+
+// ============================================================================
+//                         FEATURE EXTRACTION
+// ============================================================================
+static float readWorldNum(const FeatureKey& key)
+{
+    switch (key.kind)
+    {
+    case FeatureKind::kGameHour:
+        return getGameHour();
+    case FeatureKind::kGlobalValue:
+    {
+        // (Only if the global didn't exist when it was registered.)
+        const TESGlobal* global = lookupGlobal(key.param);
+        return global ? global->value : std::numeric_limits<float>::quiet_NaN();
+    }
+    default:
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+}
+
+static const float* findWorldNumSource(const FeatureKey& key)
+{
+    // Globals are read straight from the TESGlobal, looked up just once.
+    if (key.kind == FeatureKind::kGlobalValue)
+    {
+        const TESGlobal* global = lookupGlobal(key.param);
+        return global ? &global->value : NULL;
+    }
+    return NULL;
+}
+
+static uint32_t readWorldFormID(const FeatureKey& key)
+{
+    if (key.kind == FeatureKind::kWeather)
+    {
+        Sky* theSky = RE::Sky_GetSingleton();
+        return theSky && theSky->currentWeather ? theSky->currentWeather->form.formID : 0;
+    }
+    return 0;
+}
+
+WorldState g_worldState(readWorldNum, readWorldFormID, findWorldNumSource);
+
+static uint32_t readParentLocation(uint32_t locationID)
+{
+    TESForm* form = RE::Game_GetForm(locationID);
+    if (!form || form->formType != FormType::Location)
+    {
+        return 0;
+    }
+    BGSLocation* parent = ((BGSLocation*)form)->parentLoc;
+    return parent ? parent->form.formID : 0;
+}
+
+LocationAncestry g_locationAncestry(readParentLocation);
+
+static bool readFactionRanks(uint32_t actorID, const uint32_t* factionIDs, size_t nFactions,
+                             FactionRank* ranks_out)
+{
+    TESForm* form = RE::Game_GetForm(actorID);
+    if (!form || form->formType != FormType::ActorCharacter)
     {
         return false;
     }
+    Actor* actor = (Actor*)form;
+    bool isPlayer = (actor == *(Actor**)RE::g_thePlayer);
+    for (size_t i = 0; i < nFactions; i++)
+    {
+        TESForm* faction = RE::Game_GetForm(factionIDs[i]);
+        if (!faction || faction->formType != FormType::Faction)
+        {
+            ranks_out[i] = FactionRank();
+            continue;
+        }
+        ranks_out[i].rank = RE::Actor_GetFactionRank(actor, (TESFaction*)faction, isPlayer);
+        ranks_out[i].bIsIn = (*(_Actor_IsInFaction)(actor->ref.form.pVft + 0x7C8))(actor, faction);
+    }
+    return true;
+}
 
-    float actorMoveDir = 0.0;
-    if (RE::Actor_IsMoving(actor))
+FactionRanks g_factionRanks(readFactionRanks, 8192);
+
+static float readNumFeature(const FeatureKey& key, const FeatureLayout& layout, Actor* actor)
+{
+    switch (key.kind)
     {
-        double move_angle = RE::Actor_GetMoveDirRelToFacing(actor);
-        // Ensure movement angle (in radians) is within the range [0, 2*PI]
-        for (; move_angle < 0.0; move_angle += TWO_PI);
-        for (; move_angle > TWO_PI; move_angle -= TWO_PI);
+    case FeatureKind::kPredicate:
+    {
+        ConditionArg args[kMaxConditionArgs];
+        args[0].formID = key.param;
+        return evaluateCondition(key.funcId, actor, args) ? 1.0f : 0.0f;
+    }
+    case FeatureKind::kCall:
+    {
+        const ConditionCall& call = layout.calls[key.param];
+        return evaluateCondition(call.funcId, actor, call.args) ? 1.0f : 0.0f;
+    }
+    case FeatureKind::kEquippedType:
+        return (float)getEquippedFormType(getEquippedForm(actor, key.param));
+    case FeatureKind::kLevel:
+        return RE::Actor_GetLevel(actor);
+    case FeatureKind::kMovementDirection:
+        return getMovementDirection(actor);
+    case FeatureKind::kActorValue:
+        return getActorValue(actor, key.param);
+    case FeatureKind::kActorValueBase:
+        return getBaseActorValue(actor, key.param);
+    case FeatureKind::kActorValueMax:
+        return getPermanentActorValue(actor, key.param);
+    case FeatureKind::kActorValuePercentage:
+        return getActorValPct(actor, key.param);
+    case FeatureKind::kFactionRank:
+    {
+        ConditionArg arg;
+        arg.formID = key.param;
+        FormRef<TESFaction> faction;
+        return readArg(arg, faction) ? getFactionRank(actor, faction)
+                                     : std::numeric_limits<float>::quiet_NaN();
+    }
+    default:
+        break;
+    }
+    return std::numeric_limits<float>::quiet_NaN();
+}
 
-        // Get nearest boundary of circular quadrant containing this angle.
-        // Ex. 1: If movement angle is 0.4 * PI (i.e. in 1st quadrant, closest
-        //        to 0.5*PI boundary), first calc evaluates to:
-        //         y = ((0.4*PI / 2*PI) + 1/8) * 4.0 / 4.0
-        //           = [(0.2 + 0.125) * 4.0] / 4.0
-        //           = fmodf(1.3, 4.0) = 1.3 - (1.3 / 4.0 = 0.325 => 0) * 4 = 1.3
-        //        Second calc then evaluates as 1.0 + 1.0 = 2 (Right)
-        // Ex. 2. For movement angle 1.1 * PI (i.e. in 3rd quadrant, closest
-        //        to PI boundary), calcs evaluate to:
-        //        [1]:  y = ((1.1*PI / 2*PI) + 1/8) * 4.0 / 4.0 
-        //                = fmodf(2.7, 4.0) = 2.7 - (2.7 / 4.0 = 0.675 => 0) * 4 = 2.7
-        //        [2]:  2.0 + 1.0 = 3 (Back).
-        // As expected.
-        float y = fmodf((float)((move_angle / TWO_PI) + 0.125) * 4.0, 4.0);
-        actorMoveDir = floorf(y) + 1.0;
+static uint32_t formIDOf(const TESForm* form)
+{
+    return form ? form->formID : 0;
+}
+
+static uint32_t readFormIDFeature(const FeatureKey& key, Actor* actor)
+{
+    TESNPC* npc = (TESNPC*)actor->ref.baseForm;
+    switch (key.kind)
+    {
+    case FeatureKind::kEquipped:
+        return formIDOf(getEquippedForm(actor, key.param));
+    case FeatureKind::kSelectedPower:
+        return formIDOf(actor->selectedPower);
+    case FeatureKind::kActorBase:
+        return formIDOf(actor->ref.baseForm);
+    case FeatureKind::kRace:
+        return npc && npc->raceForm.race ? npc->raceForm.race->form.formID : 0;
+    case FeatureKind::kClass:
+        return npc && npc->npcClass ? npc->npcClass->form.formID : 0;
+    case FeatureKind::kCombatStyle:
+        return npc && npc->combatStyle ? npc->combatStyle->form.formID : 0;
+    case FeatureKind::kVoiceType:
+        return npc && npc->actorBase.actorData.voiceType
+            ? npc->actorBase.actorData.voiceType->form.formID : 0;
+    case FeatureKind::kParentCell:
+        return actor->ref.parentCell ? actor->ref.parentCell->form.formID : 0;
+    case FeatureKind::kWorldSpace:
+    {
+        TESWorldSpace* worldspace = RE::TESObjectREFR_GetWorldSpace(&actor->ref);
+        return worldspace ? worldspace->form.formID : 0;
+    }
+    case FeatureKind::kLocationRefType:
+    {
+        ExtraLocationRefType* locRef =
+            (ExtraLocationRefType*)ExtraDataList_GetByTypeImpl(&actor->ref.extraData, ExtraDataType::kLocationRefType);
+        return locRef && locRef->locRefType ? locRef->locRefType->keyword.form.formID : 0;
+    }
+    case FeatureKind::kCurrentLocation:
+        return formIDOf((TESForm*)RE::ObjectReference_GetCurrentLocation(&actor->ref));
+    default:
+        return 0;
+    }
+}
+
+// ============================================================================
+//                              GAME STATE
+// ============================================================================
+// What the loaders, the registry and the condition evaluator read the game
+// through (see GameState.h).
+class SkyrimGameState : public GameState
+{
+public:
+    uint32_t actorID(Actor* actor) override
+    {
+        return actor->ref.form.formID;
+    }
+
+    bool isPlayer(Actor* actor) override
+    {
+        return actor == *(Actor**)RE::g_thePlayer;
+    }
+
+    float readNum(const FeatureKey& key, const FeatureLayout& layout, Actor* actor) override
+    {
+        return readNumFeature(key, layout, actor);
+    }
+
+    uint32_t readFormID(const FeatureKey& key, Actor* actor) override
+    {
+        return readFormIDFeature(key, actor);
+    }
+
+    const TESGlobal* lookupGlobal(uint32_t formID) override
+    {
+        return ::lookupGlobal(formID);
     }
-    return (actorMoveDir == fArg0);
-}
-
-// The DAR defined actor state functions
-// These all test an actor for a specific state and return TRUE or FALSE.
-std::vector<std::pair<std::string, FuncInfo>> v
-{
-    // ==============================================================================================
-    // Function Name                           {  address of function,      nArgs, argTypeMask  }
-    // ----------------------------------------------------------------------------------------------
-    { "IsEquippedRight",                FuncInfo{ &IsEquippedRight,                1, 0 } },  // 0
-    { "IsEquippedRightType",            FuncInfo{ &IsEquippedRightType,            1, 1 } },  // 1
-    { "IsEquippedRightHasKeyword",      FuncInfo{ &IsEquippedRightHasKeyword,      1, 0 } },  // 2
-    { "IsEquippedLeft",                 FuncInfo{ &IsEquippedLeft,                 1, 0 } },  // 3
-    { "IsEquippedLeftType",             FuncInfo{ &IsEquippedLeftType,             1, 1 } },  // 4
-    { "IsEquippedLeftHasKeyword",       FuncInfo{ &IsEquippedLeftHasKeyword,       1, 0 } },  // 5
-    { "IsEquippedShout",                FuncInfo{ &IsEquippedShout,                1, 0 } },  // 6
-    { "IsWorn",                         FuncInfo{ &IsWorn,                         1, 0 } },  // 7
-    { "IsWornHasKeyword",               FuncInfo{ &IsWornHasKeyword,               1, 0 } },  // 8
-    { "IsFemale",                       FuncInfo{ &IsFemale,                       0, 0 } },  // 9
-    { "IsChild",                        FuncInfo{ &Is_Child,                       0, 0 } },  // 10
-    { "IsPlayerTeammate",               FuncInfo{ &IsPlayerTeammate,               0, 0 } },  // 11
-    { "IsInInterior",                   FuncInfo{ &IsInInterior,                   0, 0 } },  // 12
-    { "IsInFaction",                    FuncInfo{ &IsInFaction,                    1, 0 } },  // 13
-    { "HasKeyword",                     FuncInfo{ &HasKeyword,                     1, 0 } },  // 14
-    { "HasMagicEffect",                 FuncInfo{ &HasMagicEffect,                 1, 0 } },  // 15
-    { "HasMagicEffectWithKeyword",      FuncInfo{ &HasMagicEffectWithKeyword,      1, 0 } },  // 16
-    { "HasPerk",                        FuncInfo{ &HasPerk,                        1, 0 } },  // 17
-    { "HasSpell",                       FuncInfo{ &HasSpell,                       1, 0 } },  // 18
-    { "IsActorValueEqualTo",            FuncInfo{ &IsActorValueEqualTo,            2, 3 } },  // 19
-    { "IsActorValueLessThan",           FuncInfo{ &IsActorValueLessThan,           2, 3 } },  // 20
-    { "IsActorValueBaseEqualTo",        FuncInfo{ &IsActorValueBaseEqualTo,        2, 3 } },  // 21
-    { "IsActorValueBaseLessThan",       FuncInfo{ &IsActorValueBaseLessThan,       2, 3 } },  // 22
-    { "IsActorValueMaxEqualTo",         FuncInfo{ &IsActorValueMaxEqualTo,         2, 3 } },  // 23
-    { "IsActorValueMaxLessThan",        FuncInfo{ &IsActorValueMaxLessThan,        2, 3 } },  // 24
-    { "IsActorValuePercentageEqualTo",  FuncInfo{ &IsActorValuePercentageEqualTo,  2, 3 } },  // 25
-    { "IsActorValuePercentageLessThan", FuncInfo{ &IsActorValuePercentageLessThan, 2, 3 } },  // 26
-    { "IsLevelLessThan",                FuncInfo{ &IsLevelLessThan,                1, 1 } },  // 27
-    { "IsActorBase",                    FuncInfo{ &IsActorBase,                    1, 0 } },  // 28
-    { "IsRace",                         FuncInfo{ &IsRace,                         1, 0 } },  // 29
-    { "CurrentWeather",                 FuncInfo{ &CurrentWeather,                 1, 0 } },  // 30
-    { "CurrentGameTimeLessThan",        FuncInfo{ &CurrentGameTimeLessThan,        1, 1 } },  // 31
-    { "ValueEqualTo",                   FuncInfo{ &ValueEqualTo,                   2, 3 } },  // 32
-    { "ValueLessThan",                  FuncInfo{ &ValueLessThan,                  2, 3 } },  // 33
-    { "Random",                         FuncInfo{ &Random,                         1, 1 } },  // 34
-    { "IsUnique",                       FuncInfo{ &IsUnique,                       0, 0 } },  // 35
-    { "IsClass",                        FuncInfo{ &IsClass,                        1, 0 } },  // 36
-    { "IsCombatStyle",                  FuncInfo{ &IsCombatStyle,                  1, 0 } },  // 37
-    { "IsVoiceType",                    FuncInfo{ &IsVoiceType,                    1, 0 } },  // 38
-    { "IsAttacking",                    FuncInfo{ &IsAttacking,                    0, 0 } },  // 39
-    { "IsRunning",                      FuncInfo{ &IsRunning,                      0, 0 } },  // 40
-    { "IsSneaking",                     FuncInfo{ &IsSneaking,                     0, 0 } },  // 41
-    { "IsSprinting",                    FuncInfo{ &IsSprinting,                    0, 0 } },  // 42
-    { "IsInAir",                        FuncInfo{ &IsInAir,                        0, 0 } },  // 43
-    { "IsInCombat",                     FuncInfo{ &IsInCombat,                     0, 0 } },  // 44
-    { "IsWeaponDrawn",                  FuncInfo{ &IsWeaponDrawn,                  0, 0 } },  // 45
-    { "IsInLocation",                   FuncInfo{ &IsInLocation,                   1, 0 } },  // 46
-    { "HasRefType",                     FuncInfo{ &HasRefType,                     1, 0 } },  // 47
-    { "IsParentCell",                   FuncInfo{ &IsParentCell,                   1, 0 } },  // 48
-    { "IsWorldSpace",                   FuncInfo{ &IsWorldSpace,                   1, 0 } },  // 49
-    { "IsFactionRankEqualTo",           FuncInfo{ &IsFactionRankEqualTo,           2, 1 } },  // 50
-    { "IsFactionRankLessThan",          FuncInfo{ &IsFactionRankLessThan,          2, 1 } },  // 51
-    { "IsMovementDirection",            FuncInfo{ &IsMovementDirection,            1, 1 } },  // 52
-    // ==============================================================================================
 };
-std::unordered_map<std::string, FuncInfo> g_DARConditionFuncs(v.begin(), v.end());
\ No newline at end of file
+
+static SkyrimGameState s_skyrimGameState;
+GameState* g_gameState = &s_skyrimGameState;
\ No newline at end of file
@@ -0,0 +1,582 @@
+// ============================================================================
+//                           ConditionsParser.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "ConditionsParser.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+
+// ============================================================================
+//                            ConditionsParser.cpp
+// ----------------------------------------------------------------------------
+// The syntax pass of the _conditions.txt parser. The whole file is read into
+// one buffer and then tokenised in place with string_views; numbers are
+// converted with std::from_chars. Nothing is copied, nothing here can throw,
+// and nothing here needs the game (so it also runs in the DAR bundle
+// compiler).
+// 
+// Together with the bind pass (bindConditions in DARProject.cpp), the accept
+// / reject rules are exactly those of the original parser (and so of DAR
+// itself), which worked on copies of each line and each token: std::getline
+// + trim, istringstream splits, std::stoi(s, 0, 0) and std::stof. The
+// comments below point out where those had quirks that we deliberately
+// keep. The one difference is that the inputs which made stoi / stof throw
+// (no digits at all, or out of range) now simply reject the file, rather
+// than taking an exception out of the data loaded handler.
+// ============================================================================
+
+namespace
+{
+	bool isBlank(char ch)
+	{
+		// Same whitespace as trim() in Utilities.cpp.
+		return ch == ' ' || ch == '\t';
+	}
+
+	std::string_view trimView(std::string_view s)
+	{
+		size_t posStart = 0;
+		while (posStart < s.size() && isBlank(s[posStart]))
+		{
+			++posStart;
+		}
+		size_t posEnd = s.size();
+		while (posEnd > posStart && isBlank(s[posEnd - 1]))
+		{
+			--posEnd;
+		}
+		return s.substr(posStart, posEnd - posStart);
+	}
+
+	bool startsWith(std::string_view s, std::string_view prefix)
+	{
+		return s.size() >= prefix.size() && s.substr(0, prefix.size()) == prefix;
+	}
+
+	bool endsWith(std::string_view s, std::string_view suffix)
+	{
+		return s.size() >= suffix.size()
+			&& s.substr(s.size() - suffix.size()) == suffix;
+	}
+
+	bool isCSpace(char ch)
+	{
+		// Whitespace skipped by strtol / strtof.
+		return ch == ' ' || (ch >= '\t' && ch <= '\r');
+	}
+
+	bool isHexDigit(char ch)
+	{
+		return (ch >= '0' && ch <= '9')
+			|| (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F');
+	}
+
+	class Splitter
+	{
+		// ====================================================================
+		//                            Splitter
+		// --------------------------------------------------------------------
+		// Splits a string_view on a single character delimiter, optionally
+		// ignoring delimiters inside double quotes. Produces the same tokens
+		// as splitOnCommas / splitOnPipes (i.e. as std::getline with a
+		// delimiter): empty tokens are kept, except that nothing is produced
+		// for an empty string or after a trailing delimiter.
+		// ====================================================================
+	public:
+		Splitter(std::string_view s, char delim, bool respectQuotes)
+			: s(s), delim(delim), respectQuotes(respectQuotes) {}
+
+		bool next(std::string_view& token_out)
+		{
+			if (pos >= s.size())
+			{
+				return false;
+			}
+			size_t posEnd = pos;
+			for (; posEnd < s.size(); ++posEnd)
+			{
+				if (respectQuotes && s[posEnd] == '"')
+				{
+					// N.B. like splitOnCommas, the quote state carries
+					// on into the next token if the quotes don't match.
+					inQuote = !inQuote;
+				}
+				if (s[posEnd] == delim && !inQuote)
+				{
+					break;
+				}
+			}
+			token_out = s.substr(pos, posEnd - pos);
+			pos = posEnd + 1;
+			return true;
+		}
+
+	private:
+		std::string_view s;
+		size_t pos = 0;
+		char delim;
+		bool respectQuotes;
+		bool inQuote = false;
+	};
+
+	class LineReader
+	{
+		// ====================================================================
+		//                           LineReader
+		// --------------------------------------------------------------------
+		// Returns the trimmed, non-empty, non-comment lines of the text one
+		// at a time, with one line of look ahead: the parser needs to know
+		// whether the line it is on is the last one.
+		// ====================================================================
+	public:
+		explicit LineReader(std::string_view text) : text(text)
+		{
+			bHaveNext = advance(nextLine);
+		}
+
+		bool next(std::string_view& line_out, bool& bIsLast_out)
+		{
+			if (!bHaveNext)
+			{
+				return false;
+			}
+			line_out = nextLine;
+			bHaveNext = advance(nextLine);
+			bIsLast_out = !bHaveNext;
+			return true;
+		}
+
+	private:
+		std::string_view text;
+		size_t pos = 0;
+		std::string_view nextLine;
+		bool bHaveNext;
+
+		bool advance(std::string_view& line_out)
+		{
+			while (pos < text.size())
+			{
+				size_t posEnd = text.find('\n', pos);
+				if (posEnd == std::string_view::npos)
+				{
+					posEnd = text.size();
+				}
+				std::string_view line = text.substr(pos, posEnd - pos);
+				bool bHasLF = posEnd < text.size();
+				pos = posEnd + 1;
+
+				// The file used to be read in text mode, which turns CR LF
+				// into LF (a lone CR, even one at the very end, is kept, and
+				// trim() doesn't remove it).
+				if (bHasLF && !line.empty() && line.back() == '\r')
+				{
+					line.remove_suffix(1);
+				}
+				line = trimView(line);
+				if (!line.empty() && line[0] != ';')
+				{
+					line_out = line;
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+
+	bool parseFormID(std::string_view s, uint32_t& iFormID_out)
+	{
+		// ====================================================================
+		//                           parseFormID
+		// --------------------------------------------------------------------
+		// Same result as std::stoi(s, nullptr, 0): optional sign, then hex
+		// ("0x"), octal (leading "0") or decimal, stopping at the first
+		// character that isn't a digit. The value must fit in a (32 bit)
+		// long. Returns false where stoi would have thrown.
+		// ====================================================================
+		size_t pos = 0;
+		while (pos < s.size() && isCSpace(s[pos]))
+		{
+			++pos;
+		}
+		bool bNegative = false;
+		if (pos < s.size() && (s[pos] == '+' || s[pos] == '-'))
+		{
+			bNegative = (s[pos] == '-');
+			++pos;
+		}
+
+		int base = 10;
+		if (pos < s.size() && s[pos] == '0')
+		{
+			if (pos + 1 < s.size() && (s[pos + 1] == 'x' || s[pos + 1] == 'X'))
+			{
+				if (pos + 2 >= s.size() || !isHexDigit(s[pos + 2]))
+				{
+					// Just the "0" is converted.
+					iFormID_out = 0;
+					return true;
+				}
+				base = 16;
+				pos += 2;
+			}
+			else
+			{
+				base = 8;
+			}
+		}
+
+		uint64_t val;
+		auto result = std::from_chars(s.data() + pos, s.data() + s.size(), val, base);
+		if (result.ec != std::errc()
+			|| val > (bNegative ? 0x80000000ull : 0x7FFFFFFFull))
+		{
+			return false;
+		}
+		iFormID_out = (uint32_t)(bNegative ? 0 - val : val);
+		return true;
+	}
+
+	bool parseFloat(std::string_view s, float& fVal_out)
+	{
+		// ====================================================================
+		//                           parseFloat
+		// --------------------------------------------------------------------
+		// Same result as std::stof(s): optional sign, then a decimal or hex
+		// ("0x") float, "inf", "infinity" or "nan", stopping at the first
+		// character that doesn't fit. Returns false where stof would have
+		// thrown.
+		// ====================================================================
+		size_t pos = 0;
+		while (pos < s.size() && isCSpace(s[pos]))
+		{
+			++pos;
+		}
+		bool bNegative = false;
+		if (pos < s.size() && (s[pos] == '+' || s[pos] == '-'))
+		{
+			bNegative = (s[pos] == '-');
+			++pos;
+		}
+
+		const char* pFirst = s.data() + pos;
+		const char* pLast = s.data() + s.size();
+		if (pFirst != pLast && (*pFirst == '+' || *pFirst == '-'))
+		{
+			// from_chars would take a second sign; strtof doesn't.
+			return false;
+		}
+		std::from_chars_result result;
+		float fVal;
+		if (pLast - pFirst >= 2 && pFirst[0] == '0'
+			&& (pFirst[1] == 'x' || pFirst[1] == 'X'))
+		{
+			if (pFirst + 2 != pLast && (pFirst[2] == '+' || pFirst[2] == '-'))
+			{
+				result.ec = std::errc::invalid_argument;
+			}
+			else
+			{
+				result = std::from_chars(pFirst + 2, pLast, fVal, std::chars_format::hex);
+			}
+			if (result.ec == std::errc::invalid_argument)
+			{
+				// No hex digits: just the "0" is converted.
+				fVal = 0.0f;
+				result.ec = std::errc();
+			}
+		}
+		else
+		{
+			result = std::from_chars(pFirst, pLast, fVal);
+		}
+		if (result.ec != std::errc()
+			|| std::fpclassify(fVal) == FP_SUBNORMAL)
+		{
+			// (strtof reports a denormal result as out of range too, so
+			// stof threw on those.)
+			return false;
+		}
+		fVal_out = bNegative ? -fVal : fVal;
+		return true;
+	}
+}
+
+namespace DARGH
+{
+	bool parseConditionSyntax(std::string_view text, ParsedConditions& parsed_out)
+	{
+		parsed_out.clear();
+
+		LineReader lines(text);
+		std::string_view full_line;
+		bool bIsLastLine;
+		while (lines.next(full_line, bIsLastLine))
+		{
+			std::string_view chomped_line = full_line;
+
+			ParsedCondition condition;
+			condition.line = full_line;
+			condition.firstArg = (uint32_t)parsed_out.args.size();
+
+			// Does this line start with a "NOT"?
+			// Must have at least one trailing space or one trailing tab.
+			if (startsWith(chomped_line, "NOT ") ||
+				startsWith(chomped_line, "NOT\t"))
+			{
+				condition.bNot = true;
+				chomped_line.remove_prefix(3);   // chomp
+			}
+
+			// Get the position of the opening bracket.
+			size_t posLB = chomped_line.find('(');
+			if (posLB == std::string_view::npos)
+			{
+				// *** USER ERROR ***
+				// There is no opening bracket on this line.
+				parsed_out.syntaxErrorLine = full_line;
+				break;    //  Stop parsing conditions file.
+			}
+
+			// Get the function name.
+			// We assume this is all the text up to the opening bracket,
+			// with optional lead and trailing whitespace. (Whether it's
+			// a real function is checked when the conditions are bound.)
+			condition.funcName = trimView(chomped_line.substr(0, posLB));
+			size_t posRB = chomped_line.find(')');
+			if (posRB == std::string_view::npos || posRB < posLB)
+			{
+				// *** USER ERROR ***
+				// Function name parsing error.
+				parsed_out.syntaxErrorLine = full_line;
+				break;    //  Stop parsing conditions file.
+			}
+
+			// Anything after the closing bracket (could just be whitespace)?
+			std::string_view rest = trimView(chomped_line.substr(posRB + 1));
+			if (rest.size() > 0)
+			{
+				// The further characters are not just whitespace.
+				// N.B. only the start is checked, so e.g. "ANDx" is fine.
+				if (startsWith(rest, "AND"))
+				{
+					condition.bAnd = true;
+				}
+				else
+				{
+					if (!startsWith(rest, "OR"))
+					{
+						// *** USER ERROR ***
+						// The user has written non-whitespace
+						// characters at the end of this line with
+						// something other than "AND" or "OR".
+						parsed_out.syntaxErrorLine = full_line;
+						break;    //  Stop parsing conditions file.
+					}
+					condition.bAnd = false;
+				}
+			}
+			else if (!bIsLastLine)
+			{
+				// *** USER ERROR ***
+				// There's no "AND" or "OR" after the ")", but there are still
+				// further lines in the file. Which means we don't know how
+				// to interpret those additional conditions (should they be
+				// ANDed or ORed to this one?)
+				parsed_out.syntaxErrorLine = full_line;
+				break;    //  Stop parsing the conditions file.
+			}
+
+			// ----------------------------------------------------------------
+			//                     Parse any arguments.
+			// ----------------------------------------------------------------
+			if (posLB != posRB - 1)
+			{
+				// There is something between the brackets
+				// (presumably the arguments...)
+				std::string_view commaSepArgs =
+					trimView(chomped_line.substr(posLB + 1, posRB - (posLB + 1)));
+				if (commaSepArgs.size() == 0)
+				{
+					// Only whitespace between the brackets. As in DAR,
+					// once the function name has been checked this
+					// condition is silently dropped (and its argument
+					// count is never checked).
+					condition.bBlankArgs = true;
+					parsed_out.conditions.push_back(condition);
+					continue;    //  Skip to next line.
+				}
+
+				// Parse the arguments.
+				Splitter args(commaSepArgs, ',', true);
+				std::string_view sArg;
+				while (args.next(sArg))
+				{
+					ParsedConditionArg arg;
+					sArg = trimView(sArg);
+					if (sArg.size() == 0 || sArg[0] == '"')
+					{
+						// ----------------------------------------------------
+						//      Argument should be "esp name" | formID
+						// ----------------------------------------------------
+						// Note for newbies: Global variables are also 
+						// specified with formIDs. For more on formIDs and how
+						// to recreate them, see the notes in DARProject.cpp.
+						// ----------------------------------------------------
+						std::string_view sArgTokens[2];
+						size_t nArgTokens = 0;
+						Splitter pipes(sArg, '|', false);
+						std::string_view sToken;
+						while (pipes.next(sToken))
+						{
+							if (nArgTokens < 2)
+							{
+								sArgTokens[nArgTokens] = sToken;
+							}
+							++nArgTokens;
+						}
+						if (nArgTokens != 2)
+						{
+							// *** USER ERROR ***
+							// User hasn't specified exactly two items in
+							// the pipe-delimited list comprising this arg.
+							parsed_out.syntaxErrorLine = full_line;
+							break;    //  Stop parsing arguments.
+						}
+
+						// ----------------------------------------------------
+						//            Process token 1: "esp name".
+						// ----------------------------------------------------
+						std::string_view espName = trimView(sArgTokens[0]);
+						if (espName.size() <= 2 || espName.front() != '"'
+							|| espName.back() != '"')
+						{
+							// *** USER ERROR ***
+							// User hasn't specified the mod name with the
+							// correct syntax ("<mod name>").
+							parsed_out.syntaxErrorLine = full_line;
+							break;    //  Stop parsing arguments.
+						}
+
+						// Remove the surrounding quotes
+						espName = espName.substr(1, espName.size() - 2);
+						if (!endsWith(espName, ".esp") &&
+							!endsWith(espName, ".esm") &&
+							!endsWith(espName, ".esl"))
+						{
+							// *** USER ERROR ***
+							// User has provided an invalid mod name
+							// (doesn't end in extension ".esp", ".esm"
+							// or ".esl")
+							parsed_out.syntaxErrorLine = full_line;
+							break;    //  Stop parsing arguments.
+						}
+
+						// ----------------------------------------------------
+						//              Process token 2: form ID.
+						// ----------------------------------------------------
+						// (Its range depends on whether the mod is light,
+						// so that's checked when the conditions are bound.)
+						if (!parseFormID(trimView(sArgTokens[1]), arg.formBaseID))
+						{
+							// *** USER ERROR ***
+							// Not a number.
+							parsed_out.syntaxErrorLine = full_line;
+							break;    //  Stop parsing arguments.
+						}
+						arg.modName = espName;
+						arg.bIsFormID = true;
+					}
+					else
+					{
+						// ----------------------------------------------------
+						//             Argument should be a float.
+						// ----------------------------------------------------
+						// (Whether this arg of the function can be a float
+						// is checked when the conditions are bound.)
+						if (!parseFloat(sArg, arg.fVal) || std::isnan(arg.fVal))
+						{
+							// *** USER ERROR ***
+							// User has provided a value that is not a
+							// number.
+							parsed_out.syntaxErrorLine = full_line;
+							break;    //  Stop parsing arguments.
+						}
+					}
+					parsed_out.args.push_back(arg);
+				}
+				if (!parsed_out.syntaxErrorLine.empty())
+				{
+					break;    //  Stop parsing conditions file.
+				}
+			}
+
+			condition.nArgs = (uint32_t)parsed_out.args.size() - condition.firstArg;
+			parsed_out.conditions.push_back(condition);
+		}
+		return parsed_out.syntaxErrorLine.empty();
+	}
+
+	bool readConditionsFile(const std::string& path, std::string& text_out)
+	{
+#ifdef _WIN32
+		FILE* f = fopen(path.c_str(), "rb");
+#else
+		// The DAR code builds its paths with backslashes.
+		std::string localPath = path;
+		for (auto& ch : localPath)
+		{
+			if (ch == '\\')
+			{
+				ch = '/';
+			}
+		}
+		FILE* f = fopen(localPath.c_str(), "rb");
+#endif
+		if (!f)
+		{
+			return false;
+		}
+		text_out.clear();
+		char chunk[4096];
+		size_t nRead;
+		while ((nRead = fread(chunk, 1, sizeof(chunk), f)) > 0)
+		{
+			text_out.append(chunk, nRead);
+		}
+		fclose(f);
+		// Text mode reads (on Windows, where DAR runs) used to stop at a
+		// Ctrl+Z. Here too, so that darbundle reads a file as DAR does
+		// whatever it runs on.
+		size_t posEOF = text_out.find('\x1A');
+		if (posEOF != std::string::npos)
+		{
+			text_out.resize(posEOF);
+		}
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+// ============================================================================
+//                                CoreLog.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "CorePrefix.h"
+
+#include <atomic>
+
+// ============================================================================
+// The core's log, when it's built on its own (see CorePrefix.h). Each call is
+// written as one line, with a single write, so lines from different threads
+// don't interleave.
+// ============================================================================
+static std::atomic<FILE*> s_logFile{ stderr };
+
+void setCoreLog(FILE* f)
+{
+	s_logFile = f;
+}
+
+void coreLog(CoreLogLevel level, const char* fmt, va_list args)
+{
+	FILE* f = s_logFile;
+	if (!f)
+	{
+		return;
+	}
+	const char* prefix = "";
+	switch (level)
+	{
+	case CoreLogLevel::kFatalError: prefix = "fatal error: "; break;
+	case CoreLogLevel::kError:      prefix = "error: "; break;
+	case CoreLogLevel::kWarning:    prefix = "warning: "; break;
+	default:                        break;
+	}
+	char line[8192];
+	int n = snprintf(line, sizeof(line), "%s", prefix);
+	vsnprintf(line + n, sizeof(line) - n - 1, fmt, args);
+	strcat(line, "\n");
+	fputs(line, f);
+}
\ No newline at end of file
@@ -0,0 +1,487 @@
+// ============================================================================
+//                           DARAnimationNames.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "DARAnimationNames.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Temporary structures used when generating animations from DAR data:
+
+// Actor base remappings (method 1)
+struct obj16_m1
+{
+	uint32_t             animIndex_orig;
+	uint32_t             animIndex_new;
+	const ActorBaseLink* actorBaseLink;
+};
+
+// Condition remappings (method 2)
+struct obj16_m2
+{
+	uint32_t             animIndex_orig;
+	uint32_t             animIndex_new;
+	const ConditionLink* conditionLink;
+};
+
+static char* dupAnimName(const char* animName)
+{
+	// Heap copy of an animation file name, for storage in a rebuilt
+	// animationNames hkArray. Returns NULL if 'animName' is NULL.
+	if (!animName)
+	{
+		return NULL;
+	}
+	size_t sz = strlen(animName);
+	char* animName_dup = (char*)operator new(sz + 1);
+	memcpy(animName_dup, animName, sz + 1);
+	return animName_dup;
+}
+
+static void chargeLinkIndex(uint32_t projectID, const DARLinkIndex& linkIndex, MemCategory category)
+{
+	// Charges the project with the index's LinkData objects and the
+	// AnimLinks holding them, under 'category'.
+	size_t bytes = memBytes(linkIndex.allLinks) + memBytes(linkIndex.likelyLinks), nLinkData = 0;
+	for (auto& entry : linkIndex.allLinks)
+	{
+		bytes += memBytes(entry.second.byPriority) + entry.second.features.numBytes();
+		for (auto& priorityLink : entry.second.byPriority)
+		{
+			bytes += priorityLink.second->numBytes();
+			nLinkData++;
+		}
+	}
+	linkIndex.linksCharge.set(projectID, category, bytes, nLinkData);
+}
+
+// A remap (M1 or M2) competing for a replacement slot.
+struct SlotRequest
+{
+	int                 priority;        // DAR priority (M1 links are always 0)
+	uint32_t*           pSlot;           // where to store the assigned slot
+	PathID              from_hkx_file;
+	PathID              to_hkx_file;
+};
+
+// Replacement slots in a rebuilt animationNames hkArray. Links whose TO
+// animation files are the same (compared as canonical paths, i.e. lower-cased
+// with '/' treated as '\\') share a single slot, and so a single binding index.
+// At most 'budget' slots are handed out; once they are used up, requests for
+// further new TO files are refused with kNoSlot.
+struct ReplacementSlots
+{
+	static const uint32_t kNoSlot = 0xFFFFFFFF;
+
+	uint32_t                                   firstSlot = 0;
+	uint32_t                                   budget = 0;
+	std::vector<PathID>                        names;         // TO file name for each slot
+	std::unordered_map<std::string, uint32_t>  slotByName;    // canonical TO file name => slot
+	std::unordered_map<std::string, uint32_t>  refusedNames;  // canonical TO file name => nRefused
+
+	uint32_t assign(PathID to_hkx_file)
+	{
+		std::string key(g_pathTable.str(to_hkx_file));
+		std::transform(key.begin(), key.end(), key.begin(),
+			[](unsigned char c) { return c == '/' ? '\\' : (char)tolower(c); });
+		auto search = slotByName.find(key);
+		if (search != slotByName.end())
+		{
+			// Already have a slot for this file; sharing it is free.
+			return search->second;
+		}
+		if (names.size() >= budget)
+		{
+			// Out of slots.
+			++refusedNames[key];
+			return kNoSlot;
+		}
+		uint32_t slot = firstSlot + (uint32_t)names.size();
+		slotByName.insert(std::pair(key, slot));
+		names.push_back(to_hkx_file);
+		return slot;
+	}
+};
+
+bool g_ShownConditionError = false;
+
+namespace DARGH
+{
+	void rebuildAnimationNames(DARProject& darProj, const DARLinkTable& links,
+		                       const char* const* origNames, uint32_t nOrig,
+		                       uint32_t maxNames, AnimationNames& names_out)
+	{
+		// ------------------------------------------------------------------------------
+		// Iterate over the animation names array, see what M1 and/or M2 mappings we have 
+		// for each one, temporarily store those mappings in m1data and m2data vectors.
+		// ------------------------------------------------------------------------------
+		std::vector<obj16_m1> m1data_vec;
+		std::vector<obj16_m2> m2data_vec;
+
+		// Index the links by the (precomputed) hash of their FROM file, so that each
+		// name is only compared against the links with the same hash, rather than
+		// against every link in the project.
+		std::unordered_map<uint32_t, std::vector<uint32_t>> m1ByHash, m2ByHash;
+		for (uint32_t j = 0; j < links.actorBaseLinks.size(); ++j)
+		{
+			m1ByHash[g_pathTable.lowerHash(links.actorBaseLinks[j].from_hkx_file)].push_back(j);
+		}
+		for (uint32_t j = 0; j < links.conditionLinks.size(); ++j)
+		{
+			m2ByHash[g_pathTable.lowerHash(links.conditionLinks[j].from_hkx_file)].push_back(j);
+		}
+
+		for (uint32_t i = 0; i < nOrig; ++i)
+		{
+			std::string_view animName_Orig(origNames[i]);
+			uint32_t hash = PathTable::hashLower(animName_Orig);
+
+			// Actor Base replacement animation files (M1).
+			auto m1Search = m1ByHash.find(hash);
+			if (m1Search != m1ByHash.end())
+			{
+				for (uint32_t j : m1Search->second)
+				{
+					const ActorBaseLink& pM1Obj = links.actorBaseLinks[j];
+					if (g_pathTable.sameFile(pM1Obj.from_hkx_file, animName_Orig))
+					{
+						obj16_m1 m1data;
+						m1data.animIndex_orig = i;
+						m1data.actorBaseLink = &pM1Obj;
+						m1data_vec.push_back(m1data);
+					}
+				}
+			}
+
+			// Conditional replacement animation files (M2).
+			auto m2Search = m2ByHash.find(hash);
+			if (m2Search != m2ByHash.end())
+			{
+				for (uint32_t j : m2Search->second)
+				{
+					const ConditionLink& pM2Obj = links.conditionLinks[j];
+					if (g_pathTable.sameFile(pM2Obj.from_hkx_file, animName_Orig))
+					{
+						obj16_m2 m2data;
+						m2data.animIndex_orig = i;
+						m2data.conditionLink = &pM2Obj;
+						m2data_vec.push_back(m2data);
+					}
+				}
+			}
+		}  // for (uint32_t i = 0; i < nOrig; ++i)
+
+		// ------------------------------------------------------------------------------
+		// Assign each remap a replacement slot. Remaps with the same TO animation file
+		// share a slot, so the same file is only bound (and its name only copied) once.
+		// 
+		// Only (maxNames - nOrig) slots are available. Slots are handed out in DAR
+		// priority order (highest first; M1 links have priority 0), so if the limit is
+		// reached it is the lowest priority remaps that are dropped, rather than all of
+		// them (which is what DAR does).
+		// 
+		// N.B. Only animations in the project's own animationNames array (i.e. those
+		// its behaviour graph can actually bind) ever compete for slots here.
+		// ------------------------------------------------------------------------------
+		std::vector<SlotRequest> slotRequests;
+		slotRequests.reserve(m1data_vec.size() + m2data_vec.size());
+		for (auto& m2data : m2data_vec)
+		{
+			slotRequests.push_back(
+				SlotRequest{ m2data.conditionLink->priority, &m2data.animIndex_new,
+				             m2data.conditionLink->from_hkx_file,
+				             m2data.conditionLink->to_hkx_file });
+		}
+		for (auto& m1data : m1data_vec)
+		{
+			slotRequests.push_back(
+				SlotRequest{ 0, &m1data.animIndex_new,
+				             m1data.actorBaseLink->from_hkx_file,
+				             m1data.actorBaseLink->to_hkx_file });
+		}
+		std::stable_sort(slotRequests.begin(), slotRequests.end(),
+			[](const SlotRequest& a, const SlotRequest& b) { return a.priority > b.priority; });
+
+		ReplacementSlots replSlots;
+		replSlots.firstSlot = nOrig;
+		maxNames = std::min(maxNames, kMaxAnimationNames);
+		replSlots.budget = nOrig < maxNames ? maxNames - nOrig : 0;
+		uint32_t nDropped = 0;
+		for (auto& slotRequest : slotRequests)
+		{
+			*slotRequest.pSlot = replSlots.assign(slotRequest.to_hkx_file);
+			if (*slotRequest.pSlot == ReplacementSlots::kNoSlot)
+			{
+				++nDropped;
+			}
+		}
+
+		// What it came to (for the caller to report).
+		names_out = AnimationNames();
+		names_out.nOrig = nOrig;
+		names_out.nNames = nOrig + (uint32_t)replSlots.names.size();
+		names_out.nM1Remaps = (uint32_t)m1data_vec.size();
+		names_out.nM2Remaps = (uint32_t)m2data_vec.size();
+		names_out.nRemaps = (uint32_t)slotRequests.size() - nDropped;
+		names_out.nRefusedFiles = (uint32_t)replSlots.refusedNames.size();
+		names_out.nWanted = names_out.nNames + names_out.nRefusedFiles;
+		for (auto it = slotRequests.rbegin(); it != slotRequests.rend(); ++it)
+		{
+			if (*it->pSlot == ReplacementSlots::kNoSlot)
+			{
+				names_out.dropped.push_back(
+					DroppedRemap{ it->priority, it->from_hkx_file, it->to_hkx_file });
+			}
+		}
+
+		// ------------------------------------------------------------------------------
+		// If there are available slots for the replacement animations, create a new
+		// hkArray with exactly nNames elements, laid out as:
+		//        [0, nOrig)                      the original animation file names
+		//        [nOrig, nNames)                 the unique remapped (TO) animation file
+		//                                        names, in DAR priority order
+		// 
+		// N.B. DAR instead allocates MAX_ANIMATION_FILES elements, puts the remapped
+		// names first, pads with empty strings and moves the original names to the
+		// end, which shifts every original index by (MAX_ANIMATION_FILES - nOrig).
+		// Keeping the original names at the front means the FROM index stored in
+		// the link index is just the original index, and only the replacement
+		// slots cost any memory.
+		// 
+		// The links are built into a new DARLinkIndex, published for the new array
+		// once complete: graphs generated with an earlier array go on using the
+		// index built for that one, whose binding indices match it.
+		// ------------------------------------------------------------------------------
+		if (names_out.nNames == nOrig)
+		{
+			return;
+		}
+		char** datAnimNames_New = (char**)operator new(sizeof(char*) * names_out.nNames);
+		auto linkIndex = std::make_shared<DARLinkIndex>();
+		linkIndex->nNames = names_out.nNames;
+		auto& allLinks = linkIndex->allLinks;
+
+		// ==============================================
+		//      1. COPY THE ORIGINAL FILE NAMES.
+		// ==============================================
+		for (uint32_t i = 0; i < nOrig; ++i)
+		{
+			datAnimNames_New[i] = dupAnimName(origNames[i]);
+		}
+
+		// The replacements an actor is likely to want, going by its actor
+		// base, race and equipped types (see AnimPrefetcher), with the
+		// paths of their files relative to Data.
+		std::vector<LikelyLink>& likelyLinks = linkIndex->likelyLinks;
+		std::string likelyPathPrefix = "meshes\\" + darProj.projFolder + "\\";
+		auto addLikelyLink = [&](const ConditionLinkData& linkData,
+			                     const FeatureLayout& layout, PathID to_hkx_file)
+		{
+			LikelyLink likely;
+			if (likely.guardsFrom(linkData.program, layout))
+			{
+				likely.path = likelyPathPrefix + g_pathTable.str(to_hkx_file);
+				likelyLinks.push_back(std::move(likely));
+			}
+		};
+
+		// ==============================================
+		//      2. COPY THE REPLACEMENT FILE NAMES.
+		// ==============================================
+		// One copy per unique TO animation file.
+		for (uint32_t i = 0; i < replSlots.names.size(); ++i)
+		{
+			datAnimNames_New[replSlots.firstSlot + i] =
+				dupAnimName(g_pathTable.str(replSlots.names[i]));
+		}
+
+		// ==============================================
+		//      3. STORE ACTOR BASE MAPPINGS (M1)
+		// ==============================================
+		for (uint32_t i = 0; i < m1data_vec.size(); ++i)
+		{
+			// The (possibly shared) slot holding the TO animation name.
+			// Skip links that were dropped for lack of slots.
+			if (m1data_vec[i].animIndex_new == ReplacementSlots::kNoSlot)
+			{
+				continue;
+			}
+			hkInt16 destIndex = (hkInt16)m1data_vec[i].animIndex_new;
+
+			// The original FROM animation keeps its index in the new array.
+			uint32_t fromAnimIndex = m1data_vec[i].animIndex_orig;
+
+			// Does the FROM anim index already exist in our link data map for this project?
+			// I.e. have we already stored M1 mappings to this index?
+			auto search = allLinks.find(fromAnimIndex);
+			if (search == allLinks.end())
+			{
+				// --------------------------------------------------------------------
+				// FROM animation index was NOT found in the project hash map.
+				// --------------------------------------------------------------------
+				// Store the relevant data in a new BaseLinkData object.
+				BaseLinkData* oBLinkData = new BaseLinkData();
+				oBLinkData->allLinks.insert(
+					std::pair(m1data_vec[i].actorBaseLink->actorBaseID, destIndex)
+				);
+
+				// Create an ordered map, with <priority> => <BaseLinkData object>
+				// BaseLinkData always has a priority of 0.
+				AnimLinks animLinks;
+				animLinks.byPriority.insert(std::pair<int, LinkData*>(0, oBLinkData));
+				allLinks.insert(
+					std::pair<uint32_t, AnimLinks>(fromAnimIndex, std::move(animLinks))
+				);
+			}
+			else
+			{
+				// --------------------------------------------------------------------
+				// FROM animation index WAS found in the project hash map.
+				// --------------------------------------------------------------------
+				// Retrieve the BaseLinkData object in the existing ordered map and add this
+				// TO mapping to that. There should only be one BaseLinkData object in 
+				// the map (if not next line will throw exception), with priority of 0.
+				BaseLinkData* oBLinkData =
+					dynamic_cast<BaseLinkData*>(search->second.byPriority.at(0));
+				oBLinkData->allLinks.insert(
+					std::pair(m1data_vec[i].actorBaseLink->actorBaseID, destIndex)
+				);
+			}
+
+			// Any actor with this base is likely to want the TO animation.
+			LikelyLink likely;
+			likely.guards = LikelyLink::kActorBase;
+			likely.actorBaseID = m1data_vec[i].actorBaseLink->actorBaseID;
+			likely.path = likelyPathPrefix + g_pathTable.str(m1data_vec[i].actorBaseLink->to_hkx_file);
+			likelyLinks.push_back(std::move(likely));
+		} // for (uint32_t i = 0; i < m1data.size(); ++i)
+
+		// ==============================================
+		//        4. STORE CONDITION MAPPINGS (M2)
+		// ==============================================
+		for (uint32_t i = 0; i < m2data_vec.size(); i++)
+		{
+			// The (possibly shared) slot holding the TO animation name.
+			// Skip links that were dropped for lack of slots.
+			if (m2data_vec[i].animIndex_new == ReplacementSlots::kNoSlot)
+			{
+				continue;
+			}
+			hkInt16 destIndex = (hkInt16)m2data_vec[i].animIndex_new;
+
+			// The original FROM animation keeps its index in the new array.
+			// And get the priority.
+			int priority = m2data_vec[i].conditionLink->priority;
+			uint32_t fromAnimIndex = m2data_vec[i].animIndex_orig;
+
+			// Store the relevant data in a new ConditionLinkData object.
+			// Its conditions are compiled against the features of
+			// all the links from the same FROM animation (below).
+			ConditionLinkData* oCLinkData = new ConditionLinkData();
+			const std::vector<ConditionLinkFunc>& conditions =
+				m2data_vec[i].conditionLink->conditions;
+			oCLinkData->to_hkx_index = destIndex;
+
+			// Does the FROM anim index already exist in our link data map for this project?
+			// I.e. have we already stored M2 mappings to this index?
+			auto search = allLinks.find(fromAnimIndex);
+			if (search == allLinks.end())
+			{
+				// --------------------------------------------------------------------
+				// FROM animation index was NOT found in the project hash map.
+				// --------------------------------------------------------------------
+				// Create an ordered map, with <priority> => <ConditionLinkData object>.
+				// ConditionLinkData can have any priority from -ve to +ve, except 0.
+				// Larger numbers mean greater priority (and thus their associated
+				// ConditionLinkData objects should appear earlier when iterating
+				// over the map).
+				AnimLinks animLinks;
+				oCLinkData->compile(conditions, animLinks.features);
+				addLikelyLink(*oCLinkData, animLinks.features, m2data_vec[i].conditionLink->to_hkx_file);
+				animLinks.byPriority.insert(std::pair(priority, (LinkData*)oCLinkData));
+				allLinks.insert(
+					std::pair<uint32_t, AnimLinks>(fromAnimIndex, std::move(animLinks))
+				);
+			}
+			else
+			{
+				// --------------------------------------------------------------------
+				// FROM animation index WAS found in the project hash map.
+				// --------------------------------------------------------------------
+				// Retrieve the existing ordered map, then add the ConditionLinkData
+				// object to it - unless the priority is taken, in which case the
+				// link is dropped before it adds anything to the shared layout.
+				AnimLinks& animLinks = search->second;
+				if (animLinks.byPriority.find(priority) != animLinks.byPriority.end())
+				{
+					if (!g_ShownConditionError)
+					{
+						g_ShownConditionError = true;
+						_ERROR("couldn't add conditions");
+					}
+					delete oCLinkData;
+					continue;
+				}
+				oCLinkData->compile(conditions, animLinks.features);
+				addLikelyLink(*oCLinkData, animLinks.features, m2data_vec[i].conditionLink->to_hkx_file);
+				animLinks.byPriority.insert(std::pair(priority, (LinkData*)oCLinkData));
+			}
+		} // for (uint32_t i = 0; i < m2data.size(); i++)
+
+		// ==============================================
+		//                 5. DONE...!
+		// ==============================================
+		// Published for the array, and as the project's latest (the one it
+		// supersedes is kept for the graphs generated with its array, but
+		// counted as leaked).
+		chargeLinkIndex(darProj.id, *linkIndex, MemCategory::kLinkData);
+		darProj.linkIndexes.update(datAnimNames_New,
+			[&](std::shared_ptr<const DARLinkIndex>& stored) { stored = linkIndex; });
+		std::shared_ptr<const DARLinkIndex> superseded = std::atomic_exchange(
+			&darProj.latestLinkIndex, std::shared_ptr<const DARLinkIndex>(linkIndex));
+		if (superseded)
+		{
+			chargeLinkIndex(darProj.id, *superseded, MemCategory::kLeakedRebuilds);
+		}
+
+		// The name array is handed over to the game, which we never see
+		// free it: it stays charged to the project.
+		size_t nameBytes = sizeof(char*) * names_out.nNames;
+		for (uint32_t i = 0; i < names_out.nNames; ++i)
+		{
+			if (datAnimNames_New[i])
+			{
+				nameBytes += strlen(datAnimNames_New[i]) + 1;
+			}
+		}
+		g_memoryAccounts.add(darProj.id, MemCategory::kNameArrays,
+			                 (int64_t)nameBytes, (int64_t)names_out.nNames);
+		names_out.names = datAnimNames_New;
+	}
+}
\ No newline at end of file
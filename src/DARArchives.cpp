@@ -0,0 +1,109 @@
+// ============================================================================
+//                              DARArchives.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "DARArchives.h"
+
+#include <cstring>
+
+namespace
+{
+	const char kDARFolder[] = "\\animations\\dynamicanimationreplacer";
+
+	std::string toLower(std::string_view s)
+	{
+		std::string lower(s);
+		for (auto& ch : lower)
+		{
+			ch = (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+		}
+		return lower;
+	}
+
+	bool endsWith(std::string_view s, std::string_view suffix)
+	{
+		return s.size() >= suffix.size()
+			&& s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+}
+
+bool DARArchives::addArchive(const std::string& archivePath)
+{
+	std::unique_ptr<BSAArchive> archive(new BSAArchive);
+	bool bOpened = archive->open(archivePath, [](std::string_view folder)
+	{
+		// Only folders in (or beneath) a DynamicAnimationReplacer folder.
+		size_t pos = folder.find(kDARFolder);
+		if (pos == std::string_view::npos)
+		{
+			return false;
+		}
+		char next = folder.size() > pos + strlen(kDARFolder) ? folder[pos + strlen(kDARFolder)] : '\0';
+		return next == '\0' || next == '\\';
+	});
+	if (!bOpened)
+	{
+		return archive->error() == NULL;
+	}
+	if (archive->files().empty())
+	{
+		return true;
+	}
+	for (const auto& file : archive->files())
+	{
+		files[file.path] = std::make_pair(archive.get(), &file);
+	}
+	archives.push_back(std::move(archive));
+	return true;
+}
+
+void DARArchives::mergeInto(const std::string& darDir, DirSnapshot& darTree,
+	                        const std::string& subDir) const
+{
+	// The map is ordered, so the files beneath darDir (or subDir) are one
+	// contiguous run.
+	std::string darDirPrefix = toLower(darDir) + "\\";
+	std::string prefix = subDir.empty() ? darDirPrefix : darDirPrefix + toLower(subDir) + "\\";
+	for (auto it = files.lower_bound(prefix);
+		 it != files.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+		 ++it)
+	{
+		if (endsWith(it->first, ".hkx"))
+		{
+			darTree.addFile(std::string_view(it->first).substr(darDirPrefix.size()));
+		}
+	}
+}
+
+bool DARArchives::readFile(const std::string& path, std::string& data_out) const
+{
+	auto it = files.find(toLower(path));
+	if (it == files.end())
+	{
+		return false;
+	}
+	return it->second.first->readFile(*it->second.second, data_out);
+}
\ No newline at end of file
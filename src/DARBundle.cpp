@@ -0,0 +1,501 @@
+// ============================================================================
+//                               DARBundle.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "DARBundle.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ============================================================================
+//                          DAR bundle file layout
+// ----------------------------------------------------------------------------
+// Strings (condition lines, function names, mod names and priority folder
+// names) are stored once each in the string table at the end of the file and
+// referred to by StrRef. Arg indices in Condition records are relative to the
+// first arg of their CondFile. Everything is validated on open, so a corrupt
+// bundle is rejected rather than read out of bounds.
+// ============================================================================
+namespace
+{
+	const char kMagic[4] = { 'D', 'A', 'R', 'B' };
+
+	struct StrRef
+	{
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	struct Header
+	{
+		char     magic[4];
+		uint32_t version;
+		uint32_t nNodes;
+		uint32_t nodesOffset;
+		uint32_t namesSize;
+		uint32_t namesOffset;
+		uint32_t nCondFiles;
+		uint32_t condFilesOffset;
+		uint32_t nConditions;
+		uint32_t conditionsOffset;
+		uint32_t nArgs;
+		uint32_t argsOffset;
+		uint32_t stringsSize;
+		uint32_t stringsOffset;
+	};
+
+	struct CondFile
+	{
+		StrRef   priority;             // priority folder name
+		StrRef   syntaxErrorLine;      // length 0 if none
+		uint32_t firstCondition;
+		uint32_t nConditions;
+		uint32_t firstArg;
+		uint32_t nArgs;
+	};
+
+	// Condition::flags
+	const uint32_t kCondition_Not       = 1 << 0;
+	const uint32_t kCondition_And       = 1 << 1;
+	const uint32_t kCondition_BlankArgs = 1 << 2;
+
+	struct Condition
+	{
+		StrRef   line;
+		StrRef   funcName;
+		uint32_t firstArg;             // relative to CondFile::firstArg
+		uint32_t nArgs;
+		uint32_t flags;                // kCondition_xxx
+	};
+
+	struct Arg
+	{
+		StrRef   modName;
+		uint32_t formBaseID;
+		float    fVal;
+		uint32_t bIsFormID;
+	};
+
+	static_assert(sizeof(DirSnapshot::Node) == 20, "bundle layout changed");
+	static_assert(sizeof(Header) == 56, "bundle layout changed");
+	static_assert(sizeof(CondFile) == 32, "bundle layout changed");
+	static_assert(sizeof(Condition) == 28, "bundle layout changed");
+	static_assert(sizeof(Arg) == 20, "bundle layout changed");
+
+	uint32_t align4(size_t n)
+	{
+		return (uint32_t)((n + 3) & ~(size_t)3);
+	}
+
+	class StringTable
+	{
+	public:
+		StrRef add(std::string_view s)
+		{
+			auto it = index.find(std::string(s));
+			if (it != index.end())
+			{
+				return it->second;
+			}
+			StrRef ref = { (uint32_t)data.size(), (uint32_t)s.size() };
+			data.append(s.data(), s.size());
+			index.emplace(std::string(s), ref);
+			return ref;
+		}
+		std::string data;
+
+	private:
+		std::unordered_map<std::string, StrRef> index;
+	};
+}
+
+bool DARBundle::write(const std::string& path, const DirSnapshot& darTree,
+	                  const std::vector<std::pair<std::string, ParsedConditions>>& condFiles)
+{
+	// Flatten the conditions into records.
+	StringTable strings;
+	std::vector<CondFile> condFileRecs;
+	std::vector<Condition> conditionRecs;
+	std::vector<Arg> argRecs;
+	for (auto& condFile : condFiles)
+	{
+		const ParsedConditions& parsed = condFile.second;
+		CondFile condFileRec;
+		condFileRec.priority = strings.add(condFile.first);
+		condFileRec.syntaxErrorLine = strings.add(parsed.syntaxErrorLine);
+		condFileRec.firstCondition = (uint32_t)conditionRecs.size();
+		condFileRec.nConditions = (uint32_t)parsed.conditions.size();
+		condFileRec.firstArg = (uint32_t)argRecs.size();
+		condFileRec.nArgs = (uint32_t)parsed.args.size();
+		condFileRecs.push_back(condFileRec);
+
+		for (auto& condition : parsed.conditions)
+		{
+			Condition conditionRec;
+			conditionRec.line = strings.add(condition.line);
+			conditionRec.funcName = strings.add(condition.funcName);
+			conditionRec.firstArg = condition.firstArg;
+			conditionRec.nArgs = condition.nArgs;
+			conditionRec.flags = (condition.bNot ? kCondition_Not : 0)
+				| (condition.bAnd ? kCondition_And : 0)
+				| (condition.bBlankArgs ? kCondition_BlankArgs : 0);
+			conditionRecs.push_back(conditionRec);
+		}
+		for (auto& arg : parsed.args)
+		{
+			Arg argRec;
+			argRec.modName = strings.add(arg.modName);
+			argRec.formBaseID = arg.formBaseID;
+			argRec.fVal = arg.fVal;
+			argRec.bIsFormID = arg.bIsFormID ? 1 : 0;
+			argRecs.push_back(argRec);
+		}
+	}
+
+	// Lay out the file.
+	Header header;
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.nNodes = darTree.numNodes();
+	header.nodesOffset = sizeof(Header);
+	header.namesSize = darTree.namesSize();
+	header.namesOffset = header.nodesOffset + header.nNodes * sizeof(DirSnapshot::Node);
+	header.nCondFiles = (uint32_t)condFileRecs.size();
+	header.condFilesOffset = align4(header.namesOffset + header.namesSize);
+	header.nConditions = (uint32_t)conditionRecs.size();
+	header.conditionsOffset = header.condFilesOffset + header.nCondFiles * sizeof(CondFile);
+	header.nArgs = (uint32_t)argRecs.size();
+	header.argsOffset = header.conditionsOffset + header.nConditions * sizeof(Condition);
+	header.stringsSize = (uint32_t)strings.data.size();
+	header.stringsOffset = header.argsOffset + header.nArgs * sizeof(Arg);
+
+	std::string image(header.stringsOffset + header.stringsSize, '\0');
+	char* p = &image[0];
+	memcpy(p, &header, sizeof(header));
+	if (header.nNodes)
+	{
+		memcpy(p + header.nodesOffset, darTree.nodeData(),
+			   header.nNodes * sizeof(DirSnapshot::Node));
+	}
+	if (header.namesSize)
+	{
+		memcpy(p + header.namesOffset, darTree.nameData(), header.namesSize);
+	}
+	if (header.nCondFiles)
+	{
+		memcpy(p + header.condFilesOffset, condFileRecs.data(),
+			   header.nCondFiles * sizeof(CondFile));
+	}
+	if (header.nConditions)
+	{
+		memcpy(p + header.conditionsOffset, conditionRecs.data(),
+			   header.nConditions * sizeof(Condition));
+	}
+	if (header.nArgs)
+	{
+		memcpy(p + header.argsOffset, argRecs.data(), header.nArgs * sizeof(Arg));
+	}
+	memcpy(p + header.stringsOffset, strings.data.data(), header.stringsSize);
+
+	FILE* f = fopen(path.c_str(), "wb");
+	if (!f)
+	{
+		return false;
+	}
+	bool bOK = fwrite(image.data(), 1, image.size(), f) == image.size();
+	return (fclose(f) == 0) && bOK;
+}
+
+bool DARBundle::mapFile(const std::string& path)
+{
+#ifdef _WIN32
+	HANDLE hFileToMap = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		                            NULL, OPEN_EXISTING,
+		                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		                            NULL);
+	if (hFileToMap == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	hFile = hFileToMap;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFileToMap, &fileSize) || fileSize.QuadPart == 0
+		|| fileSize.QuadPart > 0xFFFFFFFF)
+	{
+		openError = "bad file size";
+		return false;
+	}
+	hMapping = CreateFileMappingA(hFileToMap, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!hMapping)
+	{
+		openError = "couldn't map file";
+		return false;
+	}
+	pMap = (const char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!pMap)
+	{
+		openError = "couldn't map file";
+		return false;
+	}
+	mapSize = (size_t)fileSize.QuadPart;
+#else
+	// The DAR code builds its paths with backslashes.
+	std::string localPath = path;
+	for (auto& ch : localPath)
+	{
+		if (ch == '\\')
+		{
+			ch = '/';
+		}
+	}
+	int fd = ::open(localPath.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0 || st.st_size > 0xFFFFFFFF)
+	{
+		::close(fd);
+		openError = "bad file size";
+		return false;
+	}
+	void* pMapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (pMapped == MAP_FAILED)
+	{
+		openError = "couldn't map file";
+		return false;
+	}
+	pMap = (const char*)pMapped;
+	mapSize = (size_t)st.st_size;
+#endif
+	return true;
+}
+
+void DARBundle::close()
+{
+	darTree.clear();
+	condFileByPriority.clear();
+#ifdef _WIN32
+	if (pMap)
+	{
+		UnmapViewOfFile(pMap);
+	}
+	if (hMapping)
+	{
+		CloseHandle(hMapping);
+	}
+	if (hFile)
+	{
+		CloseHandle(hFile);
+	}
+	hMapping = NULL;
+	hFile = NULL;
+#else
+	if (pMap)
+	{
+		munmap((void*)pMap, mapSize);
+	}
+#endif
+	pMap = NULL;
+	mapSize = 0;
+}
+
+bool DARBundle::open(const std::string& path, const std::string& darDir)
+{
+	close();
+	openError = NULL;
+	if (!mapFile(path))
+	{
+		close();
+		return false;
+	}
+	if (!validate())
+	{
+		close();
+		return false;
+	}
+
+	const Header& header = *(const Header*)pMap;
+	if (!darTree.attach(darDir,
+		                (const DirSnapshot::Node*)(pMap + header.nodesOffset), header.nNodes,
+		                pMap + header.namesOffset, header.namesSize))
+	{
+		openError = "bad folder tree";
+		close();
+		return false;
+	}
+
+	const CondFile* condFileRecs = (const CondFile*)(pMap + header.condFilesOffset);
+	const char* strings = pMap + header.stringsOffset;
+	for (uint32_t i = 0; i < header.nCondFiles; ++i)
+	{
+		std::string_view priority(strings + condFileRecs[i].priority.offset,
+			                      condFileRecs[i].priority.length);
+		condFileByPriority.emplace(priority, i);
+	}
+	return true;
+}
+
+bool DARBundle::validate()
+{
+	// ====================================================================
+	//                            validate
+	// --------------------------------------------------------------------
+	// Checks that every section, record and string lies within the
+	// mapping, so nothing after this needs to.
+	// ====================================================================
+	if (mapSize < sizeof(Header))
+	{
+		openError = "truncated";
+		return false;
+	}
+	const Header& header = *(const Header*)pMap;
+	if (memcmp(header.magic, kMagic, sizeof(kMagic)))
+	{
+		openError = "not a DAR bundle";
+		return false;
+	}
+	if (header.version != kVersion)
+	{
+		openError = "wrong version (rebuild it with the matching darbundle)";
+		return false;
+	}
+
+	auto sectionOK = [&](uint32_t offset, uint64_t count, size_t recSize)
+	{
+		return offset % 4 == 0 && offset >= sizeof(Header)
+			&& offset + count * recSize <= mapSize;
+	};
+	if (!sectionOK(header.nodesOffset, header.nNodes, sizeof(DirSnapshot::Node))
+		|| !(header.namesOffset + (uint64_t)header.namesSize <= mapSize)
+		|| !sectionOK(header.condFilesOffset, header.nCondFiles, sizeof(CondFile))
+		|| !sectionOK(header.conditionsOffset, header.nConditions, sizeof(Condition))
+		|| !sectionOK(header.argsOffset, header.nArgs, sizeof(Arg))
+		|| !(header.stringsOffset + (uint64_t)header.stringsSize <= mapSize))
+	{
+		openError = "bad section table";
+		return false;
+	}
+
+	auto strOK = [&](const StrRef& ref)
+	{
+		return (uint64_t)ref.offset + ref.length <= header.stringsSize;
+	};
+	const CondFile* condFileRecs = (const CondFile*)(pMap + header.condFilesOffset);
+	const Condition* conditionRecs = (const Condition*)(pMap + header.conditionsOffset);
+	const Arg* argRecs = (const Arg*)(pMap + header.argsOffset);
+	for (uint32_t i = 0; i < header.nCondFiles; ++i)
+	{
+		const CondFile& condFile = condFileRecs[i];
+		if (!strOK(condFile.priority) || !strOK(condFile.syntaxErrorLine)
+			|| (uint64_t)condFile.firstCondition + condFile.nConditions > header.nConditions
+			|| (uint64_t)condFile.firstArg + condFile.nArgs > header.nArgs)
+		{
+			openError = "bad conditions";
+			return false;
+		}
+		for (uint32_t j = 0; j < condFile.nConditions; ++j)
+		{
+			const Condition& condition = conditionRecs[condFile.firstCondition + j];
+			if (!strOK(condition.line) || !strOK(condition.funcName)
+				|| (uint64_t)condition.firstArg + condition.nArgs > condFile.nArgs)
+			{
+				openError = "bad conditions";
+				return false;
+			}
+		}
+	}
+	for (uint32_t i = 0; i < header.nArgs; ++i)
+	{
+		if (!strOK(argRecs[i].modName))
+		{
+			openError = "bad conditions";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool DARBundle::getConditions(const std::string& sPriority,
+	                          ParsedConditions& parsed_out) const
+{
+	auto it = condFileByPriority.find(sPriority);
+	if (it == condFileByPriority.end())
+	{
+		return false;
+	}
+
+	const Header& header = *(const Header*)pMap;
+	const CondFile& condFile =
+		((const CondFile*)(pMap + header.condFilesOffset))[it->second];
+	const Condition* conditionRecs =
+		(const Condition*)(pMap + header.conditionsOffset) + condFile.firstCondition;
+	const Arg* argRecs = (const Arg*)(pMap + header.argsOffset) + condFile.firstArg;
+	const char* strings = pMap + header.stringsOffset;
+	auto str = [strings](const StrRef& ref)
+	{
+		return std::string_view(strings + ref.offset, ref.length);
+	};
+
+	parsed_out.clear();
+	parsed_out.syntaxErrorLine = str(condFile.syntaxErrorLine);
+	parsed_out.conditions.resize(condFile.nConditions);
+	for (uint32_t i = 0; i < condFile.nConditions; ++i)
+	{
+		const Condition& conditionRec = conditionRecs[i];
+		ParsedCondition& condition = parsed_out.conditions[i];
+		condition.line = str(conditionRec.line);
+		condition.funcName = str(conditionRec.funcName);
+		condition.firstArg = conditionRec.firstArg;
+		condition.nArgs = conditionRec.nArgs;
+		condition.bNot = (conditionRec.flags & kCondition_Not) != 0;
+		condition.bAnd = (conditionRec.flags & kCondition_And) != 0;
+		condition.bBlankArgs = (conditionRec.flags & kCondition_BlankArgs) != 0;
+	}
+	parsed_out.args.resize(condFile.nArgs);
+	for (uint32_t i = 0; i < condFile.nArgs; ++i)
+	{
+		const Arg& argRec = argRecs[i];
+		ParsedConditionArg& arg = parsed_out.args[i];
+		arg.modName = str(argRec.modName);
+		arg.formBaseID = argRec.formBaseID;
+		arg.fVal = argRec.fVal;
+		arg.bIsFormID = argRec.bIsFormID != 0;
+	}
+	return true;
+}
\ No newline at end of file
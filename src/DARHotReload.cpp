@@ -0,0 +1,190 @@
+// ============================================================================
+//                             DARHotReload.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "DARHotReload.h"
+#include "DARProjectRegistry.h"
+#include "DirWatcher.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace DARGH
+{
+	// A project's changes are applied once its folder has been quiet for
+	// this long (saving a file, or copying in a folder of them, is often
+	// several changes in quick succession).
+	static const std::chrono::milliseconds kSettleTime(300);
+
+	struct WatchedProject
+	{
+		DARProject*                 darProj;
+		std::unique_ptr<DirWatcher> watcher;
+	};
+
+	static bool s_bHotReload = false;
+	static SpinLock s_watchedLock;
+	static std::vector<WatchedProject> s_watched;    // never shrinks
+
+	static std::string toLower(const std::string& s)
+	{
+		std::string lower(s);
+		std::transform(lower.begin(), lower.end(), lower.begin(),
+			           [](unsigned char ch) { return (char)tolower(ch); });
+		return lower;
+	}
+
+	void foldersToReload(const std::vector<std::string>& changedPaths,
+		                 std::vector<std::string>& folders_out)
+	{
+		// ====================================================================
+		//                          foldersToReload
+		// --------------------------------------------------------------------
+		// Each link comes from one of:
+		// 
+		//     _CustomConditions\<Priority>\...           (M2)
+		//     <esp name>\<actor base id>\...              (M1)
+		// 
+		// so a change anywhere below one of those folders needs just that
+		// folder reloaded. A change to an esp folder itself (e.g. it was
+		// renamed) needs all of its actor base folders reloaded, and a
+		// change to _CustomConditions itself, or one we couldn't pin down,
+		// needs everything reloaded.
+		// ====================================================================
+		std::vector<std::pair<std::string, std::string>> folders;    // (lower case, as is)
+		for (auto& path : changedPaths)
+		{
+			size_t posSep1 = path.find('\\');
+			std::string first = path.substr(0, posSep1);
+			std::string folder;
+			if (first.empty())
+			{
+				folder = "";
+			}
+			else if (posSep1 == std::string::npos)
+			{
+				folder = (toLower(first) == "_customconditions") ? "" : first;
+			}
+			else
+			{
+				size_t posSep2 = path.find('\\', posSep1 + 1);
+				folder = path.substr(0, posSep2);
+			}
+			folders.emplace_back(toLower(folder), folder);
+		}
+
+		// In order, a folder comes after any that contain it.
+		std::sort(folders.begin(), folders.end());
+		std::vector<std::string> kept;    // lower case
+		for (auto& folder : folders)
+		{
+			bool bCovered = false;
+			for (auto& keptFolder : kept)
+			{
+				bCovered = keptFolder.empty()
+					|| folder.first == keptFolder
+					|| folder.first.compare(0, keptFolder.size() + 1, keptFolder + "\\") == 0;
+				if (bCovered)
+				{
+					break;
+				}
+			}
+			if (!bCovered)
+			{
+				folders_out.push_back(folder.second);
+				kept.push_back(folder.first);
+			}
+		}
+	}
+
+	static void hotReloadThread()
+	{
+		std::vector<std::pair<DARProject*, DirWatcher*>> watched;
+		std::vector<std::string> changedPaths;
+		std::vector<std::string> folders;
+		while (true)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			{
+				std::lock_guard<SpinLock> guard(s_watchedLock);
+				watched.clear();
+				for (auto& entry : s_watched)
+				{
+					watched.emplace_back(entry.darProj, entry.watcher.get());
+				}
+			}
+
+			// Reload the folders that have changed in each project, once
+			// the changes have settled.
+			auto now = std::chrono::steady_clock::now();
+			for (auto& entry : watched)
+			{
+				changedPaths.clear();
+				if (now - entry.second->lastChangeTime() < kSettleTime
+					|| !entry.second->takeChanges(changedPaths))
+				{
+					continue;
+				}
+				folders.clear();
+				foldersToReload(changedPaths, folders);
+				_MESSAGE("%s: %d changes in DynamicAnimationReplacer, reloading %d folders",
+					     entry.first->projFolder.c_str(), (int)changedPaths.size(),
+					     (int)folders.size());
+				reloadDARMaps(*entry.first, folders);
+			}
+		}
+	}
+
+	void startDARHotReload()
+	{
+		if (s_bHotReload)
+		{
+			return;
+		}
+		s_bHotReload = true;
+		std::thread(hotReloadThread).detach();
+		_MESSAGE("hot reloading of DAR folders is on");
+	}
+
+	void watchDARProject(DARProject& darProj, const std::string& darDir)
+	{
+		if (!s_bHotReload)
+		{
+			return;
+		}
+		std::unique_ptr<DirWatcher> watcher(new DirWatcher);
+		if (!watcher->start(darDir))
+		{
+			// Nothing to watch (yet). N.B. we don't notice a DAR folder
+			// being created from scratch.
+			return;
+		}
+		std::lock_guard<SpinLock> guard(s_watchedLock);
+		s_watched.push_back(WatchedProject{ &darProj, std::move(watcher) });
+	}
+}
\ No newline at end of file
@@ -26,13 +26,14 @@
 // (The MIT License)
 // ============================================================================
 #include "DARProject.h"
+#include "ConditionsParser.h"
 #include "Utilities.h"
 #include "Conditions.h"
+#include "GameState.h"
+#include "WorldState.h"
 
-#include "RE/T/TESFile.h"
-
-#include <fstream>
 #include <algorithm>
+#include <charconv>
 
 // Turn this on if you want to trace & debug DAR data loading.
 //#define DEBUG_TRACE_DAR_LOADING
@@ -56,9 +57,103 @@ struct modNameActorBaseId
 	uint32_t modIndex = 0;
 };
 
+DARLinkIndex::~DARLinkIndex()
+{
+	// (Only once no graph can be using it: see DARGH::findLinkIndex.)
+	for (auto& entry : allLinks)
+	{
+		for (auto& priorityLink : entry.second.byPriority)
+		{
+			delete priorityLink.second;
+		}
+	}
+}
+
 namespace DARGH
 {
-	hkInt16 getNewAnimIndex(DARProject* darProj,
+	std::shared_ptr<const DARLinkIndex> findLinkIndex(DARProject& darProj, const void* names,
+		                                              uint32_t nNames)
+	{
+		// (The size is checked as well in case the game freed one of our
+		// arrays and the memory went to some other array.)
+		std::shared_ptr<const DARLinkIndex> linkIndex;
+		if (!darProj.linkIndexes.find(names, linkIndex) || linkIndex->nNames != nNames)
+		{
+			return NULL;
+		}
+		return linkIndex;
+	}
+
+	// The (actor, project) pairs whose likely replacements have been
+	// prefetched: (actor form ID << 32) | project ID.
+	static ShardedHashMap<uint64_t, bool> s_prefetchedFor;
+	static std::atomic<size_t> s_nPrefetchedFor{ 0 };
+	static const size_t kMaxPrefetchedFor = 16384;
+
+	void prefetchLikelyAnimations(const DARProject& darProj, const DARLinkIndex& linkIndex,
+		                          Actor* actor)
+	{
+		uint64_t key = ((uint64_t)g_gameState->actorID(actor) << 32) | darProj.id;
+		bool bFirst = false;
+		s_prefetchedFor.findOrInsert(key, [] { return true; }, &bFirst);
+		if (!bFirst)
+		{
+			return;
+		}
+		if (++s_nPrefetchedFor > kMaxPrefetchedFor)
+		{
+			// (Actors seen long ago just get their files requested again,
+			// which the prefetcher mostly turns away as recently read.)
+			s_prefetchedFor.clear();
+			s_nPrefetchedFor = 0;
+		}
+
+		if (linkIndex.likelyLinks.empty())
+		{
+			return;
+		}
+		ActorProfile profile;
+		readActorProfile(actor, profile);
+		for (auto& likely : linkIndex.likelyLinks)
+		{
+			if (likely.matches(profile))
+			{
+				g_animPrefetcher.request(likely.path);
+			}
+		}
+	}
+
+	static hkInt16 applyLinks(const AnimLinks& animLinks, const LinkContext& context)
+	{
+		// Returns the index from the first link (in priority order) whose
+		// conditions hold, or -1 if none do.
+		hkInt16 to_hkx_index;
+		for (auto& link : animLinks.byPriority)
+		{
+#ifdef DEBUG_TRACE_CONDITION_EVAL
+			_MESSAGE("getNewAnimIndex: apply map with priority %d...?",
+				link.first);
+#endif
+			auto& link_dat = link.second;
+			to_hkx_index = link_dat->getNewAnimIndex(context);
+			if (to_hkx_index != -1)
+			{
+#ifdef DEBUG_TRACE_CONDITION_EVAL
+				_MESSAGE("  => yes, new anim index = %d", to_hkx_index);
+#endif
+				return to_hkx_index;
+			}
+#ifdef DEBUG_TRACE_CONDITION_EVAL
+			_MESSAGE("  => no");
+#endif
+		}
+#ifdef DEBUG_TRACE_CONDITION_EVAL
+		_MESSAGE(" => no applicable mappings.");
+#endif
+		return -1;
+	}
+
+	hkInt16 getNewAnimIndex(DARProject* darProj, const DARLinkIndex& linkIndex,
 		                    hkInt16 from_hkx_index, Actor* actor)
 	{
 		// ====================================================================
@@ -72,16 +167,22 @@ namespace DARGH
 		// mapping that doesn't return -1 and returns that index. If no
 		// mappings found or they all return -1, returns -1.
 		// ====================================================================
-		hkInt16 to_hkx_index;
 
 		// Try to find the orig index.
-		auto& search = darProj->allLinks.find(from_hkx_index);
-		if (search == darProj->allLinks.end())
+		auto search = linkIndex.allLinks.find(from_hkx_index);
+		if (search == linkIndex.allLinks.end())
 		{
 			// Not found
 			return -1;
 		}
 
+		// The first time we see the actor using this project's replacements,
+		// get the files it's likely to want next read in the background.
+		if (g_animPrefetcher.isRunning())
+		{
+			prefetchLikelyAnimations(*darProj, linkIndex, actor);
+		}
+
 		// Found it. Now return the new animation index of the first link
 		// data item in that map (over which we iterate in order from higher
 		// priority number to lower priority), that returns a valid index.
@@ -89,40 +190,68 @@ namespace DARGH
 		_MESSAGE("getNewAnimIndex: found potential mapping(s) for index %d",
 			from_hkx_index);
 #endif
-		std::map<int, LinkData*, std::greater<int>> all_links = search->second;
-		for (auto& link : all_links)
+		// Extract the features that the links' conditions read, once for all
+		// of them.
+		const AnimLinks& animLinks = search->second;
+		const FeatureLayout& layout = animLinks.features;
+		std::shared_ptr<const WorldSnapshot> world;
+		if (layout.hasWorldFeatures())
 		{
-#ifdef DEBUG_TRACE_CONDITION_EVAL
-			_MESSAGE("getNewAnimIndex: apply map with priority %d...?",
-				link.first);
-#endif
-			auto& link_dat = link.second;
-			to_hkx_index = link_dat->getNewAnimIndex(actor);
-			if (to_hkx_index != -1)
+			world = g_worldState.get();
+		}
+
+		// Start from what the actor's last activation of this animation
+		// found (see ConditionCache), if nobody else is using that right now.
+		// Not for the player, whose base record RaceMenu edits in place.
+		uint32_t actorID = g_gameState->actorID(actor);
+		uint32_t baseFormID = g_gameState->readFormID(FeatureKey{ FeatureKind::kActorBase, 0, 0 }, actor);
+		std::shared_ptr<ConditionCache::Entry> cached;
+		if (baseFormID && !g_gameState->isPlayer(actor))
+		{
+			cached = g_conditionCache.get(actorID, layout.id);
+			if (!cached->lock.try_lock())
 			{
-#ifdef DEBUG_TRACE_CONDITION_EVAL
-				_MESSAGE("  => yes, new anim index = %d", to_hkx_index);
-#endif
-				return to_hkx_index;
+				cached.reset();
 			}
-#ifdef DEBUG_TRACE_CONDITION_EVAL
-			_MESSAGE("  => no");
-#endif
 		}
-#ifdef DEBUG_TRACE_CONDITION_EVAL
-		_MESSAGE(" => no applicable mappings.");
-#endif
-		return -1;
+
+		hkInt16 new_hkx_index = -1;
+		if (cached)
+		{
+			if (cached->baseFormID != baseFormID
+				|| cached->stamps.size() != layout.nPrograms)
+			{
+				cached->reset(baseFormID, layout);
+			}
+			ActorObservation observed;
+			observeActor(actor, observed);
+			uint32_t readScopes = cached->beginActivation(actorID, observed,
+				                                          g_conditionEvents);
+			extractFeatures(layout, actor, world.get(), readScopes, cached->features);
+			new_hkx_index = applyLinks(animLinks,
+				                       LinkContext{ cached->features, world.get(), cached.get(), baseFormID });
+			cached->lock.unlock();
+		}
+		else
+		{
+			// (Reusing this thread's buffers.)
+			static thread_local FeatureVector features;
+			extractFeatures(layout, actor, world.get(), ~0u, features);
+			new_hkx_index = applyLinks(animLinks,
+				                       LinkContext{ features, world.get(), NULL, baseFormID });
+		}
+		return new_hkx_index;
 	}
 
-	void loadDARMaps_ActorBase(DARProject& darProj,
-		                       TESDataHandler* dh, std::string darDir)
+	void loadDARMaps_ActorBase(const DARProject& darProj, const LoadOrderIndex& loadOrder,
+		                       const DirSnapshot& darTree, DARLinkTable& links_out,
+		                       ProjectLoadTimes* times)
 	{
 		// ====================================================================
 		//            METHOD 1: Assignment depending on ActorBase
 		// --------------------------------------------------------------------
 		// Loads all valid DAR M1 animation file links for the given project.
-		// This data is loaded into darProj.actorBaseLinks.
+		// This data is loaded into links_out.actorBaseLinks.
 		// 
 		// Method 1 description from the DAR documentation:
 		// 
@@ -143,8 +272,7 @@ namespace DARGH
 
 		// Get (esp name) subfolders.
 		std::vector<std::string> modNames;
-		if (!findMatchingFiles(darDir, modNames, 0, 0,
-			                   std::string(""), std::string("")))
+		if (!darTree.listSubdirs(darTree.root(), modNames))
 		{
 			_WARNING("couldn't find %s\\animations\\DynamicAnimationReplacer",
 				      darProj.projFolder.c_str());
@@ -166,7 +294,7 @@ namespace DARGH
 			}
 
 			// Ok, this is an ESP, ESM or ESL. Is it active?
-			const TESFile* modinfo = LookupModByName(dh, modName.c_str());
+			const LoadOrderIndex::Mod* modinfo = loadOrder.find(modName);
 			if (!modinfo)
 			{
 				// WARNING: The mod is not active. Don't load the mappings.
@@ -177,10 +305,8 @@ namespace DARGH
 			// Yes mod is active. Store (mod_name, index) tuple in modInfoMap,
 			// as information we'll later use to recreate the complete form ID.
 			modIndexAndIsESL modDat;
-			modDat.isESL = ((modinfo->recordFlags & 0x200) != 0);
-			modDat.modIndex =
-				(modinfo->compileIndex << 24) + 
-				(modinfo->smallFileCompileIndex << 12);
+			modDat.isESL = modinfo->isESL;
+			modDat.modIndex = modinfo->formIDBase();
 			modInfoMap.insert(
 				std::pair<std::string, modIndexAndIsESL>(modName, modDat)
 			);
@@ -190,15 +316,14 @@ namespace DARGH
 		// modInfoMap and find their (actor base id) subfolders.
 		for (auto& modInfo : modInfoMap)
 		{
-			std::string espDir = darDir + "\\" + modInfo.first;
+			uint32_t espDir = darTree.childDir(darTree.root(), modInfo.first);
 			// ... i.e.:
 			//     "data\meshes\actors\(project folder)\animations\
 			//      DynamicAnimationReplacer\(esp name)"
 
 			// Get the (actor base id) subfolders.
 			std::vector<std::string> sActorBaseIDs;
-			findMatchingFiles(espDir, sActorBaseIDs, 0, 0,
-				              std::string(""), std::string(""));
+			darTree.listSubdirs(espDir, sActorBaseIDs);
 			std::unordered_map<std::string, modNameActorBaseId> mActorBaseIDs;
 			for (auto& sActorBaseID : sActorBaseIDs)
 			{
@@ -234,8 +359,17 @@ namespace DARGH
 				//   https://en.uesp.net/wiki/Skyrim:Form_ID and
 				//   https://skyrim.fandom.com/wiki/ID
 				// ------------------------------------------------------------
-				std::string strHex = "0x" + sActorBaseID;
-				uint32_t iActorBaseID = std::stoi(strHex, nullptr, 0);
+				// (Loading may run on the warming thread, where stoi's
+				// exceptions would end the game: from_chars can't throw.)
+				uint32_t iActorBaseID = 0;
+				const char* pLast = sActorBaseID.data() + sActorBaseID.size();
+				auto result = std::from_chars(sActorBaseID.data(), pLast, iActorBaseID, 16);
+				if (result.ec != std::errc() || result.ptr != pLast)
+				{
+					// *** USER ERROR ***
+					// Not a hex number.
+					continue;    // Skip to next (actor base id) subfolder.
+				}
 
 				if (iActorBaseID <= 0xFFFFFF)
 				{
@@ -256,13 +390,16 @@ namespace DARGH
 			// valid actor base directories (and their subdirectories, if any).
 			for (auto& mActorBaseID : mActorBaseIDs)
 			{
-				std::string actorBaseDir = espDir + "\\" + mActorBaseID.first;
+				uint32_t actorBaseDir = darTree.childDir(espDir, mActorBaseID.first);
 				// ... i.e. looks like:
 				//     "data\meshes\actors\(project folder)\animations\
 				//      DynamicAnimationReplacer\(esp name)\(actor base id)"
 				std::vector<std::string> hkxFiles;
-				findMatchingFiles(actorBaseDir, hkxFiles, 1, 1,
-					              std::string(".hkx"), std::string(""));
+				darTree.findFiles(actorBaseDir, std::string(".hkx"), hkxFiles);
+				if (times)
+				{
+					times->nActorBaseFiles += (uint32_t)hkxFiles.size();
+				}
 				for (auto& hkxFile : hkxFiles)
 				{
 					std::string fromHkx = "Animations\\" + hkxFile;
@@ -294,17 +431,17 @@ namespace DARGH
 					//
 					// which is the complete form ID
 					ActorBaseLink actorBaseLink;
-					actorBaseLink.from_hkx_file = fromHkx;
-					actorBaseLink.to_hkx_file = toHkx;
+					actorBaseLink.from_hkx_file = g_pathTable.intern(fromHkx);
+					actorBaseLink.to_hkx_file = g_pathTable.intern(toHkx);
 					actorBaseLink.actorBaseID =
 						mActorBaseID.second.modIndex +
 						mActorBaseID.second.actorBaseID;
-					darProj.actorBaseLinks.push_back(actorBaseLink);
+					links_out.actorBaseLinks.push_back(actorBaseLink);
 
 #ifdef DEBUG_TRACE_DAR_LOADING
 					_MESSAGE("  M1: stored link: '%s' => '%s' (%d)",
-						     actorBaseLink.from_hkx_file.c_str(),
-						     actorBaseLink.to_hkx_file.c_str(),
+						     g_pathTable.str(actorBaseLink.from_hkx_file),
+						     g_pathTable.str(actorBaseLink.to_hkx_file),
 						     actorBaseLink.actorBaseID);
 #endif
 				}
@@ -312,14 +449,140 @@ namespace DARGH
 		}
 	}
 
-	void loadDARMaps_Conditional(DARProject& darProj,
-		                         TESDataHandler* dh, std::string darDir)
+	static bool bindConditions(const ParsedConditions& parsed, const LoadOrderIndex& loadOrder,
+		                       std::vector<ConditionLinkFunc>& conditions_out,
+		                       std::string_view& lineWithError_out)
+	{
+		// ====================================================================
+		//                         bindConditions
+		// --------------------------------------------------------------------
+		// The second (bind) pass over a _conditions.txt file, after the syntax
+		// pass in ConditionsParser.cpp: looks up each function, checks its
+		// argument count and which of its args may be floats, and resolves
+		// each "esp name" | formID against the load order. Returns false, with
+		// 'lineWithError_out' set, on the first line with an error (taking a
+		// syntax error as coming after all the lines before it).
+		// ====================================================================
+		std::string funcName;
+		for (auto& parsedCondition : parsed.conditions)
+		{
+			// Look up the function from the name.
+			funcName.assign(parsedCondition.funcName);
+			auto funcInfoPair = g_DARConditionFuncs.find(funcName);
+			if (funcInfoPair == g_DARConditionFuncs.end())
+			{
+				// *** USER ERROR ***
+				// Specified function name was not found (see Conditions.cpp).
+				lineWithError_out = parsedCondition.line;
+				return false;
+			}
+			if (parsedCondition.bBlankArgs)
+			{
+				// As in DAR, "Function( )" is dropped without further checks.
+				continue;
+			}
+			if (parsedCondition.nArgs != funcInfoPair->second.nArgs)
+			{
+				// *** USER ERROR ***
+				// User hasn't provided the required number of arguments
+				// for the specified function.
+				lineWithError_out = parsedCondition.line;
+				return false;
+			}
+
+			ConditionLinkFunc condition;
+			condition.funcId = funcInfoPair->second.funcId;
+			bool bESPNotLoaded = false;
+			for (uint32_t i = 0; i < parsedCondition.nArgs; ++i)
+			{
+				const ParsedConditionArg& arg = parsed.args[parsedCondition.firstArg + i];
+				if (arg.bIsFormID)
+				{
+					// Is the mod active?
+					uint32_t modIndex = 0;
+					bool bIsESL = false;
+					const LoadOrderIndex::Mod* modinfo = loadOrder.find(arg.modName);
+					if (!modinfo)
+					{
+						// Mod is not active.
+						// *DON'T* fail... these cases actually do still get
+						// added to the conditions list, with a special flag.
+						_WARNING("esp file not loaded: %.*s",
+							     (int)arg.modName.size(), arg.modName.data());
+						bESPNotLoaded = true;
+					}
+					else
+					{
+						bIsESL = modinfo->isESL;
+						modIndex = modinfo->formIDBase();
+					}
+
+					// Ensure that the supplied base ID is valid, depending on
+					// whether the given mod is light or not: .esl mods take
+					// (at most) yyy, .esp / .esm mods yyyyyy (see the note on
+					// form ID reconstruction above).
+					if (arg.formBaseID > (bIsESL ? 0xFFFu : 0xFFFFFFu))
+					{
+						// *** USER ERROR ***
+						// User hasn't provided a valid base form ID
+						// for the given mod type (ESL or non-ESL).
+						lineWithError_out = parsedCondition.line;
+						return false;
+					}
+					condition.args[i].formID = modIndex + arg.formBaseID;
+					if (!bESPNotLoaded && (funcInfoPair->second.bmArgIsFloat & (1 << i)))
+					{
+						// A GlobalVariable: keep a pointer to it, rather than
+						// looking it up by form ID every time it's read. (If
+						// there's no such global the condition is just false,
+						// as in DAR.)
+						condition.args[i].global = g_gameState->lookupGlobal(condition.args[i].formID);
+					}
+				}
+				else
+				{
+					// Check the actual arg type against the expected arg
+					// mask in 'funcInfoPair'. This mask has the corresponding
+					// bit set when the argument can be a float (args can
+					// always be specified as formIds).
+					uint32_t flagArgIsFloat = 1 << i;
+					if ((flagArgIsFloat & funcInfoPair->second.bmArgIsFloat) == 0)
+					{
+						// *** USER ERROR ***
+						// This arg in the corresponding function must be
+						// a form ID.
+						lineWithError_out = parsedCondition.line;
+						return false;
+					}
+					condition.args[i].fVal = arg.fVal;
+					condition.args[i].bIsFloat = true;
+				}
+			}
+
+			// All validation checks passed - store the condition data.
+			condition.bNot = parsedCondition.bNot;
+			condition.bAnd = parsedCondition.bAnd;
+			condition.bESPNotLoaded = bESPNotLoaded;
+			conditions_out.push_back(std::move(condition));
+		}
+		if (!parsed.syntaxErrorLine.empty())
+		{
+			lineWithError_out = parsed.syntaxErrorLine;
+			return false;
+		}
+		return true;
+	}
+
+	void loadDARMaps_Conditional(const DARProject& darProj, const LoadOrderIndex& loadOrder,
+		                         const DirSnapshot& darTree, const DARBundle* darBundle,
+		                         const DARArchives* darArchives, DARLinkTable& links_out,
+		                         ProjectLoadTimes* times)
 	{
 		// ====================================================================
 		//         METHOD 2: Assignment depending on custom conditions
 		// --------------------------------------------------------------------
 		// Loads all valid DAR M2 animation file links for the given project.
-		// The data is loaded into darProj.conditionLinks.
+		// The data is loaded into links_out.conditionLinks.
 		// 
 		// Method 2 description from the DAR documentation:
 		// 
@@ -373,7 +636,7 @@ namespace DARGH
 		//     (A || B) && C
 		//      = A || B && C                                                 "
 		// ====================================================================
-		std::string customCondDir = darDir + "\\" + "_CustomConditions";
+		uint32_t customCondDir = darTree.childDir(darTree.root(), "_CustomConditions");
 		// ... i.e:
 		//     "data\meshes\actors\(project folder)\animations\
 		//      DynamicAnimationReplacer\_CustomConditions"
@@ -382,14 +645,16 @@ namespace DARGH
 		//           Load data from each of the priority subfolders.
 		// --------------------------------------------------------------------
 		std::vector<std::string> sPriorities;
-		if (!findMatchingFiles(customCondDir, sPriorities, 0, 0,
-			std::string(""), std::string("")))
+		if (!darTree.listSubdirs(customCondDir, sPriorities))
 		{
 			// No subfolders found. No mappings to load for this project.
 			return;
 		}
 
 		// We have at least one subfolder.
+		// (Each _conditions.txt is read into this buffer in turn.)
+		std::string condFileText;
+		ParsedConditions parsed;
 		for (auto& sPriority : sPriorities)
 		{
 			// Check that priority string is valid.
@@ -418,353 +683,78 @@ namespace DARGH
 				// As per spec, conditions with priority == 0 are ignored.
 				continue;    //  Skip to next priority subfolder.
 			}
-			std::string priorityDir = customCondDir + "\\" + sPriority;
+			uint32_t priorityDir = darTree.childDir(customCondDir, sPriority);
 			// ... i.e:
 			//     "data\meshes\actors\(project folder)\animations\
 			//      DynamicAnimationReplacer\_CustomConditions\(Priority)"
 
+			// Times the folder, however it's left.
+			struct FolderTimer
+			{
+				ProjectLoadTimes*         times;
+				const std::string&        priority;
+				StartupClock::time_point  start = StartupClock::now();
+				~FolderTimer()
+				{
+					if (times)
+					{
+						times->addFolder(priority, StartupClock::now() - start);
+					}
+				}
+			} folderTimer{ times, sPriority };
+
 			// ----------------------------------------------------------------
 			//                Parse the _conditions.txt file.
 			// ----------------------------------------------------------------
-			std::string condFilePath = priorityDir + "\\_conditions.txt";
-			std::ifstream fConditions;
-			fConditions.open(condFilePath);   // by default opens read-only
-			if (!fConditions.is_open())
+			// (Or rather take it ready parsed, if we have a bundle.)
+			bool bHaveConditions;
+			if (darBundle)
 			{
-				// *** WARNING ***
-				// Can't open the conditions file.
-				_WARNING("couldn't find %s\\animations\\DynamicAnimationReplacer\\_CustomConditions\\%s\\_conditions.txt",
-					darProj.projFolder.c_str(), sPriority);
-				continue;    //  Skip to next priority subfolder.
+				bHaveConditions = darBundle->getConditions(sPriority, parsed);
 			}
-
-			// Read lines of "_conditions.txt" file into our string vector.
-			std::vector<std::string> vLines;
-			std::string sLine;
-			while (std::getline(fConditions, sLine))
+			else
 			{
-				sLine = trim(sLine);
-				if (sLine.size() > 0 && sLine.at(0) != ';')
+				std::string condFilePath = darTree.rootPath() +
+					"\\_CustomConditions\\" + sPriority + "\\_conditions.txt";
+				bHaveConditions = readConditionsFile(condFilePath, condFileText);
+				if (!bHaveConditions && darArchives)
+				{
+					// Not a loose file; it may be in a BSA.
+					bHaveConditions = darArchives->readFile(
+						"meshes\\" + darProj.projFolder +
+						"\\animations\\DynamicAnimationReplacer\\_CustomConditions\\" +
+						sPriority + "\\_conditions.txt", condFileText);
+				}
+				if (bHaveConditions)
 				{
-					vLines.push_back(sLine);
+					parseConditionSyntax(condFileText, parsed);
 				}
 			}
-			fConditions.close();
+			if (!bHaveConditions)
+			{
+				// *** WARNING ***
+				// Can't open the conditions file.
+				_WARNING("couldn't find %s\\animations\\DynamicAnimationReplacer\\_CustomConditions\\%s\\_conditions.txt",
+					darProj.projFolder.c_str(), sPriority.c_str());
+				continue;    //  Skip to next priority subfolder.
+			}
 
-			// Process each line.
-			// Parsed results are stored in vFuncData.
-			// If parsing fails, this stores the line where it happened:
-			std::string lineWithError = "";
+			// Bind the conditions to their functions and mods.
+			// If that fails, this points at the line where it happened:
+			std::string_view lineWithError;
 			std::vector<ConditionLinkFunc> conditions;
-			for (int iLineNum = 0; iLineNum < vLines.size(); ++iLineNum)
+			bool bBound = bindConditions(parsed, loadOrder, conditions, lineWithError);
+			if (times)
 			{
-				std::string full_line = vLines.at(iLineNum);
-				std::string chomped_line = vLines.at(iLineNum);
-
-				bool bNot = false;
-				bool bAnd = true;
-				bool bESPNotLoaded = false;
-
-				// Does this line start with a "NOT"?
-				// Must have at least one trailing space or one trailing tab.
-				if (startsWith(chomped_line, "NOT ") ||
-					startsWith(chomped_line, "NOT\t"))
-				{
-					bNot = true;
-					chomped_line = chomped_line.substr(3);   // chomp
-				}
-
-				// Get the position of the opening bracket.
-				std::size_t posLB = chomped_line.find_first_of("(");
-				if (posLB == std::string::npos)
-				{
-					// *** USER ERROR ***
-					// There is no opening bracket on this line.
-					lineWithError.assign(full_line);
-					break;    //  Stop parsing conditions file.
-				}
-
-				// Get the function name.
-				// We assume this is all the text up to the opening bracket,
-				// with optional lead and trailing whitespace.
-				std::string funcName = chomped_line.substr(0, posLB);
-				funcName = trim(funcName);
-				std::size_t posRB = chomped_line.find_first_of(")");
-
-				// Look up the function address from the name.
-				auto& funcInfoPair = g_DARConditionFuncs.find(funcName);
-				if (funcInfoPair == g_DARConditionFuncs.end()
-					|| posRB == std::string::npos || posRB < posLB)
-				{
-					// *** USER ERROR ***
-					// Specified function name was not found
-					// (see Conditions.cpp), or there was a
-					// function name parsing error.
-					lineWithError.assign(full_line);
-					break;    //  Stop parsing conditions file.
-				}
-
-				if (posRB == chomped_line.size() - 1)
-				{
-					// Nothing after the closing bracket on this line.
-					if (iLineNum < vLines.size() - 1)
-					{
-						// *** USER ERROR ***
-						// There are no additional characters on this line
-						// after the ")", but there are still more lines
-						// in the file. Which means we don't know how to
-						// interpret those additional conditions (should they
-						// be ANDed or ORed to this one?)
-						lineWithError.assign(full_line);
-						funcName = "";
-						break;    //  Stop parsing conditions file.
-					}
-				}
-				else
-				{
-					// There are further characters after the ")".
-					// (could just be whitespace).
-					std::string rest =
-						chomped_line.substr(
-							posRB + 1,
-							chomped_line.size() - (posRB + 1)
-						);
-					rest = trim(rest);
-					if (rest.size() > 0)
-					{
-						// The further characters are not just whitespace.
-						if (startsWith(rest, "AND"))
-						{
-							bAnd = true;
-						}
-						else
-						{
-							if (!startsWith(rest, "OR"))
-							{
-								// *** USER ERROR ***
-								// The user has written non-whitespace
-								// characters at the end of this line with
-								// something other than "AND" or "OR".
-								lineWithError.assign(full_line);
-								break;    //  Stop parsing conditions file.
-							}
-							bAnd = false;
-						}
-					}
-					else if (iLineNum < vLines.size() - 1)
-					{
-						// *** USER ERROR ***
-						// The last few characters on this line are all
-						// whitespace, but there are still further lines
-						// in the file. Which means we don't know how to
-						// interpret those additional conditions (should
-						// they be ANDed or ORed to this one?)
-						lineWithError.assign(full_line);
-						break;    //  Stop parsing the conditions file.
-					}
-				}
-
-				// ------------------------------------------------------------
-				//                   Parse any arguments.
-				// ------------------------------------------------------------
-				// 'bmArgIsFloat' is a bitmask; if a bit is set it indicates
-				// that the corresponding arg is global variable or float.
-				std::vector<std::variant<uint32_t, float>> vArgs;
-				uint32_t bmArgIsFloat = 0;
-				if (posLB != posRB - 1)
-				{
-					// There is something between the brackets
-					// (presumably the arguments...)
-					std::string commaSepArgs =
-						chomped_line.substr(posLB + 1, posRB - (posLB + 1));
-					commaSepArgs = trim(commaSepArgs);
-					if (commaSepArgs.size() == 0)
-					{
-						// No arguments to process.
-						continue;    //  Skip to next priority subfolder.
-					}
-
-					// Parse the arguments.
-					std::vector<std::string> sArgs;
-					splitOnCommas(sArgs, commaSepArgs);
-					for (auto& sArg : sArgs)
-					{
-						sArg = trim(sArg);
-						if (sArg.size() == 0 || sArg.at(0) == '"')
-						{
-							// ------------------------------------------------
-							//    Argument should be "esp name" | formID
-							// ------------------------------------------------
-							// Note for newbies: Global variables are also 
-							// specified with formIDs. For more on formIDs and
-							// how to recreate them, see note earlier above.
-							// ------------------------------------------------
-							std::vector<std::string> sArgTokens;
-							splitOnPipes(sArgTokens, sArg);
-							if (sArgTokens.size() != 2)
-							{
-								// *** USER ERROR ***
-								// User hasn't specified exactly two items in
-								// the pipe-delimited list comprising this arg.
-								lineWithError.assign(full_line);
-								break;    //  Stop parsing arguments.
-							}
-
-							// ------------------------------------------------
-							//          Process token 1: "esp name".
-							// ------------------------------------------------
-							std::string espName = sArgTokens.at(0);
-							espName = trim(espName);
-
-							if (espName.size() <= 2 || espName.at(0) != '"'
-								|| espName.at(espName.size() - 1) != '"')
-							{
-								// *** USER ERROR ***
-								// User hasn't specified the mod name with the
-								// correct syntax ("<mod name>").
-								lineWithError.assign(full_line);
-								break;    //  Stop parsing arguments.
-							}
-
-							// Remove the surrounding quotes
-							espName = espName.substr(1, espName.size() - 2);
-							if (!endsWith(espName, ".esp") &&
-								!endsWith(espName, ".esm") &&
-								!endsWith(espName, ".esl"))
-							{
-								// *** USER ERROR ***
-								// User has provided an invalid mod name
-								// (doesn't end in extension ".esp", ".esm"
-								// or ".esl")
-								lineWithError.assign(full_line);
-								break;    //  Stop parsing arguments.
-							}
-
-							// Ok, this is an ESP, ESM or ESL. Is it active?
-							uint32_t modIndex = 0;
-							bool bIsESL = false;
-							const TESFile* modinfo =
-								LookupModByName(dh, espName.c_str());
-							if (!modinfo)
-							{
-								// Mod is not active.
-								// *DON'T* break... these cases actually do
-								// still get added to the conditions list,
-								// with a special flag.
-								_WARNING("esp file not loaded: %s",
-									     espName.c_str());
-								bESPNotLoaded = true;
-							}
-							else
-							{
-								bIsESL = ((modinfo->recordFlags & 0x200) != 0);
-								modIndex =
-									(modinfo->compileIndex << 24) +
-									(modinfo->smallFileCompileIndex << 12);
-							}
-
-							// ------------------------------------------------
-							//            Process token 2: form ID.
-							// ------------------------------------------------
-							std::string sFormBaseID = sArgTokens.at(1);
-							sFormBaseID = trim(sFormBaseID);
-							uint32_t iFormBaseID =
-								std::stoi(sFormBaseID, nullptr, 0);
-
-							// Ensure that the supplied actorBaseID is valid,
-							// depending on whether the given mod is light or
-							// not. If valid, add to our list.
-							bool bIsValidBaseID = false;
-							if (bIsESL)
-							{
-								// .esl (light mod):
-								// As said earlier, user should provide a valid
-								// hex string of no more than yyy digits.
-								bIsValidBaseID = (iFormBaseID <= 0xFFF);
-							}
-							else
-							{
-								// .esp or .esm:
-								// As said earlier, user should provide a valid
-								// hex string of no more than yyyyyyyy digits.
-								bIsValidBaseID = (iFormBaseID <= 0xFFFFFF);
-							}
-
-							if (!bIsValidBaseID)
-							{
-								// *** USER ERROR ***
-								// User hasn't provided a valid base form ID
-								// for the given mod type (ESL or non-ESL).
-								lineWithError.assign(full_line);
-								break;    //  Stop parsing the arguments.
-							}
-
-							// Append evaluated arg to the vector.
-							iFormBaseID = modIndex + iFormBaseID;
-							vArgs.push_back(iFormBaseID);
-						}
-						else
-						{
-							// ------------------------------------------------
-							//           Argument should be a float.
-							// ------------------------------------------------
-							uint32_t flagArgIsFloat = 1 << vArgs.size();
-							float fVal = std::stof(sArg);
-
-							// Check the actual arg type against the expected
-							// arg mask in 'funcInfoPair'. This mask has the
-							// corresponding bit set when the argument can be
-							// a float (args can always be specified as formIds,
-							// i.e. "esp name" | formID).
-							if ((flagArgIsFloat &
-								funcInfoPair->second.bmArgIsFloat) == 0
-								|| std::isnan(fVal))
-							{
-								// *** USER ERROR ***
-								// User has either provided a value that is NaN
-								// or their float value is valid, but this arg
-								// in the corresponding function must be a
-								// form ID.
-								lineWithError.assign(full_line);
-								break;    //  Stop parsing arguments.
-							}
-
-							// Record the arg type and append evaluated arg
-							// to the vector.
-							bmArgIsFloat |= flagArgIsFloat;
-							vArgs.push_back(fVal);
-						}
-					} // for (auto& sArg : vArgsAsStr)
-				} // if (posLB != posRB - 1)
-
-				if (vArgs.size() != funcInfoPair->second.nArgs)
-				{
-					// *** USER ERROR ***
-					// User hasn't provided the required number of arguments
-					// for the specified function.
-					lineWithError.assign(full_line);
-					break;    //  Stop parsing conditions file.
-				}
-
-				// All validation checks passed - store the condition data.
-				ConditionLinkFunc condition;
-				condition.funcPtr = funcInfoPair->second.funcPtr;
-				condition.bmArgIsFloat = bmArgIsFloat;
-				condition.args = vArgs;
-				condition.bNot = bNot;
-				condition.bAnd = bAnd;
-				condition.bESPNotLoaded = bESPNotLoaded;
-				conditions.push_back(condition);
-			}  // for (int i = 0; i < lines.size(); ++i)
-
-			// We've finished parsing the conditions file - did we have a
-			// parsing error?
-			if (lineWithError.size() > 0)
+				times->nConditionsFiles++;
+				times->parseTime += StartupClock::now() - folderTimer.start;
+			}
+			if (!bBound)
 			{
-				// Yes. Log the error and skip this conditions file.
+				// Log the error and skip this conditions file.
 				_ERROR("error: %s\\animations\\DynamicAnimationReplacer\\_CustomConditions\\%s\\_conditions.txt",
-					   darProj.projFolder.c_str(), sPriority);
-				_ERROR("   %s", lineWithError.c_str());
+					   darProj.projFolder.c_str(), sPriority.c_str());
+				_ERROR("   %.*s", (int)lineWithError.size(), lineWithError.data());
 				continue;    //  Skip to next priority subfolder.
 			}
 
@@ -772,8 +762,11 @@ namespace DARGH
 			// Find and store all the animation HKX mappings in the directory
 			// (including its sub-directories, if any).
 			std::vector<std::string> hkxFiles;
-			findMatchingFiles(priorityDir, hkxFiles, 1, 1,
-				              std::string(".hkx"), std::string(""));
+			darTree.findFiles(priorityDir, std::string(".hkx"), hkxFiles);
+			if (times)
+			{
+				times->nConditionalFiles += (uint32_t)hkxFiles.size();
+			}
 			for (auto& hkxFile : hkxFiles)
 			{
 				std::string fromHkx =
@@ -793,17 +786,17 @@ namespace DARGH
 				// not lower-cased, what to map TO.
 
 				ConditionLink conditionLink;
-				conditionLink.from_hkx_file = fromHkx;
-				conditionLink.to_hkx_file = toHkx;
+				conditionLink.from_hkx_file = g_pathTable.intern(fromHkx);
+				conditionLink.to_hkx_file = g_pathTable.intern(toHkx);
 				conditionLink.priority = iPriority;
 				conditionLink.conditions = conditions;
-				darProj.conditionLinks.push_back(conditionLink);
+				links_out.conditionLinks.push_back(conditionLink);
 
 				// Debug message:
 #ifdef DEBUG_TRACE_DAR_LOADING
 				_MESSAGE("  M2: stored link: '%s' => '%s' (priority: %d)",
-					     conditionLink.from_hkx_file.c_str(),
-					     conditionLink.to_hkx_file.c_str(),
+					     g_pathTable.str(conditionLink.from_hkx_file),
+					     g_pathTable.str(conditionLink.to_hkx_file),
 					     conditionLink.priority);
 #endif
 			} // for (auto& hkxFile : hkxFiles)		
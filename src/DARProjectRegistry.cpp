@@ -26,8 +26,12 @@
 // (The MIT License)
 // ============================================================================
 #include "DARProjectRegistry.h"
+#include "DARHotReload.h"
+#include "Utilities.h"
 
 #include <algorithm>
+#include <mutex>
+#include <thread>
 
 namespace DARGH
 {
@@ -80,20 +84,272 @@ namespace DARGH
 				           projFilePath.begin(), tolower);
 
 			// Only register a new project entry if there isn't already
-			// one there.
-			std::map<std::string, DARProject>::iterator it =
-				g_DARProjectRegistry.find(projFilePath);
-			if (it == g_DARProjectRegistry.end()) {
-				// Doesn't already exist in the map, so create and register
-				// a new entry.
-				DARProject darProj;
-				darProj.projFolder =
+			// one there. (Its DAR maps aren't loaded until it's first
+			// used; see ensureDARMapsLoaded.)
+			const auto [it, inserted] = g_DARProjectRegistry.try_emplace(projFilePath);
+			if (inserted) {
+				// Didn't already exist in the map, so fill in the new entry.
+				it->second.projFolder =
 					projFilePath.substr(0, projFilePath.find_last_of("\\"));
-				g_DARProjectRegistry.insert(
-					std::pair<std::string, DARProject>
-					(projFilePath, darProj)
-				);
+				it->second.id = (uint32_t)g_DARProjectRegistry.size();
+				g_memoryAccounts.setName(it->second.id, projFilePath);
 			}
 		}
 	}
-}
\ No newline at end of file
+
+	// What the loaders need, recorded by initDARLoading. (The loaders
+	// never touch the data handler.)
+	static std::string s_dataDir;
+	static LoadOrderIndex s_loadOrder;
+	static std::vector<std::string> s_archivePaths;    // in load order
+
+	// The DAR files in the load order's archives. Read by whichever thread
+	// loads the first project.
+	static DARArchives s_darArchives;
+	static std::once_flag s_darArchivesRead;
+
+	void initDARLoading(const std::string& dataDir, LoadOrderIndex loadOrder,
+		                std::vector<std::string> archivePaths)
+	{
+		s_dataDir = dataDir;
+		s_loadOrder = std::move(loadOrder);
+		s_archivePaths = std::move(archivePaths);
+		_MESSAGE("indexed %d plugins", (int)s_loadOrder.size());
+	}
+
+	static void readDARArchives()
+	{
+		// ====================================================================
+		//                          readDARArchives
+		// --------------------------------------------------------------------
+		// Collects the DAR files in each active plugin's "<plugin>.bsa",
+		// later plugins overriding earlier ones. (Loose files override them
+		// all.)
+		// ====================================================================
+		for (auto& archivePath : s_archivePaths)
+		{
+			if (!s_darArchives.addArchive(archivePath))
+			{
+				_WARNING("couldn't read %s", archivePath.c_str());
+			}
+		}
+		if (s_darArchives.numFiles())
+		{
+			_MESSAGE("found %d DAR files in %d archives",
+				     (int)s_darArchives.numFiles(), (int)s_darArchives.numArchives());
+		}
+	}
+
+	static bool loadDARMaps(const DARProject& darProj, const std::string& subDir,
+		                    DARLinkTable& links_out, ProjectLoadTimes* times = NULL)
+	{
+		// ====================================================================
+		//                            loadDARMaps
+		// --------------------------------------------------------------------
+		// Loads the DAR M1 and M2 links for 'darProj' into 'links_out': all
+		// of them, or if 'subDir' isn't empty, just those in that folder
+		// (relative to the project's DynamicAnimationReplacer folder, e.g.
+		// "_CustomConditions\100"). Returns true if they came from a
+		// bundle (which 'subDir' must then be empty for). Records how long
+		// each step took in 'times', if it isn't NULL.
+		// ====================================================================
+		std::string darDir_rel =
+			"meshes\\" + darProj.projFolder + "\\animations\\DynamicAnimationReplacer";
+		std::string darDir = s_dataDir + darDir_rel;
+		// ... i.e.
+		//     "data\meshes\actors\(project folder)\
+		//        animations\DynamicAnimationReplacer"
+
+		// If the project has a precompiled bundle, use that. Otherwise
+		// walk the project's DAR folder once; both loaders then query
+		// the snapshot rather than going back to the file system.
+		DARBundle darBundle;
+		DirSnapshot darTree;
+		StartupClock::time_point start = StartupClock::now();
+		const DirSnapshot* tree = &darTree;
+		bool bFromBundle = subDir.empty() && darBundle.open(darDir + ".darb", darDir);
+		if (bFromBundle)
+		{
+			_MESSAGE("%s: using DynamicAnimationReplacer.darb (%d KB)",
+				     darProj.projFolder.c_str(),
+				     (int)(darBundle.numBytes() / 1024));
+			tree = &darBundle.tree();
+		}
+		else
+		{
+			if (darBundle.error())
+			{
+				_WARNING("%s: ignoring DynamicAnimationReplacer.darb: %s",
+					     darProj.projFolder.c_str(), darBundle.error());
+			}
+			darTree.build(darDir, ".hkx", subDir);
+			s_darArchives.mergeInto(darDir_rel, darTree, subDir);
+		}
+		StartupClock::time_point treeEnd = StartupClock::now();
+		loadDARMaps_ActorBase(darProj, s_loadOrder, *tree, links_out, times);
+		StartupClock::time_point actorBaseEnd = StartupClock::now();
+		loadDARMaps_Conditional(darProj, s_loadOrder, *tree, bFromBundle ? &darBundle : NULL,
+			                    bFromBundle ? NULL : &s_darArchives, links_out, times);
+		if (times)
+		{
+			times->bFromBundle = bFromBundle;
+			times->treeTime += treeEnd - start;
+			times->actorBaseTime += actorBaseEnd - treeEnd;
+			times->conditionalTime += StartupClock::now() - actorBaseEnd;
+		}
+		return bFromBundle;
+	}
+
+	void ensureDARMapsLoaded(DARProject& darProj)
+	{
+		// ====================================================================
+		//                        ensureDARMapsLoaded
+		// --------------------------------------------------------------------
+		// DAR loaded the maps for every registered project at data load,
+		// including all the creature projects a session may never use. We
+		// load each one the first time the game generates its animations
+		// (or ahead of time, see warmDARProjects).
+		// ====================================================================
+		if (darProj.mapsLoaded.load(std::memory_order_acquire))
+		{
+			return;
+		}
+		std::lock_guard<SpinLock> guard(darProj.loadLock);
+		if (darProj.mapsLoaded.load(std::memory_order_relaxed))
+		{
+			return;    // another thread got there first
+		}
+		std::call_once(s_darArchivesRead, readDARArchives);
+		std::shared_ptr<DARLinkTable> links = std::make_shared<DARLinkTable>();
+		ProjectLoadTimes times;
+		times.project = darProj.projFolder;
+		bool bFromBundle = loadDARMaps(darProj, "", *links, &times);
+		_MESSAGE("%s: loaded %d actor base and %d conditional DAR links",
+			     darProj.projFolder.c_str(),
+			     (int)links->actorBaseLinks.size(), (int)links->conditionLinks.size());
+		times.report([](const char* line) { _MESSAGE("%s", line); });
+		links->account(darProj.id);
+		std::atomic_store(&darProj.links, std::shared_ptr<const DARLinkTable>(std::move(links)));
+		darProj.mapsLoaded.store(true, std::memory_order_release);
+
+		// Bundles are a snapshot of the folder by design, so only watch
+		// projects loaded from the folder itself.
+		if (!bFromBundle)
+		{
+			watchDARProject(darProj,
+				s_dataDir + "meshes\\" + darProj.projFolder +
+				"\\animations\\DynamicAnimationReplacer");
+		}
+	}
+
+	void reloadDARMaps(DARProject& darProj, const std::vector<std::string>& subDirs)
+	{
+		// ====================================================================
+		//                           reloadDARMaps
+		// --------------------------------------------------------------------
+		// Reloads just the given folders of a loaded project (see
+		// loadDARMaps; "" means the whole project), and publishes the
+		// result as the project's new link table. The rest of the table is
+		// copied across as is, rather than being loaded again.
+		// ====================================================================
+		std::lock_guard<SpinLock> guard(darProj.loadLock);
+		if (!darProj.mapsLoaded.load(std::memory_order_relaxed))
+		{
+			return;    // it'll be loaded afresh when it's first used
+		}
+		std::shared_ptr<DARLinkTable> links =
+			std::make_shared<DARLinkTable>(*std::atomic_load(&darProj.links));
+		for (auto& subDir : subDirs)
+		{
+			// Drop the links to files in the folder...
+			std::string prefix = "Animations\\DynamicAnimationReplacer\\";
+			if (!subDir.empty())
+			{
+				prefix += subDir + "\\";
+			}
+			auto isInFolder = [&prefix](const auto& link)
+			{
+				return _strnicmp(g_pathTable.str(link.to_hkx_file), prefix.c_str(), prefix.size()) == 0;
+			};
+			links->actorBaseLinks.erase(
+				std::remove_if(links->actorBaseLinks.begin(), links->actorBaseLinks.end(), isInFolder),
+				links->actorBaseLinks.end());
+			links->conditionLinks.erase(
+				std::remove_if(links->conditionLinks.begin(), links->conditionLinks.end(), isInFolder),
+				links->conditionLinks.end());
+
+			// ... then load it again.
+			loadDARMaps(darProj, subDir, *links);
+			_MESSAGE("%s: reloaded DynamicAnimationReplacer\\%s",
+				     darProj.projFolder.c_str(), subDir.c_str());
+		}
+		_MESSAGE("%s: now %d actor base and %d conditional DAR links",
+			     darProj.projFolder.c_str(),
+			     (int)links->actorBaseLinks.size(), (int)links->conditionLinks.size());
+		links->account(darProj.id);
+		std::atomic_store(&darProj.links, std::shared_ptr<const DARLinkTable>(std::move(links)));
+	}
+
+	void warmDARProjects(const std::vector<std::string>& projFilePaths)
+	{
+		// ====================================================================
+		//                          warmDARProjects
+		// --------------------------------------------------------------------
+		// Loads the maps for projects we know will be wanted (the character
+		// and 1st person ones) on a background thread, so that they're
+		// usually ready before the player loads a game.
+		// ====================================================================
+		std::vector<DARProject*> darProjs;
+		for (auto& projFilePath : projFilePaths)
+		{
+			std::string key(projFilePath);
+			std::transform(key.begin(), key.end(), key.begin(), tolower);
+			auto it = g_DARProjectRegistry.find(key);
+			if (it != g_DARProjectRegistry.end())
+			{
+				darProjs.push_back(&it->second);
+			}
+		}
+		if (darProjs.empty())
+		{
+			return;
+		}
+		std::thread([darProjs]()
+		{
+			for (auto darProj : darProjs)
+			{
+				ensureDARMapsLoaded(*darProj);
+			}
+		}).detach();
+	}
+
+	static uint64_t readAnimFile(const std::string& path)
+	{
+		// ====================================================================
+		//                           readAnimFile
+		// --------------------------------------------------------------------
+		// Reads the file at 'path' (relative to Data), loose or failing that
+		// from an archive, and throws it away: it's only read so that it's in
+		// the OS's file cache when the game comes to load it. (Only called
+		// for the replacements of projects whose maps have been loaded, so
+		// after the archives have been read.)
+		// ====================================================================
+		FILE* f = fopen((s_dataDir + path).c_str(), "rb");
+		if (f)
+		{
+			static thread_local std::vector<char> buf(1 << 16);
+			uint64_t nBytes = 0;
+			size_t nRead;
+			while ((nRead = fread(buf.data(), 1, buf.size(), f)) > 0)
+			{
+				nBytes += nRead;
+			}
+			fclose(f);
+			return nBytes;
+		}
+		std::string data;
+		return s_darArchives.readFile(path, data) ? data.size() : 0;
+	}
+}
+
+AnimPrefetcher g_animPrefetcher(DARGH::readAnimFile);
\ No newline at end of file
@@ -0,0 +1,426 @@
+// ============================================================================
+//                              DirSnapshot.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "DirSnapshot.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <filesystem>
+#include <system_error>
+#endif
+
+static bool keepFile(const char* name, size_t nameLength, const std::string& ext)
+{
+	return ext.empty()
+		|| (nameLength >= ext.size()
+			&& !memcmp(name + nameLength - ext.size(), ext.data(), ext.size()));
+}
+
+static bool equalsNoCase(const char* a, size_t aLength, std::string_view b)
+{
+	if (aLength != b.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < aLength; ++i)
+	{
+		if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+uint32_t DirSnapshot::addNode(uint32_t parent, uint32_t& lastChild,
+	                          const char* name, size_t nameLength, bool isDir)
+{
+	Node node;
+	node.nameOffset = (uint32_t)names.size();
+	node.nameLength = (uint32_t)nameLength;
+	node.firstChild = kNoNode;
+	node.nextSibling = kNoNode;
+	node.isDir = isDir ? 1 : 0;
+	names.insert(names.end(), name, name + nameLength);
+
+	uint32_t index = (uint32_t)nodes.size();
+	nodes.push_back(node);
+	if (lastChild == kNoNode)
+	{
+		nodes[parent].firstChild = index;
+	}
+	else
+	{
+		nodes[lastChild].nextSibling = index;
+	}
+	lastChild = index;
+	return index;
+}
+
+void DirSnapshot::walk(uint32_t dir, std::string& path)
+{
+	// ====================================================================
+	//                               walk
+	// --------------------------------------------------------------------
+	// Adds the entries of directory node 'dir' (whose full path is 'path')
+	// to the snapshot, then walks each of its subdirectories. The find
+	// handle is closed before recursing, so only one is ever open.
+	// ====================================================================
+	uint32_t lastChild = kNoNode;
+	std::vector<uint32_t> subDirs;
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	size_t pathLength = path.size();
+	path.append("\\*");
+	HANDLE hFind = FindFirstFileExA(path.c_str(), FindExInfoBasic, &findData,
+		                            FindExSearchNameMatch, NULL,
+		                            FIND_FIRST_EX_LARGE_FETCH);
+	path.resize(pathLength);
+	if (hFind == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	do
+	{
+		const char* name = findData.cFileName;
+		if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+		{
+			continue;    // "." or ".."
+		}
+		bool isDir = (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		if (!isDir && !keepFile(name, strlen(name), keepExt))
+		{
+			continue;
+		}
+		uint32_t child = addNode(dir, lastChild, name, strlen(name), isDir);
+		if (isDir)
+		{
+			subDirs.push_back(child);
+		}
+	} while (FindNextFileA(hFind, &findData));
+	FindClose(hFind);
+#else
+	std::error_code ec;
+	for (std::filesystem::directory_iterator it(path, ec), end;
+		 !ec && it != end; it.increment(ec))
+	{
+		std::string name = it->path().filename().string();
+		bool isDir = it->is_directory(ec);
+		if (!isDir && !keepFile(name.data(), name.size(), keepExt))
+		{
+			continue;
+		}
+		uint32_t child = addNode(dir, lastChild, name.data(), name.size(), isDir);
+		if (isDir)
+		{
+			subDirs.push_back(child);
+		}
+	}
+#endif
+
+	for (uint32_t subDir : subDirs)
+	{
+		size_t pathLength = path.size();
+#ifdef _WIN32
+		path.push_back('\\');
+#else
+		path.push_back('/');
+#endif
+		path.append(&names[nodes[subDir].nameOffset], nodes[subDir].nameLength);
+		walk(subDir, path);
+		path.resize(pathLength);
+	}
+}
+
+void DirSnapshot::clear()
+{
+	pNodes = NULL;
+	nNodes = 0;
+	pNames = NULL;
+	nNamesBytes = 0;
+	nodes.clear();
+	names.clear();
+}
+
+static bool isDirectory(const std::string& path)
+{
+#ifdef _WIN32
+	DWORD attributes = GetFileAttributesA(path.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES
+		&& (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+	std::error_code ec;
+	return std::filesystem::is_directory(path, ec);
+#endif
+}
+
+bool DirSnapshot::build(const std::string& rootDirToWalk, const std::string& fileExt,
+	                    const std::string& subDir)
+{
+	clear();
+	rootDir = rootDirToWalk;
+	keepExt = fileExt;
+
+	std::string path = rootDir;
+#ifndef _WIN32
+	// The DAR code builds its paths with backslashes.
+	for (auto& ch : path)
+	{
+		if (ch == '\\')
+		{
+			ch = '/';
+		}
+	}
+#endif
+	if (!isDirectory(path))
+	{
+		return false;
+	}
+
+	Node rootNode;
+	rootNode.nameOffset = 0;
+	rootNode.nameLength = 0;
+	rootNode.firstChild = kNoNode;
+	rootNode.nextSibling = kNoNode;
+	rootNode.isDir = 1;
+	nodes.push_back(rootNode);
+
+	// Follow subDir (if any) down from the root, then walk what's there.
+	uint32_t dir = 0;
+	size_t pos = 0;
+	while (dir != kNoNode && pos < subDir.size())
+	{
+		size_t posSep = subDir.find('\\', pos);
+		std::string name = subDir.substr(pos, posSep == std::string::npos ? std::string::npos : posSep - pos);
+		pos = (posSep == std::string::npos) ? subDir.size() : posSep + 1;
+		if (name.empty())
+		{
+			continue;
+		}
+#ifdef _WIN32
+		path.push_back('\\');
+#else
+		path.push_back('/');
+#endif
+		path.append(name);
+		uint32_t lastChild = kNoNode;
+		dir = isDirectory(path) ? addNode(dir, lastChild, name.data(), name.size(), true) : kNoNode;
+	}
+	if (dir != kNoNode)
+	{
+		walk(dir, path);
+	}
+
+	pNodes = nodes.data();
+	nNodes = (uint32_t)nodes.size();
+	pNames = names.data();
+	nNamesBytes = (uint32_t)names.size();
+	return true;
+}
+
+void DirSnapshot::addFile(std::string_view relPath)
+{
+	if (nNodes != 0 && pNodes != nodes.data())
+	{
+		return;    // attached
+	}
+	if (nodes.empty())
+	{
+		Node rootNode;
+		rootNode.nameOffset = 0;
+		rootNode.nameLength = 0;
+		rootNode.firstChild = kNoNode;
+		rootNode.nextSibling = kNoNode;
+		rootNode.isDir = 1;
+		nodes.push_back(rootNode);
+	}
+
+	uint32_t dir = 0;
+	size_t pos = 0;
+	while (pos <= relPath.size())
+	{
+		size_t posSep = relPath.find('\\', pos);
+		bool isDir = (posSep != std::string_view::npos);
+		std::string_view name = relPath.substr(pos, isDir ? posSep - pos : std::string_view::npos);
+		pos = isDir ? posSep + 1 : relPath.size() + 1;
+		if (name.empty())
+		{
+			continue;
+		}
+
+		uint32_t child = nodes[dir].firstChild;
+		uint32_t lastChild = kNoNode;
+		for (; child != kNoNode; child = nodes[child].nextSibling)
+		{
+			lastChild = child;
+			if ((nodes[child].isDir != 0) == isDir
+				&& equalsNoCase(&names[nodes[child].nameOffset], nodes[child].nameLength, name))
+			{
+				break;
+			}
+		}
+		if (child == kNoNode)
+		{
+			child = addNode(dir, lastChild, name.data(), name.size(), isDir);
+		}
+		dir = child;
+	}
+
+	pNodes = nodes.data();
+	nNodes = (uint32_t)nodes.size();
+	pNames = names.data();
+	nNamesBytes = (uint32_t)names.size();
+}
+
+bool DirSnapshot::attach(const std::string& rootDirOfSnapshot,
+	                     const Node* nodesToView, uint32_t nNodesToView,
+	                     const char* namesToView, uint32_t namesSize)
+{
+	clear();
+	rootDir = rootDirOfSnapshot;
+
+	// Children are always stored after their parent, and siblings after
+	// each other, so every link must point forwards (which also rules out
+	// cycles). And each node but the root is linked to exactly once (or
+	// a few hundred nodes sharing subtrees could take forever to walk).
+	// Everything else must be in bounds.
+	if (nNodesToView == 0
+		|| !nodesToView[0].isDir || nodesToView[0].nextSibling != kNoNode)
+	{
+		return false;
+	}
+	std::vector<bool> linkedTo(nNodesToView);
+	auto linkOK = [&](uint32_t from, uint32_t to)
+	{
+		if (to == kNoNode)
+		{
+			return true;
+		}
+		if (to <= from || to >= nNodesToView || linkedTo[to])
+		{
+			return false;
+		}
+		linkedTo[to] = true;
+		return true;
+	};
+	for (uint32_t i = 0; i < nNodesToView; ++i)
+	{
+		const Node& node = nodesToView[i];
+		if ((uint64_t)node.nameOffset + node.nameLength > namesSize
+			|| (node.firstChild != kNoNode && !node.isDir)
+			|| !linkOK(i, node.firstChild) || !linkOK(i, node.nextSibling))
+		{
+			return false;
+		}
+	}
+
+	pNodes = nodesToView;
+	nNodes = nNodesToView;
+	pNames = namesToView;
+	nNamesBytes = namesSize;
+	return true;
+}
+
+uint32_t DirSnapshot::childDir(uint32_t dir, const std::string& name) const
+{
+	if (dir == kNoNode)
+	{
+		return kNoNode;
+	}
+	for (uint32_t child = pNodes[dir].firstChild; child != kNoNode;
+		 child = pNodes[child].nextSibling)
+	{
+		const Node& node = pNodes[child];
+		if (node.isDir
+			&& equalsNoCase(&pNames[node.nameOffset], node.nameLength, name))
+		{
+			return child;
+		}
+	}
+	return kNoNode;
+}
+
+bool DirSnapshot::listSubdirs(uint32_t dir, std::vector<std::string>& names_out) const
+{
+	if (dir == kNoNode)
+	{
+		return false;
+	}
+	for (uint32_t child = pNodes[dir].firstChild; child != kNoNode;
+		 child = pNodes[child].nextSibling)
+	{
+		const Node& node = pNodes[child];
+		if (node.isDir)
+		{
+			names_out.emplace_back(&pNames[node.nameOffset], node.nameLength);
+		}
+	}
+	return true;
+}
+
+void DirSnapshot::collectFiles(uint32_t dir, const std::string& ext, std::string& subDir,
+	                           std::vector<std::string>& paths_out) const
+{
+	// Depth first, visiting subdirectories as they are met, which is the
+	// same order findMatchingFiles produces.
+	for (uint32_t child = pNodes[dir].firstChild; child != kNoNode;
+		 child = pNodes[child].nextSibling)
+	{
+		const Node& node = pNodes[child];
+		const char* name = &pNames[node.nameOffset];
+		if (node.isDir)
+		{
+			size_t subDirLength = subDir.size();
+			subDir.append(name, node.nameLength);
+			subDir.push_back('\\');
+			collectFiles(child, ext, subDir, paths_out);
+			subDir.resize(subDirLength);
+		}
+		else if (node.nameLength >= ext.size()
+			     && !memcmp(name + node.nameLength - ext.size(), ext.data(), ext.size()))
+		{
+			paths_out.emplace_back(subDir);
+			paths_out.back().append(name, node.nameLength);
+		}
+	}
+}
+
+bool DirSnapshot::findFiles(uint32_t dir, const std::string& ext,
+	                        std::vector<std::string>& paths_out) const
+{
+	if (dir == kNoNode)
+	{
+		return false;
+	}
+	std::string subDir;
+	collectFiles(dir, ext, subDir, paths_out);
+	return true;
+}
\ No newline at end of file
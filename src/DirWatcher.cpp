@@ -0,0 +1,258 @@
+// ============================================================================
+//                              DirWatcher.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "DirWatcher.h"
+
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <filesystem>
+#include <system_error>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+void DirWatcher::addChange(std::string relPath)
+{
+	std::lock_guard<SpinLock> guard(changesLock);
+	changes.push_back(std::move(relPath));
+	lastChange = std::chrono::steady_clock::now();
+}
+
+bool DirWatcher::takeChanges(std::vector<std::string>& paths_out)
+{
+	std::lock_guard<SpinLock> guard(changesLock);
+	if (changes.empty())
+	{
+		return false;
+	}
+	paths_out.insert(paths_out.end(), changes.begin(), changes.end());
+	changes.clear();
+	return true;
+}
+
+std::chrono::steady_clock::time_point DirWatcher::lastChangeTime()
+{
+	std::lock_guard<SpinLock> guard(changesLock);
+	return lastChange;
+}
+
+#ifdef _WIN32
+
+bool DirWatcher::start(const std::string& rootDirToWatch)
+{
+	stop();
+	rootDir = rootDirToWatch;
+	HANDLE h = CreateFileA(rootDir.c_str(), FILE_LIST_DIRECTORY,
+		                   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		                   NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	hDir = h;
+	bStop = false;
+	worker = std::thread(&DirWatcher::run, this);
+	return true;
+}
+
+void DirWatcher::stop()
+{
+	if (!worker.joinable())
+	{
+		return;
+	}
+	bStop = true;
+	CancelIoEx((HANDLE)hDir, NULL);    // wakes the worker out of ReadDirectoryChangesW
+	worker.join();
+	CloseHandle((HANDLE)hDir);
+	hDir = NULL;
+}
+
+void DirWatcher::run()
+{
+	// ReadDirectoryChangesW needs a DWORD aligned buffer.
+	std::vector<DWORD> buf(16384);
+	std::string relPath;
+	while (!bStop)
+	{
+		DWORD nBytes = 0;
+		if (!ReadDirectoryChangesW((HANDLE)hDir, buf.data(), (DWORD)(buf.size() * sizeof(DWORD)),
+			                       TRUE,
+			                       FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME
+			                       | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+			                       &nBytes, NULL, NULL))
+		{
+			break;    // cancelled by stop(), or the folder's gone
+		}
+		if (nBytes == 0)
+		{
+			// The buffer overflowed, so we don't know what changed.
+			addChange("");
+			continue;
+		}
+		const char* p = (const char*)buf.data();
+		while (true)
+		{
+			const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)p;
+			int nChars = (int)(info->FileNameLength / sizeof(WCHAR));
+			int nBytesNeeded = WideCharToMultiByte(CP_ACP, 0, info->FileName, nChars,
+				                                   NULL, 0, NULL, NULL);
+			relPath.resize(nBytesNeeded);
+			WideCharToMultiByte(CP_ACP, 0, info->FileName, nChars,
+				                &relPath[0], nBytesNeeded, NULL, NULL);
+			addChange(relPath);
+			if (info->NextEntryOffset == 0)
+			{
+				break;
+			}
+			p += info->NextEntryOffset;
+		}
+	}
+}
+
+#else
+
+void DirWatcher::addWatches(const std::string& relPath)
+{
+	// Watches the folder 'relPath' and every folder beneath it.
+	const uint32_t kEvents = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE
+		                   | IN_MOVED_FROM | IN_MOVED_TO;
+	std::string path = rootDir;
+	for (auto& ch : path)
+	{
+		if (ch == '\\')
+		{
+			ch = '/';
+		}
+	}
+	std::string relPathSlashes = relPath;
+	for (auto& ch : relPathSlashes)
+	{
+		if (ch == '\\')
+		{
+			ch = '/';
+		}
+	}
+	if (!relPath.empty())
+	{
+		path += "/" + relPathSlashes;
+	}
+	int wd = inotify_add_watch(fd, path.c_str(), kEvents);
+	if (wd < 0)
+	{
+		return;
+	}
+	watchPaths[wd] = relPath;
+
+	std::error_code ec;
+	for (std::filesystem::directory_iterator it(path, ec), end;
+		 !ec && it != end; it.increment(ec))
+	{
+		if (it->is_directory(ec))
+		{
+			std::string name = it->path().filename().string();
+			addWatches(relPath.empty() ? name : relPath + "\\" + name);
+		}
+	}
+}
+
+bool DirWatcher::start(const std::string& rootDirToWatch)
+{
+	stop();
+	rootDir = rootDirToWatch;
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+	watchPaths.clear();
+	addWatches("");
+	if (watchPaths.empty())
+	{
+		close(fd);
+		fd = -1;
+		return false;
+	}
+	bStop = false;
+	worker = std::thread(&DirWatcher::run, this);
+	return true;
+}
+
+void DirWatcher::stop()
+{
+	if (!worker.joinable())
+	{
+		return;
+	}
+	bStop = true;    // the worker polls with a timeout, so will notice
+	worker.join();
+	close(fd);
+	fd = -1;
+}
+
+void DirWatcher::run()
+{
+	alignas(inotify_event) char buf[16384];
+	while (!bStop)
+	{
+		pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, 100) <= 0)
+		{
+			continue;
+		}
+		ssize_t nBytes = read(fd, buf, sizeof(buf));
+		for (ssize_t pos = 0; pos < nBytes; )
+		{
+			const inotify_event* event = (const inotify_event*)(buf + pos);
+			pos += sizeof(inotify_event) + event->len;
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				addChange("");
+				continue;
+			}
+			auto it = watchPaths.find(event->wd);
+			if (it == watchPaths.end() || event->len == 0)
+			{
+				continue;
+			}
+			std::string relPath = it->second.empty()
+				? std::string(event->name)
+				: it->second + "\\" + event->name;
+			if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+			{
+				addWatches(relPath);
+			}
+			addChange(relPath);
+		}
+	}
+}
+
+#endif
\ No newline at end of file
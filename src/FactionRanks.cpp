@@ -0,0 +1,122 @@
+// ============================================================================
+//                             FactionRanks.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "FactionRanks.h"
+
+#include <algorithm>
+#include <mutex>
+
+void FactionRanks::addFaction(uint32_t factionID)
+{
+	if (factionID == 0)
+	{
+		return;
+	}
+	std::lock_guard<SpinLock> guard(registryLock);
+	std::shared_ptr<const FactionIDs> current = std::atomic_load(&factionIDs);
+	if (current && std::binary_search(current->begin(), current->end(), factionID))
+	{
+		return;
+	}
+
+	// Copy on write: tables built from the old list keep it (and are
+	// rebuilt the next time they're used).
+	auto added = std::make_shared<FactionIDs>();
+	if (current)
+	{
+		*added = *current;
+	}
+	added->insert(std::upper_bound(added->begin(), added->end(), factionID), factionID);
+	std::atomic_store(&factionIDs, std::shared_ptr<const FactionIDs>(std::move(added)));
+}
+
+void FactionRanks::setMaxAge(Clock::duration maxAge)
+{
+	maxAgeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(maxAge).count();
+}
+
+bool FactionRanks::isFresh(const Table* table, const FactionIDs* current, Clock::time_point now) const
+{
+	return table
+		&& table->factionIDs.get() == current
+		&& std::chrono::duration_cast<std::chrono::nanoseconds>(now - table->built).count()
+		   <= maxAgeNs;
+}
+
+bool FactionRanks::find(uint32_t actorID, uint32_t factionID, FactionRank& rank_out,
+	                    Clock::time_point now)
+{
+	std::shared_ptr<const FactionIDs> current = std::atomic_load(&factionIDs);
+	if (!current || maxAgeNs == 0)
+	{
+		return false;
+	}
+	auto search = std::lower_bound(current->begin(), current->end(), factionID);
+	if (search == current->end() || *search != factionID)
+	{
+		return false;
+	}
+	size_t index = search - current->begin();
+
+	std::shared_ptr<const Table> table;
+	tables.find(actorID, table);
+	if (!isFresh(table.get(), current.get(), now))
+	{
+		// (Re)build it. Two threads may both do so for the same actor:
+		// they read the same ranks, and the last one stored wins.
+		auto built = std::make_shared<Table>();
+		built->built = now;
+		built->factionIDs = current;
+		built->ranks.resize(current->size());
+		if (!readRanks(actorID, current->data(), current->size(), built->ranks.data()))
+		{
+			return false;
+		}
+		nBuilt++;
+
+		bool inserted = false;
+		tables.update(actorID, [&](std::shared_ptr<const Table>& stored)
+		{
+			inserted = !stored;
+			stored = built;
+		});
+		if (inserted && ++nTables > maxActors)
+		{
+			// Too many actors (most long unloaded): start again.
+			invalidateAll();
+		}
+		table = std::move(built);
+	}
+	rank_out = table->ranks[index];
+	return true;
+}
+
+void FactionRanks::invalidateAll()
+{
+	tables.clear();
+	nTables = 0;
+}
\ No newline at end of file
@@ -26,9 +26,11 @@
 // (The MIT License)
 // ============================================================================
 #include "DARProjectRegistry.h"
+#include "ShardedHashMap.h"
 #include "hooks.h"
 
 #include "RE/B/BShkbAnimationGraph.h"
+#include "RE/H/hkbCharacterData.h"
 #include "RE/H/hkbCharacterStringData.h"
 #include "RE/H/hkbCharacter.h"
 #include "RE/H/hkbProjectData.h"
@@ -36,6 +38,8 @@
 
 #include "SKSE/SafeWrite.h"
 
+#include <atomic>
+
 // Turn this on if you want to trace & debug the hooks
 // (CAUTION: only use for debugging - this will generate large dargh.log files
 //  and degrade performance)
@@ -56,14 +60,86 @@ uint64_t hkbClipGenerator_activate_Orig;
 typedef void (*hkbClipGenerator_activate)
    (hkbClipGenerator* thisObj, hkbContext* context);
 
-BSSpinLock lock;
-std::unordered_map<hkbCharacterStringData*, hkArray*> g_animHashmap;
+// Character string data objects whose animation names we've rebuilt, still waiting
+// for their finish constructor. Written by the graph loading threads and consumed
+// by whichever thread finishes the object, so it is sharded: DAR uses a single
+// std::unordered_map behind one global BSSpinLock, which every loader thread then
+// queues on (and falls back to Sleep() on) during cell transitions.
+ShardedHashMap<hkbCharacterStringData*, hkArray*> g_animHashmap;
+
+// The replacement chosen at each clip generator's latest activation. An
+// activation whose animation isn't loaded yet goes through here (Hook 3)
+// and then through the animation loader (Trampoline 2), which reactivates
+// the generator: rather than both deciding, and with Random() in a chain
+// perhaps deciding differently, the loader reuses the decision made here.
+struct ClipDecision
+{
+	DARProject*          darProj;
+	const DARLinkIndex*  linkIndex;         // (made with)
+	hkInt16              origIndex;
+	hkInt16              newIndex;          // -1 = not replaced
+};
+ShardedHashMap<hkbClipGenerator*, ClipDecision> g_clipDecisions;
+std::atomic<size_t> g_nClipDecisions{ 0 };
+constexpr size_t kMaxClipDecisions = 65536;
+
+static void recordClipDecision(hkbClipGenerator* clipGen, const ClipDecision& decision)
+{
+	bool inserted = false;
+	g_clipDecisions.update(clipGen, [&](ClipDecision& stored)
+	{
+		inserted = stored.darProj == NULL;
+		stored = decision;
+	});
+	if (inserted && ++g_nClipDecisions > kMaxClipDecisions)
+	{
+		// Most are for generators of graphs long since unloaded.
+		g_clipDecisions.clear();
+		g_nClipDecisions = 0;
+	}
+}
+
+std::shared_ptr<const DARLinkIndex> findGraphLinkIndex(DARProject* darProj, hkbCharacter* character)
+{
+	hkArray& animationNames = character->setup->data->m_stringData->animationNames;
+	return DARGH::findLinkIndex(*darProj, (const void*)animationNames._data, animationNames._size);
+}
+
+hkInt16 decideClipReplacement(hkbClipGenerator* clipGen, DARProject* darProj,
+	                          const DARLinkIndex& linkIndex, hkInt16 origIndex, Actor* actor)
+{
+	ClipDecision decision;
+	if (g_clipDecisions.find(clipGen, decision)
+		&& decision.darProj == darProj && decision.linkIndex == &linkIndex
+		&& decision.origIndex == origIndex)
+	{
+		return decision.newIndex;
+	}
+	decision = { darProj, &linkIndex, origIndex,
+		         DARGH::getNewAnimIndex(darProj, linkIndex, origIndex, actor) };
+	recordClipDecision(clipGen, decision);
+	return decision.newIndex;
+}
+
+void activateClipGenerator(hkbClipGenerator* clipGen, hkbContext* context)
+{
+	((hkbClipGenerator_activate)hkbClipGenerator_activate_Orig)(clipGen, context);
+}
+
+// What each g_animHashmap entry costs (see MemoryAccounts).
+constexpr int64_t kAnimHashmapEntryBytes =
+	sizeof(std::pair<hkbCharacterStringData* const, hkArray*>) + 2 * sizeof(void*);
 
 void cacheModifiedCharStringData(hkbCharacterStringData* p_hkbCharStringData)
 {
-	BSSpinLock_lock(&lock);
-	g_animHashmap.insert(std::pair(p_hkbCharStringData, &p_hkbCharStringData->animationNames));
-	BSSpinLock_unlock(&lock);
+	bool inserted;
+	g_animHashmap.findOrInsert(p_hkbCharStringData,
+		[&]() { return &p_hkbCharStringData->animationNames; }, &inserted);
+	if (inserted)
+	{
+		g_memoryAccounts.add(MemoryAccounts::kShared, MemCategory::kAnimHashmap,
+			                 kAnimHashmapEntryBytes, 1);
+	}
 }
 
 void hkbCharacterStringData_fctor_Hook(hkbCharacterStringData* thisObj, hkFinishLoadedObjectFlag flag)
@@ -73,28 +149,32 @@ void hkbCharacterStringData_fctor_Hook(hkbCharacterStringData* thisObj, hkFinish
 	// an object usable. It's at this point that we actually replace the animation names,
 	// and then remove the entry from our cache (g_animHashmap).
 	// TODO: Should we free any other memory at this point? Memory leaks?
-	BSSpinLock_lock(&lock);
 #ifdef DEBUG_TRACE_HOOKS
 	_MESSAGE("\n========= HOOK 1: hkbCharacterStringData: FCTOR ========\n");
 #endif
-	auto& search = g_animHashmap.find(thisObj);
-	if (search != g_animHashmap.end())
+	// Find and clear the entry in the map (in one step, under the shard's lock).
+	hkArray* animationNames;
+	if (g_animHashmap.take(thisObj, animationNames))
 	{
 		// Found it.
-		hkArray* animationNames = search->second;
+		g_memoryAccounts.add(MemoryAccounts::kShared, MemCategory::kAnimHashmap,
+			                 -kAnimHashmapEntryBytes, -1);
 		thisObj->animationNames._data = animationNames->_data;
 		thisObj->animationNames._size = animationNames->_size;
-
-		// Clear the entry in the map.
-		g_animHashmap.erase(search);
 	}
 #ifdef DEBUG_TRACE_HOOKS
-	_MESSAGE("Unlocking and passing control back to orig function...");
+	_MESSAGE("Passing control back to orig function...");
 #endif
-	BSSpinLock_unlock(&lock);
 	((hkbCharacterStringData_fctor)hkbCharacterStringData_fctor_Orig)(thisObj, flag);
 }
 
+void logHookLockStats()
+{
+	// Contention report for the locks taken by the hooks (only has
+	// anything to report if built with DARGH_SPINLOCK_STATS).
+	g_animHashmap.logLockStats("g_animHashmap");
+}
+
 void hkbProjectData_fctor_Hook(hkbProjectData* thisObj, hkFinishLoadedObjectFlag flag)
 {
 	// Finish constructor for a hkbProjectData object.
@@ -151,8 +231,17 @@ void hkbClipGenerator_activate_Hook(hkbClipGenerator* thisObj, hkbContext* conte
 	{
 		return ((hkbClipGenerator_activate)hkbClipGenerator_activate_Orig)(thisObj, context);
 	}
+
+	// The links for the animationNames array this graph was generated with
+	// (which a later rebuild of the project doesn't change).
+	std::shared_ptr<const DARLinkIndex> linkIndex = findGraphLinkIndex(darProj, context->character);
+	if (!linkIndex)
+	{
+		return ((hkbClipGenerator_activate)hkbClipGenerator_activate_Orig)(thisObj, context);
+	}
 	
-	hkInt16 newIndex = DARGH::getNewAnimIndex(darProj, origIndex, actor);
+	hkInt16 newIndex = DARGH::getNewAnimIndex(darProj, *linkIndex, origIndex, actor);
+	recordClipDecision(thisObj, { darProj, linkIndex.get(), origIndex, newIndex });
 	if (newIndex == -1)
 	{
 		return ((hkbClipGenerator_activate)hkbClipGenerator_activate_Orig)(thisObj, context);
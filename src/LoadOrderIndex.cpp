@@ -0,0 +1,67 @@
+// ============================================================================
+//                            LoadOrderIndex.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "LoadOrderIndex.h"
+
+static char toLower(char ch)
+{
+	return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+void LoadOrderIndex::add(std::string_view modName, const Mod& mod)
+{
+	if (modName.size() > kMaxNameLength)
+	{
+		return;
+	}
+	std::string key(modName);
+	for (auto& ch : key)
+	{
+		ch = toLower(ch);
+	}
+	if (mods.find(key) == mods.end())    // (the first one wins)
+	{
+		names.push_back(std::move(key));
+		mods.emplace(names.back(), mod);
+	}
+}
+
+const LoadOrderIndex::Mod* LoadOrderIndex::find(std::string_view modName) const
+{
+	if (modName.size() > kMaxNameLength)
+	{
+		return NULL;
+	}
+	// Fold the name into a buffer on the stack.
+	char key[kMaxNameLength];
+	for (size_t i = 0; i < modName.size(); ++i)
+	{
+		key[i] = toLower(modName[i]);
+	}
+	auto it = mods.find(std::string_view(key, modName.size()));
+	return it == mods.end() ? NULL : &it->second;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+// ============================================================================
+//                           LocationAncestry.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "LocationAncestry.h"
+
+#include <algorithm>
+
+bool LocationAncestry::isIn(uint32_t locationID, uint32_t ancestorID)
+{
+	if (locationID == 0)
+	{
+		return false;
+	}
+	bool bIsIn = false;
+	auto test = [&](const std::vector<uint32_t>& set)
+	{
+		bIsIn = std::binary_search(set.begin(), set.end(), ancestorID);
+	};
+	if (ancestors.visit(locationID, test))
+	{
+		return bIsIn;
+	}
+
+	// First time we've seen this location: walk its chain. (If another
+	// thread gets there first, it will have found the same set.)
+	std::vector<uint32_t> set;
+	for (uint32_t id = locationID; id != 0 && set.size() < kMaxDepth; id = readParent(id))
+	{
+		set.push_back(id);
+	}
+	std::sort(set.begin(), set.end());
+	set.erase(std::unique(set.begin(), set.end()), set.end());
+	test(set);
+	ancestors.insert(locationID, std::move(set));
+	return bIsIn;
+}
\ No newline at end of file
@@ -26,8 +26,10 @@
 // (The MIT License)
 // ============================================================================
 #include "hooks.h"
+#include "DARAnimationNames.h"
 #include "trampolines.h"
 #include "Plugin.h"
+#include "StartupTimes.h"
 #include "Utilities.h"
 
 #include "RE/Offsets.h"
@@ -73,10 +75,91 @@ void ProcessDARIniFile()
 		int iMaxAnimFiles = std::stoi(value, nullptr, 0);
 		if (iMaxAnimFiles >= 0)
 		{
+			// The game indexes the names with hkInt16s, so more than
+			// that can't be used.
+			if ((uint32_t)iMaxAnimFiles > kMaxAnimationNames)
+			{
+				_WARNING("   AnimationLimit %d is more than the game can index, using %d",
+					     iMaxAnimFiles, (int)kMaxAnimationNames);
+				iMaxAnimFiles = (int)kMaxAnimationNames;
+			}
 			Plugin::g_MAX_ANIMATION_FILES = iMaxAnimFiles;
 			_MESSAGE("   AnimationLimit  =  %d", iMaxAnimFiles);
 		}
 	}
+
+	// Our own setting: whether to load the character and 1st person
+	// projects' mappings in the background as soon as the game's data is
+	// loaded (rather than when they're first used).
+	GetPrivateProfileString
+	("Main", "WarmProjects", NULL, value, 256, darINIPath.c_str());
+	if (strcmp(value, ""))
+	{
+		Plugin::g_bWarmDARProjects = std::stoi(value, nullptr, 0) != 0;
+		_MESSAGE("   WarmProjects  =  %d", (int)Plugin::g_bWarmDARProjects);
+	}
+
+	// And whether to watch the DAR folders and apply changes to them
+	// while the game is running (for animation authors).
+	GetPrivateProfileString
+	("Main", "HotReload", NULL, value, 256, darINIPath.c_str());
+	if (strcmp(value, ""))
+	{
+		Plugin::g_bHotReload = std::stoi(value, nullptr, 0) != 0;
+		_MESSAGE("   HotReload  =  %d", (int)Plugin::g_bHotReload);
+	}
+
+	// And how stale (in milliseconds) the weather, game time and global
+	// variables that conditions test may be: they're read at most once
+	// in that time, however many actors are animating (0 = every time).
+	GetPrivateProfileString
+	("Main", "WorldStateMaxAge", NULL, value, 256, darINIPath.c_str());
+	if (strcmp(value, ""))
+	{
+		int iMaxAge = std::stoi(value, nullptr, 0);
+		if (iMaxAge >= 0)
+		{
+			Plugin::g_WorldStateMaxAgeMs = iMaxAge;
+			_MESSAGE("   WorldStateMaxAge  =  %d", iMaxAge);
+		}
+	}
+
+	// And how stale (in milliseconds) an actor's faction ranks may be:
+	// the game sends no event when a script changes them, so each actor's
+	// are read again once they're this old (0 = every time).
+	GetPrivateProfileString
+	("Main", "FactionRanksMaxAge", NULL, value, 256, darINIPath.c_str());
+	if (strcmp(value, ""))
+	{
+		int iMaxAge = std::stoi(value, nullptr, 0);
+		if (iMaxAge >= 0)
+		{
+			Plugin::g_FactionRanksMaxAgeMs = iMaxAge;
+			_MESSAGE("   FactionRanksMaxAge  =  %d", iMaxAge);
+		}
+	}
+
+	// And whether to read the replacement animations that actors are
+	// likely to want ahead of time, in the background, and how much of
+	// the disk (in KB per second) that may use.
+	GetPrivateProfileString
+	("Main", "PrefetchAnimations", NULL, value, 256, darINIPath.c_str());
+	if (strcmp(value, ""))
+	{
+		Plugin::g_bPrefetchAnimations = std::stoi(value, nullptr, 0) != 0;
+		_MESSAGE("   PrefetchAnimations  =  %d", (int)Plugin::g_bPrefetchAnimations);
+	}
+	GetPrivateProfileString
+	("Main", "PrefetchKBPerSecond", NULL, value, 256, darINIPath.c_str());
+	if (strcmp(value, ""))
+	{
+		int iKBPerSecond = std::stoi(value, nullptr, 0);
+		if (iKBPerSecond > 0)
+		{
+			Plugin::g_PrefetchKBPerSecond = iKBPerSecond;
+			_MESSAGE("   PrefetchKBPerSecond  =  %d", iKBPerSecond);
+		}
+	}
 }
 
 extern "C"
@@ -141,6 +224,8 @@ extern "C"
 		}
 
 		// ---------- Initialize offsets with address library. ----------
+		// (Each step from here on is timed: see StartupTimes.)
+		g_startupTimes.startPhase("RE::InitialiseOffsets");
 		if (!RE::InitialiseOffsets()) { 
 			return false;
 		}
@@ -148,6 +233,7 @@ extern "C"
 		//Plugin::DumpOffsets();
 
 		// ---------- Initialize the two branch trampolines. ----------
+		g_startupTimes.startPhase("trampoline creation");
 		if (!g_branchTrampoline.Create(static_cast<size_t>(1024) * 64))
 		{
 			_ERROR("couldn't create branch trampoline. this is fatal. skipping remainder of init process.");
@@ -160,15 +246,24 @@ extern "C"
 		}
 
 		// ---------- Process the DAR INI file. ----------
+		g_startupTimes.startPhase("ProcessDARIniFile");
 		ProcessDARIniFile();
 
 		// ---------- Install the hooks and trampolines. ----------
 		_MESSAGE("------------- Installing hooks and trampolines -------------");
-		if (!install_hooks() || !install_trampolines())
+		g_startupTimes.startPhase("install_hooks");
+		if (!install_hooks())
+		{
+			return false;
+		}
+		g_startupTimes.startPhase("install_trampolines");
+		if (!install_trampolines())
 		{
 			return false;
 		}
+		g_startupTimes.endPhase();
 		_MESSAGE("------------------------------------------------------------");
+		g_startupTimes.report("plugin load times", [](const char* line) { _MESSAGE("%s", line); });
 		
 		// ---------- Register for the dataLoaded SKSE callback. ----------
 		g_msgInterface->RegisterListener(g_pluginHandle, "SKSE", Plugin::HandleSKSEMessage);
@@ -0,0 +1,211 @@
+// ============================================================================
+//                           MemoryAccounting.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "MemoryAccounting.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <mutex>
+
+MemoryAccounts& g_memoryAccounts = *new MemoryAccounts();
+
+static const char* s_categoryNames[(size_t)MemCategory::kNumCategories] =
+{
+	"link vectors",
+	"condition args",
+	"link data",
+	"name arrays",
+	"anim hashmap",
+	"leaked rebuilds",
+	"paths",
+};
+
+const char* memCategoryName(MemCategory category)
+{
+	return category < MemCategory::kNumCategories ? s_categoryNames[(size_t)category] : "?";
+}
+
+void MemoryAccounts::add(uint32_t projectID, MemCategory category, int64_t bytes, int64_t objects)
+{
+	std::lock_guard<SpinLock> guard(lock);
+	Usage& usage = accounts[projectID].usage[(size_t)category];
+	usage.bytes += bytes;
+	usage.objects += objects;
+	totals[(size_t)category].bytes += bytes;
+	totals[(size_t)category].objects += objects;
+	totalBytes += bytes;
+	if (totalBytes > peak)
+	{
+		peak = totalBytes;
+	}
+}
+
+MemoryAccounts::Usage MemoryAccounts::take(uint32_t projectID, MemCategory category)
+{
+	std::lock_guard<SpinLock> guard(lock);
+	Usage taken;
+	auto search = accounts.find(projectID);
+	if (search != accounts.end())
+	{
+		taken = search->second.usage[(size_t)category];
+		search->second.usage[(size_t)category] = Usage();
+		totals[(size_t)category].bytes -= taken.bytes;
+		totals[(size_t)category].objects -= taken.objects;
+		totalBytes -= taken.bytes;
+	}
+	return taken;
+}
+
+void MemoryAccounts::setName(uint32_t projectID, const std::string& name)
+{
+	std::lock_guard<SpinLock> guard(lock);
+	accounts[projectID].name = name;
+}
+
+MemoryAccounts::Usage MemoryAccounts::usage(uint32_t projectID, MemCategory category) const
+{
+	std::lock_guard<SpinLock> guard(lock);
+	auto search = accounts.find(projectID);
+	return search != accounts.end() ? search->second.usage[(size_t)category] : Usage();
+}
+
+MemoryAccounts::Usage MemoryAccounts::total(MemCategory category) const
+{
+	std::lock_guard<SpinLock> guard(lock);
+	return totals[(size_t)category];
+}
+
+MemoryAccounts::Usage MemoryAccounts::total() const
+{
+	std::lock_guard<SpinLock> guard(lock);
+	Usage sum;
+	for (auto& usage : totals)
+	{
+		sum.bytes += usage.bytes;
+		sum.objects += usage.objects;
+	}
+	return sum;
+}
+
+int64_t MemoryAccounts::peakBytes() const
+{
+	std::lock_guard<SpinLock> guard(lock);
+	return peak;
+}
+
+void MemoryAccounts::report(LineWriter write) const
+{
+	// Copied out first, so as not to hold the lock while writing.
+	std::map<uint32_t, Account> copied;
+	Usage copiedTotals[(size_t)MemCategory::kNumCategories];
+	int64_t copiedTotal, copiedPeak;
+	{
+		std::lock_guard<SpinLock> guard(lock);
+		copied = accounts;
+		std::copy(std::begin(totals), std::end(totals), copiedTotals);
+		copiedTotal = totalBytes;
+		copiedPeak = peak;
+	}
+
+	char line[512];
+	snprintf(line, sizeof(line), "DARGH memory: %lld KB held (peak %lld KB)",
+		     (long long)(copiedTotal / 1024), (long long)(copiedPeak / 1024));
+	write(line);
+	for (size_t i = 0; i < (size_t)MemCategory::kNumCategories; i++)
+	{
+		snprintf(line, sizeof(line), "  %-16s %10lld KB %10lld objects", s_categoryNames[i],
+			     (long long)(copiedTotals[i].bytes / 1024), (long long)copiedTotals[i].objects);
+		write(line);
+	}
+
+	// Then a line per account, listing the categories it holds anything in.
+	for (auto& entry : copied)
+	{
+		const Account& account = entry.second;
+		int n;
+		if (entry.first == kShared)
+		{
+			n = snprintf(line, sizeof(line), "  (shared):");
+		}
+		else
+		{
+			n = snprintf(line, sizeof(line), "  %s:",
+				         account.name.empty() ? "(unnamed project)" : account.name.c_str());
+		}
+		bool bAny = false;
+		for (size_t i = 0; i < (size_t)MemCategory::kNumCategories; i++)
+		{
+			const Usage& usage = account.usage[i];
+			if ((usage.bytes || usage.objects) && n > 0 && (size_t)n < sizeof(line))
+			{
+				n += snprintf(line + n, sizeof(line) - n, " %s %lld KB (%lld),", s_categoryNames[i],
+					          (long long)(usage.bytes / 1024), (long long)usage.objects);
+				bAny = true;
+			}
+		}
+		if (bAny)
+		{
+			if ((size_t)n < sizeof(line))
+			{
+				line[n - 1] = 0;    // (the last comma)
+			}
+			write(line);
+		}
+	}
+}
+
+void MemoryAccounts::clear()
+{
+	std::lock_guard<SpinLock> guard(lock);
+	accounts.clear();
+	for (auto& usage : totals)
+	{
+		usage = Usage();
+	}
+	totalBytes = 0;
+	peak = 0;
+}
+
+void MemoryCharge::set(uint32_t project, MemCategory cat, size_t nBytes, size_t nObjects)
+{
+	release();
+	g_memoryAccounts.add(project, cat, (int64_t)nBytes, (int64_t)nObjects);
+	projectID = project;
+	category = cat;
+	bytes = nBytes;
+	objects = nObjects;
+}
+
+void MemoryCharge::release()
+{
+	if (category != MemCategory::kNumCategories)
+	{
+		g_memoryAccounts.add(projectID, category, -(int64_t)bytes, -(int64_t)objects);
+		category = MemCategory::kNumCategories;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+// ============================================================================
+//                               PathTable.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "PathTable.h"
+
+#include <cctype>
+#include <cstring>
+#include <mutex>
+
+PathTable g_pathTable(true);
+
+PathTable::~PathTable()
+{
+	for (auto& chunk : entryChunks)
+	{
+		delete[] chunk.load();
+	}
+	delete[] blocks;
+}
+
+static inline unsigned char canonical(unsigned char c)
+{
+	return c == '/' ? '\\' : (unsigned char)tolower(c);
+}
+
+uint32_t PathTable::hashLower(std::string_view path)
+{
+	// FNV-1a.
+	uint32_t h = 2166136261u;
+	for (unsigned char c : path)
+	{
+		h = (h ^ canonical(c)) * 16777619u;
+	}
+	return h;
+}
+
+bool PathTable::sameFile(PathID id, std::string_view path) const
+{
+	if (length(id) != path.size())
+	{
+		return false;
+	}
+	const char* s = str(id);
+	for (size_t i = 0; i < path.size(); i++)
+	{
+		if (canonical(s[i]) != canonical(path[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+char* PathTable::store(std::string_view path)
+{
+	// (Under lock.) Copies 'path' (with a terminating 0) into the current
+	// block, starting a new one if it doesn't fit. A path longer than a
+	// block gets a block of its own.
+	size_t size = path.size() + 1;
+	if (blockUsed + size > kBlockSize)
+	{
+		if (nBlocks == maxBlocks)
+		{
+			maxBlocks = maxBlocks ? maxBlocks * 2 : 16;
+			std::unique_ptr<char[]>* grown = new std::unique_ptr<char[]>[maxBlocks];
+			for (size_t i = 0; i < nBlocks; i++)
+			{
+				grown[i] = std::move(blocks[i]);
+			}
+			delete[] blocks;
+			blocks = grown;
+		}
+		size_t blockSize = size > kBlockSize ? size : kBlockSize;
+		blocks[nBlocks++].reset(new char[blockSize]);
+		blockUsed = size > kBlockSize ? kBlockSize : 0;
+		nBytes += blockSize;
+		if (size > kBlockSize)
+		{
+			char* s = blocks[nBlocks - 1].get();
+			memcpy(s, path.data(), path.size());
+			s[path.size()] = 0;
+			return s;
+		}
+	}
+	char* s = blocks[nBlocks - 1].get() + blockUsed;
+	memcpy(s, path.data(), path.size());
+	s[path.size()] = 0;
+	blockUsed += size;
+	return s;
+}
+
+PathID PathTable::intern(std::string_view path)
+{
+	std::lock_guard<SpinLock> guard(lock);
+	auto search = ids.find(path);
+	if (search != ids.end())
+	{
+		return search->second;
+	}
+
+	size_t index = nPaths.load(std::memory_order_relaxed);
+	size_t chunk = index >> kEntryChunkBits;
+	if (chunk >= kMaxEntryChunks)
+	{
+		return 0;    // (16M distinct paths: never in practice)
+	}
+	size_t prevBytes = nBytes;
+	Entry* entries = entryChunks[chunk].load(std::memory_order_relaxed);
+	if (!entries)
+	{
+		entries = new Entry[kEntriesPerChunk];
+		entryChunks[chunk].store(entries, std::memory_order_release);
+		nBytes += kEntriesPerChunk * sizeof(Entry);
+	}
+	char* s = store(path);
+	entries[index & (kEntriesPerChunk - 1)] = Entry{ s, (uint32_t)path.size(), hashLower(path) };
+	PathID id = (PathID)(index + 1);
+	ids.emplace(std::string_view(s, path.size()), id);
+	nBytes += sizeof(decltype(ids)::value_type) + 2 * sizeof(void*);
+	if (bAccounted)
+	{
+		g_memoryAccounts.add(MemoryAccounts::kShared, MemCategory::kPaths,
+			                 (int64_t)(nBytes - prevBytes), 1);
+	}
+
+	// Publish it (readers only ever look up ids they were given, i.e.
+	// ones published before).
+	nPaths.store(index + 1, std::memory_order_release);
+	return id;
+}
\ No newline at end of file
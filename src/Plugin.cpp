@@ -26,20 +26,93 @@
 // (The MIT License)
 // ============================================================================
 #include "Plugin.h"
+#include "AnimPrefetcher.h"
+#include "ConditionCache.h"
+#include "ConditionEvents.h"
+#include "Hooks.h"
 #include "DARProjectRegistry.h"
 #include "DARProject.h"
+#include "DARHotReload.h"
+#include "FactionRanks.h"
+#include "MemoryAccounting.h"
+#include "StartupTimes.h"
 #include "Utilities.h"
+#include "WorldState.h"
 
 #include "RE/S/SettingCollectionList.h"
 #include "RE/S/Setting.h"
+#include "RE/T/TESDataHandler.h"
 #include "RE/Offsets.h"
 
 namespace Plugin
 {
 	uint32_t g_MAX_ANIMATION_FILES = 16384;
+	bool g_bWarmDARProjects = true;
+	bool g_bHotReload = false;
+	uint32_t g_WorldStateMaxAgeMs = 16;
+	uint32_t g_FactionRanksMaxAgeMs = 250;
+	bool g_bPrefetchAnimations = true;
+	uint32_t g_PrefetchKBPerSecond = 8192;
+
+	void logMemoryReport()
+	{
+		g_memoryAccounts.report([](const char* line) { _MESSAGE("%s", line); });
+	}
+
+	static void initDARLoading(TESDataHandler* dh)
+	{
+		// Gives the loaders what they need from the data handler, so that
+		// they never have to touch it (see DARGH::initDARLoading).
+		std::string dataDir = getSkyrimDirectory() + "data\\";
+
+		// Index the load order, and note each active plugin's archive.
+		// N.B. like LookupModByName, the index covers every file the data
+		// handler knows of (with the first of any duplicate names winning).
+		LoadOrderIndex loadOrder;
+		std::vector<std::string> archivePaths;    // in load order
+		for (auto& file : dh->files)
+		{
+			LoadOrderIndex::Mod mod;
+			mod.compileIndex = file->compileIndex;
+			mod.smallFileCompileIndex = file->smallFileCompileIndex;
+			mod.isESL = ((file->recordFlags & 0x200) != 0);
+			loadOrder.add(file->fileName, mod);
+
+			if (file->compileIndex == 0xFF)
+			{
+				continue;    // not active
+			}
+			std::string archivePath = file->fileName;
+			size_t dot = archivePath.rfind('.');
+			if (dot != std::string::npos)
+			{
+				archivePath.resize(dot);
+			}
+			archivePaths.push_back(dataDir + archivePath + ".bsa");
+		}
+		DARGH::initDARLoading(dataDir, std::move(loadOrder), std::move(archivePaths));
+	}
 
 	void HandleSKSEMessage(SKSEMessagingInterface::Message * msg)
 	{
+		if (msg->type == SKSEMessagingInterface::kMessage_SaveGame)
+		{
+			// Saving is as good an "on demand" trigger as any for
+			// writing out the lock contention and memory reports.
+			logHookLockStats();
+			logMemoryReport();
+			return;
+		}
+		if (msg->type == SKSEMessagingInterface::kMessage_PostLoadGame
+			|| msg->type == SKSEMessagingInterface::kMessage_NewGame)
+		{
+			// Loading restores every actor's equipment, combat state, ...
+			// without sending the events the cached conditions rely on
+			// (and every actor's factions).
+			g_conditionCache.clear();
+			g_factionRanks.invalidateAll();
+			return;
+		}
 		if (msg->type != SKSEMessagingInterface::kMessage_DataLoaded) return;
 		
 		// --------------------------------------------------------------------
@@ -55,7 +128,9 @@ namespace Plugin
 		// --------------------------------------------------------------------
 		//  2. Register two projects (male & female) for each loaded race.
 		// --------------------------------------------------------------------
+		g_startupTimes.startPhase("project registration");
 		std::string sProjName;
+		std::vector<std::string> warmProjects;    // loaded up front (see 4.)
 		for (int i = 0; i < dh->formArrays[FormType::Race].count; ++i)
 		{
 			TESRace* race = (TESRace*)dh->formArrays[FormType::Race].entries[i];
@@ -72,6 +147,12 @@ namespace Plugin
 					{
 						sProjName.assign(projName);
 						DARGH::registerDARProject(sProjName);
+						if (_strnicmp(projName, "actors\\character\\", 17) == 0
+							&& !strchr(projName + 17, '\\'))
+						{
+							// One of the (humanoid) character projects.
+							warmProjects.push_back(sProjName);
+						}
 					}
 				}
 			}
@@ -93,27 +174,45 @@ namespace Plugin
 			{
 				sProjName.assign(*projName);
 				DARGH::registerDARProject(sProjName);
+				warmProjects.push_back(sProjName);
 			}
 		}	
 	
 		// --------------------------------------------------------------------
-		//  4. Load applicable DAR mappings for the registered projects.
+		//  4. Get ready to load the DAR mappings. Each project's are loaded
+		//     when the game first generates its animations; the character
+		//     and 1st person ones are warmed up in the background now.
+		//     (Each project's load times are logged as it's loaded.)
 		// --------------------------------------------------------------------
-		std::string meshesDir = getSkyrimDirectory() + "data\\meshes\\";
-		for (auto& entry : DARGH::g_DARProjectRegistry)
+		g_startupTimes.startPhase("loading setup");
+		g_worldState.setMaxAge(std::chrono::milliseconds(g_WorldStateMaxAgeMs));
+		g_factionRanks.setMaxAge(std::chrono::milliseconds(g_FactionRanksMaxAgeMs));
+		registerConditionEventSinks();
+		initDARLoading(dh);
+		DARGH::g_isDARDataLoaded = true;
+		if (g_bHotReload)
 		{
-			DARProject& darProj = entry.second;
-
-			std::string darDir =
-				meshesDir + darProj.projFolder + 
-				"\\animations\\DynamicAnimationReplacer";
-			// ... i.e.
-			//     "data\meshes\actors\(project folder)\
-			//        animations\DynamicAnimationReplacer"
-
-			DARGH::loadDARMaps_ActorBase(darProj, dh, darDir);
-			DARGH::loadDARMaps_Conditional(darProj, dh, darDir);
+			DARGH::startDARHotReload();
 		}
-		DARGH::g_isDARDataLoaded = true;
+		if (g_bWarmDARProjects)
+		{
+			DARGH::warmDARProjects(warmProjects);
+		}
+		if (g_bPrefetchAnimations)
+		{
+			AnimPrefetcher::Settings settings;
+			settings.bytesPerSecond = (uint64_t)g_PrefetchKBPerSecond * 1024;
+			g_animPrefetcher.configure(settings);
+			g_animPrefetcher.start();
+		}
+
+		// --------------------------------------------------------------------
+		//  5. What's held so far (any projects being warmed up will be
+		//     in the report written when the game is next saved), and
+		//     how long all that took.
+		// --------------------------------------------------------------------
+		g_startupTimes.endPhase();
+		logMemoryReport();
+		g_startupTimes.report("data load times", [](const char* line) { _MESSAGE("%s", line); });
 	}
 }
\ No newline at end of file
@@ -77,6 +77,10 @@ namespace RE
 	_Actor_IsMoving Actor_IsMoving;
 	_Actor_GetMoveDirRelToFacing Actor_GetMoveDirRelToFacing;
 	_AnimationFileManager_Load AnimationFileManager_Load;
+	_ScriptEventSourceHolder_GetSingleton ScriptEventSourceHolder_GetSingleton;
+	_MemoryManager_GetSingleton MemoryManager_GetSingleton;
+	_MemoryManager_Allocate MemoryManager_Allocate;
+	_MemoryManager_Deallocate MemoryManager_Deallocate;
 
 	std::vector<std::tuple<void*, uint64_t, uint64_t>> skyrim_addr
 	{
@@ -138,7 +142,13 @@ namespace RE
 		{ &Actor_GetMoveDirRelToFacing,                  37960,         0  },     //  40  [0x00642340]
 
 		// Use this to avoid deriving it via g_AnimFileManager VFT (which is what DAR does):
-		{ &AnimationFileManager_Load,                    63982,         0  }      //  41  [0x00B40D10]
+		{ &AnimationFileManager_Load,                    63982,         0  },     //  41  [0x00B40D10]
+
+		// Used for sinking the game events that invalidate cached conditions: ----
+		{ &ScriptEventSourceHolder_GetSingleton,        400475,         0  },     //  42
+		{ &MemoryManager_GetSingleton,                   11141,         0  },     //  43
+		{ &MemoryManager_Allocate,                       68115,         0  },     //  44
+		{ &MemoryManager_Deallocate,                     68117,         0  }      //  45
 		// ====================================================================================================
 	};
 
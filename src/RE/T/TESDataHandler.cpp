@@ -41,9 +41,15 @@
 
 const TESFile* LookupModByName(TESDataHandler* dh, std::string_view a_modName)
 {
+	// N.B. a_modName needn't be null terminated.
+	if (a_modName.size() >= sizeof(TESFile::fileName))
+	{
+		return nullptr;
+	}
 	for (auto& file : dh->files)
 	{
-		if (_stricmp(file->fileName, a_modName.data()) == 0)
+		if (_strnicmp(file->fileName, a_modName.data(), a_modName.size()) == 0
+			&& file->fileName[a_modName.size()] == '\0')
 		{
 			return file;
 		}
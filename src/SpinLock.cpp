@@ -0,0 +1,190 @@
+// ============================================================================
+//                               SpinLock.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "SpinLock.h"
+
+#include <chrono>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#pragma comment(lib, "Synchronization.lib")    // WaitOnAddress, WakeByAddressSingle
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DARGH_CPU_PAUSE() _mm_pause()
+#else
+#define DARGH_CPU_PAUSE() std::this_thread::yield()
+#endif
+
+#ifdef DARGH_SPINLOCK_STATS
+static uint64_t nowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t histBucket(uint64_t ns)
+{
+	uint32_t bucket = 0;
+	while (ns > 1 && bucket < SpinLock::kNumHistBuckets - 1)
+	{
+		ns >>= 1;
+		++bucket;
+	}
+	return bucket;
+}
+
+void SpinLock::recordAcquired(uint64_t waitNs)
+{
+	acquiredAt = nowNs();
+	stats.nAcquired.fetch_add(1, std::memory_order_relaxed);
+	stats.waitHist[histBucket(waitNs)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void SpinLock::recordReleased()
+{
+	stats.holdHist[histBucket(nowNs() - acquiredAt)].fetch_add(1, std::memory_order_relaxed);
+}
+#endif
+
+void SpinLock::lockContended()
+{
+	// ====================================================================
+	//                          lockContended
+	// --------------------------------------------------------------------
+	// Slow path of lock(): the first compare-exchange failed.
+	// ====================================================================
+#ifdef DARGH_SPINLOCK_STATS
+	uint64_t waitStart = nowNs();
+	stats.nContended.fetch_add(1, std::memory_order_relaxed);
+#endif
+	// 1. Spin (test-and-test-and-set with exponential backoff).
+	uint32_t backoff = 1;
+	for (uint32_t attempt = 0; attempt < kSpinLimit || !park; ++attempt)
+	{
+		for (uint32_t i = 0; i < backoff; ++i)
+		{
+			DARGH_CPU_PAUSE();
+		}
+		if (backoff < kMaxBackoff)
+		{
+			backoff <<= 1;
+		}
+
+		// Only try for the lock when it looks free.
+		uint32_t expected = kUnlocked;
+		if (state.load(std::memory_order_relaxed) == kUnlocked
+			&& state.compare_exchange_weak(expected, kLocked,
+				                           std::memory_order_acquire))
+		{
+#ifdef DARGH_SPINLOCK_STATS
+			recordAcquired(nowNs() - waitStart);
+#endif
+			return;
+		}
+		if (!park && backoff == kMaxBackoff)
+		{
+			// Never park, but at least give up the time slice.
+			std::this_thread::yield();
+		}
+	}
+
+	// 2. Park. Mark the lock as having waiters (so that unlock() wakes
+	// one of us up) and sleep until it's released. If the exchange
+	// returns kUnlocked we've got the lock, albeit in the
+	// kLockedWithWaiters state, which only costs a spare wake-up.
+	while (state.exchange(kLockedWithWaiters, std::memory_order_acquire) != kUnlocked)
+	{
+#ifdef DARGH_SPINLOCK_STATS
+		stats.nParked.fetch_add(1, std::memory_order_relaxed);
+#endif
+		parkWhile(kLockedWithWaiters);
+	}
+#ifdef DARGH_SPINLOCK_STATS
+	recordAcquired(nowNs() - waitStart);
+#endif
+}
+
+void SpinLock::parkWhile(uint32_t value)
+{
+	// Sleep until the lock word no longer holds 'value' (spurious
+	// wake-ups are fine: the caller re-checks).
+#if defined(_WIN32)
+	WaitOnAddress(&state, &value, sizeof(value), INFINITE);
+#elif defined(__linux__)
+	syscall(SYS_futex, (uint32_t*)&state, FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+#else
+	std::this_thread::yield();
+#endif
+}
+
+void SpinLock::wakeOne()
+{
+#if defined(_WIN32)
+	WakeByAddressSingle(&state);
+#elif defined(__linux__)
+	syscall(SYS_futex, (uint32_t*)&state, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+}
+
+void SpinLock::addStatsTo([[maybe_unused]] Stats& stats_out) const
+{
+#ifdef DARGH_SPINLOCK_STATS
+	for (uint32_t i = 0; i < kNumHistBuckets; ++i)
+	{
+		stats_out.waitHist[i] += stats.waitHist[i].load(std::memory_order_relaxed);
+		stats_out.holdHist[i] += stats.holdHist[i].load(std::memory_order_relaxed);
+	}
+	stats_out.nAcquired += stats.nAcquired.load(std::memory_order_relaxed);
+	stats_out.nContended += stats.nContended.load(std::memory_order_relaxed);
+	stats_out.nParked += stats.nParked.load(std::memory_order_relaxed);
+#endif
+}
+
+void SpinLock::logStats([[maybe_unused]] const char* name, [[maybe_unused]] const Stats& stats)
+{
+#ifdef DARGH_SPINLOCK_STATS
+	_MESSAGE("lock stats: %s: %llu acquired, %llu contended, %llu parked",
+		name, stats.nAcquired.load(), stats.nContended.load(), stats.nParked.load());
+	_MESSAGE("   %-16s %12s %12s", "ns", "wait", "hold");
+	for (uint32_t i = 0; i < kNumHistBuckets; ++i)
+	{
+		uint64_t nWait = stats.waitHist[i].load();
+		uint64_t nHold = stats.holdHist[i].load();
+		if (nWait || nHold)
+		{
+			_MESSAGE("   < %-14llu %12llu %12llu", 2ull << i, nWait, nHold);
+		}
+	}
+#endif
+}
\ No newline at end of file
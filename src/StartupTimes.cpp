@@ -0,0 +1,117 @@
+// ============================================================================
+//                             StartupTimes.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "StartupTimes.h"
+
+#include <algorithm>
+#include <cstdio>
+
+StartupTimes g_startupTimes;
+
+static double toMs(StartupClock::duration elapsed)
+{
+	return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+void ProjectLoadTimes::addFolder(const std::string& priority, StartupClock::duration elapsed)
+{
+	if (slowestFolders.size() == kMaxSlowestFolders && elapsed <= slowestFolders.back().elapsed)
+	{
+		return;
+	}
+	auto pos = std::upper_bound(slowestFolders.begin(), slowestFolders.end(), elapsed,
+		[](StartupClock::duration slower, const Folder& folder) { return slower > folder.elapsed; });
+	slowestFolders.insert(pos, Folder{ priority, elapsed });
+	if (slowestFolders.size() > kMaxSlowestFolders)
+	{
+		slowestFolders.pop_back();
+	}
+}
+
+void ProjectLoadTimes::report(LineWriter write) const
+{
+	char line[512];
+	snprintf(line, sizeof(line), "%s: DAR maps loaded in %.3f ms",
+		     project.c_str(), toMs(treeTime + actorBaseTime + conditionalTime));
+	write(line);
+	snprintf(line, sizeof(line), "   %-12s %10.3f ms   (%s)", "tree", toMs(treeTime),
+		     bFromBundle ? "bundle" : "folder");
+	write(line);
+	snprintf(line, sizeof(line), "   %-12s %10.3f ms   %u files", "actor base",
+		     toMs(actorBaseTime), nActorBaseFiles);
+	write(line);
+	snprintf(line, sizeof(line), "   %-12s %10.3f ms   %u files, %u _conditions.txt (%.3f ms reading, parsing and binding)",
+		     "conditional", toMs(conditionalTime), nConditionalFiles, nConditionsFiles,
+		     toMs(parseTime));
+	write(line);
+	if (!slowestFolders.empty())
+	{
+		int n = snprintf(line, sizeof(line), "   slowest priority folders:");
+		for (auto& folder : slowestFolders)
+		{
+			if (n > 0 && (size_t)n < sizeof(line))
+			{
+				n += snprintf(line + n, sizeof(line) - n, " %s (%.3f ms)",
+					          folder.priority.c_str(), toMs(folder.elapsed));
+			}
+		}
+		write(line);
+	}
+}
+
+void StartupTimes::startPhase(const char* name)
+{
+	endPhase();
+	current = name;
+	currentStart = StartupClock::now();
+}
+
+void StartupTimes::endPhase()
+{
+	if (current)
+	{
+		ended.push_back(Phase{ current, StartupClock::now() - currentStart });
+		current = nullptr;
+	}
+}
+
+void StartupTimes::report(const char* title, LineWriter write)
+{
+	char line[512];
+	StartupClock::duration total{};
+	snprintf(line, sizeof(line), "%s:", title);
+	write(line);
+	for (auto& phase : ended)
+	{
+		snprintf(line, sizeof(line), "   %-32s %10.3f ms", phase.name, toMs(phase.elapsed));
+		write(line);
+		total += phase.elapsed;
+	}
+	snprintf(line, sizeof(line), "   %-32s %10.3f ms", "(total)", toMs(total));
+	write(line);
+	ended.clear();
+}
\ No newline at end of file
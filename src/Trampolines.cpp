@@ -27,6 +27,7 @@
 // ============================================================================
 #include "hooks.h"
 #include "trampolines.h"
+#include "DARAnimationNames.h"
 #include "DARProjectRegistry.h"
 #include "DARLink.h"
 #include "Plugin.h"
@@ -59,30 +60,6 @@ typedef uint64_t  (* _GenerateAnimation)
                   (hkbCharacterStringData*, hkbAnimationBindingSet*,
 				   uint64_t, uint64_t, const char*, uint64_t, uint64_t);
 
-typedef void      (* _hkbClipGenerator_Activate)
-                  (hkbClipGenerator*, hkbContext*);
-
-// ============================================================================
-//                        LOCAL HELPER STRUCTURES
-// ============================================================================
-// Temporary structures used when generating animations from DAR data:
-
-// Actor base remappings (method 1)
-struct obj16_m1
-{
-	uint32_t        animIndex_orig;
-	uint32_t        animIndex_new;
-	ActorBaseLink*  ActorBaseLink;
-};
-
-// Condition remappings (method 2)
-struct obj16_m2
-{
-	uint32_t        animIndex_orig;
-	uint32_t        animIndex_new;
-	ConditionLink*  ConditionLink;
-};
-
 // Prior to 1.6.629, DAR was using additional trampolines.
 // From 1.6.629, the active trampolines are just these two:
 
@@ -135,13 +112,10 @@ _GenerateAnimation GenAnimation_Orig;
 //                                                         |  hkbClipGenerator::activate(hkbCharacter character)
 //   40A42EE3  loc_40A42EE3 :                              |
 //   40A42EE3     movss   xmm2, dword ptr[rbx + 64h]  <=  trampoline jumps back here (0x13 bytes from (*))
-_hkbClipGenerator_Activate hkbClipGenerator_Activate;
 
 // ============================================================================
 //                    CODE RELATING TO TRAMPOLINE 1
 // ============================================================================
-bool g_ShownConditionError = false;
-
 uint64_t GenAnimation_Hook(const char* a7_dar, hkbAnimationBindingSet* a2, uint64_t a3,
 	                       uint64_t a4, const char* a5, uint64_t a6, hkbCharacter* a8_dar)
 {
@@ -200,78 +174,71 @@ uint64_t GenAnimation_Hook(const char* a7_dar, hkbAnimationBindingSet* a2, uint6
 					     projFilePath.c_str());
 #endif
 				DARProject& darProj = itProj->second;
+				DARGH::ensureDARMapsLoaded(darProj);
+				std::shared_ptr<const DARLinkTable> links = std::atomic_load(&darProj.links);
 				char** datAnimNames_Orig = (char**)hkbCharStringData_obj->animationNames._data;
 				uint32_t szAnimNames_Orig = hkbCharStringData_obj->animationNames._size;
 
 				if (szAnimNames_Orig > 0)
 				{
 					// ------------------------------------------------------------------------------
-					// Iterate over the animation names array, see what M1 and/or M2 mappings we have 
-					// for each one, temporarily store those mappings in m1data and m2data vectors.
+					// Rebuild the animation names array with the project's replacements, and the
+					// project's links to match (see DARAnimationNames.h).
 					// ------------------------------------------------------------------------------
-					std::vector<obj16_m1> m1data_vec;
-					std::vector<obj16_m2> m2data_vec;
-					std::string animName_Orig;
-
-					for (uint64_t i = 0; i < szAnimNames_Orig; ++i)
-					{
-						animName_Orig.assign((const char*)(*(datAnimNames_Orig + i)));
-						std::transform(animName_Orig.begin(), animName_Orig.end(),
-							           animName_Orig.begin(), tolower);
-
-						// Actor Base replacement animation files (M1).
-						for (auto& pM1Obj : darProj.actorBaseLinks)
-						{
-							if (pM1Obj.from_hkx_file == animName_Orig)
-							{
-								obj16_m1 m1data;
-								m1data.animIndex_orig = i;
-								m1data.ActorBaseLink = &pM1Obj;
-								m1data_vec.push_back(m1data);
-							}
-						}
-
-						// Conditional replacement animation files (M2).
-						for (auto& pM2Obj : darProj.conditionLinks)
-						{
-							if (pM2Obj.from_hkx_file == animName_Orig)
-							{
-								obj16_m2 m2data;
-								m2data.animIndex_orig = i;
-								m2data.ConditionLink = &pM2Obj;
-								m2data_vec.push_back(m2data);
-							}
-						}
-					}  // for (uint64_t i = 0; i < szAnimNames; ++i)
+					AnimationNames animNames;
+					DARGH::rebuildAnimationNames(darProj, *links, (const char* const*)datAnimNames_Orig,
+						                         szAnimNames_Orig, Plugin::g_MAX_ANIMATION_FILES, animNames);
+					uint32_t szAnimNames_New = animNames.nNames;
+					uint32_t nReplacements = szAnimNames_New - szAnimNames_Orig;
+#ifdef DEBUG_TRACE_TRAMPOLINES
+					_MESSAGE("    => Total anim files is %d = %d orig + %d unique replacements (%d M1 remaps + %d M2 remaps)",
+						     szAnimNames_New, szAnimNames_Orig, nReplacements,
+						     animNames.nM1Remaps, animNames.nM2Remaps);
+#endif
 
 					// ------------------------------------------------------------------------------
-					// Calculate the total number of replacement animations and inform the user.
-					// Also advise the user if we have breached the MAX_ANIMATION_FILES limit
-					// (by default this is 16384).
+					// Inform the user of the total number of animations. Also advise the user if we
+					// have breached the MAX_ANIMATION_FILES limit (by default this is 16384).
 					// ------------------------------------------------------------------------------
-					uint32_t szAnimNames_New = szAnimNames_Orig + m2data_vec.size() + m1data_vec.size();
-#ifdef DEBUG_TRACE_TRAMPOLINES
-					_MESSAGE("    => Total anim files is %d = %d orig + %d M1 remaps + %d M2 remaps",
-						     szAnimNames_New, szAnimNames_Orig, m1data_vec.size(), m2data_vec.size());
-#endif
 					if (!darProj.animationsLoaded)
 					{
 						darProj.animationsLoaded = true;
-						if (szAnimNames_New <= Plugin::g_MAX_ANIMATION_FILES)
+						if (animNames.dropped.empty())
 						{
 							_MESSAGE("%d / %d : %s", 
 								szAnimNames_New, Plugin::g_MAX_ANIMATION_FILES,
 								itProj->first.c_str());
+
+							// Per-project memory report for the rebuilt name array. Before
+							// right-sizing, every rebuild was padded out to MAX_ANIMATION_FILES
+							// slots (each padding slot holding its own 1 byte heap string).
+							uint32_t szPadded = Plugin::g_MAX_ANIMATION_FILES;
+							_MESSAGE("   binding slots: %d (%d orig + %d replacement), %d bytes of name pointers (padded layout: %d slots, %d bytes)",
+								szAnimNames_New, szAnimNames_Orig, szAnimNames_New - szAnimNames_Orig,
+								szAnimNames_New * 8, szPadded, szPadded * 8);
+							_MESSAGE("   replacement slots: %d for %d remaps (%d saved by sharing identical targets)",
+								nReplacements, animNames.nRemaps, animNames.nRemaps - nReplacements);
 						}
 						else
 						{
 							_MESSAGE("Too many animation files. %d / %d : %s",
-								szAnimNames_New, Plugin::g_MAX_ANIMATION_FILES,
+								animNames.nWanted, Plugin::g_MAX_ANIMATION_FILES,
 								itProj->first.c_str());
 
+							// Report exactly which links didn't make the cut. Everything
+							// else (all of the higher priority links) is still applied.
+							_MESSAGE("   %d of %d remaps dropped (%d replacement files), lowest priority first:",
+								(int)animNames.dropped.size(), animNames.nM1Remaps + animNames.nM2Remaps,
+								animNames.nRefusedFiles);
+							for (auto& dropped : animNames.dropped)
+							{
+								_MESSAGE("      [%d] %s => %s", dropped.priority,
+									g_pathTable.str(dropped.from_hkx_file), g_pathTable.str(dropped.to_hkx_file));
+							}
+
 							// Also display error via an in-game message box:
 							std::string msg = "Too many animation files.\n";
-							msg += std::to_string(szAnimNames_New);
+							msg += std::to_string(animNames.nWanted);
 							msg += " / ";
 							msg += std::to_string(Plugin::g_MAX_ANIMATION_FILES);
 							msg += "\n";
@@ -279,233 +246,17 @@ uint64_t GenAnimation_Hook(const char* a7_dar, hkbAnimationBindingSet* a2, uint6
 						}
 					}
 
-					// ------------------------------------------------------------------------------
-					// If there are available slots for the replacement animations, create
-					// a new hkArray with MAX_ANIMATION_FILES elements. Then copy into that:
-					//        (1) the M1 remapped animation file names
-					//        (2) the M2 remapped animation file names
-					//        (3) the original animation file names
-					// ------------------------------------------------------------------------------
-					if (szAnimNames_Orig < Plugin::g_MAX_ANIMATION_FILES)
+					if (animNames.names)
 					{
-						darProj.allLinks.clear();
-
-						char** datAnimNames_New =
-							(char**)operator new(8ui64 * Plugin::g_MAX_ANIMATION_FILES);
-						if (szAnimNames_New >= Plugin::g_MAX_ANIMATION_FILES)
-						{
-							// Put empty strings in the new hkArray, but we won't actually
-							// copy in any new animation remappings as there are not enough slots to
-							// include all of them (we only do all or none).
-							char** animName_New = datAnimNames_New;
-							for (uint16_t i = 0; i < Plugin::g_MAX_ANIMATION_FILES - szAnimNames_Orig;
-								++i, ++animName_New)
-							{
-								*animName_New = (char*)operator new(1);
-								strcpy_s(*animName_New, 1, "");
-							}
-						}
-						else
-						{
-							// ==============================================
-							//      1. COPY ACTOR BASE MAPPINGS (M1)
-							// ==============================================
-							for (uint16_t i = 0; i < m1data_vec.size(); ++i)
-							{
-								// Copy all non-null animation names from our M1 vector into our new hkArray.
-								const char* toHkxFile_M1 =
-									m1data_vec.at(i).ActorBaseLink->to_hkx_file.c_str();
-								if (toHkxFile_M1)
-								{
-									// Create a new string, copy the TO animation name from the
-									// m1 vector into it, then stash the pointer in the new array.
-									size_t sz = strlen(toHkxFile_M1);
-									char* toHkxFile_M1_dup = (char*)operator new(sz + 1);
-									strcpy_s(toHkxFile_M1_dup, sz + 1, toHkxFile_M1);
-									datAnimNames_New[i] = toHkxFile_M1_dup;
-								}
-								else
-								{
-									// No animation name to remap to, so stash a NULL in the new array.
-									datAnimNames_New[i] = 0;
-								}
-
-								// Calculate a revised animation index for the original FROM animation name.
-								uint32_t fromAnimIndex_rev = 
-									(Plugin::g_MAX_ANIMATION_FILES - szAnimNames_Orig) +
-									m1data_vec[i].animIndex_orig;
-									
-								// Does the revised anim index already exist in our link data map for this project?
-								// I.e. have we already stored M1 mappings to this index?
-								auto& search = darProj.allLinks.find(fromAnimIndex_rev);
-								if (search == darProj.allLinks.end())
-								{
-									// --------------------------------------------------------------------
-									// Revised FROM animation index was NOT found in the project hash map.
-									// --------------------------------------------------------------------
-									// Store the relevant data in a new BaseLinkData object.
-									BaseLinkData* oBLinkData = new BaseLinkData();
-									oBLinkData->allLinks.insert(
-										std::pair(m1data_vec[i].ActorBaseLink->actorBaseID, i)
-									);
-
-									// Create an ordered map, with <priority> => <BaseLinkData object>
-									// BaseLinkData always has a priority of 0.
-									std::map<int, LinkData*, std::greater<int>> oMap;
-									oMap.insert(std::pair<int, LinkData*>(0, oBLinkData));
-									darProj.allLinks.insert(
-										std::pair<uint32_t, std::map<int, LinkData*, std::greater<int>>>
-										(fromAnimIndex_rev, oMap)
-									);
-								}
-								else
-								{
-									// --------------------------------------------------------------------
-									// Revised FROM animation index WAS found in the project hash map.
-									// --------------------------------------------------------------------
-									// Retrieve the BaseLinkData object in the existing ordered map and add this
-									// TO mapping to that. There should only be one BaseLinkData object in 
-									// the map (if not next line will throw exception), with priority of 0.
-									BaseLinkData* oBLinkData =
-										dynamic_cast<BaseLinkData*>(search->second.at(0));
-									oBLinkData->allLinks.insert(
-										std::pair(m1data_vec[i].ActorBaseLink->actorBaseID, i)
-									);
-								}
-							} // for (uint16_t i = 0; i < m1data.size(); ++i)
-							
-							// ==============================================
-							//        2. COPY CONDITION MAPPINGS (M2)
-							// ==============================================
-							uint16_t startIndex = m1data_vec.size();
-							uint16_t destIndex;
-							for (uint16_t i = 0; i < m2data_vec.size(); i++)
-							{
-								destIndex = startIndex + i;
-								const char* toHkxFile_M2 =
-									m2data_vec.at(i).ConditionLink->to_hkx_file.c_str();
-								if (toHkxFile_M2)
-								{
-									// Create a new string, copy the TO animation name from the
-									// m2 vector into it, then stash the pointer in the new array.
-									size_t sz = strlen(toHkxFile_M2);
-									char* toHkxFile_M2_dup = (char*)operator new(sz + 1);
-									strcpy_s(toHkxFile_M2_dup, sz + 1, toHkxFile_M2);
-									datAnimNames_New[destIndex] = toHkxFile_M2_dup;
-								}
-								else
-								{
-									// No animation name to remap to, so stash a NULL in the new array.
-									datAnimNames_New[destIndex] = 0;
-								}
-								
-								// Calculate new animation index for the FROM animation name.
-								// And get the priority.
-								int priority = m2data_vec[i].ConditionLink->priority;
-								uint32_t fromAnimIndex_rev = 
-									(Plugin::g_MAX_ANIMATION_FILES - szAnimNames_Orig) +
-									m2data_vec[i].animIndex_orig;
-									
-								// Does the new anim index already exist in our link data map for this project?
-								// I.e. have we already stored M2 mappings to this index?
-								auto& search = darProj.allLinks.find(fromAnimIndex_rev);
-								if (search == darProj.allLinks.end())
-								{
-									// --------------------------------------------------------------------
-									// Revised FROM animation index was NOT found in the project hash map.
-									// --------------------------------------------------------------------
-									// Store the relevant data in a new ConditionLinkData object.
-									ConditionLinkData* oCLinkData = new ConditionLinkData();
-									oCLinkData->conditions = m2data_vec[i].ConditionLink->conditions;
-									oCLinkData->to_hkx_index = destIndex;
-
-									// Create an ordered map, with <priority> => <ConditionLinkData object>.
-									// ConditionLinkData can have any priority from -ve to +ve, except 0.
-									// Larger numbers mean greater priority (and thus their associated
-									// ConditionLinkData objects should appear earlier when iterating
-									// over the map).
-									std::map<int, LinkData*, std::greater<int>> oMap;
-									oMap.insert(std::pair(priority, (LinkData*)oCLinkData));
-									darProj.allLinks.insert(
-										std::pair<uint32_t, std::map<int, LinkData*, std::greater<int>>>
-										(fromAnimIndex_rev, oMap)
-									);
-								}
-								else
-								{
-									// --------------------------------------------------------------------
-									// Revised FROM animation index WAS found in the project hash map.
-									// --------------------------------------------------------------------
-									// Store the relevant data in a new ConditionLinkData object.
-									ConditionLinkData* oCLinkData = new ConditionLinkData();
-									oCLinkData->conditions = m2data_vec[i].ConditionLink->conditions;
-									oCLinkData->to_hkx_index = destIndex;
-									
-									// Retrieve the existing ordered map, then add the ConditionLinkData
-									// object to it.
-									std::map<int, LinkData*, std::greater<int>>& oMap = search->second;
-									const auto [it, success2] =
-										oMap.insert(std::pair(priority, (LinkData*)oCLinkData));
-									if (!success2 && !g_ShownConditionError)
-									{
-										g_ShownConditionError = true;
-										_ERROR("couldn't add conditions");
-									}
-								}
-							} // for (uint16_t i = 0; i < m2data.size(); i++)
-
-							// ============================================================================
-							//    3. PAD ANY REMAINING ELEMENTS WITH EMPTY STRINGS, UNTIL WE
-							//       REACH THE START OF THE ORIGINAL FILE NAME SLOTS.
-							// ============================================================================
-							uint16_t j = m2data_vec.size() + m1data_vec.size();
-							char** animName_New = &datAnimNames_New[j];
-							for (uint16_t i = j; i < Plugin::g_MAX_ANIMATION_FILES - szAnimNames_Orig;
-								 ++i, ++animName_New)
-							{
-								*animName_New = (char*)operator new(1);
-								strcpy_s(*animName_New, 1, "");
-							}
-						} // if (nAnimationFiles <= g_MAX_ANIMATION_FILES)
-
-						// ==============================================
-						//    4. FINALLY, COPY THE ORIGINAL FILE NAMES.
-						// ==============================================
-						uint16_t startIndex = Plugin::g_MAX_ANIMATION_FILES - szAnimNames_Orig;
-						char** pDestAnimName = &datAnimNames_New[startIndex];
-						char** pSrcAnimName = datAnimNames_Orig;
-						for (uint16_t i = startIndex; i < Plugin::g_MAX_ANIMATION_FILES;
-							 ++i, ++pDestAnimName, ++pSrcAnimName)
-						{
-							const char* srcAnimName = *pSrcAnimName;
-							char* destAnimName = *pDestAnimName;
-							if (srcAnimName != destAnimName)
-							{
-								if (srcAnimName)
-								{
-									size_t sz = strlen(srcAnimName);
-									*pDestAnimName = (char*)operator new(sz + 1);
-									strcpy_s(*pDestAnimName, sz + 1, srcAnimName);
-								}
-								else
-								{
-									*pDestAnimName = 0;
-								}
-							}
-						}
-
-						// ==============================================
-						//                 4. DONE...!
-						// ==============================================
 						// We're done: replace the arguments with our modified version.
 #ifdef DEBUG_TRACE_TRAMPOLINES
 						_MESSAGE("We're done! Overwriting the original mappings...");
 #endif
 						cacheModifiedCharStringData(hkbCharStringData_obj);
-						hkbCharStringData_obj->animationNames._data = (uint64_t)datAnimNames_New;
-						hkbCharStringData_obj->animationNames._size = Plugin::g_MAX_ANIMATION_FILES;
+						hkbCharStringData_obj->animationNames._data = (uint64_t)animNames.names;
+						hkbCharStringData_obj->animationNames._size = szAnimNames_New;
 						darProj.projData = projData;
-					} // if (szAnimNames_Orig < Plugin::g_MAX_ANIMATION_FILES)
+					}
 				} // if ( szAnimNames_Orig > 0 )
 			} // if (itProj != Plugin::g_ProjDataMap.end())
 		}
@@ -554,9 +305,10 @@ void AnimationLoader_Hook(uint64_t a1, hkbContext* a2, hkbClipGenerator* a3, uin
 	_MESSAGE("                      AnimationLoader_Hook                       ");
 	_MESSAGE("-----------------------------------------------------------------");
 #endif
-	uint16_t origIndex = a3->animationBindingIndex;
-	uint16_t newIndex;
+	hkInt16 origIndex = a3->animationBindingIndex;
+	hkInt16 newIndex;
 	DARProject* darProj;
+	std::shared_ptr<const DARLinkIndex> linkIndex;
 	
 	// Assume here that the hkbCharacter reference is stored in a
 	// BShkbAnimationGraph object o, at o.characterInstance (offset 0xC0):
@@ -572,8 +324,9 @@ void AnimationLoader_Hook(uint64_t a1, hkbContext* a2, hkbClipGenerator* a3, uin
 			 DARGH::getDARProject(a2->character->projectData)) != 0
 		&& tesActor != 0
 		&& tesActor->ref.form.formType == FormType::ActorCharacter
+		&& (linkIndex = findGraphLinkIndex(darProj, a2->character)) != NULL
 		&& (newIndex = 
-			 DARGH::getNewAnimIndex(darProj, origIndex, tesActor)) != -1)
+			 decideClipReplacement(a3, darProj, *linkIndex, origIndex, tesActor)) != -1)
 	{
 #ifdef DEBUG_TRACE_TRAMPOLINES
 		_MESSAGE("Replacing with index %d.", animIndex_New);
@@ -584,7 +337,7 @@ void AnimationLoader_Hook(uint64_t a1, hkbContext* a2, hkbClipGenerator* a3, uin
 		a3->animationBindingIndex = newIndex;
 		if (RE::AnimationFileManager_Load(a1, a2, a3, a4))
 		{
-			hkbClipGenerator_Activate(a3, a2);
+			activateClipGenerator(a3, a2);
 		}
 		a3->animationBindingIndex = origIndex;
 	}
@@ -598,7 +351,7 @@ void AnimationLoader_Hook(uint64_t a1, hkbContext* a2, hkbClipGenerator* a3, uin
 		// then, if successful, activate the clip generator.
 		if (RE::AnimationFileManager_Load(a1, a2, a3, a4))
 		{
-			hkbClipGenerator_Activate(a3, a2);
+			activateClipGenerator(a3, a2);
 		}
 	}
 }
@@ -676,15 +429,10 @@ bool install_trampolines()
 		return false;
 	}
 
-	// Store the address of hkbClipGenerator::Activate
-	// (the 4th entry in the VFT for hkbClipGenerator, i.e. offset 0x20)
-	// Potential TODO: this is also loaded and stored by Hooks.cpp, so could
-	// just do once and share. Irrespective, the perf overhead here is negligible
-	// (pointer dereferencing).
-	hkbClipGenerator_Activate =
-		(_hkbClipGenerator_Activate)*(uint64_t*)(RE::VTBL_hkbClipGenerator + 0x20);
-	_MESSAGE("hkbClipGenerator::Activate is at %#010x.",                                         // 0x40A42760
-		     hkbClipGenerator_Activate);
+	// N.B. the clip generators are (re)activated through activateClipGenerator(),
+	// i.e. the original hkbClipGenerator::Activate that Hooks.cpp stored (the 4th
+	// entry in the VFT for hkbClipGenerator, offset 0x20): the replacement has
+	// already been decided by then, so Hook 3 mustn't decide again.
 	
 	_MESSAGE("Successfully installed trampolines.");
 	return true;
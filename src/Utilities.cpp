@@ -27,7 +27,11 @@
 // ============================================================================
 #include "Utilities.h"
 
+#ifdef _WIN32
 #include <shlwapi.h>
+#endif
+#include <algorithm>
+#include <cctype>
 #include <filesystem>
 #include <sstream>
 
@@ -45,6 +49,7 @@ std::string trim(const std::string& s)
 	return s.substr(posStart, posLast - posStart + 1);
 }
 
+#ifdef _WIN32
 std::string getSkyrimDirectory()
 {
 	char path[MAX_PATH + 12];
@@ -56,6 +61,7 @@ std::string getSkyrimDirectory()
 	ret.append("\\");
 	return ret;
 }
+#endif
 
 bool startsWith(const std::string& str, const std::string& prefix)
 {
@@ -80,6 +86,7 @@ bool isNumber(const std::string& s)
 			[](unsigned char c) { return !std::isdigit(c); }) == s.end();
 }
 
+#ifdef _WIN32
 bool findMatchingFiles(std::string& dirToSearch,
 	                   std::vector<std::string>& matches_out,
 	                   bool filterToExt, bool recursive,
@@ -147,6 +154,7 @@ bool findMatchingFiles(std::string& dirToSearch,
 	FindClose(hFindFile);
 	return true;
 }
+#endif
 
 std::vector<std::string> splitOnPipes(std::vector<std::string>& vec,
 	                                  std::string sArg)
@@ -0,0 +1,153 @@
+// ============================================================================
+//                              WorldState.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "WorldState.h"
+
+#include <cstring>
+#include <mutex>
+
+static uint32_t addKey(std::vector<FeatureKey>& keys, const FeatureKey& key)
+{
+	for (size_t slot = 0; slot < keys.size(); slot++)
+	{
+		if (keys[slot] == key)
+		{
+			return (uint32_t)slot;
+		}
+	}
+	keys.push_back(key);
+	return (uint32_t)(keys.size() - 1);
+}
+
+uint32_t WorldState::addNum(const FeatureKey& key)
+{
+	std::lock_guard<SpinLock> guard(registryLock);
+	uint32_t slot = addKey(numKeys, key);
+	if (numSources.size() < numKeys.size())
+	{
+		numSources.push_back(findNumSource ? findNumSource(key) : nullptr);
+	}
+	nNumKeys = numKeys.size();
+	return slot;
+}
+
+uint32_t WorldState::addFormID(const FeatureKey& key)
+{
+	std::lock_guard<SpinLock> guard(registryLock);
+	uint32_t slot = addKey(formIDKeys, key);
+	nFormIDKeys = formIDKeys.size();
+	return slot;
+}
+
+void WorldState::setMaxAge(Clock::duration maxAge)
+{
+	maxAgeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(maxAge).count();
+}
+
+template <typename T>
+static void setVersions(const std::vector<T>& values, const std::vector<T>* prevValues,
+	                    const std::vector<uint64_t>* prevVersions, uint64_t& lastVersion,
+	                    uint64_t& nChanged, std::vector<uint64_t>& versions_out)
+{
+	// A value keeps its version for as long as it's bitwise unchanged (so a
+	// NaN doesn't count as changing every time), and otherwise gets a new
+	// one. Values that weren't in the previous snapshot are new.
+	versions_out.resize(values.size());
+	for (size_t slot = 0; slot < values.size(); slot++)
+	{
+		if (prevValues && slot < prevValues->size()
+			&& std::memcmp(&values[slot], &(*prevValues)[slot], sizeof(T)) == 0)
+		{
+			versions_out[slot] = (*prevVersions)[slot];
+		}
+		else
+		{
+			versions_out[slot] = ++lastVersion;
+			nChanged++;
+		}
+	}
+}
+
+bool WorldState::isFresh(const Snapshot* snapshot, Clock::time_point now) const
+{
+	return snapshot
+		&& snapshot->nums.size() >= nNumKeys
+		&& snapshot->formIDs.size() >= nFormIDKeys
+		&& std::chrono::duration_cast<std::chrono::nanoseconds>(now - snapshot->taken).count()
+		   <= maxAgeNs;
+}
+
+std::shared_ptr<const WorldState::Snapshot> WorldState::get(Clock::time_point now)
+{
+	std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&current);
+	if (isFresh(snapshot.get(), now))
+	{
+		return snapshot;
+	}
+
+	// Retake it, unless another thread just has.
+	std::lock_guard<SpinLock> guard(snapshotLock);
+	snapshot = std::atomic_load(&current);
+	if (isFresh(snapshot.get(), now))
+	{
+		return snapshot;
+	}
+
+	// (Read the game without holding the registry lock.)
+	std::vector<FeatureKey> nums, formIDs;
+	std::vector<const float*> sources;
+	{
+		std::lock_guard<SpinLock> registryGuard(registryLock);
+		nums = numKeys;
+		sources = numSources;
+		formIDs = formIDKeys;
+	}
+	std::shared_ptr<Snapshot> fresh = std::make_shared<Snapshot>();
+	fresh->taken = now;
+	fresh->nums.reserve(nums.size());
+	for (size_t slot = 0; slot < nums.size(); slot++)
+	{
+		fresh->nums.push_back(sources[slot] ? *sources[slot] : readNum(nums[slot]));
+	}
+	fresh->formIDs.reserve(formIDs.size());
+	for (auto& key : formIDs)
+	{
+		fresh->formIDs.push_back(readFormID(key));
+	}
+
+	const Snapshot* prev = snapshot.get();
+	uint64_t nChanged = 0;
+	setVersions(fresh->nums, prev ? &prev->nums : nullptr, prev ? &prev->numVersions : nullptr,
+		        lastVersion, nChanged, fresh->numVersions);
+	setVersions(fresh->formIDs, prev ? &prev->formIDs : nullptr, prev ? &prev->formIDVersions : nullptr,
+		        lastVersion, nChanged, fresh->formIDVersions);
+	nChanges += nChanged;
+	snapshot = fresh;
+	std::atomic_store(&current, snapshot);
+	nSnapshots++;
+	return snapshot;
+}
\ No newline at end of file
@@ -0,0 +1,284 @@
+// ============================================================================
+//                          AnimPrefetcherTest.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "AnimPrefetcher.h"
+#include "Conditions.h"
+#include "TestUtils.h"
+
+#include <map>
+
+// ============================================================================
+//                          AnimPrefetcherTest.cpp
+// ----------------------------------------------------------------------------
+// AnimPrefetcher with a mock reader and a clock of our own: which requests
+// it queues, which files it reads when, given its budget, and what it
+// remembers having read. Then the guards LikelyLink takes from compiled
+// condition chains.
+// ============================================================================
+
+namespace
+{
+	typedef AnimPrefetcher::Clock Clock;
+
+	// The mock's files: size by path (files not in it are missing), and
+	// the paths read, in order.
+	std::map<std::string, uint64_t> s_fileSizes;
+	std::vector<std::string> s_filesRead;
+
+	uint64_t readMockFile(const std::string& path)
+	{
+		s_filesRead.push_back(path);
+		auto search = s_fileSizes.find(path);
+		return search != s_fileSizes.end() ? search->second : 0;
+	}
+
+	// (Not the epoch: the prefetcher takes that to mean never.)
+	const Clock::time_point kStart = Clock::time_point{} + std::chrono::hours(1);
+
+	Clock::time_point at(double seconds)
+	{
+		return kStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+	}
+
+	AnimPrefetcher::Settings settings(uint64_t bytesPerSecond, uint64_t burstBytes, size_t maxFiles)
+	{
+		AnimPrefetcher::Settings settings;
+		settings.bytesPerSecond = bytesPerSecond;
+		settings.burstBytes = burstBytes;
+		settings.maxFiles = maxFiles;
+		return settings;
+	}
+
+	// Reads everything queued (with budget to spare).
+	void readAll(AnimPrefetcher& prefetcher)
+	{
+		while (prefetcher.readNext(kStart))
+		{
+		}
+	}
+
+	void testRequests()
+	{
+		s_filesRead.clear();
+		AnimPrefetcher prefetcher(readMockFile);
+		prefetcher.configure(settings(1 << 20, 1 << 30, 16));
+
+		// Paths are queued once, whatever their case.
+		CHECK(prefetcher.request("Meshes\\A.hkx"));
+		CHECK(!prefetcher.request("meshes\\a.HKX"));
+		CHECK(prefetcher.request("meshes\\b.hkx"));
+		CHECK(prefetcher.queueSize() == 2 && prefetcher.numQueued() == 2);
+
+		// In the order requested, and a missing file counts as read.
+		readAll(prefetcher);
+		CHECK(s_filesRead == std::vector<std::string>({ "meshes\\a.hkx", "meshes\\b.hkx" }));
+		CHECK(prefetcher.numRead() == 2 && prefetcher.bytesRead() == 0);
+		CHECK(prefetcher.queueSize() == 0);
+
+		// Files just read aren't queued again.
+		CHECK(!prefetcher.request("meshes\\A.hkx"));
+		CHECK(prefetcher.numRecent() == 1 && prefetcher.numQueued() == 2);
+		CHECK(!prefetcher.readNext(kStart));
+		CHECK(s_filesRead.size() == 2);
+	}
+
+	void testRecent()
+	{
+		// Only the last maxFiles files requested are remembered, least
+		// recently requested first out.
+		s_filesRead.clear();
+		AnimPrefetcher prefetcher(readMockFile);
+		prefetcher.configure(settings(1 << 20, 1 << 30, 3));
+		for (const char* path : { "a", "b", "c" })
+		{
+			CHECK(prefetcher.request(path));
+		}
+		readAll(prefetcher);
+		CHECK(!prefetcher.request("a"));    // (now the most recent)
+		CHECK(prefetcher.request("d"));
+		readAll(prefetcher);                // b is forgotten
+
+		CHECK(!prefetcher.request("a"));
+		CHECK(!prefetcher.request("c"));
+		CHECK(!prefetcher.request("d"));
+		CHECK(prefetcher.request("b"));
+		readAll(prefetcher);                // ... and now a
+
+		CHECK(!prefetcher.request("c") && !prefetcher.request("d") && !prefetcher.request("b"));
+		CHECK(prefetcher.request("a"));
+		CHECK(prefetcher.numRecent() == 7);
+		CHECK(s_filesRead == std::vector<std::string>({ "a", "b", "c", "d", "b" }));
+	}
+
+	void testQueueFull()
+	{
+		AnimPrefetcher prefetcher(readMockFile);
+		prefetcher.configure(settings(1 << 20, 1 << 30, 2));
+		CHECK(prefetcher.request("a") && prefetcher.request("b"));
+		CHECK(!prefetcher.request("c"));
+		CHECK(prefetcher.numDropped() == 1 && prefetcher.queueSize() == 2);
+		CHECK(prefetcher.readNext(kStart));
+		CHECK(prefetcher.request("c"));
+		CHECK(prefetcher.numDropped() == 1 && prefetcher.queueSize() == 2);
+	}
+
+	void testBudget()
+	{
+		// 1,000 bytes a second, at most 2,000 at once, files of 1,500.
+		s_filesRead.clear();
+		s_fileSizes.clear();
+		AnimPrefetcher prefetcher(readMockFile);
+		prefetcher.configure(settings(1000, 2000, 16));
+		for (int i = 0; i < 8; i++)
+		{
+			std::string path = "f" + std::to_string(i);
+			s_fileSizes[path] = 1500;
+			CHECK(prefetcher.request(path));
+		}
+
+		// The burst allowance is there to start with, and a file is read
+		// whole even if that overdraws it (to -1,000 here).
+		CHECK(prefetcher.readNext(at(0)));
+		CHECK(prefetcher.readNext(at(0)));
+		CHECK(!prefetcher.readNext(at(0)));
+		CHECK(prefetcher.numRead() == 2 && prefetcher.bytesRead() == 3000);
+
+		// Paid back at bytesPerSecond.
+		CHECK(!prefetcher.readNext(at(0.5)));
+		CHECK(!prefetcher.readNext(at(1.0)));
+		CHECK(prefetcher.readNext(at(1.01)));
+		CHECK(!prefetcher.readNext(at(1.01)));
+
+		// Time going backwards adds nothing.
+		CHECK(!prefetcher.readNext(at(0)));
+		CHECK(!prefetcher.readNext(at(1.01)));
+
+		// However long it's idle, it only builds up to the burst allowance:
+		// two files, not the rest.
+		CHECK(prefetcher.readNext(at(100)));
+		CHECK(prefetcher.readNext(at(100)));
+		CHECK(!prefetcher.readNext(at(100)));
+		CHECK(prefetcher.numRead() == 5 && prefetcher.queueSize() == 3);
+		s_fileSizes.clear();
+	}
+
+	// ------------------------------------------------------------------------
+	//                               LikelyLink
+	// ------------------------------------------------------------------------
+	const uint32_t kActorBaseID = 0x00013746;
+	const uint32_t kRaceID = 0x00013740;
+
+	struct Condition
+	{
+		uint16_t  funcId;
+		float     fVal;           // (a float arg)
+		uint32_t  formID;         // (otherwise)
+		bool      bNot;
+		bool      bAnd;
+	};
+
+	ConditionOp compile(const Condition& condition, FeatureLayout& layout)
+	{
+		ConditionArg args[kMaxConditionArgs];
+		args[0].bIsFloat = condition.formID == 0;
+		args[0].fVal = condition.fVal;
+		args[0].formID = condition.formID;
+		ConditionOp op = compileCondition(condition.funcId, args, layout);
+		op.bNot = condition.bNot;
+		op.bAnd = condition.bAnd;
+		return op;
+	}
+
+	// The guards of the chain 'conditions'; false if it has none.
+	bool guardsFrom(std::initializer_list<Condition> conditions, LikelyLink& link_out)
+	{
+		FeatureLayout layout;
+		ConditionProgram program;
+		for (auto& condition : conditions)
+		{
+			program.ops.push_back(compile(condition, layout));
+		}
+		link_out = LikelyLink();
+		return link_out.guardsFrom(program, layout);
+	}
+
+	void testLikelyLinks()
+	{
+		LikelyLink link;
+		CHECK(guardsFrom({ { kCondition_IsActorBase, 0, kActorBaseID, false, true },
+						   { kCondition_IsEquippedRightType, 7, 0, false, true },
+						   { kCondition_IsInCombat, 0, 0, false, true } }, link));
+		CHECK(link.guards == (LikelyLink::kActorBase | LikelyLink::kRightType));
+		CHECK(link.actorBaseID == kActorBaseID && link.equippedTypes[1] == 7);
+
+		ActorProfile profile;
+		profile.baseFormID = kActorBaseID;
+		profile.raceFormID = kRaceID;
+		profile.equippedTypes[1] = 7;
+		CHECK(link.matches(profile));
+		profile.equippedTypes[1] = 6;
+		CHECK(!link.matches(profile));
+		profile.equippedTypes[1] = 7;
+		profile.baseFormID++;
+		CHECK(!link.matches(profile));
+		profile.baseFormID--;
+
+		// The last condition's AND or OR doesn't matter.
+		CHECK(guardsFrom({ { kCondition_IsRace, 0, kRaceID, false, true },
+						   { kCondition_IsEquippedLeftType, 3, 0, false, false } }, link));
+		CHECK(link.guards == (LikelyLink::kRace | LikelyLink::kLeftType));
+		profile.equippedTypes[0] = 3;
+		CHECK(link.matches(profile));
+
+		// An OR anywhere else: nothing is required.
+		CHECK(!guardsFrom({ { kCondition_IsActorBase, 0, kActorBaseID, false, false },
+							{ kCondition_IsRace, 0, kRaceID, false, true } }, link));
+		CHECK(!guardsFrom({ { kCondition_IsActorBase, 0, kActorBaseID, false, true },
+							{ kCondition_IsInCombat, 0, 0, false, false },
+							{ kCondition_IsRace, 0, kRaceID, false, true } }, link));
+		CHECK(link.guards == 0 && !link.matches(profile));
+
+		// NOTs guard nothing; nor does a type given as a global.
+		CHECK(guardsFrom({ { kCondition_IsActorBase, 0, kActorBaseID, true, true },
+						   { kCondition_IsRace, 0, kRaceID, false, true } }, link));
+		CHECK(link.guards == LikelyLink::kRace && link.matches(profile));
+		CHECK(!guardsFrom({ { kCondition_IsRace, 0, kRaceID, true, true },
+							{ kCondition_IsEquippedRightType, 0, 0x00060000, false, true },
+							{ kCondition_IsInCombat, 0, 0, false, true } }, link));
+		CHECK(!link.matches(profile));
+	}
+}
+
+int main()
+{
+	testRequests();
+	testRecent();
+	testQueueFull();
+	testBudget();
+	testLikelyLinks();
+	return testResult();
+}
\ No newline at end of file
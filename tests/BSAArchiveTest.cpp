@@ -0,0 +1,561 @@
+// ============================================================================
+//                            BSAArchiveTest.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "BSAArchive.h"
+#include "TestUtils.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+
+// ============================================================================
+//                            BSAArchiveTest.cpp
+// ----------------------------------------------------------------------------
+// Writes small version 105 archives (stored, LZ4 compressed, with embedded
+// names) and reads them back with BSAArchive; then truncated and damaged
+// ones, which it must reject without believing the sizes they give. The
+// program counts its own allocations to check the last part.
+// ============================================================================
+
+namespace
+{
+	size_t s_largestAllocation = 0;
+}
+
+void* operator new(size_t size)
+{
+	if (size > s_largestAllocation)
+	{
+		s_largestAllocation = size;
+	}
+	void* p = malloc(size ? size : 1);
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+namespace
+{
+	void putU8(std::string& out, uint8_t val)
+	{
+		out.push_back((char)val);
+	}
+
+	void putU16(std::string& out, uint16_t val)
+	{
+		out.append((const char*)&val, sizeof(val));
+	}
+
+	void putU32(std::string& out, uint32_t val)
+	{
+		out.append((const char*)&val, sizeof(val));
+	}
+
+	void putU64(std::string& out, uint64_t val)
+	{
+		out.append((const char*)&val, sizeof(val));
+	}
+
+	void setU32(std::string& data, size_t offset, uint32_t val)
+	{
+		memcpy(&data[offset], &val, sizeof(val));
+	}
+
+	// ------------------------------------------------------------------------
+	//                                  LZ4
+	// ------------------------------------------------------------------------
+	void putLZ4Length(std::string& out, size_t length)
+	{
+		// (What's left of a length after the token's 15.)
+		for (; length >= 255; length -= 255)
+		{
+			putU8(out, 255);
+		}
+		putU8(out, (uint8_t)length);
+	}
+
+	void putLZ4Sequence(std::string& out, const char* literals, size_t nLiterals,
+		                size_t offset, size_t matchLength)
+	{
+		size_t nMatchExtra = matchLength ? matchLength - 4 : 0;
+		putU8(out, (uint8_t)((nLiterals < 15 ? nLiterals : 15) << 4
+							 | (nMatchExtra < 15 ? nMatchExtra : 15)));
+		if (nLiterals >= 15)
+		{
+			putLZ4Length(out, nLiterals - 15);
+		}
+		out.append(literals, nLiterals);
+		if (matchLength)
+		{
+			putU16(out, (uint16_t)offset);
+			if (nMatchExtra >= 15)
+			{
+				putLZ4Length(out, nMatchExtra - 15);
+			}
+		}
+	}
+
+	std::string compressLZ4Block(const char* src, size_t srcSize)
+	{
+		// Greedy, with the last matches and literals where the format wants
+		// them (no match within 12 bytes of the end; the last 5 literals).
+		std::string out;
+		std::vector<int64_t> lastSeen(1 << 12, -1);
+		size_t anchor = 0;
+		size_t pos = 0;
+		while (srcSize >= 12 && pos <= srcSize - 12)
+		{
+			uint32_t seq;
+			memcpy(&seq, src + pos, sizeof(seq));
+			uint32_t hash = (seq * 2654435761u) >> 20;
+			int64_t candidate = lastSeen[hash];
+			lastSeen[hash] = (int64_t)pos;
+			if (candidate >= 0 && pos - candidate <= 0xFFFF
+				&& memcmp(src + candidate, src + pos, 4) == 0)
+			{
+				size_t matchLength = 4;
+				while (pos + matchLength < srcSize - 5
+					   && src[candidate + matchLength] == src[pos + matchLength])
+				{
+					matchLength++;
+				}
+				putLZ4Sequence(out, src + anchor, pos - anchor, pos - candidate, matchLength);
+				pos += matchLength;
+				anchor = pos;
+			}
+			else
+			{
+				pos++;
+			}
+		}
+		putLZ4Sequence(out, src + anchor, srcSize - anchor, 0, 0);
+		return out;
+	}
+
+	struct LZ4Options
+	{
+		bool bBlockChecksums = false;
+		bool bContentSize = false;
+		bool bContentChecksum = false;
+		bool bStoreBlocks = false;      // as uncompressed blocks
+	};
+
+	std::string compressLZ4Frame(const std::string& src, const LZ4Options& options)
+	{
+		std::string out;
+		putU32(out, 0x184D2204);
+		putU8(out, (uint8_t)(0x60 | (options.bBlockChecksums ? 0x10 : 0)
+							 | (options.bContentSize ? 0x08 : 0) | (options.bContentChecksum ? 0x04 : 0)));
+		putU8(out, 0x40);    // 64 KB blocks
+		if (options.bContentSize)
+		{
+			putU64(out, src.size());
+		}
+		putU8(out, 0);       // header checksum (not checked)
+		const size_t kBlockSize = 64 << 10;
+		for (size_t pos = 0; pos < src.size(); pos += kBlockSize)
+		{
+			size_t size = std::min(kBlockSize, src.size() - pos);
+			if (options.bStoreBlocks)
+			{
+				putU32(out, 0x80000000 | (uint32_t)size);
+				out.append(src, pos, size);
+			}
+			else
+			{
+				std::string block = compressLZ4Block(src.data() + pos, size);
+				putU32(out, (uint32_t)block.size());
+				out += block;
+			}
+			if (options.bBlockChecksums)
+			{
+				putU32(out, 0);
+			}
+		}
+		putU32(out, 0);      // end mark
+		if (options.bContentChecksum)
+		{
+			putU32(out, 0);
+		}
+		return out;
+	}
+
+	// ------------------------------------------------------------------------
+	//                                  BSA
+	// ------------------------------------------------------------------------
+	const uint32_t kArchive_DirectoryNames = 0x001;
+	const uint32_t kArchive_FileNames      = 0x002;
+	const uint32_t kArchive_Compressed     = 0x004;
+	const uint32_t kArchive_EmbedNames     = 0x100;
+	const uint32_t kSize_ToggleCompression = 0x40000000;
+	const size_t kHeaderSize = 36;
+	const size_t kFolderRecordSize = 24;
+	const size_t kFileRecordSize = 16;
+
+	struct ArchiveFile
+	{
+		std::string folder;
+		std::string name;
+		std::string data;
+		bool        bToggleCompression = false;
+	};
+
+	struct WrittenFile
+	{
+		size_t recordOffset;     // of its file record
+		size_t dataOffset;
+		size_t dataSize;
+	};
+
+	std::string writeArchive(const std::vector<ArchiveFile>& files, uint32_t archiveFlags,
+		                     const LZ4Options& lz4Options, std::vector<WrittenFile>& written_out)
+	{
+		// Files must be grouped by folder.
+		std::vector<std::pair<std::string, std::vector<size_t>>> folders;
+		uint32_t totalFolderNameLength = 0, totalFileNameLength = 0;
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			if (folders.empty() || folders.back().first != files[i].folder)
+			{
+				folders.emplace_back(files[i].folder, std::vector<size_t>());
+				totalFolderNameLength += (uint32_t)files[i].folder.size() + 1;
+			}
+			folders.back().second.push_back(i);
+			totalFileNameLength += (uint32_t)files[i].name.size() + 1;
+		}
+
+		std::string out;
+		out.append("BSA\0", 4);
+		putU32(out, BSAArchive::kVersion);
+		putU32(out, (uint32_t)kHeaderSize);
+		putU32(out, archiveFlags);
+		putU32(out, (uint32_t)folders.size());
+		putU32(out, (uint32_t)files.size());
+		putU32(out, totalFolderNameLength);
+		putU32(out, totalFileNameLength);
+		putU16(out, 0);
+		putU16(out, 0);
+
+		// Folder records (hashes and offsets aren't read).
+		for (auto& folder : folders)
+		{
+			putU64(out, 0);
+			putU32(out, (uint32_t)folder.second.size());
+			putU32(out, 0);
+			putU64(out, 0);
+		}
+		// Folder names and file records; the records' sizes and offsets
+		// are filled in below.
+		written_out.assign(files.size(), WrittenFile());
+		for (auto& folder : folders)
+		{
+			putU8(out, (uint8_t)(folder.first.size() + 1));
+			out.append(folder.first.c_str(), folder.first.size() + 1);
+			for (size_t i : folder.second)
+			{
+				written_out[i].recordOffset = out.size();
+				putU64(out, 0);
+				putU32(out, 0);
+				putU32(out, 0);
+			}
+		}
+		for (auto& folder : folders)
+		{
+			for (size_t i : folder.second)
+			{
+				out.append(files[i].name.c_str(), files[i].name.size() + 1);
+			}
+		}
+		// File data.
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			const ArchiveFile& file = files[i];
+			size_t start = out.size();
+			if (archiveFlags & kArchive_EmbedNames)
+			{
+				std::string path = file.folder + "\\" + file.name;
+				putU8(out, (uint8_t)path.size());
+				out += path;
+			}
+			if (((archiveFlags & kArchive_Compressed) != 0) != file.bToggleCompression)
+			{
+				putU32(out, (uint32_t)file.data.size());
+				out += compressLZ4Frame(file.data, lz4Options);
+			}
+			else
+			{
+				out += file.data;
+			}
+			uint32_t size = (uint32_t)(out.size() - start);
+			setU32(out, written_out[i].recordOffset + 8,
+				   size | (file.bToggleCompression ? kSize_ToggleCompression : 0));
+			setU32(out, written_out[i].recordOffset + 12, (uint32_t)start);
+			written_out[i].dataOffset = start;
+			written_out[i].dataSize = size;
+		}
+		return out;
+	}
+
+	std::vector<ArchiveFile> testFiles()
+	{
+		// Some text, a long run (long matches) and some noise (long
+		// literals), in three folders of which we want two.
+		std::string text;
+		for (int i = 0; i < 3000; i++)
+		{
+			text += "IsActorBase(\"Skyrim.esm\" | 0x" + std::to_string(0x13746 + i % 7) + ") AND\r\n";
+		}
+		std::string noise(70000, '\0');
+		std::mt19937 rng(34);
+		for (auto& ch : noise)
+		{
+			ch = (char)rng();
+		}
+		const char* kFolder = "Meshes\\Actors\\Character\\Animations\\DynamicAnimationReplacer\\_CustomConditions\\100";
+		std::vector<ArchiveFile> files =
+		{
+			{ kFolder, "_conditions.txt", "IsFemale()\r\n" },
+			{ kFolder, "MT_Idle.hkx", text + std::string(5000, 'a') + noise },
+			{ kFolder, "empty.hkx", "" },
+			{ "textures\\actors", "skin.dds", noise },
+			{ "meshes/actors/character/animations/dynamicanimationreplacer/_customconditions/200", "tiny.hkx", "x" },
+		};
+		files[2].bToggleCompression = true;
+		return files;
+	}
+
+	bool wantFolder(std::string_view folder)
+	{
+		return folder.find("dynamicanimationreplacer") != std::string_view::npos;
+	}
+
+	std::string lowerPath(const ArchiveFile& file)
+	{
+		std::string path = file.folder + "\\" + file.name;
+		for (auto& ch : path)
+		{
+			ch = ch == '/' ? '\\' : (char)tolower((unsigned char)ch);
+		}
+		return path;
+	}
+
+	// ------------------------------------------------------------------------
+	//                                The tests
+	// ------------------------------------------------------------------------
+	void testArchive(const char* name, const std::string& path, uint32_t archiveFlags,
+		             const LZ4Options& lz4Options = LZ4Options())
+	{
+		std::vector<ArchiveFile> files = testFiles();
+		std::vector<WrittenFile> written;
+		if (!CHECK(writeFile(path, writeArchive(files, archiveFlags, lz4Options, written))))
+		{
+			return;
+		}
+		BSAArchive archive;
+		if (!CHECK(archive.open(path, wantFolder)))
+		{
+			fprintf(stderr, "  (%s: %s)\n", name, archive.error());
+			return;
+		}
+		// All but textures\actors\skin.dds.
+		if (!CHECK(archive.files().size() == 4))
+		{
+			return;
+		}
+		size_t iWanted = 0;
+		std::string data;
+		for (auto& file : files)
+		{
+			if (!wantFolder(lowerPath(file)))
+			{
+				continue;
+			}
+			const BSAArchive::File& archiveFile = archive.files()[iWanted++];
+			if (!CHECK(archiveFile.path == lowerPath(file))
+				|| !CHECK(archive.readFile(archiveFile, data) && data == file.data))
+			{
+				fprintf(stderr, "  (%s: %s)\n", name, archiveFile.path.c_str());
+			}
+		}
+	}
+
+	void testTruncated(const std::string& path)
+	{
+		// Every length short of the whole: no directory, no archive; after
+		// that, only the files that are all there can be read.
+		std::vector<ArchiveFile> files = testFiles();
+		std::vector<WrittenFile> written;
+		std::string data = writeArchive(files, kArchive_DirectoryNames | kArchive_FileNames
+										| kArchive_Compressed | kArchive_EmbedNames,
+										LZ4Options(), written);
+		size_t directorySize = written[0].dataOffset;
+		std::string fileData;
+		for (size_t size = 0; size < data.size(); size += (size < directorySize + 64 ? 1 : 509))
+		{
+			writeFile(path, data.substr(0, size));
+			BSAArchive archive;
+			bool bOpened = archive.open(path, [](std::string_view) { return true; });
+			if (!CHECK(bOpened == (size >= directorySize)))
+			{
+				fprintf(stderr, "  (truncated to %d bytes)\n", (int)size);
+				continue;
+			}
+			if (!bOpened)
+			{
+				CHECK(archive.error() && (strcmp(archive.error(), "truncated") == 0
+										  || (size < kHeaderSize && strcmp(archive.error(), "not a BSA") == 0)));
+				continue;
+			}
+			for (size_t i = 0; i < files.size(); i++)
+			{
+				bool bWhole = written[i].dataOffset + written[i].dataSize <= size;
+				if (!CHECK(archive.readFile(archive.files()[i], fileData) == bWhole)
+					|| (bWhole && !CHECK(fileData == files[i].data)))
+				{
+					fprintf(stderr, "  (truncated to %d bytes, file %d)\n", (int)size, (int)i);
+				}
+			}
+		}
+	}
+
+	void testOversized(const std::string& path)
+	{
+		// Header and record fields far bigger than the archive: rejected,
+		// and without allocating what they ask for.
+		std::vector<ArchiveFile> files = testFiles();
+		std::vector<WrittenFile> written;
+		std::string data = writeArchive(files, kArchive_DirectoryNames | kArchive_FileNames
+										| kArchive_Compressed, LZ4Options(), written);
+		const size_t kTooMuch = 64 << 20;
+		std::string bad;
+		std::string fileData;
+		for (size_t field : { 16, 20, 24, 28 })
+		{
+			for (uint32_t val : { 0x10000000u, 0x7FFFFFFFu, 0xFFFFFFFFu })
+			{
+				bad = data;
+				setU32(bad, field, val);
+				writeFile(path, bad);
+				BSAArchive archive;
+				s_largestAllocation = 0;
+				bool bOpened = archive.open(path, [](std::string_view) { return true; });
+				if (!CHECK(!bOpened || field == 24) || !CHECK(s_largestAllocation < kTooMuch))
+				{
+					fprintf(stderr, "  (header field at %d = 0x%X)\n", (int)field, val);
+				}
+			}
+		}
+
+		// A file record whose size (or offset) runs past the end.
+		for (size_t field : { 8, 12 })
+		{
+			bad = data;
+			setU32(bad, written[1].recordOffset + field, 0x3FFFFFFF);
+			writeFile(path, bad);
+			BSAArchive archive;
+			CHECK(archive.open(path, wantFolder));
+			s_largestAllocation = 0;
+			CHECK(!archive.readFile(archive.files()[1], fileData));
+			CHECK(archive.error() && strcmp(archive.error(), "truncated") == 0);
+			CHECK(s_largestAllocation < kTooMuch);
+			CHECK(archive.readFile(archive.files()[0], fileData) && fileData == files[0].data);
+		}
+
+		// Original sizes the data can't have.
+		uint32_t originalSize = (uint32_t)files[1].data.size();
+		for (uint32_t val : { 0u, originalSize - 1, originalSize + 1, 0x7FFFFFFFu, 0xFFFFFFFFu })
+		{
+			bad = data;
+			setU32(bad, written[1].dataOffset, val);
+			writeFile(path, bad);
+			BSAArchive archive;
+			CHECK(archive.open(path, wantFolder));
+			s_largestAllocation = 0;
+			if (!CHECK(!archive.readFile(archive.files()[1], fileData))
+				|| !CHECK(archive.error() && strcmp(archive.error(), "bad compressed data") == 0)
+				|| !CHECK(s_largestAllocation < kTooMuch))
+			{
+				fprintf(stderr, "  (original size 0x%X)\n", val);
+			}
+		}
+
+		// Damaged compressed data: an error or the right size, nothing else.
+		std::mt19937 rng(3);
+		for (int i = 0; i < 500; i++)
+		{
+			bad = data;
+			size_t start = written[1].dataOffset + 4;
+			size_t offset = start + rng() % (written[1].dataSize - 4);
+			bad[offset] ^= (char)(1 << (rng() % 8));
+			writeFile(path, bad);
+			BSAArchive archive;
+			CHECK(archive.open(path, wantFolder));
+			bool bRead = archive.readFile(archive.files()[1], fileData);
+			CHECK(bRead ? fileData.size() == originalSize : fileData.empty());
+		}
+	}
+}
+
+int main()
+{
+	TempDir tempDir("dargh-bsa");
+	std::string path = (tempDir.path / "test.bsa").string();
+
+	const uint32_t kNames = kArchive_DirectoryNames | kArchive_FileNames;
+	testArchive("stored", path, kNames);
+	testArchive("compressed", path, kNames | kArchive_Compressed);
+	LZ4Options lz4Options;
+	lz4Options.bBlockChecksums = lz4Options.bContentSize = lz4Options.bContentChecksum = true;
+	testArchive("compressed, with checksums", path, kNames | kArchive_Compressed, lz4Options);
+	lz4Options = LZ4Options();
+	lz4Options.bStoreBlocks = true;
+	testArchive("compressed, stored blocks", path, kNames | kArchive_Compressed, lz4Options);
+	testArchive("stored, embedded names", path, kNames | kArchive_EmbedNames);
+	testArchive("compressed, embedded names", path, kNames | kArchive_Compressed | kArchive_EmbedNames);
+
+	BSAArchive archive;
+	CHECK(!archive.open(path + ".missing", wantFolder) && !archive.error());
+	writeFile(path, std::string("BSA\0\x68\0\0\0", 8));
+	CHECK(!archive.open(path, wantFolder) && archive.error());
+
+	testTruncated(path);
+	testOversized(path);
+	return testResult();
+}
\ No newline at end of file
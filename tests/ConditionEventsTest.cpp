@@ -0,0 +1,342 @@
+// ============================================================================
+//                          ConditionEventsTest.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "ConditionCache.h"
+#include "ConditionEvents.h"
+#include "TestGame.h"
+#include "TestUtils.h"
+
+#include <thread>
+
+// ============================================================================
+//                          ConditionEventsTest.cpp
+// ----------------------------------------------------------------------------
+// ConditionEvents (which scopes of an actor are dirty, given the events
+// notified), and what ConditionCache entries make of it: which scopes an
+// activation reads again, and so which cached results still stand.
+// ============================================================================
+
+namespace
+{
+	const uint32_t kActor = scopeBit(FeatureScope::kActor);
+	const uint32_t kStatic = scopeBit(FeatureScope::kStatic);
+	const uint32_t kWorld = scopeBit(FeatureScope::kWorld);
+	const uint32_t kEquipment = scopeBit(FeatureScope::kEquipment);
+	const uint32_t kCombat = scopeBit(FeatureScope::kCombat);
+	const uint32_t kCell = scopeBit(FeatureScope::kCell);
+	const uint32_t kEventScopes = ConditionEvents::kEventScopes;
+
+	void testTicks()
+	{
+		ConditionEvents events(64);
+		events.subscribe(kEventScopes);
+		ConditionEvents::Tick t0 = events.now();
+		CHECK(events.now() > t0);
+		CHECK(events.dirtyScopes(1, t0) == 0);
+
+		// An event is dirty for whoever read before it, and only for its
+		// actor and its scopes.
+		events.notify(1, kEquipment);
+		CHECK(events.dirtyScopes(1, t0) == kEquipment);
+		CHECK(events.dirtyScopes(2, t0) == 0);
+		ConditionEvents::Tick t1 = events.now();
+		CHECK(events.dirtyScopes(1, t1) == 0);
+		CHECK(events.dirtyScopes(1, t0) == kEquipment);
+
+		events.notify(1, kCombat | kCell);
+		events.notify(2, kCell);
+		CHECK(events.dirtyScopes(1, t1) == (kCombat | kCell));
+		CHECK(events.dirtyScopes(1, t0) == kEventScopes);
+		CHECK(events.dirtyScopes(2, t1) == kCell);
+
+		// One for every actor, including ones never seen.
+		ConditionEvents::Tick t2 = events.now();
+		events.notifyAll(kCombat);
+		CHECK(events.dirtyScopes(1, t2) == kCombat);
+		CHECK(events.dirtyScopes(3, t2) == kCombat);
+		CHECK(events.dirtyScopes(3, events.now()) == 0);
+		CHECK(events.numNotified() == 4);
+	}
+
+	void testUnsubscribed()
+	{
+		// Scopes nobody notifies are always dirty.
+		ConditionEvents events(64);
+		CHECK(events.dirtyScopes(1, events.now()) == kEventScopes);
+		events.subscribe(kEquipment);
+		CHECK(events.dirtyScopes(1, events.now()) == (kCombat | kCell));
+		events.subscribe(kCombat);
+		ConditionEvents::Tick t0 = events.now();
+		CHECK(events.dirtyScopes(1, t0) == kCell);
+		events.notify(1, kEquipment);
+		CHECK(events.dirtyScopes(1, t0) == (kEquipment | kCell));
+		CHECK(events.dirtyScopes(1, events.now()) == kCell);
+		events.subscribe(kCell);
+		CHECK(events.dirtyScopes(1, events.now()) == 0);
+	}
+
+	void testOverflow()
+	{
+		// Past maxActors, it forgets them all, as if everything had changed.
+		ConditionEvents events(4);
+		events.subscribe(kEventScopes);
+		for (uint32_t actorID = 1; actorID <= 4; actorID++)
+		{
+			events.notify(actorID, kEquipment);
+		}
+		ConditionEvents::Tick t0 = events.now();
+		for (uint32_t actorID = 1; actorID <= 4; actorID++)
+		{
+			CHECK(events.dirtyScopes(actorID, t0) == 0);
+		}
+		events.notify(5, kCombat);
+		for (uint32_t actorID = 1; actorID <= 6; actorID++)
+		{
+			CHECK(events.dirtyScopes(actorID, t0) == kEventScopes);
+		}
+		ConditionEvents::Tick t1 = events.now();
+		CHECK(events.dirtyScopes(1, t1) == 0);
+		CHECK(events.dirtyScopes(5, t1) == 0);
+
+		// And starts counting again.
+		events.notify(1, kCell);
+		CHECK(events.dirtyScopes(1, t1) == kCell);
+		CHECK(events.dirtyScopes(5, t1) == 0);
+	}
+
+	void testInterleaved()
+	{
+		// Whoever reads features takes the time before asking what's dirty
+		// (as Entry::beginActivation does): an event notified in between
+		// then shows up, if not now, next time.
+		ConditionEvents events(64);
+		events.subscribe(kEventScopes);
+		ConditionEvents::Tick since = events.now();
+		ConditionEvents::Tick seen = events.now();
+		events.notify(1, kEquipment);
+		events.notifyAll(kCombat);
+		CHECK(events.dirtyScopes(1, since) == (kEquipment | kCombat));
+		CHECK(events.dirtyScopes(1, seen) == (kEquipment | kCombat));
+		CHECK(events.dirtyScopes(1, events.now()) == 0);
+	}
+
+	// ------------------------------------------------------------------------
+	//                            The cache entries
+	// ------------------------------------------------------------------------
+	struct Programs
+	{
+		// One program per kind of scope (so by index: what it reads).
+		enum { kReadsActor, kReadsStatic, kReadsEquipment, kReadsCombatCell, kNumPrograms };
+		FeatureLayout layout;
+		ConditionProgram programs[kNumPrograms];
+
+		Programs()
+		{
+			const uint32_t readScopes[kNumPrograms] = { kActor, kStatic, kEquipment, kCombat | kCell };
+			for (uint16_t i = 0; i < kNumPrograms; i++)
+			{
+				programs[i].index = i;
+				programs[i].readScopes = readScopes[i];
+				programs[i].bCacheable = true;
+			}
+			layout.nPrograms = kNumPrograms;
+		}
+
+		// Evaluates every program whose result isn't cached (with 'result').
+		// Returns the programs (as bits) that were.
+		uint32_t activate(ConditionCache::Entry& entry, uint64_t stamp, bool result)
+		{
+			uint32_t evaluated = 0;
+			for (auto& program : programs)
+			{
+				bool bCachedResult;
+				if (!entry.findResult(program, stamp, bCachedResult))
+				{
+					entry.setResult(program, stamp, result);
+					evaluated |= 1u << program.index;
+				}
+				else
+				{
+					CHECK(bCachedResult == result);
+				}
+			}
+			return evaluated;
+		}
+	};
+
+	void testEntries()
+	{
+		const uint32_t kAll = (1u << Programs::kNumPrograms) - 1;
+		const uint32_t kActorOnly = 1u << Programs::kReadsActor;
+		Programs p;
+		ConditionEvents events(64);
+		events.subscribe(kEventScopes);
+		ConditionCache::Entry entry;
+		entry.reset(0x13746, p.layout);
+		ActorObservation observed;
+		observed.parentCell = 0x50000;
+		observed.hands[1] = 0x1397E;
+
+		// The first activation reads everything but the world, and the
+		// programs are all evaluated.
+		CHECK(entry.beginActivation(7, observed, events) == ~kWorld);
+		CHECK(p.activate(entry, 1, true) == kAll);
+
+		// Nothing's happened: just the kActor features are read, and only
+		// the program that reads them is evaluated.
+		CHECK(entry.beginActivation(7, observed, events) == kActor);
+		CHECK(p.activate(entry, 1, true) == kActorOnly);
+
+		// Events for the actor.
+		events.notify(7, kEquipment);
+		CHECK(entry.beginActivation(7, observed, events) == (kActor | kEquipment));
+		CHECK(p.activate(entry, 1, true) == (kActorOnly | 1u << Programs::kReadsEquipment));
+		events.notify(7, kCell);
+		CHECK(entry.beginActivation(7, observed, events) == (kActor | kCell));
+		CHECK(p.activate(entry, 1, true) == (kActorOnly | 1u << Programs::kReadsCombatCell));
+
+		// An event for someone else, then one for everybody.
+		events.notify(8, kEventScopes);
+		CHECK(entry.beginActivation(7, observed, events) == kActor);
+		CHECK(p.activate(entry, 1, true) == kActorOnly);
+		events.notifyAll(kCombat);
+		CHECK(entry.beginActivation(7, observed, events) == (kActor | kCombat));
+		CHECK(p.activate(entry, 1, true) == (kActorOnly | 1u << Programs::kReadsCombatCell));
+
+		// Changes seen without an event.
+		observed.parentCell++;
+		CHECK(entry.beginActivation(7, observed, events) == (kActor | kCell));
+		CHECK(p.activate(entry, 1, true) == (kActorOnly | 1u << Programs::kReadsCombatCell));
+		observed.hands[0] = 0x12EB7;
+		CHECK(entry.beginActivation(7, observed, events) == (kActor | kEquipment));
+		CHECK(p.activate(entry, 1, true) == (kActorOnly | 1u << Programs::kReadsEquipment));
+
+		// A result is only found for the stamp it was set with (i.e. a
+		// world feature changing invalidates it).
+		CHECK(entry.beginActivation(7, observed, events) == kActor);
+		CHECK(p.activate(entry, 2, false) == kAll);
+		CHECK(entry.beginActivation(7, observed, events) == kActor);
+		CHECK(p.activate(entry, 2, false) == kActorOnly);
+
+		// Emptied, it starts again.
+		entry.reset(0x13746, p.layout);
+		CHECK(entry.beginActivation(7, observed, events) == ~kWorld);
+		CHECK(p.activate(entry, 2, false) == kAll);
+
+		// With nothing subscribed, every activation reads the event driven
+		// scopes again.
+		ConditionEvents noEvents(64);
+		ConditionCache::Entry unsubscribedEntry;
+		unsubscribedEntry.reset(0x13746, p.layout);
+		CHECK(unsubscribedEntry.beginActivation(7, observed, noEvents) == ~kWorld);
+		CHECK(p.activate(unsubscribedEntry, 1, true) == kAll);
+		CHECK(unsubscribedEntry.beginActivation(7, observed, noEvents) == (kActor | kEventScopes));
+		CHECK(p.activate(unsubscribedEntry, 1, true) == (kAll & ~(1u << Programs::kReadsStatic)));
+	}
+
+	void testRacingEvents()
+	{
+		// An actor's equipment changing (and the event being notified) on
+		// one thread while another activates it over and over: once the
+		// change is done, the next activation must see it, whatever the
+		// timing. (Each round has one change, at some point during the
+		// activations.)
+		const uint32_t kRounds = 500;
+		ConditionEvents events(64);
+		events.subscribe(kEventScopes);
+		ConditionCache::Entry entry;
+		FeatureLayout layout;
+		entry.reset(0x13746, layout);
+		ActorObservation observed;
+		std::atomic<uint32_t> equipped{ 0 };
+		std::atomic<uint32_t> roundStarted{ 0 };
+		std::atomic<uint32_t> roundChanged{ 0 };
+		std::thread notifier([&]()
+		{
+			for (uint32_t round = 1; round <= kRounds; round++)
+			{
+				while (roundStarted.load() != round)
+				{
+					std::this_thread::yield();
+				}
+				equipped.store(round);
+				events.notify(7, kEquipment);
+				roundChanged.store(round);
+			}
+		});
+
+		uint32_t cached = 0;
+		uint32_t nStale = 0;
+		auto activate = [&]()
+		{
+			if (entry.beginActivation(7, observed, events) & kEquipment)
+			{
+				cached = equipped.load();
+			}
+		};
+		for (uint32_t round = 1; round <= kRounds; round++)
+		{
+			roundStarted.store(round);
+			while (roundChanged.load() != round)
+			{
+				activate();
+			}
+			activate();
+			nStale += cached != round;
+		}
+		notifier.join();
+		CHECK(nStale == 0);
+	}
+
+	void testCache()
+	{
+		ConditionCache cache(3);
+		auto entry = cache.get(7, 1);
+		CHECK(cache.get(7, 1) == entry);
+		CHECK(cache.get(7, 2) != entry && cache.get(8, 1) != entry);
+		CHECK(cache.size() == 3);
+
+		// Full: emptied before adding (the entry we hold stays valid).
+		entry->baseFormID = 0x13746;
+		auto newEntry = cache.get(9, 1);
+		CHECK(cache.size() == 1);
+		CHECK(cache.get(7, 1) != entry && entry->baseFormID == 0x13746);
+		CHECK(cache.get(9, 1) == newEntry);
+	}
+}
+
+int main()
+{
+	testTicks();
+	testUnsubscribed();
+	testOverflow();
+	testInterleaved();
+	testEntries();
+	testRacingEvents();
+	testCache();
+	return testResult();
+}
\ No newline at end of file
@@ -0,0 +1,513 @@
+// ============================================================================
+//                         ConditionsParserTest.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "ConditionsParser.h"
+#include "TestUtils.h"
+#include "Utilities.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+// ============================================================================
+//                          ConditionsParserTest.cpp
+// ----------------------------------------------------------------------------
+// Checks the syntax pass of the _conditions.txt parser (ConditionsParser.cpp)
+// against the parser it replaced, which was DAR's: first on the quirks it
+// deliberately keeps, then on a corpus of generated files, each read back
+// from disk (so through readConditionsFile) and parsed by both.
+// ============================================================================
+
+namespace
+{
+	struct RefArg
+	{
+		std::string modName;
+		uint32_t    formBaseID = 0;
+		float       fVal = 0.0f;
+		bool        bIsFormID = false;
+	};
+
+	struct RefCondition
+	{
+		std::string         funcName;
+		std::vector<RefArg> args;
+		bool                bNot = false;
+		bool                bAnd = true;
+		bool                bBlankArgs = false;
+	};
+
+	bool parseLikeDAR(const std::string& fileData, std::vector<RefCondition>& conditions_out,
+		              std::string& lineWithError_out)
+	{
+		// ====================================================================
+		//                           parseLikeDAR
+		// --------------------------------------------------------------------
+		// The reference: the original parser (DARProject.cpp, before the
+		// syntax pass was split out), reading 'fileData' as a file of that
+		// name would have been read, with just the checks that need no game
+		// (the function lookups, arg counts and load order came later), and
+		// stopping at the first error. Its stoi / stof threw on bad numbers,
+		// which here rejects the file.
+		// ====================================================================
+		conditions_out.clear();
+		lineWithError_out.clear();
+
+		// std::ifstream reads in text mode: it stops at a Ctrl+Z, and
+		// turns CR LF into LF.
+		std::string text = fileData.substr(0, fileData.find('\x1A'));
+		std::string textLF;
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			if (!(text[i] == '\r' && i + 1 < text.size() && text[i + 1] == '\n'))
+			{
+				textLF += text[i];
+			}
+		}
+		std::istringstream fConditions(textLF);
+		std::vector<std::string> vLines;
+		std::string sLine;
+		while (std::getline(fConditions, sLine))
+		{
+			sLine = trim(sLine);
+			if (sLine.size() > 0 && sLine.at(0) != ';')
+			{
+				vLines.push_back(sLine);
+			}
+		}
+
+		for (size_t iLineNum = 0; iLineNum < vLines.size(); ++iLineNum)
+		{
+			const std::string& full_line = vLines[iLineNum];
+			std::string chomped_line = full_line;
+			RefCondition condition;
+			lineWithError_out = full_line;
+
+			if (startsWith(chomped_line, "NOT ") || startsWith(chomped_line, "NOT\t"))
+			{
+				condition.bNot = true;
+				chomped_line = chomped_line.substr(3);
+			}
+			size_t posLB = chomped_line.find_first_of("(");
+			if (posLB == std::string::npos)
+			{
+				return false;
+			}
+			condition.funcName = trim(chomped_line.substr(0, posLB));
+			size_t posRB = chomped_line.find_first_of(")");
+			if (posRB == std::string::npos || posRB < posLB)
+			{
+				return false;
+			}
+			if (posRB == chomped_line.size() - 1)
+			{
+				if (iLineNum < vLines.size() - 1)
+				{
+					return false;
+				}
+			}
+			else
+			{
+				std::string rest = trim(chomped_line.substr(posRB + 1));
+				if (rest.size() > 0)
+				{
+					if (startsWith(rest, "AND"))
+					{
+						condition.bAnd = true;
+					}
+					else
+					{
+						if (!startsWith(rest, "OR"))
+						{
+							return false;
+						}
+						condition.bAnd = false;
+					}
+				}
+				else if (iLineNum < vLines.size() - 1)
+				{
+					return false;
+				}
+			}
+
+			if (posLB != posRB - 1)
+			{
+				std::string commaSepArgs = trim(chomped_line.substr(posLB + 1, posRB - (posLB + 1)));
+				if (commaSepArgs.size() == 0)
+				{
+					condition.bBlankArgs = true;
+					conditions_out.push_back(condition);
+					continue;
+				}
+				std::vector<std::string> sArgs;
+				splitOnCommas(sArgs, commaSepArgs);
+				for (auto& sArg : sArgs)
+				{
+					RefArg arg;
+					sArg = trim(sArg);
+					try
+					{
+						if (sArg.size() == 0 || sArg.at(0) == '"')
+						{
+							std::vector<std::string> sArgTokens;
+							splitOnPipes(sArgTokens, sArg);
+							if (sArgTokens.size() != 2)
+							{
+								return false;
+							}
+							std::string espName = trim(sArgTokens.at(0));
+							if (espName.size() <= 2 || espName.at(0) != '"'
+								|| espName.at(espName.size() - 1) != '"')
+							{
+								return false;
+							}
+							espName = espName.substr(1, espName.size() - 2);
+							if (!endsWith(espName, ".esp") && !endsWith(espName, ".esm")
+								&& !endsWith(espName, ".esl"))
+							{
+								return false;
+							}
+							arg.modName = espName;
+							arg.formBaseID = (uint32_t)std::stoi(trim(sArgTokens.at(1)), nullptr, 0);
+							arg.bIsFormID = true;
+						}
+						else
+						{
+							arg.fVal = std::stof(sArg);
+							if (std::isnan(arg.fVal))
+							{
+								return false;
+							}
+						}
+					}
+					catch (const std::exception&)
+					{
+						return false;
+					}
+					condition.args.push_back(arg);
+				}
+			}
+			conditions_out.push_back(condition);
+		}
+		lineWithError_out.clear();
+		return true;
+	}
+
+	bool sameFloat(float x, float y)
+	{
+		return memcmp(&x, &y, sizeof(float)) == 0;
+	}
+
+	bool sameResult(const ParsedConditions& parsed, bool bParsed,
+		            const std::vector<RefCondition>& expected, bool bExpected,
+		            const std::string& expectedLineWithError)
+	{
+		if (bParsed != bExpected)
+		{
+			return false;
+		}
+		if (!bParsed)
+		{
+			return parsed.syntaxErrorLine == expectedLineWithError;
+		}
+		if (parsed.conditions.size() != expected.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < expected.size(); i++)
+		{
+			const ParsedCondition& condition = parsed.conditions[i];
+			const RefCondition& refCondition = expected[i];
+			if (condition.funcName != refCondition.funcName
+				|| condition.bNot != refCondition.bNot
+				|| condition.bAnd != refCondition.bAnd
+				|| condition.bBlankArgs != refCondition.bBlankArgs
+				|| condition.nArgs != refCondition.args.size())
+			{
+				return false;
+			}
+			for (size_t j = 0; j < refCondition.args.size(); j++)
+			{
+				const ParsedConditionArg& arg = parsed.args[condition.firstArg + j];
+				const RefArg& refArg = refCondition.args[j];
+				if (arg.bIsFormID != refArg.bIsFormID
+					|| arg.modName != refArg.modName
+					|| arg.formBaseID != refArg.formBaseID
+					|| !sameFloat(arg.fVal, refArg.fVal))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	class ParseFile
+	{
+		// Writes files to a temporary folder and parses them as the loaders
+		// do (readConditionsFile, then parseConditionSyntax).
+	public:
+		ParseFile() : tempDir("dargh-parser"), path((tempDir.path / "_conditions.txt").string()) {}
+
+		bool operator()(const std::string& fileData, ParsedConditions& parsed_out)
+		{
+			bool bRead = writeFile(path, fileData) && DARGH::readConditionsFile(path, text);
+			CHECK(bRead);
+			return bRead && DARGH::parseConditionSyntax(text, parsed_out);
+		}
+
+	private:
+		TempDir tempDir;
+		std::string path;
+		std::string text;
+	};
+
+	// ------------------------------------------------------------------------
+	//                               The quirks
+	// ------------------------------------------------------------------------
+	void testQuirks(ParseFile& parseFile)
+	{
+		ParsedConditions parsed;
+
+		// NOT needs a space or tab after it; otherwise it's part of the name.
+		CHECK(parseFile("NOT IsFemale()", parsed) && parsed.conditions[0].bNot
+			  && parsed.conditions[0].funcName == "IsFemale");
+		CHECK(parseFile("NOT\t IsFemale()", parsed) && parsed.conditions[0].bNot);
+		CHECK(parseFile("NOTIsFemale()", parsed) && !parsed.conditions[0].bNot
+			  && parsed.conditions[0].funcName == "NOTIsFemale");
+		CHECK(parseFile("not IsFemale()", parsed) && !parsed.conditions[0].bNot
+			  && parsed.conditions[0].funcName == "not IsFemale");
+
+		// Only the start of what follows the ")" is checked.
+		CHECK(parseFile("IsFemale() ANDx\nIsChild()", parsed) && parsed.conditions[0].bAnd);
+		CHECK(parseFile("IsFemale() ORELSE\nIsChild()", parsed) && !parsed.conditions[0].bAnd);
+		CHECK(!parseFile("IsFemale() XOR\nIsChild()", parsed)
+			  && parsed.syntaxErrorLine == "IsFemale() XOR");
+		CHECK(!parseFile("IsFemale()\nIsChild()", parsed)
+			  && parsed.syntaxErrorLine == "IsFemale()");
+		CHECK(parseFile("IsFemale() AND", parsed) && parsed.conditions.size() == 1);
+		CHECK(parseFile("IsFemale() OR ; a comment\n; another\nIsChild()", parsed)
+			  && parsed.conditions.size() == 2 && !parsed.conditions[0].bAnd);
+
+		// Blank args: kept (for the bind pass to check the name and drop).
+		CHECK(parseFile("IsActorBase( \t) AND\nIsFemale()", parsed)
+			  && parsed.conditions.size() == 2 && parsed.conditions[0].bBlankArgs
+			  && parsed.conditions[0].nArgs == 0);
+		CHECK(parseFile("IsFemale()", parsed) && !parsed.conditions[0].bBlankArgs);
+
+		// Form IDs: std::stoi(s, nullptr, 0).
+		struct { const char* sFormID; bool bOK; uint32_t formID; } formIDs[] =
+		{
+			{ "0x13746", true, 0x13746 }, { "0X1f", true, 0x1F }, { "010", true, 8 },
+			{ "10", true, 10 }, { "08", true, 0 }, { "0x", true, 0 }, { "0xG", true, 0 },
+			{ "12abc", true, 12 }, { "-1", true, 0xFFFFFFFF }, { "+7", true, 7 },
+			{ "0x7FFFFFFF", true, 0x7FFFFFFF }, { "-0x80000000", true, 0x80000000 },
+			{ "0x80000000", false, 0 }, { "abc", false, 0 }, { "", false, 0 }, { "--1", false, 0 }
+		};
+		for (auto& formID : formIDs)
+		{
+			std::string line = std::string("IsActorBase(\"Skyrim.esm\" | ") + formID.sFormID + ")";
+			bool bParsed = parseFile(line, parsed);
+			if (!CHECK(bParsed == formID.bOK)
+				|| (bParsed && !CHECK(parsed.args[0].bIsFormID && parsed.args[0].formBaseID == formID.formID
+									  && parsed.args[0].modName == "Skyrim.esm")))
+			{
+				fprintf(stderr, "  (form ID \"%s\")\n", formID.sFormID);
+			}
+		}
+		CHECK(!parseFile("IsActorBase(\"Skyrim.txt\" | 1)", parsed));
+		CHECK(!parseFile("IsActorBase(\"\" | 1)", parsed));
+		CHECK(!parseFile("IsActorBase(Skyrim.esm | 1)", parsed));
+		CHECK(!parseFile("IsActorBase(\"Skyrim.esm\" | 1 | 2)", parsed));
+		CHECK(parseFile("IsActorBase(\"a, b.esp\" | 1)", parsed) && parsed.args[0].modName == "a, b.esp");
+
+		// Floats: std::stof, then NaN is rejected.
+		struct { const char* sVal; bool bOK; float fVal; } floats[] =
+		{
+			{ "1.5", true, 1.5f }, { "-2", true, -2.0f }, { ".5", true, 0.5f }, { "5.", true, 5.0f },
+			{ "3abc", true, 3.0f }, { "1e3", true, 1000.0f }, { "1e", true, 1.0f },
+			{ "0x1p3", true, 8.0f }, { "0x", true, 0.0f }, { "inf", true, INFINITY },
+			{ "-Infinity", true, -INFINITY }, { "1e39", false, 0 }, { "-1e39", false, 0 },
+			{ "1e-38", false, 0 }, { "1e-50", false, 0 }, { "0e-50", true, 0.0f },
+			{ "nan", false, 0 }, { "-NAN", false, 0 }, { "abc", false, 0 }, { "+-1", false, 0 }
+		};
+		for (auto& val : floats)
+		{
+			std::string line = std::string("IsLevelLessThan(") + val.sVal + ")";
+			bool bParsed = parseFile(line, parsed);
+			if (!CHECK(bParsed == val.bOK)
+				|| (bParsed && !CHECK(!parsed.args[0].bIsFormID && sameFloat(parsed.args[0].fVal, val.fVal))))
+			{
+				fprintf(stderr, "  (float \"%s\")\n", val.sVal);
+			}
+		}
+
+		// CR LF is read as LF; a lone CR is kept (and isn't whitespace).
+		CHECK(parseFile("IsFemale() AND\r\nIsChild()\r\n", parsed) && parsed.conditions.size() == 2);
+		CHECK(parseFile("IsFemale() AND\rIsChild()", parsed) && parsed.conditions.size() == 1);
+		CHECK(!parseFile("IsFemale()\r", parsed));
+		CHECK(!parseFile("IsFemale()\r\r\n", parsed));
+		CHECK(parseFile("\r\n\r\n IsFemale()\r\n\r\n", parsed) && parsed.conditions.size() == 1);
+
+		// A Ctrl+Z ends the file.
+		CHECK(parseFile("IsFemale()\x1A garbage", parsed) && parsed.conditions.size() == 1);
+		CHECK(parseFile("IsFemale() AND\r\n\x1AIsChild()", parsed) && parsed.conditions.size() == 1);
+	}
+
+	// ------------------------------------------------------------------------
+	//                              The corpus
+	// ------------------------------------------------------------------------
+	template <size_t N>
+	const char* pick(std::mt19937& rng, const char* const (&choices)[N])
+	{
+		return choices[rng() % N];
+	}
+
+	std::string corpusArg(std::mt19937& rng)
+	{
+		static const char* const kFormIDs[] =
+		{
+			"0x13746", "0x0", "0xFFF", "0x1000", "0xFFFFFF", "0x1000000", "010", "08", "0x", "-1",
+			"0x7FFFFFFF", "0x80000000", "-0x80000000", "99999999999", "abc", "", " 12 ", "0x1G", "+0x10"
+		};
+		static const char* const kModNames[] =
+		{
+			"\"Skyrim.esm\"", "\"Update.esm\"", "\"light.esl\"", "\"mod.esp\"", "\"mod.txt\"",
+			"\"\"", "\"x\"", "Skyrim.esm", "\"a, b.esp\"", "\"Skyrim.esm", " \"Dawnguard.esm\" "
+		};
+		static const char* const kFloats[] =
+		{
+			"1", "-1", "0", "1.5", "-0.25", ".5", "5.", "1e3", "1e", "1e39", "-1e39", "1e-38", "1e-50",
+			"nan", "NAN", "-nan", "inf", "-infinity", "0x1p3", "0x", "0x.8", "0x1p", "+-1", "--1",
+			"3abc", "abc", "  2  ", "1 2", "0x7FFFFFFF", "340282346638528859811704183484516925440"
+		};
+		switch (rng() % 8)
+		{
+		case 0: case 1: case 2:
+			return std::string(pick(rng, kModNames)) + pick(rng, { " | ", "|", " |", "| ", " || ", "" })
+				+ pick(rng, kFormIDs);
+		case 3:
+			return std::string(pick(rng, kModNames)) + " | " + pick(rng, kFormIDs) + " | 1";
+		case 4:
+			return pick(rng, { "", " ", "\t", "|", "\"|\"", "\"Skyrim.esm\" | 0x1, 2" });
+		default:
+			return pick(rng, kFloats);
+		}
+	}
+
+	std::string corpusLine(std::mt19937& rng)
+	{
+		static const char* const kFuncNames[] =
+		{
+			"IsFemale", "IsActorBase", "ValueEqualTo", "IsLevelLessThan", "Random", "", "Is Female",
+			"NOTIsChild", "IsEquippedRightType"
+		};
+		switch (rng() % 16)
+		{
+		case 0:
+			return pick(rng, { "", " ", "\t", "; a comment", "  ;IsFemale()", "IsFemale", ")(" });
+		case 1:
+			return std::string(pick(rng, kFuncNames)) + pick(rng, { "( )", "(\t)", "(  \t )" })
+				+ pick(rng, { "", " AND", " OR" });
+		default:
+			break;
+		}
+		std::string line = pick(rng, { "", "", "", "NOT ", "NOT\t", "NOT", " NOT  ", "not " });
+		line += pick(rng, kFuncNames);
+		line += pick(rng, { "(", "(", "(", "(", "(", " (", "" });
+		uint32_t nArgs = rng() % 3;
+		for (uint32_t i = 0; i < nArgs; i++)
+		{
+			line += (i ? "," : "") + corpusArg(rng);
+		}
+		line += pick(rng, { ")", ")", ")", ")", ")", "))", "", ") (" });
+		line += pick(rng, { " AND", " AND", " OR", " OR", "AND", " ANDx", " OR;", " XOR", "", " ", "\t" });
+		return line;
+	}
+
+	std::string corpusFile(std::mt19937& rng)
+	{
+		std::string fileData;
+		uint32_t nLines = 1 + rng() % 4;
+		for (uint32_t i = 0; i < nLines; i++)
+		{
+			fileData += corpusLine(rng);
+			if (i < nLines - 1 || rng() % 2)
+			{
+				fileData += pick(rng, { "\r\n", "\r\n", "\n", "\r", "\r\r\n" });
+			}
+		}
+		if (rng() % 16 == 0)
+		{
+			// A Ctrl+Z somewhere.
+			fileData.insert(rng() % (fileData.size() + 1), 1, '\x1A');
+		}
+		return fileData;
+	}
+
+	void testCorpus(ParseFile& parseFile, uint32_t nFiles)
+	{
+		// The corpus is mostly valid, so that the args get parsed.
+		std::mt19937 rng(1234);
+		ParsedConditions parsed;
+		std::vector<RefCondition> expected;
+		std::string expectedLineWithError;
+		uint32_t nAccepted = 0;
+		uint32_t nMismatched = 0;
+		for (uint32_t i = 0; i < nFiles; i++)
+		{
+			std::string fileData = corpusFile(rng);
+			bool bParsed = parseFile(fileData, parsed);
+			bool bExpected = parseLikeDAR(fileData, expected, expectedLineWithError);
+			if (!sameResult(parsed, bParsed, expected, bExpected, expectedLineWithError)
+				&& nMismatched++ < 10)
+			{
+				std::string shown;
+				for (char ch : fileData)
+				{
+					shown += ch == '\r' ? "\\r" : ch == '\n' ? "\\n" : ch == '\x1A' ? "^Z" : std::string(1, ch);
+				}
+				fprintf(stderr, "mismatch (parsed: %d, expected: %d) on: %s\n", bParsed, bExpected, shown.c_str());
+			}
+			nAccepted += bExpected;
+		}
+		CHECK(nMismatched == 0);
+		// (And the corpus isn't all rejects.)
+		CHECK(nAccepted > nFiles / 10);
+		printf("corpus: %u files, %u accepted, %u mismatched\n", nFiles, nAccepted, nMismatched);
+	}
+}
+
+int main()
+{
+	ParseFile parseFile;
+	testQuirks(parseFile);
+	testCorpus(parseFile, 5000);
+	return testResult();
+}
\ No newline at end of file
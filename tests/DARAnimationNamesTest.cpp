@@ -0,0 +1,130 @@
+// ============================================================================
+//                         DARAnimationNamesTest.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "DARAnimationNames.h"
+#include "DARProjectRegistry.h"
+#include "TestGame.h"
+#include "TestUtils.h"
+
+#include <atomic>
+#include <thread>
+
+// ============================================================================
+//                         DARAnimationNamesTest.cpp
+// ----------------------------------------------------------------------------
+// Link indexes across a reload and a second rebuild: the graphs generated
+// with the first array must keep the index built for it, which never gives
+// out a slot past that array's end.
+// ============================================================================
+
+namespace
+{
+	const char* const kOrigNames[] = { "Animations\\mt_idle.hkx", "Animations\\mt_walk.hkx" };
+	const uint32_t kNumOrig = 2;
+}
+
+int main()
+{
+	TempDir dataDir("dargh-animnames");
+	std::filesystem::path actorBaseDir =
+		dataDir.path / "meshes" / "actors" / "character" / "animations" / "DynamicAnimationReplacer"
+		/ "Skyrim.esm" / "00013746";
+	CHECK(writeFile(actorBaseDir / "mt_idle.hkx", ""));
+
+	LoadOrderIndex loadOrder;
+	loadOrder.add("Skyrim.esm", LoadOrderIndex::Mod{ 0, 0, false });
+	std::string projFilePath = "Actors\\Character\\DefaultMale.hkx";
+	DARGH::registerDARProject(projFilePath);
+	DARGH::initDARLoading(dataDir.path.string() + "/", std::move(loadOrder), std::vector<std::string>());
+	DARProject& darProj = DARGH::g_DARProjectRegistry.begin()->second;
+	DARGH::ensureDARMapsLoaded(darProj);
+
+	Actor actor;
+	actor.formID = 0x00000014;
+	actor.baseFormID = 0x00013746;
+
+	// The first array: one replacement, for mt_idle.
+	AnimationNames namesA;
+	DARGH::rebuildAnimationNames(darProj, *std::atomic_load(&darProj.links), kOrigNames, kNumOrig,
+		                         kMaxAnimationNames, namesA);
+	CHECK(namesA.names && namesA.nNames == kNumOrig + 1);
+	std::shared_ptr<const DARLinkIndex> indexA = DARGH::findLinkIndex(darProj, namesA.names, namesA.nNames);
+	CHECK(indexA && indexA->nNames == namesA.nNames);
+	CHECK(DARGH::getNewAnimIndex(&darProj, *indexA, 0, &actor) == (hkInt16)kNumOrig);
+	CHECK(DARGH::getNewAnimIndex(&darProj, *indexA, 1, &actor) == -1);
+
+	// Neither the original array nor a wrong size finds it.
+	CHECK(!DARGH::findLinkIndex(darProj, kOrigNames, kNumOrig));
+	CHECK(!DARGH::findLinkIndex(darProj, namesA.names, namesA.nNames + 1));
+
+	// A reload adds a replacement for mt_walk. While the project's arrays
+	// are rebuilt for it, the graphs of the first array go on looking up
+	// their replacements in its index.
+	CHECK(writeFile(actorBaseDir / "mt_walk.hkx", ""));
+	DARGH::reloadDARMaps(darProj, std::vector<std::string>{ "" });
+	std::atomic<bool> bDone{ false };
+	std::atomic<int> nPastEnd{ 0 };
+	std::thread reader([&]()
+	{
+		while (!bDone)
+		{
+			std::shared_ptr<const DARLinkIndex> index =
+				DARGH::findLinkIndex(darProj, namesA.names, namesA.nNames);
+			for (hkInt16 anim = 0; anim < (hkInt16)kNumOrig; anim++)
+			{
+				hkInt16 newIndex = index ? DARGH::getNewAnimIndex(&darProj, *index, anim, &actor) : -1;
+				if (!index || newIndex >= (hkInt16)namesA.nNames)
+				{
+					nPastEnd++;
+				}
+			}
+			std::this_thread::yield();
+		}
+	});
+	AnimationNames namesB;
+	for (int i = 0; i < 20; i++)
+	{
+		DARGH::rebuildAnimationNames(darProj, *std::atomic_load(&darProj.links), kOrigNames, kNumOrig,
+			                         kMaxAnimationNames, namesB);
+		std::this_thread::yield();
+	}
+	bDone = true;
+	reader.join();
+	CHECK(nPastEnd == 0);
+
+	// The first array's index is as it was; the latest array has its own.
+	CHECK(DARGH::findLinkIndex(darProj, namesA.names, namesA.nNames) == indexA);
+	CHECK(indexA->allLinks.size() == 1);
+	CHECK(namesB.names && namesB.nNames == kNumOrig + 2);
+	std::shared_ptr<const DARLinkIndex> indexB = DARGH::findLinkIndex(darProj, namesB.names, namesB.nNames);
+	CHECK(indexB && indexB != indexA && indexB == std::atomic_load(&darProj.latestLinkIndex));
+	hkInt16 idleB = DARGH::getNewAnimIndex(&darProj, *indexB, 0, &actor);
+	hkInt16 walkB = DARGH::getNewAnimIndex(&darProj, *indexB, 1, &actor);
+	CHECK(idleB >= (hkInt16)kNumOrig && idleB < (hkInt16)namesB.nNames);
+	CHECK(walkB >= (hkInt16)kNumOrig && walkB < (hkInt16)namesB.nNames && walkB != idleB);
+	return testResult();
+}
\ No newline at end of file
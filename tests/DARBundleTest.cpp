@@ -0,0 +1,420 @@
+// ============================================================================
+//                             DARBundleTest.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "DARBundle.h"
+#include "DARProject.h"
+#include "TestGame.h"
+#include "TestUtils.h"
+
+#include <cstring>
+#include <random>
+
+// ============================================================================
+//                             DARBundleTest.cpp
+// ----------------------------------------------------------------------------
+// Makes a bundle of a small DynamicAnimationReplacer folder, as darbundle
+// does, and checks that loading the project from it gives the same links as
+// loading it from the folder. Then opens corrupted copies of the bundle:
+// they must be rejected, or else load without reading outside it.
+// ============================================================================
+
+namespace
+{
+	const char* const kProjFolder = "actors\\character";
+
+	bool writeDARFolder(const std::filesystem::path& darDir)
+	{
+		struct { const char* path; const char* data; } files[] =
+		{
+			{ "Skyrim.esm/00013746/1hm_idle.hkx", "" },
+			{ "Skyrim.esm/00013746/1hm_walk.hkx", "" },
+			{ "Skyrim.esm/00013747/mt_idle.hkx", "" },
+			{ "Skyrim.esm/13747/skipped.hkx", "" },
+			{ "Skyrim.esm/FFFFFFFF/skipped.hkx", "" },
+			{ "Skyrim.esm/zzzzzzzz/skipped.hkx", "" },
+			{ "Skyrim.esm/0013746g/skipped.hkx", "" },
+			{ "Missing.esp/00000800/skipped.hkx", "" },
+			{ "_CustomConditions/100/_conditions.txt",
+			  "IsActorBase(\"Skyrim.esm\" | 0x13746) AND\r\nNOT IsFemale()\r\n" },
+			{ "_CustomConditions/100/mt_idle.hkx", "" },
+			{ "_CustomConditions/100/sub/mt_walk.hkx", "" },
+			{ "_CustomConditions/200/_conditions.txt",
+			  "IsEquippedRightType(3) OR\r\nIsActorBase(\"Missing.esp\" | 0x800)\r\n" },
+			{ "_CustomConditions/200/1hm_idle.hkx", "" },
+			{ "_CustomConditions/300/_conditions.txt", "IsFemale() XOR\r\nIsChild()\r\n" },
+			{ "_CustomConditions/300/syntax_error.hkx", "" },
+			{ "_CustomConditions/400/no_conditions.hkx", "" },
+			{ "_CustomConditions/500/_conditions.txt", "IsActorBase( ) AND\r\nIsLevelLessThan(20.5)" },
+			{ "_CustomConditions/500/mt_run.hkx", "" },
+			{ "_CustomConditions/500/readme.txt", "" },
+			{ "_CustomConditions/600/_conditions.txt", "IsActorBase(\"light.esl\" | 0x1000)" },
+			{ "_CustomConditions/600/bind_error.hkx", "" },
+			{ "_CustomConditions/700/_conditions.txt", "IsActorBase(\"light.esl\" | 0xFFF)" },
+			{ "_CustomConditions/700/sub/sub/mt_sprint.hkx", "" },
+		};
+		for (auto& file : files)
+		{
+			if (!writeFile(darDir / file.path, file.data))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool writeBundle(const std::string& darDir, const std::string& bundlePath)
+	{
+		// What darbundle does.
+		DirSnapshot darTree;
+		if (!darTree.build(darDir, ".hkx"))
+		{
+			return false;
+		}
+		std::vector<std::string> sPriorities;
+		darTree.listSubdirs(darTree.childDir(darTree.root(), "_CustomConditions"), sPriorities);
+		std::vector<std::string> condFileTexts(sPriorities.size());
+		std::vector<std::pair<std::string, ParsedConditions>> condFiles;
+		for (size_t i = 0; i < sPriorities.size(); ++i)
+		{
+			if (DARGH::readConditionsFile(darDir + "/_CustomConditions/" + sPriorities[i] + "/_conditions.txt",
+				                          condFileTexts[i]))
+			{
+				ParsedConditions parsed;
+				DARGH::parseConditionSyntax(condFileTexts[i], parsed);
+				condFiles.emplace_back(sPriorities[i], std::move(parsed));
+			}
+		}
+		return DARBundle::write(bundlePath, darTree, condFiles);
+	}
+
+	void loadLinks(const LoadOrderIndex& loadOrder, const DirSnapshot& darTree,
+		           const DARBundle* darBundle, DARLinkTable& links_out)
+	{
+		DARProject darProj;
+		darProj.projFolder = kProjFolder;
+		DARGH::loadDARMaps_ActorBase(darProj, loadOrder, darTree, links_out);
+		DARGH::loadDARMaps_Conditional(darProj, loadOrder, darTree, darBundle, NULL, links_out);
+	}
+
+	bool sameConditions(const std::vector<ConditionLinkFunc>& xs, const std::vector<ConditionLinkFunc>& ys)
+	{
+		if (xs.size() != ys.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < xs.size(); i++)
+		{
+			const ConditionLinkFunc& x = xs[i];
+			const ConditionLinkFunc& y = ys[i];
+			if (x.funcId != y.funcId || x.bNot != y.bNot || x.bAnd != y.bAnd
+				|| x.bESPNotLoaded != y.bESPNotLoaded)
+			{
+				return false;
+			}
+			for (uint32_t j = 0; j < kMaxConditionArgs; j++)
+			{
+				if (x.args[j].formID != y.args[j].formID || x.args[j].fVal != y.args[j].fVal
+					|| x.args[j].bIsFloat != y.args[j].bIsFloat)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool sameLinks(const DARLinkTable& xs, const DARLinkTable& ys)
+	{
+		if (xs.actorBaseLinks.size() != ys.actorBaseLinks.size()
+			|| xs.conditionLinks.size() != ys.conditionLinks.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < xs.actorBaseLinks.size(); i++)
+		{
+			const ActorBaseLink& x = xs.actorBaseLinks[i];
+			const ActorBaseLink& y = ys.actorBaseLinks[i];
+			if (x.from_hkx_file != y.from_hkx_file || x.to_hkx_file != y.to_hkx_file
+				|| x.actorBaseID != y.actorBaseID)
+			{
+				return false;
+			}
+		}
+		for (size_t i = 0; i < xs.conditionLinks.size(); i++)
+		{
+			const ConditionLink& x = xs.conditionLinks[i];
+			const ConditionLink& y = ys.conditionLinks[i];
+			if (x.from_hkx_file != y.from_hkx_file || x.to_hkx_file != y.to_hkx_file
+				|| x.priority != y.priority || !sameConditions(x.conditions, y.conditions))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	const ConditionLink* findLink(const DARLinkTable& links, const char* to_hkx_file)
+	{
+		for (auto& link : links.conditionLinks)
+		{
+			if (g_pathTable.sameFile(link.to_hkx_file, to_hkx_file))
+			{
+				return &link;
+			}
+		}
+		return NULL;
+	}
+
+	// ------------------------------------------------------------------------
+	//                              Round trip
+	// ------------------------------------------------------------------------
+	void testRoundTrip(const LoadOrderIndex& loadOrder, const std::string& darDir,
+		               const std::string& bundlePath)
+	{
+		DirSnapshot darTree;
+		CHECK(darTree.build(darDir, ".hkx"));
+		DARLinkTable looseLinks;
+		loadLinks(loadOrder, darTree, NULL, looseLinks);
+
+		// (The folder loads as it should.)
+		CHECK(looseLinks.actorBaseLinks.size() == 3);
+		CHECK(looseLinks.conditionLinks.size() == 5);
+		const ConditionLink* link = findLink(looseLinks,
+			"Animations\\DynamicAnimationReplacer\\_CustomConditions\\100\\sub\\mt_walk.hkx");
+		CHECK(link && link->priority == 100 && link->conditions.size() == 2
+			  && link->conditions[0].args[0].formID == 0x13746 && link->conditions[1].bNot);
+		link = findLink(looseLinks, "Animations\\DynamicAnimationReplacer\\_CustomConditions\\200\\1hm_idle.hkx");
+		CHECK(link && link->conditions.size() == 2 && !link->conditions[0].bAnd
+			  && link->conditions[1].bESPNotLoaded);
+		link = findLink(looseLinks, "Animations\\DynamicAnimationReplacer\\_CustomConditions\\500\\mt_run.hkx");
+		CHECK(link && link->conditions.size() == 1 && link->conditions[0].args[0].fVal == 20.5f);
+		link = findLink(looseLinks, "Animations\\DynamicAnimationReplacer\\_CustomConditions\\700\\sub\\sub\\mt_sprint.hkx");
+		CHECK(link && link->conditions.size() == 1 && link->conditions[0].args[0].formID == 0xFE001FFF);
+
+		DARBundle bundle;
+		if (!CHECK(bundle.open(bundlePath, darDir)))
+		{
+			return;
+		}
+		DARLinkTable bundleLinks;
+		loadLinks(loadOrder, bundle.tree(), &bundle, bundleLinks);
+		CHECK(sameLinks(looseLinks, bundleLinks));
+	}
+
+	// ------------------------------------------------------------------------
+	//                             Corrupt input
+	// ------------------------------------------------------------------------
+	class CorruptBundle
+	{
+		// Opens corrupted copies of a bundle.
+	public:
+		CorruptBundle(const LoadOrderIndex& loadOrder, const std::string& darDir,
+			          const std::string& path)
+			: loadOrder(loadOrder), darDir(darDir), path(path) {}
+
+		// Opens 'data' as a bundle. If it opens, loads the project from it
+		// (which must then stay within it). Returns whether it opened, and
+		// why not in 'error_out'.
+		bool open(const std::string& data, std::string& error_out)
+		{
+			error_out.clear();
+			CHECK(writeFile(path, data));
+			DARBundle bundle;
+			if (!bundle.open(path, darDir))
+			{
+				error_out = bundle.error() ? bundle.error() : "";
+				return false;
+			}
+			DARLinkTable links;
+			loadLinks(loadOrder, bundle.tree(), &bundle, links);
+			nOpened++;
+			return true;
+		}
+
+		uint32_t nOpened = 0;
+
+	private:
+		const LoadOrderIndex& loadOrder;
+		std::string darDir;
+		std::string path;
+	};
+
+	uint32_t readU32(const std::string& data, size_t offset)
+	{
+		uint32_t val;
+		memcpy(&val, data.data() + offset, sizeof(val));
+		return val;
+	}
+
+	void writeU32(std::string& data, size_t offset, uint32_t val)
+	{
+		memcpy(&data[offset], &val, sizeof(val));
+	}
+
+	void testCorruptInput(const LoadOrderIndex& loadOrder, const std::string& darDir,
+		                  const std::string& bundlePath)
+	{
+		std::string data;
+		{
+			FILE* f = fopen(bundlePath.c_str(), "rb");
+			if (!CHECK(f))
+			{
+				return;
+			}
+			char chunk[4096];
+			size_t nRead;
+			while ((nRead = fread(chunk, 1, sizeof(chunk), f)) > 0)
+			{
+				data.append(chunk, nRead);
+			}
+			fclose(f);
+		}
+		const size_t kHeaderSize = 56;
+		if (!CHECK(data.size() > kHeaderSize))
+		{
+			return;
+		}
+		CorruptBundle corrupt(loadOrder, darDir, bundlePath + ".corrupt");
+		std::string error;
+		CHECK(corrupt.open(data, error));
+
+		// Truncated: the strings come last, so anything short is rejected.
+		for (size_t size = 0; size < data.size(); size++)
+		{
+			if (!CHECK(!corrupt.open(data.substr(0, size), error)))
+			{
+				fprintf(stderr, "  (truncated to %d bytes)\n", (int)size);
+			}
+		}
+		CHECK(!corrupt.open(data.substr(0, kHeaderSize - 1), error) && error == "truncated");
+
+		// Each field of the header.
+		std::string bad = data;
+		bad[0] = 'X';
+		CHECK(!corrupt.open(bad, error) && error == "not a DAR bundle");
+		bad = data;
+		writeU32(bad, 4, DARBundle::kVersion + 1);
+		CHECK(!corrupt.open(bad, error) && error == "wrong version (rebuild it with the matching darbundle)");
+		for (size_t offset = 8; offset < kHeaderSize; offset += 4)
+		{
+			uint32_t val = readU32(data, offset);
+			for (uint32_t badVal : { 0u, 1u, 2u, val - 1, val + 1, val + 4, val * 2, (uint32_t)data.size(),
+				                     0x7FFFFFFFu, 0x80000000u, 0xFFFFFFF0u, 0xFFFFFFFFu })
+			{
+				bad = data;
+				writeU32(bad, offset, badVal);
+				corrupt.open(bad, error);
+			}
+		}
+
+		// Each string reference (and anything else) in the records: every
+		// 4 bytes after the header, set to a few out of range values.
+		for (size_t offset = kHeaderSize; offset + 4 <= data.size(); offset += 4)
+		{
+			for (uint32_t badVal : { (uint32_t)data.size(), 0x10000u, 0xFFFFFFFFu })
+			{
+				bad = data;
+				writeU32(bad, offset, badVal);
+				corrupt.open(bad, error);
+			}
+		}
+
+		// A folder tree in which two links lead to the same node.
+		uint32_t nNodes = readU32(data, 8);
+		uint32_t nodesOffset = readU32(data, 12);
+		const size_t kNodeSize = sizeof(DirSnapshot::Node);
+		auto nodeField = [&](uint32_t node, size_t field)
+		{
+			return nodesOffset + node * kNodeSize + field;
+		};
+		const size_t kFirstChild = offsetof(DirSnapshot::Node, firstChild);
+		const size_t kNextSibling = offsetof(DirSnapshot::Node, nextSibling);
+		bool bShared = false;
+		for (uint32_t node = 1; node < nNodes && !bShared; node++)
+		{
+			uint32_t sibling = readU32(data, nodeField(node, kNextSibling));
+			for (uint32_t other = 1; other < nNodes && sibling != DirSnapshot::kNoNode; other++)
+			{
+				if (other != node && other < sibling
+					&& readU32(data, nodeField(other, kNextSibling)) == DirSnapshot::kNoNode)
+				{
+					bad = data;
+					writeU32(bad, nodeField(other, kNextSibling), sibling);
+					CHECK(!corrupt.open(bad, error) && error == "bad folder tree");
+					bShared = true;
+					break;
+				}
+			}
+		}
+		CHECK(bShared);
+		// And a file with children.
+		for (uint32_t node = 1; node < nNodes; node++)
+		{
+			if (readU32(data, nodeField(node, offsetof(DirSnapshot::Node, isDir))) == 0)
+			{
+				bad = data;
+				writeU32(bad, nodeField(node, kFirstChild), nNodes - 1);
+				CHECK(!corrupt.open(bad, error) && error == "bad folder tree");
+				break;
+			}
+		}
+
+		// Random bytes flipped.
+		std::mt19937 rng(33);
+		for (uint32_t i = 0; i < 2000; i++)
+		{
+			bad = data;
+			uint32_t nFlips = 1 + rng() % 4;
+			for (uint32_t j = 0; j < nFlips; j++)
+			{
+				bad[rng() % bad.size()] ^= (char)(1 << (rng() % 8));
+			}
+			corrupt.open(bad, error);
+		}
+		printf("corrupt input: %u of the corrupted bundles opened (and loaded)\n", corrupt.nOpened);
+	}
+}
+
+int main()
+{
+	setCoreLog(NULL);
+	TempDir tempDir("dargh-bundle");
+	std::filesystem::path darDir = tempDir.path / "DynamicAnimationReplacer";
+	std::string bundlePath = (tempDir.path / "DynamicAnimationReplacer.darb").string();
+	if (!CHECK(writeDARFolder(darDir)) || !CHECK(writeBundle(darDir.string(), bundlePath)))
+	{
+		return testResult();
+	}
+
+	LoadOrderIndex loadOrder;
+	loadOrder.add("Skyrim.esm", LoadOrderIndex::Mod{ 0, 0, false });
+	loadOrder.add("light.esl", LoadOrderIndex::Mod{ 0xFE, 1, true });
+
+	testRoundTrip(loadOrder, darDir.string(), bundlePath);
+	testCorruptInput(loadOrder, darDir.string(), bundlePath);
+	return testResult();
+}
\ No newline at end of file
@@ -0,0 +1,182 @@
+// ============================================================================
+//                           DARHotReloadTest.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "DARHotReload.h"
+#include "DARProjectRegistry.h"
+#include "TestGame.h"
+#include "TestUtils.h"
+
+#include <cstdlib>
+#include <thread>
+
+// ============================================================================
+//                           DARHotReloadTest.cpp
+// ----------------------------------------------------------------------------
+// Hot reloading through the real DirWatcher (inotify, here): a burst of
+// changes under one priority folder of a watched project must give exactly
+// one reload, of just that folder, once the changes have settled.
+// ============================================================================
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	const char* const kConditionsDir = "_CustomConditions";
+
+	// The core's log, as written so far.
+	class LogFile
+	{
+	public:
+		explicit LogFile(const std::filesystem::path& path) : path(path.string())
+		{
+			f = fopen(this->path.c_str(), "w");
+			setCoreLog(f);
+		}
+
+		int count(const std::string& line)
+		{
+			fflush(f);
+			FILE* fRead = fopen(path.c_str(), "r");
+			int n = 0;
+			char buf[1024];
+			while (fRead && fgets(buf, sizeof(buf), fRead))
+			{
+				n += std::string(buf) == line + "\n";
+			}
+			if (fRead)
+			{
+				fclose(fRead);
+			}
+			return n;
+		}
+
+	private:
+		std::string path;
+		FILE* f;
+	};
+
+	size_t numConditionLinks(DARProject& darProj, int32_t priority)
+	{
+		size_t n = 0;
+		for (auto& link : std::atomic_load(&darProj.links)->conditionLinks)
+		{
+			n += link.priority == priority;
+		}
+		return n;
+	}
+
+	// Watches the project's link table until it has been quiet for
+	// 'quietTime' (or for 'maxTime' in all), counting the times it's
+	// replaced, starting from 'links'.
+	int countReloads(DARProject& darProj, std::shared_ptr<const DARLinkTable> links,
+		             std::chrono::milliseconds quietTime, std::chrono::milliseconds maxTime)
+	{
+		int nReloads = 0;
+		Clock::time_point start = Clock::now();
+		Clock::time_point lastReload = start;
+		while (Clock::now() - start < maxTime
+			   && (nReloads == 0 || Clock::now() - lastReload < quietTime))
+		{
+			auto newLinks = std::atomic_load(&darProj.links);
+			if (newLinks != links)
+			{
+				nReloads++;
+				lastReload = Clock::now();
+				links = newLinks;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		return nReloads;
+	}
+
+	void changeFolder(const std::filesystem::path& dir, int nFiles)
+	{
+		// Several changes, each well within the settle time of the last:
+		// new files, then the conditions rewritten.
+		for (int i = 0; i < nFiles; i++)
+		{
+			writeFile(dir / ("new_" + std::to_string(i) + ".hkx"), "");
+			std::this_thread::sleep_for(std::chrono::milliseconds(40));
+		}
+		writeFile(dir / "_conditions.txt", "IsFemale() AND\r\nIsInCombat()\r\n");
+	}
+}
+
+int main()
+{
+	TempDir dataDir("dargh-hotreload");
+	LogFile log(dataDir.path / "dargh.log");
+	std::filesystem::path darDir =
+		dataDir.path / "meshes" / "actors" / "character" / "animations" / "DynamicAnimationReplacer";
+	for (const char* priority : { "100", "200" })
+	{
+		std::filesystem::path dir = darDir / kConditionsDir / priority;
+		CHECK(writeFile(dir / "_conditions.txt", "IsFemale()\r\n"));
+		CHECK(writeFile(dir / "mt_idle.hkx", ""));
+	}
+	CHECK(writeFile(darDir / "Skyrim.esm" / "00013746" / "mt_idle.hkx", ""));
+
+	LoadOrderIndex loadOrder;
+	loadOrder.add("Skyrim.esm", LoadOrderIndex::Mod{ 0, 0, false });
+	std::string projFilePath = "Actors\\Character\\DefaultMale.hkx";
+	DARGH::registerDARProject(projFilePath);
+	DARGH::initDARLoading(dataDir.path.string() + "/", std::move(loadOrder), std::vector<std::string>());
+	DARProject& darProj = DARGH::g_DARProjectRegistry.begin()->second;
+	DARGH::startDARHotReload();
+	DARGH::ensureDARMapsLoaded(darProj);
+	CHECK(numConditionLinks(darProj, 100) == 1 && numConditionLinks(darProj, 200) == 1);
+
+	// Nothing changes, nothing's reloaded.
+	CHECK(countReloads(darProj, std::atomic_load(&darProj.links),
+		               std::chrono::milliseconds(0), std::chrono::milliseconds(600)) == 0);
+
+	// A burst of changes in one folder: one reload, of that folder.
+	const std::string kReloaded100 = "actors\\character: reloaded DynamicAnimationReplacer\\_CustomConditions\\100";
+	const std::string kReloaded200 = "actors\\character: reloaded DynamicAnimationReplacer\\_CustomConditions\\200";
+	auto links = std::atomic_load(&darProj.links);
+	changeFolder(darDir / kConditionsDir / "100", 5);
+	CHECK(countReloads(darProj, links, std::chrono::milliseconds(1000), std::chrono::milliseconds(5000)) == 1);
+	CHECK(log.count(kReloaded100) == 1);
+	CHECK(log.count(kReloaded200) == 0);
+	CHECK(numConditionLinks(darProj, 100) == 6 && numConditionLinks(darProj, 200) == 1);
+	CHECK(std::atomic_load(&darProj.links)->actorBaseLinks.size() == 1);
+
+	// Then one in another.
+	links = std::atomic_load(&darProj.links);
+	changeFolder(darDir / kConditionsDir / "200", 2);
+	CHECK(countReloads(darProj, links, std::chrono::milliseconds(1000), std::chrono::milliseconds(5000)) == 1);
+	CHECK(log.count(kReloaded100) == 1);
+	CHECK(log.count(kReloaded200) == 1);
+	CHECK(numConditionLinks(darProj, 100) == 6 && numConditionLinks(darProj, 200) == 3);
+
+	// (The hot reload thread runs until the process ends, so leave without
+	// the static destructors it could race with.)
+	int result = testResult();
+	fflush(stdout);
+	fflush(stderr);
+	std::quick_exit(result);
+}
\ No newline at end of file
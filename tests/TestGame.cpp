@@ -0,0 +1,116 @@
+// ============================================================================
+//                               TestGame.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "TestGame.h"
+
+#include "FactionRanks.h"
+#include "LocationAncestry.h"
+#include "WorldState.h"
+
+#include <limits>
+
+namespace
+{
+	class TestGameState : public GameState
+	{
+	public:
+		uint32_t actorID(Actor* actor) override
+		{
+			return actor->formID;
+		}
+
+		bool isPlayer(Actor* actor) override
+		{
+			return actor->bIsPlayer;
+		}
+
+		float readNum(const FeatureKey& key, const FeatureLayout& layout, Actor* actor) override
+		{
+			(void)layout;
+			if (key.kind == FeatureKind::kEquippedType)
+			{
+				return actor->equippedTypes[key.param & 1];
+			}
+			return std::numeric_limits<float>::quiet_NaN();
+		}
+
+		uint32_t readFormID(const FeatureKey& key, Actor* actor) override
+		{
+			switch (key.kind)
+			{
+			case FeatureKind::kEquipped:
+				return actor->equipped[key.param & 1];
+			case FeatureKind::kActorBase:
+				return actor->baseFormID;
+			case FeatureKind::kRace:
+				return actor->raceID;
+			case FeatureKind::kParentCell:
+				return actor->parentCell;
+			default:
+				return 0;
+			}
+		}
+
+		const TESGlobal* lookupGlobal(uint32_t formID) override
+		{
+			(void)formID;
+			return NULL;
+		}
+	};
+
+	TestGameState s_testGameState;
+
+	float readWorldNum(const FeatureKey& key)
+	{
+		(void)key;
+		return std::numeric_limits<float>::quiet_NaN();
+	}
+
+	uint32_t readWorldFormID(const FeatureKey& key)
+	{
+		(void)key;
+		return 0;
+	}
+
+	uint32_t readParentLocation(uint32_t locationID)
+	{
+		(void)locationID;
+		return 0;
+	}
+
+	bool readFactionRanks(uint32_t actorID, const uint32_t* factionIDs, size_t nFactions,
+		                  FactionRank* ranks_out)
+	{
+		(void)actorID, (void)factionIDs, (void)nFactions, (void)ranks_out;
+		return false;
+	}
+}
+
+GameState* g_gameState = &s_testGameState;
+WorldState g_worldState(readWorldNum, readWorldFormID);
+LocationAncestry g_locationAncestry(readParentLocation);
+FactionRanks g_factionRanks(readFactionRanks, 64);
\ No newline at end of file
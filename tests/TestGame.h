@@ -0,0 +1,48 @@
+// ============================================================================
+//                                TestGame.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include "GameState.h"
+
+#include <cstdint>
+
+// ============================================================================
+// The game, for the tests that run the loaders or the condition code (which
+// read it through g_gameState and friends; see GameState.h). Link in
+// TestGame.cpp, which defines those over the actors below. There's no
+// world: world features, locations and factions all read as unknown.
+// ============================================================================
+struct Actor
+{
+	uint32_t  formID = 0;
+	uint32_t  baseFormID = 0;
+	uint32_t  raceID = 0;
+	uint32_t  equipped[2] = {};           // (0 = left, 1 = right)
+	float     equippedTypes[2] = {};
+	uint32_t  parentCell = 0;
+	bool      bIsPlayer = false;
+};
\ No newline at end of file
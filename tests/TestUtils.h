@@ -0,0 +1,93 @@
+// ============================================================================
+//                                TestUtils.h
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+// ============================================================================
+// What the tests share. Each test is a program of its own (see the tests in
+// CMakeLists.txt) whose main runs its cases and returns testResult(): ctest
+// takes any exit code but 0 as a failure. CHECK reports each check that
+// fails, and carries on.
+// ============================================================================
+inline int g_numFailedChecks = 0;
+
+inline bool checkFailed(const char* expr, const char* file, int line)
+{
+	fprintf(stderr, "%s(%d): failed: %s\n", file, line, expr);
+	g_numFailedChecks++;
+	return false;
+}
+
+#define CHECK(expr) ((expr) ? true : checkFailed(#expr, __FILE__, __LINE__))
+
+inline int testResult()
+{
+	if (g_numFailedChecks)
+	{
+		fprintf(stderr, "%d check(s) failed\n", g_numFailedChecks);
+		return 1;
+	}
+	return 0;
+}
+
+// A folder in the system's temporary folder, removed (with everything in
+// it) when done.
+struct TempDir
+{
+	std::filesystem::path path;
+
+	explicit TempDir(const char* name)
+		: path(std::filesystem::temp_directory_path()
+			   / (std::string(name) + "-"
+				  + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count())))
+	{
+		std::filesystem::create_directories(path);
+	}
+	~TempDir()
+	{
+		std::error_code ec;
+		std::filesystem::remove_all(path, ec);
+	}
+};
+
+// Writes 'data' to 'path' (making its folder if need be).
+inline bool writeFile(const std::filesystem::path& path, const std::string& data)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+	FILE* f = fopen(path.string().c_str(), "wb");
+	if (!f)
+	{
+		return false;
+	}
+	bool bOK = fwrite(data.data(), 1, data.size(), f) == data.size();
+	return fclose(f) == 0 && bOK;
+}
\ No newline at end of file
@@ -0,0 +1,1136 @@
+// ============================================================================
+//                               darbench.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "ConditionCache.h"
+#include "ConditionEvents.h"
+#include "ConditionsParser.h"
+#include "DARAnimationNames.h"
+#include "DARProjectRegistry.h"
+#include "DirSnapshot.h"
+#include "FactionRanks.h"
+#include "GameState.h"
+#include "LocationAncestry.h"
+#include "MemoryAccounting.h"
+#include "ShardedHashMap.h"
+#include "WorldState.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// darbench: times the portable core of dargh on a synthetic DAR project:
+// 
+//   load       loading the project's links from its DynamicAnimationReplacer
+//              folder (parsing and binding its _conditions.txt files), then
+//              reloading it
+//   rebuild    rebuilding its animation names array and links (as
+//              GenAnimation_Hook does each time the game generates the
+//              project's animations)
+//   lookup     DARGH::getNewAnimIndex for every animation, for each actor
+//   extract    reading the features each animation's conditions use
+//   evaluate   evaluating the compiled conditions on those features
+// 
+// and then prints what the core holds (see MemoryAccounts), so that a change
+// that costs memory shows up here as well as one that costs time. Then
+// walking a large DAR folder:
+// 
+//   snapshot   DirSnapshot::build over it
+//   query      finding each priority folder's .hkx files in the snapshot
+//   rewalk     walking each priority folder again instead (as the loaders
+//              did before DirSnapshot)
+//   parse      reading and parsing 10,000 _conditions.txt files
+// 
+// and the condition cache, over 1,000 actors of which a few have events:
+// 
+//   events     ConditionEvents::notify for those, and dirtyScopes for all
+//   activate   ConditionCache::Entry::beginActivation and findResult for
+//              each of their programs
+// 
+// and the structures the game's threads share:
+// 
+//   sharded    the string data map (ShardedHashMap, as g_animHashmap) on 1
+//   onelock    to 16 threads, and the same map behind a single lock
+//   spinlock   SpinLock, and a model of the game's BSSpinLock, on 2 to 32
+//   bslock     threads taking turns at a short critical section
+// 
+//   darbench [--quick] [--verbose] [<work folder>]
+// 
+// The project is written to (and afterwards removed from) a folder in the
+// work folder, by default the system's temporary folder. --quick runs a
+// small project a few times (it's what ctest runs); --verbose shows the
+// core's log. Exits with 1 if the project didn't load or apply as expected,
+// or (with --quick) the core held more memory than it should.
+// 
+// Built along with the core library by CMakeLists.txt.
+// ============================================================================
+
+typedef std::chrono::steady_clock Clock;
+
+// ============================================================================
+//                            THE SYNTHETIC GAME
+// ============================================================================
+// The core only ever sees Actor* (see GameState.h), so here an actor is
+// whatever the synthetic game state says it is.
+struct Actor
+{
+	uint32_t  formID;
+	uint32_t  baseFormID;
+	uint32_t  raceID;
+	uint32_t  equipped[2];            // (0 = left, 1 = right)
+	float     equippedTypes[2];
+	uint32_t  parentCell;
+	uint32_t  location;
+	float     level;
+};
+
+static const uint32_t kFirstActorBase = 0x00010000;
+static const uint32_t kFirstRace = 0x00013740;
+static const uint32_t kNumRaces = 8;
+static const uint32_t kFirstFaction = 0x00020000;
+static const uint32_t kNumFactions = 16;
+static const uint32_t kFirstKeyword = 0x00030000;
+static const uint32_t kFirstLocation = 0x00040000;
+static const uint32_t kNumLocations = 16;
+static const uint32_t kFirstCell = 0x00050000;
+static const uint32_t kFirstGlobal = 0x00060000;
+static const uint32_t kFirstWeather = 0x00070000;
+
+static uint32_t mix(uint32_t x, uint32_t y)
+{
+	// (Deterministic stand-ins for state we don't model.)
+	uint64_t z = ((uint64_t)x << 32 | y) + 0x9E3779B97F4A7C15ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return (uint32_t)(z ^ (z >> 31));
+}
+
+class BenchGameState : public GameState
+{
+public:
+	uint32_t actorID(Actor* actor) override
+	{
+		return actor->formID;
+	}
+
+	bool isPlayer(Actor* actor) override
+	{
+		return actor->formID == 0x14;
+	}
+
+	float readNum(const FeatureKey& key, const FeatureLayout& layout, Actor* actor) override
+	{
+		switch (key.kind)
+		{
+		case FeatureKind::kPredicate:
+			return (mix(actor->formID, ((uint32_t)key.funcId << 24) ^ key.param) & 3) ? 1.0f : 0.0f;
+		case FeatureKind::kCall:
+		{
+			const ConditionCall& call = layout.calls[key.param];
+			return (mix(actor->formID, ((uint32_t)call.funcId << 24) ^ call.args[0].formID) & 1) ? 1.0f : 0.0f;
+		}
+		case FeatureKind::kEquippedType:
+			return actor->equippedTypes[key.param & 1];
+		case FeatureKind::kLevel:
+			return actor->level;
+		case FeatureKind::kMovementDirection:
+			return (float)(mix(actor->formID, 0) % 5);
+		case FeatureKind::kActorValue:
+		case FeatureKind::kActorValueBase:
+		case FeatureKind::kActorValueMax:
+		case FeatureKind::kActorValuePercentage:
+			return (float)(mix(actor->formID, key.param) % 100);
+		case FeatureKind::kFactionRank:
+			return (float)(mix(actor->formID, key.param) % 5) - 1.0f;
+		default:
+			return std::numeric_limits<float>::quiet_NaN();
+		}
+	}
+
+	uint32_t readFormID(const FeatureKey& key, Actor* actor) override
+	{
+		switch (key.kind)
+		{
+		case FeatureKind::kEquipped:
+			return actor->equipped[key.param & 1];
+		case FeatureKind::kActorBase:
+			return actor->baseFormID;
+		case FeatureKind::kRace:
+			return actor->raceID;
+		case FeatureKind::kParentCell:
+			return actor->parentCell;
+		case FeatureKind::kCurrentLocation:
+			return actor->location;
+		case FeatureKind::kWorldSpace:
+			return 0x3C;
+		default:
+			return 0;
+		}
+	}
+
+	const TESGlobal* lookupGlobal(uint32_t formID) override
+	{
+		// (Globals are read as world features, see readWorldNum.)
+		(void)formID;
+		return NULL;
+	}
+};
+
+static BenchGameState s_benchGameState;
+GameState* g_gameState = &s_benchGameState;
+
+static float readWorldNum(const FeatureKey& key)
+{
+	switch (key.kind)
+	{
+	case FeatureKind::kGameHour:
+		return 14.5f;
+	case FeatureKind::kGlobalValue:
+		return (float)(key.param % 10);
+	default:
+		return std::numeric_limits<float>::quiet_NaN();
+	}
+}
+
+static uint32_t readWorldFormID(const FeatureKey& key)
+{
+	return key.kind == FeatureKind::kWeather ? kFirstWeather + 1 : 0;
+}
+
+WorldState g_worldState(readWorldNum, readWorldFormID);
+
+static uint32_t readParentLocation(uint32_t locationID)
+{
+	// Locations form a chain: each one's parent is the one before it.
+	return locationID > kFirstLocation && locationID < kFirstLocation + kNumLocations
+		? locationID - 1 : 0;
+}
+
+LocationAncestry g_locationAncestry(readParentLocation);
+
+static bool readFactionRanks(uint32_t actorID, const uint32_t* factionIDs, size_t nFactions,
+	                         FactionRank* ranks_out)
+{
+	for (size_t i = 0; i < nFactions; i++)
+	{
+		ranks_out[i].rank = (int)(mix(actorID, factionIDs[i]) % 5) - 1;
+		ranks_out[i].bIsIn = ranks_out[i].rank >= 0;
+	}
+	return true;
+}
+
+FactionRanks g_factionRanks(readFactionRanks, 8192);
+
+// ============================================================================
+//                           THE SYNTHETIC PROJECT
+// ============================================================================
+struct BenchSize
+{
+	uint32_t  nAnims;                 // names in the project's animationNames array
+	uint32_t  nActorBases;            // M1: (actor base id) folders
+	uint32_t  nFilesPerActorBase;
+	uint32_t  nPriorities;            // M2: _CustomConditions\<Priority> folders
+	uint32_t  nFilesPerPriority;
+	uint32_t  nActors;
+	uint32_t  nReloads;
+	uint32_t  nRebuilds;
+	uint32_t  nLookupRounds;          // times round every actor and animation
+	uint32_t  nEvalRounds;
+	const MemoryAccounts::Usage* maxUsage;    // by MemCategory, the most the core may hold after the run (if given)
+};
+
+// The quick project holds about half these bytes and three quarters of the
+// objects. (The bytes depend on the standard library's growth policies; the
+// object counts don't, but the project's random draws do.)
+static const MemoryAccounts::Usage kQuickMaxUsage[(size_t)MemCategory::kNumCategories] =
+{
+	{ 64 << 10, 1200 },       // kLinkVectors
+	{ 224 << 10, 2400 },      // kConditionArgs
+	{ 512 << 10, 1200 },      // kLinkData
+	{ 320 << 10, 3200 },      // kNameArrays
+	{ 0, 0 },                 // kAnimHashmap (every graph is freed)
+	{ 512 << 10, 1200 },      // kLeakedRebuilds
+	{ 2048 << 10, 1600 },     // kPaths
+};
+
+static const BenchSize kQuickSize = { 300, 4, 20, 20, 40, 16, 1, 2, 5, 20, kQuickMaxUsage };
+static const BenchSize kFullSize = { 3000, 16, 100, 200, 50, 256, 3, 5, 2, 5, nullptr };
+
+static std::string animFileName(uint32_t anim)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "anim%04u.hkx", anim);
+	return name;
+}
+
+// A folder of the work folder, removed (with everything in it) when done.
+struct ScratchDir
+{
+	std::filesystem::path path;
+
+	ScratchDir(const std::filesystem::path& workDir, const char* name)
+		: path(workDir / (std::string(name) + "-" + std::to_string(Clock::now().time_since_epoch().count())))
+	{
+	}
+	~ScratchDir()
+	{
+		std::error_code ec;
+		std::filesystem::remove_all(path, ec);
+	}
+};
+
+static bool writeFile(const std::filesystem::path& path, const std::string& text)
+{
+	FILE* f = fopen(path.string().c_str(), "wb");
+	if (!f)
+	{
+		return false;
+	}
+	bool bOK = fwrite(text.data(), 1, text.size(), f) == text.size();
+	return (fclose(f) == 0) && bOK;
+}
+
+static std::string conditionLine(std::mt19937& rng)
+{
+	// One condition, of the kinds DAR mods commonly use.
+	char line[128];
+	uint32_t r = rng();
+	switch (r % 14)
+	{
+	case 0:  snprintf(line, sizeof(line), "IsActorBase(\"Skyrim.esm\" | 0x%06X)", kFirstActorBase + (r >> 8) % 32); break;
+	case 1:  snprintf(line, sizeof(line), "IsRace(\"Skyrim.esm\" | 0x%06X)", kFirstRace + (r >> 8) % kNumRaces); break;
+	case 2:  snprintf(line, sizeof(line), "IsEquippedRightType(%u)", (r >> 8) % 10); break;
+	case 3:  snprintf(line, sizeof(line), "IsEquippedLeftType(%u)", (r >> 8) % 10); break;
+	case 4:  snprintf(line, sizeof(line), "IsLevelLessThan(%u)", 5 + (r >> 8) % 60); break;
+	case 5:  snprintf(line, sizeof(line), "IsInCombat()"); break;
+	case 6:  snprintf(line, sizeof(line), "IsFemale()"); break;
+	case 7:  snprintf(line, sizeof(line), "IsActorValueLessThan(%u, %u)", (r >> 8) % 24, (r >> 16) % 100); break;
+	case 8:  snprintf(line, sizeof(line), "IsFactionRankEqualTo(%u, \"Skyrim.esm\" | 0x%06X)", (r >> 8) % 4, kFirstFaction + (r >> 16) % kNumFactions); break;
+	case 9:  snprintf(line, sizeof(line), "HasKeyword(\"Skyrim.esm\" | 0x%06X)", kFirstKeyword + (r >> 8) % 64); break;
+	case 10: snprintf(line, sizeof(line), "CurrentWeather(\"Skyrim.esm\" | 0x%06X)", kFirstWeather + (r >> 8) % 4); break;
+	case 11: snprintf(line, sizeof(line), "ValueLessThan(\"Skyrim.esm\" | 0x%06X, %u)", kFirstGlobal + (r >> 8) % 8, (r >> 16) % 10); break;
+	case 12: snprintf(line, sizeof(line), "IsInLocation(\"Skyrim.esm\" | 0x%06X)", kFirstLocation + (r >> 8) % kNumLocations); break;
+	default: snprintf(line, sizeof(line), "Random(%u)", (r >> 8) % 100); break;
+	}
+	return line;
+}
+
+static std::string conditionsFile(std::mt19937& rng)
+{
+	// A _conditions.txt of 1 to 4 conditions, ANDed or ORed.
+	std::string text;
+	uint32_t nConditions = 1 + rng() % 4;
+	for (uint32_t i = 0; i < nConditions; i++)
+	{
+		if (rng() % 4 == 0)
+		{
+			text += "NOT ";
+		}
+		text += conditionLine(rng);
+		if (i + 1 < nConditions)
+		{
+			text += (rng() % 3 == 0) ? " OR" : " AND";
+		}
+		text += "\r\n";
+	}
+	return text;
+}
+
+static std::vector<uint32_t> pickAnims(std::mt19937& rng, uint32_t n, uint32_t nAnims)
+{
+	// 'n' different animations (a folder can only replace each one once).
+	std::vector<uint32_t> anims(nAnims);
+	for (uint32_t i = 0; i < nAnims; i++)
+	{
+		anims[i] = i;
+	}
+	for (uint32_t i = 0; i < n; i++)
+	{
+		std::swap(anims[i], anims[i + rng() % (nAnims - i)]);
+	}
+	anims.resize(n);
+	return anims;
+}
+
+static bool writeProject(const std::filesystem::path& darDir, const BenchSize& size)
+{
+	// ====================================================================
+	// Writes the project's DynamicAnimationReplacer folder: the M1 folders
+	// Skyrim.esm\<actor base id>, and the M2 folders
+	// _CustomConditions\<Priority>, each replacing a random selection of
+	// the project's animations. (The .hkx files are empty: only their
+	// names are ever read.)
+	// ====================================================================
+	std::mt19937 rng(12345);
+	std::error_code ec;
+	for (uint32_t i = 0; i < size.nActorBases; i++)
+	{
+		char actorBase[16];
+		snprintf(actorBase, sizeof(actorBase), "%08X", kFirstActorBase + i);
+		std::filesystem::path dir = darDir / "Skyrim.esm" / actorBase;
+		std::filesystem::create_directories(dir, ec);
+		for (uint32_t anim : pickAnims(rng, size.nFilesPerActorBase, size.nAnims))
+		{
+			if (!writeFile(dir / animFileName(anim), ""))
+			{
+				return false;
+			}
+		}
+	}
+	for (uint32_t i = 0; i < size.nPriorities; i++)
+	{
+		std::filesystem::path dir = darDir / "_CustomConditions" / std::to_string(100 + i * 10);
+		std::filesystem::create_directories(dir, ec);
+		if (!writeFile(dir / "_conditions.txt", conditionsFile(rng)))
+		{
+			return false;
+		}
+		for (uint32_t anim : pickAnims(rng, size.nFilesPerPriority, size.nAnims))
+		{
+			if (!writeFile(dir / animFileName(anim), ""))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static std::vector<Actor> makeActors(uint32_t nActors)
+{
+	std::mt19937 rng(54321);
+	std::vector<Actor> actors(nActors);
+	for (uint32_t i = 0; i < nActors; i++)
+	{
+		Actor& actor = actors[i];
+		actor.formID = 0xFF000800 + i;
+		actor.baseFormID = kFirstActorBase + rng() % 32;
+		actor.raceID = kFirstRace + rng() % kNumRaces;
+		for (int hand = 0; hand < 2; hand++)
+		{
+			actor.equipped[hand] = 0x00080000 + rng() % 256;
+			actor.equippedTypes[hand] = (float)(rng() % 10);
+		}
+		actor.parentCell = kFirstCell + rng() % 64;
+		actor.location = kFirstLocation + rng() % kNumLocations;
+		actor.level = (float)(1 + rng() % 80);
+	}
+	return actors;
+}
+
+// ============================================================================
+//                               BENCHMARKS
+// ============================================================================
+static void printTime(const char* name, uint64_t nOps, const char* opName, Clock::duration elapsed)
+{
+	double ms = std::chrono::duration<double, std::milli>(elapsed).count();
+	printf("%-12s %10llu %-12s %10.2f ms %12.1f ns/op\n", name, (unsigned long long)nOps, opName,
+		   ms, nOps ? ms * 1e6 / (double)nOps : 0.0);
+}
+
+// ----------------------------------------------------------------------------
+//  The project: load, rebuild, lookup, extract and evaluate (and memory)
+// ----------------------------------------------------------------------------
+static bool benchProject(const BenchSize& size, const std::filesystem::path& workDir)
+{
+	ScratchDir scratch(workDir, "darbench");
+	const std::filesystem::path& dataDir = scratch.path;
+	std::filesystem::path darDir = dataDir / "meshes" / "actors" / "character" / "animations" / "DynamicAnimationReplacer";
+	if (!writeProject(darDir, size))
+	{
+		fprintf(stderr, "darbench: couldn't write the project to %s\n", dataDir.string().c_str());
+		return false;
+	}
+
+	// The load order: just the master files.
+	LoadOrderIndex loadOrder;
+	const char* masters[] = { "Skyrim.esm", "Update.esm", "Dawnguard.esm" };
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		LoadOrderIndex::Mod mod;
+		mod.compileIndex = i;
+		mod.smallFileCompileIndex = 0;
+		mod.isESL = false;
+		loadOrder.add(masters[i], mod);
+	}
+	std::string projFilePath = "Actors\\Character\\DefaultMale.hkx";
+	DARGH::registerDARProject(projFilePath);
+	DARGH::initDARLoading(dataDir.string() + "/", std::move(loadOrder), std::vector<std::string>());
+	DARGH::g_isDARDataLoaded = true;
+	DARProject& darProj = DARGH::g_DARProjectRegistry.begin()->second;
+	bool bOK = true;
+
+	printf("darbench: %u animations, %u actor base and %u conditional replacements, %u actors\n\n",
+		   size.nAnims, size.nActorBases * size.nFilesPerActorBase,
+		   size.nPriorities * size.nFilesPerPriority, size.nActors);
+
+	// ------------------------------------------------------------------------
+	//  load
+	// ------------------------------------------------------------------------
+	Clock::time_point start = Clock::now();
+	DARGH::ensureDARMapsLoaded(darProj);
+	printTime("load", 1, "load", Clock::now() - start);
+	start = Clock::now();
+	for (uint32_t i = 0; i < size.nReloads; i++)
+	{
+		DARGH::reloadDARMaps(darProj, std::vector<std::string>{ "" });
+	}
+	printTime("reload", size.nReloads, "reloads", Clock::now() - start);
+	std::shared_ptr<const DARLinkTable> links = std::atomic_load(&darProj.links);
+	if (links->actorBaseLinks.size() != size.nActorBases * size.nFilesPerActorBase
+		|| links->conditionLinks.size() != size.nPriorities * size.nFilesPerPriority)
+	{
+		fprintf(stderr, "darbench: loaded %d actor base and %d conditional links\n",
+			    (int)links->actorBaseLinks.size(), (int)links->conditionLinks.size());
+		bOK = false;
+	}
+
+	// ------------------------------------------------------------------------
+	//  rebuild
+	// ------------------------------------------------------------------------
+	// The project's own names (cased as the game has them).
+	std::vector<std::string> origNameStrings;
+	std::vector<const char*> origNames;
+	for (uint32_t i = 0; i < size.nAnims; i++)
+	{
+		origNameStrings.push_back("Animations\\" + animFileName(i));
+		origNameStrings.back()[11] = 'A';
+	}
+	for (auto& name : origNameStrings)
+	{
+		origNames.push_back(name.c_str());
+	}
+	AnimationNames animNames;
+	start = Clock::now();
+	for (uint32_t i = 0; i < size.nRebuilds; i++)
+	{
+		DARGH::rebuildAnimationNames(darProj, *links, origNames.data(), size.nAnims, 16384, animNames);
+	}
+	printTime("rebuild", size.nRebuilds, "arrays", Clock::now() - start);
+	printf("             %u names: %u orig + %u replacements for %u remaps (%d dropped)\n",
+		   animNames.nNames, animNames.nOrig, animNames.nNames - animNames.nOrig,
+		   animNames.nRemaps, (int)animNames.dropped.size());
+	std::shared_ptr<const DARLinkIndex> linkIndex =
+		DARGH::findLinkIndex(darProj, animNames.names, animNames.nNames);
+	if (!linkIndex || linkIndex->allLinks.empty())
+	{
+		fprintf(stderr, "darbench: the rebuild made no replacements\n");
+		return false;
+	}
+
+	// ------------------------------------------------------------------------
+	//  lookup
+	// ------------------------------------------------------------------------
+	std::vector<Actor> actors = makeActors(size.nActors);
+	uint64_t nLookups = 0, nReplaced = 0;
+	start = Clock::now();
+	for (uint32_t round = 0; round < size.nLookupRounds; round++)
+	{
+		for (auto& actor : actors)
+		{
+			for (uint32_t anim = 0; anim < size.nAnims; anim++)
+			{
+				if (DARGH::getNewAnimIndex(&darProj, *linkIndex, (hkInt16)anim, &actor) != -1)
+				{
+					nReplaced++;
+				}
+				nLookups++;
+			}
+		}
+	}
+	printTime("lookup", nLookups, "activations", Clock::now() - start);
+	printf("             %.1f%% replaced\n", nLookups ? 100.0 * nReplaced / nLookups : 0.0);
+	if (nReplaced == 0)
+	{
+		fprintf(stderr, "darbench: no animation was ever replaced\n");
+		bOK = false;
+	}
+
+	// ------------------------------------------------------------------------
+	//  extract and evaluate
+	// ------------------------------------------------------------------------
+	// Each animation's features, for each actor, then every program over
+	// them (without the cache, i.e. the work a cache miss does).
+	std::vector<const AnimLinks*> animLinks;
+	for (auto& entry : linkIndex->allLinks)
+	{
+		animLinks.push_back(&entry.second);
+	}
+	std::vector<FeatureVector> features(animLinks.size() * actors.size());
+	std::shared_ptr<const WorldSnapshot> world = g_worldState.get();
+	uint64_t nExtracts = 0;
+	start = Clock::now();
+	for (uint32_t round = 0; round < size.nEvalRounds; round++)
+	{
+		for (size_t i = 0; i < animLinks.size(); i++)
+		{
+			for (size_t j = 0; j < actors.size(); j++)
+			{
+				extractFeatures(animLinks[i]->features, &actors[j], world.get(), ~0u,
+					            features[i * actors.size() + j]);
+				nExtracts++;
+			}
+		}
+	}
+	printTime("extract", nExtracts, "layouts", Clock::now() - start);
+
+	uint64_t nEvaluations = 0, nTrue = 0;
+	start = Clock::now();
+	for (uint32_t round = 0; round < size.nEvalRounds; round++)
+	{
+		for (size_t i = 0; i < animLinks.size(); i++)
+		{
+			for (auto& link : animLinks[i]->byPriority)
+			{
+				const ConditionLinkData* conditionLink = dynamic_cast<const ConditionLinkData*>(link.second);
+				if (!conditionLink)
+				{
+					continue;
+				}
+				for (size_t j = 0; j < actors.size(); j++)
+				{
+					if (conditionLink->program.evaluate(features[i * actors.size() + j]))
+					{
+						nTrue++;
+					}
+					nEvaluations++;
+				}
+			}
+		}
+	}
+	printTime("evaluate", nEvaluations, "programs", Clock::now() - start);
+	printf("             %.1f%% true\n", nEvaluations ? 100.0 * nTrue / nEvaluations : 0.0);
+
+	// ------------------------------------------------------------------------
+	//  memory
+	// ------------------------------------------------------------------------
+	printf("\n");
+	g_memoryAccounts.report([](const char* line) { printf("%s\n", line); });
+	printf("peak: %lld KB\n", (long long)(g_memoryAccounts.peakBytes() / 1024));
+	for (size_t i = 0; size.maxUsage && i < (size_t)MemCategory::kNumCategories; i++)
+	{
+		MemoryAccounts::Usage usage = g_memoryAccounts.total((MemCategory)i);
+		if (usage.bytes > size.maxUsage[i].bytes || usage.objects > size.maxUsage[i].objects)
+		{
+			fprintf(stderr, "darbench: %s: %lld KB (%lld objects), expected at most %lld KB (%lld)\n",
+				    memCategoryName((MemCategory)i), (long long)(usage.bytes / 1024), (long long)usage.objects,
+				    (long long)(size.maxUsage[i].bytes / 1024), (long long)size.maxUsage[i].objects);
+			bOK = false;
+		}
+	}
+	return bOK;
+}
+
+// ----------------------------------------------------------------------------
+//  The DAR folder walk
+// ----------------------------------------------------------------------------
+static size_t walkForHkxFiles(const std::filesystem::path& dir)
+{
+	// What the loaders did before DirSnapshot (with findMatchingFiles):
+	// walk each folder they were interested in, recursively, again.
+	size_t nFiles = 0;
+	std::error_code ec;
+	for (std::filesystem::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+	{
+		if (!it->is_directory(ec) && it->path().extension() == ".hkx")
+		{
+			nFiles++;
+		}
+	}
+	return nFiles;
+}
+
+static bool benchDirSnapshot(bool bQuick, const std::filesystem::path& workDir)
+{
+	// A DynamicAnimationReplacer folder of _CustomConditions\<Priority>
+	// folders, each with a _conditions.txt and .hkx files, half of them in
+	// a subfolder: 100,000 .hkx files in all (2,000 with --quick).
+	uint32_t nPriorities = bQuick ? 40 : 1000;
+	uint32_t nFilesPerPriority = bQuick ? 50 : 100;
+	uint32_t nWalks = bQuick ? 2 : 3;
+	ScratchDir scratch(workDir, "darbench-tree");
+	std::filesystem::path conditionsDir = scratch.path / "_CustomConditions";
+	std::error_code ec;
+	for (uint32_t i = 0; i < nPriorities; i++)
+	{
+		std::filesystem::path dir = conditionsDir / std::to_string(1000 + i);
+		std::filesystem::create_directories(dir / "sub", ec);
+		if (!writeFile(dir / "_conditions.txt", "IsFemale()\r\n"))
+		{
+			fprintf(stderr, "darbench: couldn't write the tree to %s\n", scratch.path.string().c_str());
+			return false;
+		}
+		for (uint32_t j = 0; j < nFilesPerPriority; j++)
+		{
+			writeFile((j % 2 ? dir / "sub" : dir) / animFileName(j), "");
+		}
+	}
+	size_t nFiles = (size_t)nPriorities * nFilesPerPriority;
+	printf("\n%u priority folders, %u .hkx files\n", nPriorities, (uint32_t)nFiles);
+
+	// The snapshot: one walk, then the loader's queries against it.
+	Clock::time_point start = Clock::now();
+	DirSnapshot tree;
+	for (uint32_t i = 0; i < nWalks; i++)
+	{
+		tree.build(scratch.path.string(), ".hkx");
+	}
+	printTime("snapshot", nWalks, "walks", Clock::now() - start);
+
+	std::vector<std::string> sPriorities;
+	std::vector<std::string> hkxFiles;
+	start = Clock::now();
+	uint32_t conditionsNode = tree.childDir(tree.root(), "_CustomConditions");
+	tree.listSubdirs(conditionsNode, sPriorities);
+	for (auto& sPriority : sPriorities)
+	{
+		tree.findFiles(tree.childDir(conditionsNode, sPriority), ".hkx", hkxFiles);
+	}
+	printTime("query", sPriorities.size(), "folders", Clock::now() - start);
+
+	// The walks the loaders used to make: one for the priority folders,
+	// then one per priority folder.
+	start = Clock::now();
+	size_t nWalked = 0;
+	for (uint32_t i = 0; i < nWalks; i++)
+	{
+		nWalked = 0;
+		for (std::filesystem::directory_iterator it(conditionsDir, ec), end; !ec && it != end; it.increment(ec))
+		{
+			nWalked += walkForHkxFiles(it->path());
+		}
+	}
+	printTime("rewalk", nWalks, "walks", Clock::now() - start);
+
+	if (hkxFiles.size() != nFiles || nWalked != nFiles)
+	{
+		fprintf(stderr, "darbench: the snapshot found %d .hkx files and the walk %d, of %d\n",
+			    (int)hkxFiles.size(), (int)nWalked, (int)nFiles);
+		return false;
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+//  Parsing _conditions.txt files
+// ----------------------------------------------------------------------------
+static bool benchParse(bool bQuick, const std::filesystem::path& workDir)
+{
+	// 10,000 files (1,000 with --quick), each read and parsed as the
+	// loaders do it, a few times over.
+	uint32_t nFiles = bQuick ? 1000 : 10000;
+	uint32_t nRounds = 3;
+	ScratchDir scratch(workDir, "darbench-parse");
+	std::error_code ec;
+	std::filesystem::create_directories(scratch.path, ec);
+	std::vector<std::string> paths;
+	std::mt19937 rng(5);
+	size_t nBytes = 0;
+	for (uint32_t i = 0; i < nFiles; i++)
+	{
+		std::string text = conditionsFile(rng);
+		paths.push_back((scratch.path / (std::to_string(i) + ".txt")).string());
+		if (!writeFile(paths.back(), text))
+		{
+			fprintf(stderr, "darbench: couldn't write the files to %s\n", scratch.path.string().c_str());
+			return false;
+		}
+		nBytes += text.size();
+	}
+	printf("\n%u _conditions.txt files, %u KB\n", nFiles, (uint32_t)(nBytes >> 10));
+
+	std::string text;
+	ParsedConditions parsed;
+	uint32_t nParsed = 0;
+	Clock::time_point start = Clock::now();
+	for (uint32_t round = 0; round < nRounds; round++)
+	{
+		nParsed = 0;
+		for (auto& path : paths)
+		{
+			nParsed += DARGH::readConditionsFile(path, text)
+				&& DARGH::parseConditionSyntax(text, parsed);
+		}
+	}
+	printTime("parse", (uint64_t)nFiles * nRounds, "files", Clock::now() - start);
+
+	if (nParsed != nFiles)
+	{
+		fprintf(stderr, "darbench: parsed %u of the %u files\n", nParsed, nFiles);
+		return false;
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+//  The condition cache
+// ----------------------------------------------------------------------------
+static bool benchConditionEvents(bool bQuick)
+{
+	// 1,000 actors activating 8 programs each, frame after frame, with 1 in
+	// 50 of them changing equipment (and 1 in 50 the cell) every frame.
+	const uint32_t kNumActors = 1000;
+	const uint32_t kNumPrograms = 8;
+	const uint32_t kEventEvery = 50;
+	uint32_t nFrames = bQuick ? 20 : 500;
+	const uint32_t kReadScopes[kNumPrograms] =
+	{
+		scopeBit(FeatureScope::kActor),
+		scopeBit(FeatureScope::kStatic),
+		scopeBit(FeatureScope::kStatic),
+		scopeBit(FeatureScope::kEquipment),
+		scopeBit(FeatureScope::kEquipment) | scopeBit(FeatureScope::kStatic),
+		scopeBit(FeatureScope::kCombat),
+		scopeBit(FeatureScope::kCell),
+		scopeBit(FeatureScope::kActor) | scopeBit(FeatureScope::kCell)
+	};
+	FeatureLayout layout;
+	layout.nPrograms = kNumPrograms;
+	std::vector<ConditionProgram> programs(kNumPrograms);
+	for (uint16_t i = 0; i < kNumPrograms; i++)
+	{
+		programs[i].index = i;
+		programs[i].readScopes = kReadScopes[i];
+		programs[i].bCacheable = true;
+	}
+	ConditionEvents events(kNumActors * 2);
+	events.subscribe(ConditionEvents::kEventScopes);
+	std::vector<ConditionCache::Entry> entries(kNumActors);
+	std::vector<uint32_t> dirty(kNumActors);
+	ActorObservation observed;
+	for (auto& entry : entries)
+	{
+		entry.reset(kFirstActorBase, layout);
+	}
+
+	// Every program is evaluated the first frame; afterwards those that read
+	// a scope that dirtyScopes gives, or the kActor scope.
+	uint64_t nEvaluated = 0;
+	uint64_t nExpected = (uint64_t)kNumActors * kNumPrograms;
+	Clock::duration eventTime{};
+	Clock::duration activateTime{};
+	for (uint32_t frame = 0; frame < nFrames; frame++)
+	{
+		Clock::time_point start = Clock::now();
+		ConditionEvents::Tick frameStart = events.now();
+		for (uint32_t actor = frame % kEventEvery; frame && actor < kNumActors; actor += kEventEvery)
+		{
+			events.notify(actor, scopeBit(FeatureScope::kEquipment));
+			events.notify((actor + 1) % kNumActors, scopeBit(FeatureScope::kCell));
+		}
+		for (uint32_t actor = 0; actor < kNumActors; actor++)
+		{
+			dirty[actor] = events.dirtyScopes(actor, frameStart);
+		}
+		eventTime += Clock::now() - start;
+		for (uint32_t actor = 0; frame && actor < kNumActors; actor++)
+		{
+			for (uint32_t readScopes : kReadScopes)
+			{
+				nExpected += (readScopes & (dirty[actor] | scopeBit(FeatureScope::kActor))) != 0;
+			}
+		}
+
+		start = Clock::now();
+		for (uint32_t actor = 0; actor < kNumActors; actor++)
+		{
+			ConditionCache::Entry& entry = entries[actor];
+			entry.beginActivation(actor, observed, events);
+			for (auto& program : programs)
+			{
+				bool bResult;
+				if (!entry.findResult(program, 1, bResult))
+				{
+					entry.setResult(program, 1, true);
+					nEvaluated++;
+				}
+			}
+		}
+		activateTime += Clock::now() - start;
+	}
+	printf("\n%u actors, %u programs each, %u frames\n", kNumActors, kNumPrograms, nFrames);
+	printTime("events", (uint64_t)kNumActors * nFrames, "actors", eventTime);
+	printTime("activate", (uint64_t)kNumActors * nFrames, "activations", activateTime);
+
+	if (nEvaluated != nExpected)
+	{
+		fprintf(stderr, "darbench: %llu programs evaluated, not %llu\n",
+			    (unsigned long long)nEvaluated, (unsigned long long)nExpected);
+		return false;
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+//  Threads: the structures the game's threads share
+// ----------------------------------------------------------------------------
+template <class Work>
+static Clock::duration runThreads(uint32_t nThreads, Work work)
+{
+	// Runs work(thread index) on 'nThreads' threads at once, returning how
+	// long they took between them.
+	std::atomic<uint32_t> nReady{ 0 };
+	std::atomic<bool> bGo{ false };
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < nThreads; t++)
+	{
+		threads.emplace_back([&, t]()
+		{
+			nReady++;
+			while (!bGo.load(std::memory_order_acquire))
+			{
+				std::this_thread::yield();
+			}
+			work(t);
+		});
+	}
+	while (nReady < nThreads)
+	{
+		std::this_thread::yield();
+	}
+	Clock::time_point start = Clock::now();
+	bGo.store(true, std::memory_order_release);
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	return Clock::now() - start;
+}
+
+template <class Map>
+static bool benchStringDataMap(const char* name, uint32_t nThreads, uint32_t nGraphsPerThread)
+{
+	// What g_animHashmap sees: each thread generating graphs inserts the
+	// rebuilt string data of each, looks it up a few times, and takes it
+	// out again when the graph is freed. (The keys stand in for heap
+	// pointers: distinct and 16 byte aligned.)
+	static Map map;
+	const uint32_t kLookups = 4;
+	Clock::duration elapsed = runThreads(nThreads, [&](uint32_t t)
+	{
+		uintptr_t firstKey = ((uintptr_t)(t + 1) << 32) | 0x1000;
+		for (uint32_t i = 0; i < nGraphsPerThread; i++)
+		{
+			uintptr_t key = firstKey + (uintptr_t)i * 16;
+			map.findOrInsert(key, [key]() { return key ^ 1; });
+			uintptr_t value;
+			for (uint32_t j = 0; j < kLookups; j++)
+			{
+				map.find(key, value);
+			}
+			map.take(key, value);
+		}
+	});
+	uint64_t nOps = (uint64_t)nThreads * nGraphsPerThread * (kLookups + 2);
+	char label[32];
+	snprintf(label, sizeof(label), "%s/%u", name, nThreads);
+	printTime(label, nOps, "map ops", elapsed);
+	return map.size() == 0;
+}
+
+static bool benchShardedHashMap(bool bQuick)
+{
+	// The sharded map against the same map with one shard, i.e. with one
+	// lock for everything as g_animHashmap used to have.
+	typedef ShardedHashMap<uintptr_t, uintptr_t> Sharded;
+	typedef ShardedHashMap<uintptr_t, uintptr_t, 1> OneLock;
+	uint32_t nGraphsPerThread = bQuick ? 2000 : 100000;
+	bool bOK = true;
+	printf("\n(%u hardware threads)\n", std::thread::hardware_concurrency());
+	for (uint32_t nThreads = 1; nThreads <= 16; nThreads *= 2)
+	{
+		bOK &= benchStringDataMap<Sharded>("sharded", nThreads, nGraphsPerThread);
+		bOK &= benchStringDataMap<OneLock>("onelock", nThreads, nGraphsPerThread);
+	}
+	if (!bOK)
+	{
+		fprintf(stderr, "darbench: entries left in the string data map\n");
+	}
+	return bOK;
+}
+
+class BSSpinLockModel
+{
+	// The game's BSSpinLock_lock / BSSpinLock_unlock (as in CommonLibSSE's
+	// BSSpinLock, called without pause attempts): recursive for the owning
+	// thread; otherwise a failed compare-exchange is retried straight away
+	// with Sleep(0) in between, and after kFastSpinThreshold tries with
+	// Sleep(1).
+public:
+	void lock()
+	{
+		uint32_t threadID = thisThreadID();
+		if (owningThread.load(std::memory_order_relaxed) == threadID)
+		{
+			lockCount.fetch_add(1, std::memory_order_acquire);
+			return;
+		}
+		uint32_t spinCount = 0;
+		uint32_t expected = 0;
+		while (!lockCount.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+		{
+			if (++spinCount < kFastSpinThreshold)
+			{
+				std::this_thread::yield();
+			}
+			else
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			expected = 0;
+		}
+		owningThread.store(threadID, std::memory_order_relaxed);
+	}
+
+	void unlock()
+	{
+		if (lockCount.load(std::memory_order_relaxed) == 1)
+		{
+			owningThread.store(0, std::memory_order_relaxed);
+			lockCount.store(0, std::memory_order_release);
+		}
+		else
+		{
+			lockCount.fetch_sub(1, std::memory_order_release);
+		}
+	}
+
+private:
+	static const uint32_t kFastSpinThreshold = 10000;
+
+	std::atomic<uint32_t> owningThread{ 0 };
+	std::atomic<uint32_t> lockCount{ 0 };
+
+	static uint32_t thisThreadID()
+	{
+		static std::atomic<uint32_t> nThreads{ 0 };
+		thread_local uint32_t threadID = ++nThreads;
+		return threadID;
+	}
+};
+
+template <class Lock>
+static bool benchLock(const char* name, uint32_t nThreads, uint32_t nLocksPerThread)
+{
+	// Short critical sections (a shard's map lookup is a few dozen ns),
+	// with a little work between them.
+	static Lock lock;
+	static uint64_t shared[8];    // [0] counts the locks taken
+	shared[0] = 0;
+	Clock::duration elapsed = runThreads(nThreads, [&](uint32_t t)
+	{
+		uint32_t x = t + 1;
+		for (uint32_t i = 0; i < nLocksPerThread; i++)
+		{
+			lock.lock();
+			shared[0]++;
+			for (size_t k = 1; k < 8; k++)
+			{
+				shared[k] += x;
+			}
+			lock.unlock();
+			for (uint32_t j = 0; j < 32; j++)
+			{
+				x = x * 1664525 + 1013904223;
+			}
+		}
+	});
+	char label[32];
+	snprintf(label, sizeof(label), "%s/%u", name, nThreads);
+	printTime(label, (uint64_t)nThreads * nLocksPerThread, "locks", elapsed);
+	if (shared[0] != (uint64_t)nThreads * nLocksPerThread)
+	{
+		fprintf(stderr, "darbench: %s lost %lld locks\n", label,
+			    (long long)((uint64_t)nThreads * nLocksPerThread - shared[0]));
+		return false;
+	}
+	return true;
+}
+
+static bool benchLocks(bool bQuick)
+{
+	// DARGH's SpinLock against the game's BSSpinLock algorithm.
+	uint32_t nLocksPerThread = bQuick ? 2000 : 100000;
+	bool bOK = true;
+	printf("\n");
+	for (uint32_t nThreads = 2; nThreads <= 32; nThreads *= 2)
+	{
+		bOK &= benchLock<SpinLock>("spinlock", nThreads, nLocksPerThread);
+		bOK &= benchLock<BSSpinLockModel>("bslock", nThreads, nLocksPerThread);
+	}
+	return bOK;
+}
+
+int main(int argc, char** argv)
+{
+	bool bQuick = false, bVerbose = false;
+	std::filesystem::path workDir;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--quick") == 0)
+		{
+			bQuick = true;
+		}
+		else if (strcmp(argv[i], "--verbose") == 0)
+		{
+			bVerbose = true;
+		}
+		else if (argv[i][0] != '-' && workDir.empty())
+		{
+			workDir = argv[i];
+		}
+		else
+		{
+			fprintf(stderr, "usage: darbench [--quick] [--verbose] [<work folder>]\n");
+			return 2;
+		}
+	}
+	if (!bVerbose)
+	{
+		setCoreLog(NULL);
+	}
+	std::error_code ec;
+	if (workDir.empty())
+	{
+		workDir = std::filesystem::temp_directory_path(ec);
+	}
+	bool bOK = benchProject(bQuick ? kQuickSize : kFullSize, workDir);
+	bOK &= benchDirSnapshot(bQuick, workDir);
+	bOK &= benchParse(bQuick, workDir);
+	bOK &= benchConditionEvents(bQuick);
+	bOK &= benchShardedHashMap(bQuick);
+	bOK &= benchLocks(bQuick);
+	return bOK ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+// ============================================================================
+//                               darbundle.cpp
+// ----------------------------------------------------------------------------
+// Part of the open-source Dynamic Animation Replacer (DARGH).
+// 
+// Copyright (c) 2023 Nox Sidereum
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the Software), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is furnished
+// to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED AS IS, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// 
+// (The MIT License)
+// ============================================================================
+#include "ConditionsParser.h"
+#include "DARBundle.h"
+#include "DirSnapshot.h"
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// darbundle: compiles a DynamicAnimationReplacer folder into a DAR bundle
+// (see include/DARBundle.h), for dargh to load in place of the folder.
+// 
+//   darbundle <DynamicAnimationReplacer folder> [<bundle>]
+// 
+// The bundle defaults to "<folder>.darb", i.e. alongside the folder, which is
+// where dargh looks for it. Syntax errors in _conditions.txt files are
+// reported here (and recorded in the bundle, so dargh logs and rejects those
+// files just as it would the loose ones). Unknown functions and mods can only
+// be checked in game.
+// 
+// Builds anywhere with a C++17 compiler, e.g. on Linux:
+// 
+//   g++ -std=c++17 -O2 -Iinclude tools/darbundle/darbundle.cpp
+//       src/DARBundle.cpp src/DirSnapshot.cpp src/ConditionsParser.cpp
+//       -o darbundle
+// 
+// or along with the core library by CMakeLists.txt.
+// ============================================================================
+
+int main(int argc, char** argv)
+{
+	if (argc != 2 && argc != 3)
+	{
+		fprintf(stderr, "usage: darbundle <DynamicAnimationReplacer folder> [<bundle>]\n");
+		return 2;
+	}
+	std::string darDir = argv[1];
+	while (darDir.size() > 1 && (darDir.back() == '/' || darDir.back() == '\\'))
+	{
+		darDir.pop_back();
+	}
+	std::string bundlePath = (argc == 3) ? argv[2] : darDir + ".darb";
+
+	// The folder tree (directories and .hkx files only; that's all the
+	// loaders look at).
+	DirSnapshot darTree;
+	if (!darTree.build(darDir, ".hkx"))
+	{
+		fprintf(stderr, "darbundle: couldn't open %s\n", darDir.c_str());
+		return 1;
+	}
+
+	// The _conditions.txt files. Their text has to outlive 'condFiles',
+	// which points into it.
+	std::vector<std::string> sPriorities;
+	darTree.listSubdirs(darTree.childDir(darTree.root(), "_CustomConditions"), sPriorities);
+	std::vector<std::string> condFileTexts(sPriorities.size());
+	std::vector<std::pair<std::string, ParsedConditions>> condFiles;
+	int nSyntaxErrors = 0;
+	for (size_t i = 0; i < sPriorities.size(); ++i)
+	{
+		std::string condFilePath =
+			darDir + "/_CustomConditions/" + sPriorities[i] + "/_conditions.txt";
+		if (!DARGH::readConditionsFile(condFilePath, condFileTexts[i]))
+		{
+			continue;    // dargh will warn about this, as for loose files.
+		}
+		ParsedConditions parsed;
+		if (!DARGH::parseConditionSyntax(condFileTexts[i], parsed))
+		{
+			fprintf(stderr, "error: _CustomConditions/%s/_conditions.txt\n   %.*s\n",
+				    sPriorities[i].c_str(),
+				    (int)parsed.syntaxErrorLine.size(), parsed.syntaxErrorLine.data());
+			++nSyntaxErrors;
+		}
+		condFiles.emplace_back(sPriorities[i], std::move(parsed));
+	}
+
+	if (!DARBundle::write(bundlePath, darTree, condFiles))
+	{
+		fprintf(stderr, "darbundle: couldn't write %s\n", bundlePath.c_str());
+		return 1;
+	}
+
+	// Summary.
+	std::vector<std::string> hkxFiles;
+	darTree.findFiles(darTree.root(), ".hkx", hkxFiles);
+	DARBundle bundle;
+	if (!bundle.open(bundlePath, darDir))
+	{
+		fprintf(stderr, "darbundle: %s doesn't read back: %s\n", bundlePath.c_str(),
+			    bundle.error() ? bundle.error() : "missing");
+		return 1;
+	}
+	printf("%s: %d .hkx files, %d _conditions.txt files (%d with errors), %d bytes\n",
+		   bundlePath.c_str(), (int)hkxFiles.size(), (int)condFiles.size(),
+		   nSyntaxErrors, (int)bundle.numBytes());
+	return 0;
+}
\ No newline at end of file